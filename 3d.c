@@ -266,6 +266,7 @@ void quaternion_slerp( const Quaternion *o, const Quaternion *p, Quaternion *q,
 		r.x = -b.x;
 		r.y = -b.y;
 		r.z = -b.z;
+		b = ( Vector_3d ) { r.x, r.y, r.z };
 		cos_omega = -cos_omega;
 	}
 	if( cos_omega > 0.9999f ) {
@@ -337,6 +338,17 @@ void matrix_4x4_mul_vector_4d( const Matrix_4x4* m, Vector_4d v,
 	out->w = v.x * m->_03 + v.y * m->_13 + v.z * m->_23 + v.w * m->_33;
 }
 
+/*! Transforms a point the way the shaders do (m * v), for matrices that
+	are uploaded without transpose. */
+void matrix_4x4_transform_point( const Matrix_4x4 *m, Vector_3d v,
+	Vector_4d *out )
+{
+	out->x = m->_00 * v.x + m->_01 * v.y + m->_02 * v.z + m->_03;
+	out->y = m->_10 * v.x + m->_11 * v.y + m->_12 * v.z + m->_13;
+	out->z = m->_20 * v.x + m->_21 * v.y + m->_22 * v.z + m->_23;
+	out->w = m->_30 * v.x + m->_31 * v.y + m->_32 * v.z + m->_33;
+}
+
 //------------------------------------------------------------------------------
 
 /*
@@ -489,6 +501,36 @@ void matrix_4x4_mul_matrix( const Matrix_4x4 *m, const Matrix_4x4 *n,
 	out->_33 = m->_03 * n->_30 + m->_13 * n->_31 + m->_23 * n->_32 + m->_33 * n->_33;
 }
 
+/*! Extracts the clip planes left, right, bottom, top, near and far of m,
+	which transforms as the shaders do (projection * view). The normals point
+	inside and xyz of each plane is normalized. */
+void frustum_planes( const Matrix_4x4 *m, Vector_4d planes[ 6 ] ) {
+	int i;
+	planes[ 0 ] = ( Vector_4d ) { m->_30 + m->_00, m->_31 + m->_01,
+		m->_32 + m->_02, m->_33 + m->_03 };
+	planes[ 1 ] = ( Vector_4d ) { m->_30 - m->_00, m->_31 - m->_01,
+		m->_32 - m->_02, m->_33 - m->_03 };
+	planes[ 2 ] = ( Vector_4d ) { m->_30 + m->_10, m->_31 + m->_11,
+		m->_32 + m->_12, m->_33 + m->_13 };
+	planes[ 3 ] = ( Vector_4d ) { m->_30 - m->_10, m->_31 - m->_11,
+		m->_32 - m->_12, m->_33 - m->_13 };
+	planes[ 4 ] = ( Vector_4d ) { m->_30 + m->_20, m->_31 + m->_21,
+		m->_32 + m->_22, m->_33 + m->_23 };
+	planes[ 5 ] = ( Vector_4d ) { m->_30 - m->_20, m->_31 - m->_21,
+		m->_32 - m->_22, m->_33 - m->_23 };
+
+	for( i = 0; i < 6; ++i ) {
+		Vector_3d n = { planes[ i ].x, planes[ i ].y, planes[ i ].z };
+		float len = vector_3d_length( n );
+		if( 0.0f != len ) {
+			planes[ i ].x /= len;
+			planes[ i ].y /= len;
+			planes[ i ].z /= len;
+			planes[ i ].w /= len;
+		}
+	}
+}
+
 Vector_4d clip_to_eye_coordinates( const Matrix_4x4 *projection, Vector_4d u ) {
 	Matrix_4x4 inverted;
 	matrix_4x4_invert_tr( projection, &inverted );
@@ -0,0 +1,136 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+
+static __thread Arena *arena_scratch; /* of the calling thread, 0 if none */
+
+int arena_init( Arena *a, size_t size, const char *name ) {
+	memset( a, 0, sizeof( Arena ) );
+	a->name = name;
+	a->base = malloc( size );
+
+	if( !a->base ) {
+		fprintf( stderr, "Could not allocate %zu bytes for the %s arena.\n",
+			size, name );
+		return -1;
+	}
+	a->size = size;
+	return 0;
+}
+
+/*! size bytes aligned to ARENA_ALIGN, valid until the next arena_reset.
+	Returns 0 if they do not fit. */
+void *arena_alloc( Arena *a, size_t size ) {
+	size_t top = ( a->top + ARENA_ALIGN - 1 ) & ~( size_t ) ( ARENA_ALIGN - 1 );
+
+	if( top > a->size || size > a->size - top ) {
+		++a->overflows;
+		return 0;
+	}
+	a->top = top + size;
+
+	if( a->top > a->high_water ) {
+		a->high_water = a->top;
+	}
+	return a->base + top;
+}
+
+void arena_reset( Arena *a ) {
+	a->top = 0;
+}
+
+void arena_summary( const Arena *a, FILE *out ) {
+	fprintf( out, "%s arena: %.2f of %.2f MB high water, %u overflows\n",
+		a->name, a->high_water / 1048576.0, a->size / 1048576.0,
+		a->overflows );
+}
+
+void arena_free( Arena *a ) {
+	free( a->base );
+	memset( a, 0, sizeof( Arena ) );
+}
+
+/*! Makes a the scratch arena of the calling thread, 0 for none. */
+void arena_set_scratch( Arena *a ) {
+	arena_scratch = a;
+}
+
+/*! size bytes for the calling thread until scratch_free. They come from
+	its scratch arena, from the heap if it has none or it is full. */
+void *scratch_alloc( size_t size ) {
+	void *p = arena_scratch ? arena_alloc( arena_scratch, size ) : 0;
+	return p ? p : malloc( size );
+}
+
+/*! Gives back p of scratch_alloc and everything the thread allocated
+	after it from its scratch arena, p may be 0. */
+void scratch_free( void *p ) {
+	Arena *a = arena_scratch;
+
+	if( a && ( u8 * ) p >= a->base && ( u8 * ) p < a->base + a->size ) {
+		if( ( size_t ) ( ( u8 * ) p - a->base ) < a->top ) {
+			a->top = ( u8 * ) p - a->base;
+		}
+	} else {
+		free( p );
+	}
+}
+
+int pool_init( Pool *p, u32 item_size, u32 capacity, const char *name ) {
+	memset( p, 0, sizeof( Pool ) );
+	p->name = name;
+	p->item_size = ( item_size + ARENA_ALIGN - 1 ) & ~( ARENA_ALIGN - 1 );
+	p->items = malloc( ( size_t ) p->item_size * capacity + 1 );
+
+	if( !p->items ) {
+		fprintf( stderr, "Could not allocate %u items for the %s pool.\n",
+			capacity, name );
+		return -1;
+	}
+	p->capacity = capacity;
+	return 0;
+}
+
+/*! An item, the last one released first. Returns 0 if all are in use. */
+void *pool_alloc( Pool *p ) {
+	u32 i;
+
+	if( p->free_list ) {
+		i = p->free_list - 1;
+		memcpy( &p->free_list, p->items + ( size_t ) i * p->item_size,
+			sizeof( u32 ) );
+	} else if( p->fresh < p->capacity ) {
+		i = p->fresh++;
+	} else {
+		++p->overflows;
+		return 0;
+	}
+	if( ++p->count > p->high_water ) {
+		p->high_water = p->count;
+	}
+	return p->items + ( size_t ) i * p->item_size;
+}
+
+void pool_release( Pool *p, void *item ) {
+	u32 i = ( u32 ) ( ( ( u8 * ) item - p->items ) / p->item_size );
+
+	memcpy( item, &p->free_list, sizeof( u32 ) );
+	p->free_list = i + 1;
+	--p->count;
+}
+
+/*! Item i in the order pool_alloc hands out fresh ones. */
+void *pool_item( const Pool *p, u32 i ) {
+	return p->items + ( size_t ) i * p->item_size;
+}
+
+void pool_summary( const Pool *p, FILE *out ) {
+	fprintf( out, "%s pool: %u of %u items high water, %u overflows\n",
+		p->name, p->high_water, p->capacity, p->overflows );
+}
+
+void pool_free( Pool *p ) {
+	free( p->items );
+	memset( p, 0, sizeof( Pool ) );
+}
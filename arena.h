@@ -0,0 +1,34 @@
+#ifndef CTOOL_ARENA
+#define CTOOL_ARENA
+
+#include <stddef.h>
+#include "types.h"
+
+#define ARENA_ALIGN			(16U)
+#define ARENA_FRAME_SIZE	(16U << 20)	/* Per frame lists, reset at swap. */
+#define ARENA_SCRATCH_SIZE	(32U << 20)	/* Per thread, buffers of loaders. */
+
+typedef struct { /*! Linear allocator over one block. Allocations only move
+	the top up, arena_reset frees all of them at once. Not thread safe,
+	every thread allocates from its own arenas. */
+	const char *name;
+	u8 *base;
+	size_t size, top;
+	size_t high_water;		/*! Largest top since arena_init. */
+	u32 overflows;			/*! Allocations that did not fit. */
+} Arena;
+
+typedef struct { /*! Fixed number of items of one size, allocated and
+	released in O(1). Released items form a list through their first bytes,
+	items never handed out follow in order after fresh. */
+	const char *name;
+	u8 *items;
+	u32 item_size;			/*! Rounded up to ARENA_ALIGN. */
+	u32 capacity, count;
+	u32 high_water;			/*! Most items in use at once. */
+	u32 fresh;				/*! Items below were handed out before. */
+	u32 free_list;			/*! Index + 1 of a released item, 0 if none. */
+	u32 overflows;
+} Pool;
+
+#endif /* CTOOL_ARENA */
@@ -1,106 +1,234 @@
 #include "assets.h"
 
-/*! Creates a vao for a 3d model (position, normals and uv). */
-void mk_indexed_model( Vao *obj, u32 num_vertices, const float *vertices,
-	u32 idx_type_size, u32 idx_count, const void *indices, GLenum usage,
-	int skinned )
+/*! Storage flags of an immutable buffer for a glBufferData usage, only
+	static data can not be updated with glBufferSubData. */
+GLbitfield buffer_storage_flags( GLenum usage ) {
+	return ( GL_STATIC_DRAW == usage ) ? 0 : GL_DYNAMIC_STORAGE_BIT;
+}
+
+/*! Direct state access version of glVertexAttribPointer, float attribute
+	i reads from its own binding point i. */
+void vertex_array_attrib( GLuint vao, GLuint i, GLint size, GLuint buffer,
+	GLintptr offset, GLsizei stride )
+{
+	glEnableVertexArrayAttrib( vao, i );
+	glVertexArrayAttribFormat( vao, i, size, GL_FLOAT, GL_FALSE, 0 );
+	glVertexArrayVertexBuffer( vao, i, buffer, offset, stride );
+	glVertexArrayAttribBinding( vao, i, i );
+}
+
+/*! Index type of glDrawElements for indices of size bytes. */
+GLenum index_type( u32 size ) {
+	return ( 1 == size ) ? GL_UNSIGNED_BYTE : ( 2 == size ) ? GL_UNSIGNED_SHORT
+		: GL_UNSIGNED_INT;
+}
+
+/*! Creates a vao for a 3d model (position, normals and uv). The vertices
+	are either interleaved or stored as blocks of positions, normals and
+	uvs. Blocked data stays in one buffer, separate data gets one buffer per
+	stream. A second vao only reads the positions for depth only passes.
+	With direct state access nothing is bound and the buffers are immutable.
+	Indices take idx_type_size bytes, see mob_index_size. */
+void mk_indexed_model( Vao *obj, int layout, u32 num_vertices,
+	const float *vertices, u32 idx_type_size, u32 idx_count,
+	const void *indices, GLenum usage, int skinned )
 {
-	u32 vao, buffers[ 2 ];
+	u32 vaos[ 2 ], buffers[ 4 ] = { 0 };
+	u32 n = num_vertices / MOB_VERTEX_FLOATS;
+	u32 i, num_vbos = ( VBO_SEPARATE == layout ) ? 3 : 1;
+	const GLvoid *offsets[ 3 ];
+	u32 strides[ 3 ];
+	u32 streams[ 3 ];
+	u32 sizes[ 3 ] = { 3 * n, 3 * n, 2 * n };
+
+	if( VBO_INTERLEAVED == layout ) {
+//		u32 sz = skinned ? ( 2 * MAX_NUM_INFLUENCES + 8 ) : 8;
+		u32 sz = MOB_VERTEX_FLOATS * sizeof( float );
+		strides[ 0 ] = strides[ 1 ] = strides[ 2 ] = sz;
+		offsets[ 0 ] = 0;
+		offsets[ 1 ] = ( const GLvoid * ) ( 3 * sizeof( float ) );
+		offsets[ 2 ] = ( const GLvoid * ) ( 6 * sizeof( float ) );
+	} else {
+		strides[ 0 ] = strides[ 1 ] = 3 * sizeof( float );
+		strides[ 2 ] = 2 * sizeof( float );
+		offsets[ 0 ] = 0;
+		offsets[ 1 ] = ( const GLvoid * ) ( n * 3 * sizeof( float ) );
+		offsets[ 2 ] = ( const GLvoid * ) ( n * 6 * sizeof( float ) );
+	}
+	if( gl_caps.direct_state_access ) {
+		GLbitfield flags = buffer_storage_flags( usage );
+		glCreateVertexArrays( 2, vaos );
+		glCreateBuffers( num_vbos + 1, buffers );
+
+		if( VBO_SEPARATE == layout ) {
+			for( i = 0; i < 3; ++i ) {
+				glNamedBufferStorage( buffers[ i ], sizes[ i ] * sizeof( float ),
+					vertices + ( size_t ) offsets[ i ] / sizeof( float ), flags );
+				streams[ i ] = buffers[ i ];
+				offsets[ i ] = 0;
+			}
+		} else {
+			glNamedBufferStorage( buffers[ 0 ], num_vertices * sizeof( float ),
+				vertices, flags );
+			streams[ 0 ] = streams[ 1 ] = streams[ 2 ] = buffers[ 0 ];
+		}
+		glNamedBufferStorage( buffers[ num_vbos ], idx_count * idx_type_size,
+			indices, flags );
 
-	glGenVertexArrays( 1, &vao );
-	glGenBuffers( 2, buffers );
-	glBindVertexArray( vao );
-	glBindBuffer( GL_ARRAY_BUFFER, buffers[ 0 ] );
-	glBufferData( GL_ARRAY_BUFFER, num_vertices * sizeof( float ), vertices,
+		for( i = 0; i < 3; ++i ) {
+			vertex_array_attrib( vaos[ 0 ], i, ( 2 == i ) ? 2 : 3, streams[ i ],
+				( GLintptr ) offsets[ i ], strides[ i ] );
+		}
+		vertex_array_attrib( vaos[ 1 ], 0, 3, streams[ 0 ],
+			( GLintptr ) offsets[ 0 ], strides[ 0 ] );
+		glVertexArrayElementBuffer( vaos[ 0 ], buffers[ num_vbos ] );
+		glVertexArrayElementBuffer( vaos[ 1 ], buffers[ num_vbos ] );
+		goto done;
+	}
+	glGenVertexArrays( 2, vaos );
+	glGenBuffers( num_vbos + 1, buffers );
+
+	if( VBO_SEPARATE == layout ) { /* each block into its own buffer */
+		for( i = 0; i < 3; ++i ) {
+			glBindBuffer( GL_ARRAY_BUFFER, buffers[ i ] );
+			glBufferData( GL_ARRAY_BUFFER, sizes[ i ] * sizeof( float ),
+				vertices + ( size_t ) offsets[ i ] / sizeof( float ), usage );
+			streams[ i ] = buffers[ i ];
+			offsets[ i ] = 0;
+		}
+	} else {
+		glBindBuffer( GL_ARRAY_BUFFER, buffers[ 0 ] );
+		glBufferData( GL_ARRAY_BUFFER, num_vertices * sizeof( float ),
+			vertices, usage );
+		streams[ 0 ] = streams[ 1 ] = streams[ 2 ] = buffers[ 0 ];
+	}
+	glBindVertexArray( vaos[ 0 ] );
+
+	for( i = 0; i < 3; ++i ) {
+		glBindBuffer( GL_ARRAY_BUFFER, streams[ i ] );
+		glEnableVertexAttribArray( i );
+		glVertexAttribPointer( i, ( 2 == i ) ? 2 : 3, GL_FLOAT, GL_FALSE,
+			strides[ i ], offsets[ i ] );
+	}
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffers[ num_vbos ] );
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER, idx_count * idx_type_size, indices,
 		usage );
+
+	glBindVertexArray( vaos[ 1 ] );
+	glBindBuffer( GL_ARRAY_BUFFER, streams[ 0 ] );
 	glEnableVertexAttribArray( 0 );
-//	u32 sz = skinned ? ( 2 * MAX_NUM_INFLUENCES + 8 ) : 8;
-	u32 sz = 8 * sizeof( float );
-	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, sz, 0 );
-	glEnableVertexAttribArray( 1 );
-	glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, sz,
-		( const GLvoid * ) ( 3 * sizeof( float ) ) );
-	glEnableVertexAttribArray( 2 );
-	glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, sz,
-		( const GLvoid * ) ( 6 * sizeof( float ) ) );
+	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, strides[ 0 ], offsets[ 0 ] );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffers[ num_vbos ] );
 
+	glBindVertexArray( 0 );
 	glBindBuffer( GL_ARRAY_BUFFER, 0 );
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffers[ 1 ] );
-	glBufferData( GL_ELEMENT_ARRAY_BUFFER, idx_count * idx_type_size, indices,
-		usage );
 	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
-	glBindVertexArray( 0 );
-	obj->vao = vao;
-	obj->vbo = buffers[ 0 ];
+done:
+	obj->vao = vaos[ 0 ];
+	obj->depth_vao = vaos[ 1 ];
+	obj->vbo[ 0 ] = buffers[ 0 ];
+	obj->vbo[ 1 ] = ( num_vbos > 1 ) ? buffers[ 1 ] : 0;
+	obj->vbo[ 2 ] = ( num_vbos > 2 ) ? buffers[ 2 ] : 0;
+	obj->layout = layout;
 	obj->len = idx_count;
-	obj->ind = buffers[ 1 ];
+	obj->index_size = idx_type_size;
+	obj->ind = buffers[ num_vbos ];
 }
 
-void read_mob( const char* file, u16* v_size, float** v_data,
-	u16* i_size, u16** i_data, int* skinned )
+/*! Replaces the vertices and indices of a vao made by mk_indexed_model in
+	place. Layout and sizes have to be the ones it was created with, the
+	buffers need updatable storage, see buffer_storage_flags. */
+void update_indexed_model( const Vao *obj, u32 num_vertices,
+	const float *vertices, u32 idx_type_size, u32 idx_count,
+	const void *indices )
 {
-	const u16 dae_version = 141;
-	long len, tmp_v, tmp_i;
-	MOB_Header header;
+	u32 n = num_vertices / MOB_VERTEX_FLOATS;
+	u32 i, offset = 0, sizes[ 3 ] = { 3 * n, 3 * n, 2 * n };
 
-	FILE *fh = fopen( file, "r" );
-	if( !fh ) {
-		fprintf( stderr, "Could not read file %s\n", file );
-		return;
+	/* GL_ARRAY_BUFFER for all of them, it is no state of the vao */
+	if( VBO_SEPARATE == obj->layout ) {
+		for( i = 0; i < 3; ++i ) {
+			glBindBuffer( GL_ARRAY_BUFFER, obj->vbo[ i ] );
+			glBufferSubData( GL_ARRAY_BUFFER, 0, sizes[ i ] * sizeof( float ),
+				vertices + offset );
+			offset += sizes[ i ];
+		}
+	} else {
+		glBindBuffer( GL_ARRAY_BUFFER, obj->vbo[ 0 ] );
+		glBufferSubData( GL_ARRAY_BUFFER, 0, num_vertices * sizeof( float ),
+			vertices );
 	}
-	fseek( fh, 0, SEEK_END );
-	len = ftell( fh );
-	fseek( fh, 0, SEEK_SET );
-	fread( &header, 1, sizeof( MOB_Header ), fh );
+	glBindBuffer( GL_ARRAY_BUFFER, obj->ind );
+	glBufferSubData( GL_ARRAY_BUFFER, 0, idx_count * idx_type_size, indices );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+}
 
-	if( dae_version != header.version ) {
-		fprintf( stderr, "Version %u invalid.\n", header.version );
-		return;
+/*! Sized internal format for immutable storage, 0 if unknown. */
+static GLenum texture_storage_format( GLenum internal_format ) {
+	switch( internal_format ) {
+	case GL_RED: return GL_R8;
+	case GL_RG: return GL_RG8;
+	case GL_RGB: return GL_RGB8;
+	case GL_RGBA: return GL_RGBA8;
+	case GL_R8: case GL_RG8: case GL_RGB8: case GL_RGBA8:
+	case GL_SRGB8: case GL_SRGB8_ALPHA8:
+		return internal_format;
 	}
-	if( VBO_INTERLEAVED != header.type ) {
-		fprintf( stderr, "Type %u invalid.\n", header.type );
-		return;
-	}
-	tmp_v = header.vertex_size * sizeof( float );
-	tmp_i = header.index_size * sizeof( u16 );
+	return 0;
+}
+
+/*! 2D texture with immutable storage, created and filled without binding. */
+static GLuint generate_texture_dsa( int w, int h, GLenum storage_format,
+	Texture_Info *info, const void *data )
+{
+	GLuint tex;
+	GLsizei levels = 1;
 
-	if( len != ( sizeof( MOB_Header ) + tmp_i + tmp_v ) ) {
-		fprintf( stderr, "File length %lu inconsistent, vertex size: %"
-			PRIu16 ", index size: %" PRIu16  ".\n",
-			len, header.vertex_size, header.index_size );
-		return;
+	if( info->mipmap ) {
+		while( ( w | h ) >> levels ) {
+			++levels;
+		}
 	}
-	u8 *buffer1 = calloc( header.vertex_size, sizeof( float ) );
-	long read = fread( buffer1, 1, tmp_v, fh );
+	glCreateTextures( GL_TEXTURE_2D, 1, &tex );
+	glTextureStorage2D( tex, levels, storage_format, w, h );
 
-	if( read != tmp_v ) {
-		free( buffer1 );
-		fprintf( stderr,
-			"Expected to read %ld bytes for vertices, but got %ld\n",
-			read, tmp_v );
-		return;
+	if( data ) {
+		glTextureSubImage2D( tex, 0, 0, 0, w, h, info->format, info->type,
+			data );
+	}
+	if( info->mipmap ) {
+		glGenerateTextureMipmap( tex );
 	}
-	u8 *buffer2 = calloc( header.index_size, sizeof( u16 ) );
-	read = fread( buffer2, 1, tmp_i, fh );
+	glTextureParameteri( tex, GL_TEXTURE_MIN_FILTER, info->min_filter );
+	glTextureParameteri( tex, GL_TEXTURE_MAG_FILTER, info->mag_filter );
+	glTextureParameteri( tex, GL_TEXTURE_WRAP_S, info->wrap_s );
+	glTextureParameteri( tex, GL_TEXTURE_WRAP_T, info->wrap_t );
 
-	if( read != tmp_i ) {
-		free( buffer1 );
-		free( buffer2 );
-		fprintf( stderr,
-			"Expected to read %ld bytes for indices, but got %ld\n",
-			read, tmp_i );
-		return;
+	if( info->modulate ) {
+		glTexEnvi( GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_BLEND );
 	}
-	fclose( fh );
-	*v_data = ( float* ) buffer1;
-	*i_data = ( u16* ) buffer2;
-	*skinned = header.num_joints;
-	*v_size = tmp_v / sizeof( float );
-	*i_size = tmp_i / sizeof( u16 );
+#if defined GL_EXT_texture_filter_anisotropic
+	if( info->anisotropy ) {
+		float max, k = 4.0;
+		glGetFloatv( GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max );
+		glTextureParameterf( tex, GL_TEXTURE_MAX_ANISOTROPY_EXT,
+			max_f( k, max ) );
+	}
+#endif
+	return tex;
 }
 
+/*! Creates a texture from info, 2D textures of a known format go through
+	direct state access when available, everything else binds to edit. */
 GLuint generate_texture( int w, int h, Texture_Info *info, const void *data ) {
 	GLuint tex;
+	GLenum storage_format = texture_storage_format( info->internal_format );
+
+	if( gl_caps.direct_state_access && ( GL_TEXTURE_2D == info->target )
+		&& storage_format )
+	{
+		return generate_texture_dsa( w, h, storage_format, info, data );
+	}
 	glGenTextures( 1, &tex );
 	glBindTexture( info->target, tex );
 
@@ -139,86 +267,207 @@ GLuint generate_texture( int w, int h, Texture_Info *info, const void *data ) {
 	return tex;
 }
 
-int load_ktx( const char* file, u32 *tex_id,
-	GLint min_filter, GLint mag_filter,
-	GLint wrap_s, GLint wrap_t, int *img_width, int *img_height,
-	GLint unpack_override )
-{
+/*! Reads the header and the first mip-map level of a ktx file. Returns
+	the pixel data, rows padded to KTX_UNPACK_ALIGNMENT, or 0. Give it back
+	with scratch_free. */
+static u8 *read_ktx( const char *file, KTX_Header *ktx_header ) {
 	const u8 ktx_identifier[ 12 ] = {
 		0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
 	};
-	s32 unpack_alignment;
-	u32 size, i, pad = 0; // convert
-	KTX_Header ktx_header;
+	u32 size, i;
 	FILE *fh = fopen( file, "r" );
 	if( !fh ) {
 		fprintf( stderr, "Could not read file %s\n", file );
-		return -1;
+		return 0;
 	}
-	fread( &ktx_header, 1, sizeof( KTX_Header ), fh );
+	fread( ktx_header, 1, sizeof( KTX_Header ), fh );
 
 	for( i = 0; i < 12; ++i ) {
-		if( ktx_header.identifier[ i ] != ktx_identifier[ i ] ) {
+		if( ktx_header->identifier[ i ] != ktx_identifier[ i ] ) {
 			fprintf( stderr,
 				"Invalid ktx identifier in file %s:\n %s,\n expected %s\n",
-				file, ktx_header.identifier, ktx_identifier );
+				file, ktx_header->identifier, ktx_identifier );
 			fclose( fh );
-			return -1;
+			return 0;
 		}
 	}
-//	convert = ( ktx_header.endianess == 0x01020304 ) ? 1 : 0;
-	if( ktx_header.pixel_width == 0 ) ktx_header.pixel_width = 1;
-	if( ktx_header.pixel_depth == 0 ) ktx_header.pixel_depth = 1;
-	if( ktx_header.num_mipmap_levels == 0 ) ktx_header.num_mipmap_levels = 1;
-	if( ktx_header.num_array_elements == 0 ) ktx_header.num_array_elements = 1;
-	if( ktx_header.num_faces == 0 ) ktx_header.num_faces = 1;
+//	convert = ( ktx_header->endianess == 0x01020304 ) ? 1 : 0;
+	if( ktx_header->pixel_width == 0 ) ktx_header->pixel_width = 1;
+	if( ktx_header->pixel_depth == 0 ) ktx_header->pixel_depth = 1;
+	if( ktx_header->num_mipmap_levels == 0 ) ktx_header->num_mipmap_levels = 1;
+	if( ktx_header->num_array_elements == 0 ) ktx_header->num_array_elements = 1;
+	if( ktx_header->num_faces == 0 ) ktx_header->num_faces = 1;
 	// skip meta data for now
-	fseek( fh, ktx_header.num_bytes_key_value, SEEK_CUR );
+	fseek( fh, ktx_header->num_bytes_key_value, SEEK_CUR );
+
+	if( 1 != ktx_header->num_mipmap_levels ) {
+		fprintf( stderr,
+			"Error: loader for ktx files supports only one mip-map level.\n" );
+		fclose( fh );
+		return 0;
+	}
+	fread( &size, 1, 4, fh );
+	u32 s = ktx_header->pixel_width * ktx_header->pixel_height;
+
+	if( ktx_header->format == GL_RGB ) {
+		if( 3 * s != size ) {
+			fprintf( stderr,
+				"Image size %u is not equal 3 * width * height: %u.\n",
+				size, s );
+		}
+	}
+	u8 *pixel_data = scratch_alloc( size );
+
+	if( pixel_data && size != fread( pixel_data, 1, size, fh ) ) {
+		fprintf( stderr, "Could not read %u bytes of pixels from %s\n",
+			size, file );
+		scratch_free( pixel_data );
+		pixel_data = 0;
+	}
+	// if( 1 == convert ) { whoever has big endian could implemented that }
+	fclose( fh );
+	return pixel_data;
+}
+
+int load_ktx( const char* file, u32 *tex_id,
+	GLint min_filter, GLint mag_filter,
+	GLint wrap_s, GLint wrap_t, int *img_width, int *img_height,
+	GLint unpack_override )
+{
+	s32 unpack_alignment;
+	KTX_Header ktx_header;
+	u8 *pixel_data = read_ktx( file, &ktx_header );
+
+	if( !pixel_data ) {
+		return -1;
+	}
 	glGetIntegerv( GL_UNPACK_ALIGNMENT, &unpack_alignment );
 
 	if( KTX_UNPACK_ALIGNMENT != unpack_alignment ) {
 		glPixelStorei( GL_UNPACK_ALIGNMENT, unpack_override );
 	}
-	if( 1 != ktx_header.num_mipmap_levels ) {
-		fprintf( stderr,
-			"Error: loader for ktx files supports only one mip-map level.\n" );
-		return -1;
+	Texture_Info info = { GL_TEXTURE_2D,
+		ktx_header.internal_format, ktx_header.format, GL_UNSIGNED_BYTE,
+		min_filter, mag_filter, wrap_s, wrap_t, 1, 1, 0 };
+	*tex_id = generate_texture(
+		ktx_header.pixel_width, ktx_header.pixel_height,
+		&info, pixel_data );
+	*img_width = ktx_header.pixel_width;
+	*img_height = ktx_header.pixel_height;
+	scratch_free( pixel_data );
+
+	if( KTX_UNPACK_ALIGNMENT != unpack_alignment ) {
+		glPixelStorei( GL_UNPACK_ALIGNMENT, unpack_alignment );
 	}
-	i = 0;
-//	while( i < ktx_header.num_mipmap_levels ) {
-		fread( &size, 1, 4, fh );
-		u32 s = ktx_header.pixel_width * ktx_header.pixel_height;
+	return 0;
+}
 
-		if( ktx_header.format == GL_RGB ) {
-			if( 3 * s != size ) {
-				fprintf( stderr,
-					"Image size %u is not equal 3 * width * height: %u.\n",
-					size, s );
+/*! Fills the mip-map levels of an image from level 0 with a 2 x 2 box
+	filter, like glGenerateMipmap. */
+static void image_build_mipmaps( Image *img ) {
+	u32 l, x, y, i;
+
+	for( l = 1; l < img->num_levels; ++l ) {
+		u32 sw = img->width >> ( l - 1 ), sh = img->height >> ( l - 1 );
+		u32 w = img->width >> l, h = img->height >> l;
+		const u8 *src = img->pixels + img->offsets[ l - 1 ];
+		u8 *dst = img->pixels + img->offsets[ l ];
+
+		if( !sw ) sw = 1;
+		if( !sh ) sh = 1;
+		if( !w ) w = 1;
+		if( !h ) h = 1;
+
+		for( y = 0; y < h; ++y ) {
+			u32 y0 = 2 * y < sh ? 2 * y : sh - 1;
+			u32 y1 = 2 * y + 1 < sh ? 2 * y + 1 : sh - 1;
+			for( x = 0; x < w; ++x ) {
+				u32 x0 = 2 * x < sw ? 2 * x : sw - 1;
+				u32 x1 = 2 * x + 1 < sw ? 2 * x + 1 : sw - 1;
+				for( i = 0; i < 4; ++i ) {
+					dst[ ( y * w + x ) * 4 + i ] = ( src[ ( y0 * sw + x0 ) * 4 + i ]
+						+ src[ ( y0 * sw + x1 ) * 4 + i ]
+						+ src[ ( y1 * sw + x0 ) * 4 + i ]
+						+ src[ ( y1 * sw + x1 ) * 4 + i ] + 2 ) / 4;
+				}
 			}
 		}
-		pad = 4 - ( size % 4 );
-		i += ( size + pad );
-		u8 *pixel_data = malloc( size );
+	}
+}
 
-		if( !pixel_data ) {
-			fclose( fh );
-			return -1;
+/*! Reads a ktx file into memory for the software rasterizer. RGB and
+	luminance images are expanded to RGBA8, the mip-maps are built as for
+	the GL texture. */
+int load_ktx_image( const char *file, Image *img ) {
+	KTX_Header ktx_header;
+	u8 *pixel_data = read_ktx( file, &ktx_header );
+	u32 channels, pitch, size = 0, x, y, l;
+
+	if( !pixel_data ) {
+		return -1;
+	}
+	switch( ktx_header.format ) {
+		case GL_RGBA: channels = 4; break;
+		case GL_RGB: channels = 3; break;
+		case GL_LUMINANCE: channels = 1; break;
+		default: channels = 0;
+	}
+	if( !channels || GL_UNSIGNED_BYTE != ktx_header.type ) {
+		fprintf( stderr, "Format 0x%x of %s not supported.\n",
+			ktx_header.format, file );
+		scratch_free( pixel_data );
+		return -1;
+	}
+	img->width = ktx_header.pixel_width;
+	img->height = ktx_header.pixel_height;
+
+	for( l = 0; l < IMAGE_MAX_LEVELS; ++l ) {
+		u32 w = img->width >> l, h = img->height >> l;
+		img->offsets[ l ] = size;
+		size += ( w ? w : 1 ) * ( h ? h : 1 ) * 4;
+		if( w <= 1 && h <= 1 ) break;
+	}
+	img->num_levels = ( l < IMAGE_MAX_LEVELS ) ? l + 1 : IMAGE_MAX_LEVELS;
+	img->pixels = malloc( size );
+
+	if( !img->pixels ) {
+		scratch_free( pixel_data );
+		return -1;
+	}
+	pitch = ( img->width * channels + KTX_UNPACK_ALIGNMENT - 1 )
+		& ~( KTX_UNPACK_ALIGNMENT - 1 );
+
+	for( y = 0; y < img->height; ++y ) {
+		const u8 *src = pixel_data + y * pitch;
+		u8 *dst = img->pixels + y * img->width * 4;
+
+		for( x = 0; x < img->width; ++x, src += channels, dst += 4 ) {
+			dst[ 0 ] = src[ 0 ];
+			dst[ 1 ] = src[ channels > 1 ? 1 : 0 ];
+			dst[ 2 ] = src[ channels > 2 ? 2 : 0 ];
+			dst[ 3 ] = ( 4 == channels ) ? src[ 3 ] : 255;
 		}
-		fread( pixel_data, 1, size, fh );
-		// if( 1 == convert ) { whoever has big endian could implemented that }
-		Texture_Info info = { GL_TEXTURE_2D,
-			ktx_header.internal_format, ktx_header.format, GL_UNSIGNED_BYTE,
-			min_filter, mag_filter, wrap_s, wrap_t, 1, 1, 0 };
-		*tex_id = generate_texture(
-			ktx_header.pixel_width, ktx_header.pixel_height,
-			&info, pixel_data );
-		*img_width = ktx_header.pixel_width;
-		*img_height = ktx_header.pixel_height;
-		free( pixel_data );
-//	}
-	if( KTX_UNPACK_ALIGNMENT != unpack_alignment ) {
-		glPixelStorei( GL_UNPACK_ALIGNMENT, unpack_alignment );
 	}
-	fclose( fh );
+	scratch_free( pixel_data );
+	image_build_mipmaps( img );
+	return 0;
+}
+
+/*! Replaces every mip-map level of a texture made by load_ktx with an
+	image of load_ktx_image, -1 if the size changed. */
+int update_texture( const Texture *tex, const Image *img ) {
+	u32 l;
+
+	if( img->width != tex->width || img->height != tex->height ) {
+		return -1;
+	}
+	glBindTexture( GL_TEXTURE_2D, tex->tex_id );
+
+	for( l = 0; l < img->num_levels; ++l ) {
+		u32 w = img->width >> l, h = img->height >> l;
+		glTexSubImage2D( GL_TEXTURE_2D, l, 0, 0, w ? w : 1, h ? h : 1,
+			GL_RGBA, GL_UNSIGNED_BYTE, img->pixels + img->offsets[ l ] );
+	}
+	glBindTexture( GL_TEXTURE_2D, 0 );
 	return 0;
 }
@@ -6,17 +6,20 @@
 enum { VBO_SEPARATE, VBO_BLOCKED, VBO_INTERLEAVED };
 
 typedef struct { /*! Represents a vertex array object. */
-	u16 vao;				/*! Handle to a vao. */
-	u16 vbo;				/*! Handle to the vertex buffer. */
-	u16 len;				/*! Number of elements to draw. */
+	u32 vao;				/*! Handle to a vao. */
+	u32 depth_vao;			/*! Vao with the positions only, depth pre-pass. */
+	u32 vbo[ 3 ];			/*! Vertex buffers, one per stream if separate. */
+	u16 layout;				/*! VBO_SEPARATE, VBO_BLOCKED or VBO_INTERLEAVED. */
+	u16 index_size;			/*! Bytes per index, 1, 2 or 4. */
 	union {
-		u16 ind;			/*! Handle to the index buffer. */
-		u16 draw_mode;		/*! OpenGL draw mode. */
+		u32 ind;			/*! Handle to the index buffer. */
+		u32 draw_mode;		/*! OpenGL draw mode. */
 	};
+	u32 len;				/*! Number of elements to draw. */
 } Vao;
 
 typedef struct {
-	u16 tex_id;
+	u32 tex_id;
 	u16 width;
 	u16 height;
 	u16 depth;
@@ -26,6 +29,18 @@ typedef struct {
 	s16 scale_y;
 } Texture;
 
+#define IMAGE_MAX_LEVELS	(16U)
+
+typedef struct { /*! Texture pixels kept in memory, RGBA8, first row is t = 0.
+	Mip-map level i starts at pixels + offsets[ i ]. */
+	u16 width;
+	u16 height;
+	u16 num_levels;
+	u16 pad_unused;
+	u32 offsets[ IMAGE_MAX_LEVELS ];
+	u8 *pixels;
+} Image;
+
 typedef struct { /*! For generating textures in OpenGL. */
 	u32 target;
 	u32 internal_format;
@@ -52,6 +67,35 @@ typedef struct {
 	u16 index_size;
 } MOB_Header;
 
+#define MOB_VERSION			(141U)	/* Sizes in the header, 16 bit indices. */
+#define MOB_VERSION_LARGE	(142U)	/* MOB_Sizes after the header. */
+#define MOB_VERSION_MESHLETS	(143U)	/* Then the number of meshlets. */
+
+typedef struct { /*! Follows a MOB_Header of version MOB_VERSION_LARGE, whose
+	sizes are 0. The same sizes without their 16 bit limit, then the
+	vertices and indices of index_bytes each. */
+	u32 vertex_size;
+	u32 normal_size;
+	u32 coord_size;
+	u32 index_size;
+	u32 index_bytes;		/*! 1, 2 or 4, see mob_index_size. */
+} MOB_Sizes;
+
+typedef struct { /*! Cluster of at most MOB_MESHLET_VERTICES vertices and
+	MOB_MESHLET_TRIANGLES triangles. A mob of version MOB_VERSION_MESHLETS
+	has a u32 with their number after its MOB_Sizes and the meshlets after
+	its indices, their index ranges cover the indices in order. */
+	u32 first_index;
+	u32 index_count;
+	float bounds[ 4 ];		/*! Sphere around the vertices, w = radius. */
+	float cone[ 4 ];		/*! Axis of the normals, w = sine of the largest
+								angle to it, above 1 if they turn away. */
+} MOB_Meshlet;
+
+#define MOB_MESHLET_VERTICES	(64U)
+#define MOB_MESHLET_TRIANGLES	(124U)
+#define MOB_MAX_HEADER	( sizeof( MOB_Header ) + sizeof( MOB_Sizes ) + 4 )
+
 #define KTX_UNPACK_ALIGNMENT	(4U)
 
 typedef struct {
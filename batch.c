@@ -0,0 +1,558 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assets.h"
+#include "batch.h"
+
+/*! Grows an array to hold at least need elements, doubling its capacity. */
+static void *batch_grow( void *data, u32 *max, u32 need, size_t size ) {
+	u32 n = *max ? *max : 16;
+
+	if( need <= *max ) {
+		return data;
+	}
+	while( n < need ) {
+		n *= 2;
+	}
+	void *tmp = realloc( data, n * size );
+
+	if( tmp ) {
+		*max = n;
+	}
+	return tmp;
+}
+
+/*! Bounding sphere around the center of the axis aligned box of the
+	positions, w = radius. */
+Vector_4d mesh_bounding_sphere( const float *v_data, u32 num_vertices,
+	u32 stride )
+{
+	Vector_3d lo = { 0.0f, 0.0f, 0.0f }, hi = lo, c;
+	float r2 = 0.0f;
+	u32 i;
+
+	for( i = 0; i < num_vertices; ++i ) {
+		const float *v = v_data + i * stride;
+		if( 0 == i || v[ 0 ] < lo.x ) lo.x = v[ 0 ];
+		if( 0 == i || v[ 1 ] < lo.y ) lo.y = v[ 1 ];
+		if( 0 == i || v[ 2 ] < lo.z ) lo.z = v[ 2 ];
+		if( 0 == i || v[ 0 ] > hi.x ) hi.x = v[ 0 ];
+		if( 0 == i || v[ 1 ] > hi.y ) hi.y = v[ 1 ];
+		if( 0 == i || v[ 2 ] > hi.z ) hi.z = v[ 2 ];
+	}
+	vector_3d_add( lo, hi, &c );
+	vector_3d_scale( &c, 0.5f );
+
+	for( i = 0; i < num_vertices; ++i ) {
+		const float *v = v_data + i * stride;
+		Vector_3d d = { v[ 0 ] - c.x, v[ 1 ] - c.y, v[ 2 ] - c.z };
+		float l = vector_3d_dot( d, d );
+		if( l > r2 ) r2 = l;
+	}
+	return ( Vector_4d ) { c.x, c.y, c.z, sqrtf( r2 ) };
+}
+
+/*! Copies the meshlets of mesh m, or makes one of all its triangles that
+	is never back-facing if there are none. */
+static void batch_set_meshlets( Batch *b, const Mesh *m,
+	const MOB_Meshlet *meshlets, u32 num_meshlets )
+{
+	Meshlet *ml = b->meshlets + m->first_meshlet;
+	u32 i;
+
+	memset( ml, 0, m->meshlet_count * sizeof( Meshlet ) );
+
+	if( !num_meshlets ) {
+		ml->bounds = m->bounds;
+		ml->cone = ( Vector_4d ) { 0.0f, 0.0f, 0.0f, 2.0f };
+		ml->first_index = m->first_index;
+		ml->index_count = m->index_count;
+		return;
+	}
+	for( i = 0; i < num_meshlets; ++i ) {
+		const MOB_Meshlet *in = &meshlets[ i ];
+		ml[ i ].bounds = ( Vector_4d ) { in->bounds[ 0 ], in->bounds[ 1 ],
+			in->bounds[ 2 ], in->bounds[ 3 ] };
+		ml[ i ].cone = ( Vector_4d ) { in->cone[ 0 ], in->cone[ 1 ],
+			in->cone[ 2 ], in->cone[ 3 ] };
+		ml[ i ].first_index = m->first_index + in->first_index;
+		ml[ i ].index_count = in->index_count;
+	}
+}
+
+/*! Appends a mesh in any mob layout to the shared vertex and index arrays,
+	the vertices are kept interleaved (position, normal, uv). The meshlets
+	of the mob may be 0. Returns the mesh index or -1. */
+int batch_add_mesh( Batch *b, int layout, u32 v_size, const float *v_data,
+	u32 i_size, const u32 *i_data, const MOB_Meshlet *meshlets,
+	u32 num_meshlets )
+{
+	u32 i, n = v_size / BATCH_VERTEX_FLOATS;
+
+	float *vertices = batch_grow( b->vertices, &b->max_floats,
+		b->num_floats + v_size, sizeof( float ) );
+	if( !vertices ) return -1;
+	b->vertices = vertices;
+
+	u32 *indices = batch_grow( b->indices, &b->max_indices,
+		b->num_indices + i_size, sizeof( u32 ) );
+	if( !indices ) return -1;
+	b->indices = indices;
+
+	Mesh *meshes = batch_grow( b->meshes, &b->max_meshes,
+		b->num_meshes + 1, sizeof( Mesh ) );
+	if( !meshes ) return -1;
+	b->meshes = meshes;
+
+	u32 count = num_meshlets ? num_meshlets : 1;
+	Meshlet *ml = batch_grow( b->meshlets, &b->max_meshlets,
+		b->num_meshlets + count, sizeof( Meshlet ) );
+	if( !ml ) return -1;
+	b->meshlets = ml;
+
+	Mesh *m = &b->meshes[ b->num_meshes ];
+	m->first_index = b->num_indices;
+	m->index_count = i_size;
+	m->base_vertex = b->num_floats / BATCH_VERTEX_FLOATS;
+	m->vertex_count = n;
+
+	for( i = 0; i < n; ++i ) {
+		mob_vertex( layout, n, v_data, i,
+			b->vertices + b->num_floats + i * BATCH_VERTEX_FLOATS );
+	}
+	m->bounds = mesh_bounding_sphere( b->vertices + b->num_floats, n,
+		BATCH_VERTEX_FLOATS );
+	m->first_meshlet = b->num_meshlets;
+	m->meshlet_count = count;
+	batch_set_meshlets( b, m, meshlets, num_meshlets );
+	memcpy( b->indices + b->num_indices, i_data, i_size * sizeof( u32 ) );
+	b->num_meshlets += count;
+	b->num_floats += v_size;
+	b->num_indices += i_size;
+	return b->num_meshes++;
+}
+
+/*! Marks draw for the next batch_update, which uploads the range of the
+	marked draws. */
+static void batch_mark_dirty( Batch *b, u32 draw ) {
+	if( b->dirty_first == b->dirty_end ) {
+		b->dirty_first = draw;
+		b->dirty_end = draw + 1;
+	} else if( draw < b->dirty_first ) {
+		b->dirty_first = draw;
+	} else if( draw >= b->dirty_end ) {
+		b->dirty_end = draw + 1;
+	}
+}
+
+/*! Moves the bounding sphere of the mesh of a draw into world space. */
+static void batch_set_bounds( Batch *b, u32 draw, const Matrix_4x4 *model ) {
+	const Vector_4d *s = &b->meshes[ b->draw_meshes[ draw ] ].bounds;
+	Vector_4d c;
+	matrix_4x4_mul_vector_4d( model, ( Vector_4d ) { s->x, s->y, s->z, 1.0f },
+		&c );
+
+	Vector_3d ax = { model->_00, model->_01, model->_02 };
+	Vector_3d ay = { model->_10, model->_11, model->_12 };
+	Vector_3d az = { model->_20, model->_21, model->_22 };
+	float scale = vector_3d_length( ax );
+	if( vector_3d_length( ay ) > scale ) scale = vector_3d_length( ay );
+	if( vector_3d_length( az ) > scale ) scale = vector_3d_length( az );
+	c.w = s->w * scale;
+	b->bounds[ draw ] = c;
+	batch_mark_dirty( b, draw );
+}
+
+/*! Sets the model matrix of a draw, the matrix is expected in the same
+	layout that render() uploads with transpose set. Also moves the bounding
+	sphere of the draw into world space. An unchanged matrix is not
+	uploaded again. */
+void batch_set_model( Batch *b, u32 draw, const Matrix_4x4 *model ) {
+	Matrix_4x4 t;
+	matrix_4x4_transpose( model, &t );
+
+	if( draw < b->num_draws
+		&& !memcmp( &t, &b->draws[ draw ].model, sizeof( Matrix_4x4 ) ) )
+	{
+		return;
+	}
+	b->draws[ draw ].model = t;
+	batch_set_bounds( b, draw, model );
+}
+
+void batch_set_flags( Batch *b, u32 draw, u32 flags ) {
+	if( b->draw_flags[ draw ] != flags ) {
+		b->draw_flags[ draw ] = flags;
+		batch_mark_dirty( b, draw );
+	}
+}
+
+/*! Adds one draw of a mesh, a command for each of its meshlets. Returns
+	the draw index or -1. */
+int batch_add_draw( Batch *b, u32 mesh, const Matrix_4x4 *model ) {
+	const Mesh *m = &b->meshes[ mesh ];
+	u32 i, max = b->max_commands; /* the second array updates max_commands */
+
+	Draw_Command *commands = batch_grow( b->commands, &max,
+		b->num_commands + m->meshlet_count, sizeof( Draw_Command ) );
+	if( !commands ) return -1;
+	b->commands = commands;
+
+	u32 *cmd_meshlets = batch_grow( b->cmd_meshlets, &b->max_commands,
+		b->num_commands + m->meshlet_count, sizeof( u32 ) );
+	if( !cmd_meshlets ) return -1;
+	b->cmd_meshlets = cmd_meshlets;
+
+	if( b->num_draws == b->max_draws ) { /* the per draw arrays grow together */
+		u32 n = b->max_draws ? 2 * b->max_draws : 16;
+		Draw_Data *draws = realloc( b->draws, n * sizeof( Draw_Data ) );
+		if( !draws ) return -1;
+		b->draws = draws;
+
+		Vector_4d *bounds = realloc( b->bounds, n * sizeof( Vector_4d ) );
+		if( !bounds ) return -1;
+		b->bounds = bounds;
+
+		u32 *draw_meshes = realloc( b->draw_meshes, n * sizeof( u32 ) );
+		if( !draw_meshes ) return -1;
+		b->draw_meshes = draw_meshes;
+
+		u32 *draw_flags = realloc( b->draw_flags, n * sizeof( u32 ) );
+		if( !draw_flags ) return -1;
+		b->draw_flags = draw_flags;
+		b->max_draws = n;
+	}
+
+	for( i = 0; i < m->meshlet_count; ++i ) {
+		const Meshlet *ml = &b->meshlets[ m->first_meshlet + i ];
+		Draw_Command *c = &b->commands[ b->num_commands ];
+		c->count = ml->index_count;
+		c->instance_count = 1;
+		c->first_index = ml->first_index;
+		c->base_vertex = m->base_vertex;
+		c->base_instance = b->num_draws;
+		b->cmd_meshlets[ b->num_commands++ ] = m->first_meshlet + i;
+	}
+	b->draw_meshes[ b->num_draws ] = mesh;
+	b->draw_flags[ b->num_draws ] = 0;
+	batch_set_model( b, b->num_draws, model );
+	return b->num_draws++;
+}
+
+/*! Replaces the vertices, indices and meshlets of a mesh with ones of the
+	same counts, in the CPU copies and, once uploaded, in the buffers. The
+	bounds of its draws and their commands follow. Returns -1 if a count
+	changed, the ranges of the other meshes stay where they are. */
+int batch_update_mesh( Batch *b, u32 mesh, int layout, u32 v_size,
+	const float *v_data, u32 i_size, const u32 *i_data,
+	const MOB_Meshlet *meshlets, u32 num_meshlets )
+{
+	Mesh *m = &b->meshes[ mesh ];
+	u32 i, n = v_size / BATCH_VERTEX_FLOATS;
+	float *v = b->vertices + m->base_vertex * BATCH_VERTEX_FLOATS;
+	Matrix_4x4 model;
+
+	if( n != m->vertex_count || i_size != m->index_count
+		|| ( num_meshlets ? num_meshlets : 1 ) != m->meshlet_count )
+	{
+		return -1;
+	}
+	for( i = 0; i < n; ++i ) {
+		mob_vertex( layout, n, v_data, i, v + i * BATCH_VERTEX_FLOATS );
+	}
+	m->bounds = mesh_bounding_sphere( v, n, BATCH_VERTEX_FLOATS );
+	batch_set_meshlets( b, m, meshlets, num_meshlets );
+	memcpy( b->indices + m->first_index, i_data, i_size * sizeof( u32 ) );
+
+	for( i = 0; i < b->num_draws; ++i ) {
+		if( mesh == b->draw_meshes[ i ] ) {
+			matrix_4x4_transpose( &b->draws[ i ].model, &model );
+			batch_set_bounds( b, i, &model );
+		}
+	}
+	for( i = 0; i < b->num_commands; ++i ) {
+		const Meshlet *ml = &b->meshlets[ b->cmd_meshlets[ i ] ];
+		b->commands[ i ].count = ml->index_count;
+		b->commands[ i ].first_index = ml->first_index;
+	}
+	if( !b->vbo ) {
+		return 0;
+	}
+	float *positions = scratch_alloc( n * 3 * sizeof( float ) );
+	float *attribs = scratch_alloc( n * BATCH_ATTRIB_FLOATS
+		* sizeof( float ) );
+	void *packed = scratch_alloc( i_size * b->index_size + 1 );
+
+	if( !positions || !attribs || !packed ) {
+		scratch_free( positions );
+		scratch_free( attribs );
+		scratch_free( packed );
+		return -1;
+	}
+	mob_pack_indices( i_data, i_size, b->index_size, packed );
+	for( i = 0; i < n; ++i ) {
+		memcpy( positions + i * 3, v + i * BATCH_VERTEX_FLOATS,
+			3 * sizeof( float ) );
+		memcpy( attribs + i * BATCH_ATTRIB_FLOATS,
+			v + i * BATCH_VERTEX_FLOATS + 3,
+			BATCH_ATTRIB_FLOATS * sizeof( float ) );
+	}
+	/* GL_ARRAY_BUFFER also for the indices, it is no state of the vao */
+	glBindBuffer( GL_ARRAY_BUFFER, b->vbo );
+	glBufferSubData( GL_ARRAY_BUFFER, m->base_vertex * 3 * sizeof( float ),
+		n * 3 * sizeof( float ), positions );
+	glBindBuffer( GL_ARRAY_BUFFER, b->attrib_vbo );
+	glBufferSubData( GL_ARRAY_BUFFER,
+		m->base_vertex * BATCH_ATTRIB_FLOATS * sizeof( float ),
+		n * BATCH_ATTRIB_FLOATS * sizeof( float ), attribs );
+	glBindBuffer( GL_ARRAY_BUFFER, b->ibo );
+	glBufferSubData( GL_ARRAY_BUFFER, m->first_index * b->index_size,
+		i_size * b->index_size, packed );
+
+	if( gl_caps.multi_draw_indirect ) {
+		glBindBuffer( GL_ARRAY_BUFFER, b->meshlet_buffer );
+		glBufferSubData( GL_ARRAY_BUFFER, m->first_meshlet * sizeof( Meshlet ),
+			m->meshlet_count * sizeof( Meshlet ),
+			b->meshlets + m->first_meshlet );
+		glBindBuffer( GL_ARRAY_BUFFER, b->cmd_buffer );
+		glBufferSubData( GL_ARRAY_BUFFER, 0,
+			b->num_commands * sizeof( Draw_Command ), b->commands );
+	}
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	scratch_free( positions );
+	scratch_free( attribs );
+	scratch_free( packed );
+	return 0;
+}
+
+/*! Creates the batch objects by binding them to edit. */
+static void batch_create_bound( const Batch *b, GLenum usage,
+	const float *positions, const float *attribs, const void *indices,
+	u32 *vaos, u32 *buffers )
+{
+	u32 n = b->num_floats / BATCH_VERTEX_FLOATS;
+	u32 sz = BATCH_ATTRIB_FLOATS * sizeof( float );
+
+	glGenVertexArrays( 2, vaos );
+	glGenBuffers( 9, buffers );
+	glBindVertexArray( vaos[ 0 ] );
+	glBindBuffer( GL_ARRAY_BUFFER, buffers[ 0 ] );
+	glBufferData( GL_ARRAY_BUFFER, n * 3 * sizeof( float ), positions, usage );
+	glEnableVertexAttribArray( 0 );
+	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, buffers[ 6 ] );
+	glBufferData( GL_ARRAY_BUFFER, n * sz, attribs, usage );
+	glEnableVertexAttribArray( 1 );
+	glVertexAttribPointer( 1, 3, GL_FLOAT, GL_FALSE, sz, 0 );
+	glEnableVertexAttribArray( 2 );
+	glVertexAttribPointer( 2, 2, GL_FLOAT, GL_FALSE, sz,
+		( const GLvoid * ) ( 3 * sizeof( float ) ) );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffers[ 1 ] );
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER, b->num_indices * b->index_size,
+		indices, usage );
+
+	glBindVertexArray( vaos[ 1 ] );
+	glBindBuffer( GL_ARRAY_BUFFER, buffers[ 0 ] );
+	glEnableVertexAttribArray( 0 );
+	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 0, 0 );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, buffers[ 1 ] );
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+
+	if( gl_caps.multi_draw_indirect ) {
+		/* written by the culling every frame */
+		glBindBuffer( GL_DRAW_INDIRECT_BUFFER, buffers[ 2 ] );
+		glBufferData( GL_DRAW_INDIRECT_BUFFER,
+			b->num_commands * sizeof( Draw_Command ), b->commands,
+			GL_DYNAMIC_DRAW );
+		glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers[ 3 ] );
+		glBufferData( GL_SHADER_STORAGE_BUFFER,
+			b->num_draws * sizeof( Draw_Data ), b->draws, GL_DYNAMIC_DRAW );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers[ 4 ] );
+		glBufferData( GL_SHADER_STORAGE_BUFFER,
+			b->num_draws * sizeof( Vector_4d ), b->bounds, GL_DYNAMIC_DRAW );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers[ 5 ] );
+		glBufferData( GL_SHADER_STORAGE_BUFFER,
+			b->num_draws * sizeof( u32 ), b->draw_flags, GL_DYNAMIC_DRAW );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers[ 7 ] );
+		glBufferData( GL_SHADER_STORAGE_BUFFER,
+			b->num_meshlets * sizeof( Meshlet ), b->meshlets, usage );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, buffers[ 8 ] );
+		glBufferData( GL_SHADER_STORAGE_BUFFER,
+			b->num_commands * sizeof( u32 ), b->cmd_meshlets, usage );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+	}
+}
+
+/*! Creates the batch objects with direct state access and immutable
+	storage, the commands and the per draw shader storage stay updatable. */
+static void batch_create_dsa( const Batch *b, GLenum usage,
+	const float *positions, const float *attribs, const void *indices,
+	u32 *vaos, u32 *buffers )
+{
+	u32 n = b->num_floats / BATCH_VERTEX_FLOATS;
+	u32 sz = BATCH_ATTRIB_FLOATS * sizeof( float );
+	GLbitfield flags = buffer_storage_flags( usage );
+	GLbitfield dynamic = buffer_storage_flags( GL_DYNAMIC_DRAW );
+
+	glCreateVertexArrays( 2, vaos );
+	glCreateBuffers( 9, buffers );
+	glNamedBufferStorage( buffers[ 0 ], n * 3 * sizeof( float ), positions,
+		flags );
+	glNamedBufferStorage( buffers[ 6 ], n * sz, attribs, flags );
+	glNamedBufferStorage( buffers[ 1 ], b->num_indices * b->index_size,
+		indices, flags );
+
+	vertex_array_attrib( vaos[ 0 ], 0, 3, buffers[ 0 ], 0, 3 * sizeof( float ) );
+	vertex_array_attrib( vaos[ 0 ], 1, 3, buffers[ 6 ], 0, sz );
+	vertex_array_attrib( vaos[ 0 ], 2, 2, buffers[ 6 ], 3 * sizeof( float ), sz );
+	glVertexArrayElementBuffer( vaos[ 0 ], buffers[ 1 ] );
+	vertex_array_attrib( vaos[ 1 ], 0, 3, buffers[ 0 ], 0, 3 * sizeof( float ) );
+	glVertexArrayElementBuffer( vaos[ 1 ], buffers[ 1 ] );
+
+	if( gl_caps.multi_draw_indirect ) {
+		glNamedBufferStorage( buffers[ 2 ],
+			b->num_commands * sizeof( Draw_Command ), b->commands, dynamic );
+		glNamedBufferStorage( buffers[ 3 ],
+			b->num_draws * sizeof( Draw_Data ), b->draws, dynamic );
+		glNamedBufferStorage( buffers[ 4 ],
+			b->num_draws * sizeof( Vector_4d ), b->bounds, dynamic );
+		glNamedBufferStorage( buffers[ 5 ],
+			b->num_draws * sizeof( u32 ), b->draw_flags, dynamic );
+		glNamedBufferStorage( buffers[ 7 ],
+			b->num_meshlets * sizeof( Meshlet ), b->meshlets, flags );
+		glNamedBufferStorage( buffers[ 8 ],
+			b->num_commands * sizeof( u32 ), b->cmd_meshlets, flags );
+	}
+}
+
+/*! Creates the shared vaos and the index buffer, with multi draw indirect
+	also the command and shader storage buffers. The positions go into their
+	own buffer so depth only passes fetch nothing else. Uses direct state
+	access when the context has it. One multi draw reads all meshes with
+	the same index type, the smallest for the largest mesh. Returns -1 if
+	out of memory, nothing is created then. */
+int batch_upload( Batch *b, GLenum usage ) {
+	u32 vaos[ 2 ], buffers[ 9 ];
+	u32 i, n = b->num_floats / BATCH_VERTEX_FLOATS, max_vertices = 0;
+	float *positions = scratch_alloc( n * 3 * sizeof( float ) + 1 );
+	float *attribs = scratch_alloc( n * BATCH_ATTRIB_FLOATS
+		* sizeof( float ) + 1 );
+	void *indices;
+
+	for( i = 0; i < b->num_meshes; ++i ) {
+		if( b->meshes[ i ].vertex_count > max_vertices ) {
+			max_vertices = b->meshes[ i ].vertex_count;
+		}
+	}
+	b->index_size = mob_index_size( max_vertices );
+	indices = scratch_alloc( b->num_indices * b->index_size + 1 );
+
+	if( !positions || !attribs || !indices ) {
+		fprintf( stderr, "Out of memory for %u batched vertices.\n", n );
+		scratch_free( positions );
+		scratch_free( attribs );
+		scratch_free( indices );
+		return -1;
+	}
+	mob_pack_indices( b->indices, b->num_indices, b->index_size, indices );
+
+	for( i = 0; i < n; ++i ) {
+		const float *v = b->vertices + i * BATCH_VERTEX_FLOATS;
+		memcpy( positions + i * 3, v, 3 * sizeof( float ) );
+		memcpy( attribs + i * BATCH_ATTRIB_FLOATS, v + 3,
+			BATCH_ATTRIB_FLOATS * sizeof( float ) );
+	}
+	if( gl_caps.direct_state_access && b->num_draws ) { /* storage > 0 */
+		batch_create_dsa( b, usage, positions, attribs, indices, vaos,
+			buffers );
+	} else {
+		batch_create_bound( b, usage, positions, attribs, indices, vaos,
+			buffers );
+	}
+	scratch_free( positions );
+	scratch_free( attribs );
+	scratch_free( indices );
+	b->vao = vaos[ 0 ];
+	b->depth_vao = vaos[ 1 ];
+	b->vbo = buffers[ 0 ];
+	b->attrib_vbo = buffers[ 6 ];
+	b->ibo = buffers[ 1 ];
+	b->cmd_buffer = buffers[ 2 ];
+	b->draw_buffer = buffers[ 3 ];
+	b->bounds_buffer = buffers[ 4 ];
+	b->flags_buffer = buffers[ 5 ];
+	b->meshlet_buffer = buffers[ 7 ];
+	b->cmd_meshlet_buffer = buffers[ 8 ];
+	b->dirty_first = b->dirty_end = 0;
+	return 0;
+}
+
+/*! Uploads draw data, bounds and flags of the draws that changed since
+	the last upload. */
+void batch_update( Batch *b ) {
+	if( b->dirty_first != b->dirty_end && gl_caps.multi_draw_indirect ) {
+		u32 first = b->dirty_first, n = b->dirty_end - b->dirty_first;
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, b->draw_buffer );
+		glBufferSubData( GL_SHADER_STORAGE_BUFFER, first * sizeof( Draw_Data ),
+			n * sizeof( Draw_Data ), b->draws + first );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, b->bounds_buffer );
+		glBufferSubData( GL_SHADER_STORAGE_BUFFER, first * sizeof( Vector_4d ),
+			n * sizeof( Vector_4d ), b->bounds + first );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, b->flags_buffer );
+		glBufferSubData( GL_SHADER_STORAGE_BUFFER, first * sizeof( u32 ),
+			n * sizeof( u32 ), b->draw_flags + first );
+		glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+		b->dirty_first = b->dirty_end = 0;
+	}
+}
+
+static void batch_draw( Batch *b, u32 vao ) {
+	batch_update( b );
+	glBindVertexArray( vao );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, BATCH_DRAW_BINDING,
+		b->draw_buffer );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, b->cmd_buffer );
+	glMultiDrawElementsIndirect( GL_TRIANGLES, index_type( b->index_size ), 0,
+		b->num_commands, 0 );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+	glBindVertexArray( 0 );
+}
+
+/*! Draws every command of the batch with one glMultiDrawElementsIndirect,
+	the program and its per frame uniforms must already be set. */
+void batch_render( Batch *b ) {
+	glBindTexture( GL_TEXTURE_2D, b->tex_id );
+	batch_draw( b, b->vao );
+}
+
+/*! Same as batch_render, but only the positions are fetched. For the depth
+	pre-pass. */
+void batch_render_depth( Batch *b ) {
+	batch_draw( b, b->depth_vao );
+}
+
+void batch_free( Batch *b ) {
+	u32 vaos[ 2 ] = { b->vao, b->depth_vao };
+	u32 buffers[ 9 ] = { b->vbo, b->ibo, b->cmd_buffer, b->draw_buffer,
+		b->bounds_buffer, b->flags_buffer, b->attrib_vbo, b->meshlet_buffer,
+		b->cmd_meshlet_buffer };
+
+	if( b->vao ) {
+		glDeleteVertexArrays( 2, vaos );
+		glDeleteBuffers( 9, buffers );
+	}
+	free( b->meshes );
+	free( b->meshlets );
+	free( b->commands );
+	free( b->cmd_meshlets );
+	free( b->draws );
+	free( b->bounds );
+	free( b->draw_meshes );
+	free( b->draw_flags );
+	free( b->vertices );
+	free( b->indices );
+	memset( b, 0, sizeof( Batch ) );
+}
@@ -0,0 +1,85 @@
+#ifndef CTOOL_BATCH
+#define CTOOL_BATCH
+
+#include "types.h"
+#include "3d.h"
+
+typedef struct { /*! Layout expected by glMultiDrawElementsIndirect. */
+	u32 count;
+	u32 instance_count;
+	u32 first_index;
+	s32 base_vertex;
+	u32 base_instance;		/*! Draw of the command. */
+} Draw_Command;
+
+typedef struct { /*! Per draw data (std430), indexed by gl_BaseInstanceARB. */
+	Matrix_4x4 model;
+} Draw_Data;
+
+enum { /* draw flags */
+	DRAW_OCCLUDER = 1,		/*! Rasterized by the software occlusion pass. */
+	DRAW_OCCLUDED = 2		/*! Hidden behind occluders this frame. */
+};
+
+typedef struct { /*! Cluster of triangles of a mesh (std430), culled on
+	its own, see MOB_Meshlet. */
+	Vector_4d bounds;		/*! Bounding sphere in model space, w = radius. */
+	Vector_4d cone;			/*! Normal cone, w = sine of its half angle. */
+	u32 first_index;		/*! In the batch. */
+	u32 index_count;
+	u32 padding[ 2 ];		/*! To the std430 array stride. */
+} Meshlet;
+
+typedef struct { /*! Range of one mesh inside the buffers of a batch. */
+	u32 first_index;
+	u32 index_count;
+	s32 base_vertex;
+	u32 vertex_count;
+	Vector_4d bounds;		/*! Bounding sphere in model space, w = radius. */
+	u32 first_meshlet;		/*! One for all triangles if the mob had none. */
+	u32 meshlet_count;
+} Mesh;
+
+typedef struct { /*! Meshes sharing one vao and one texture. */
+	u32 vao;
+	u32 depth_vao;			/*! Positions only, for the depth pre-pass. */
+	u32 vbo;				/*! Positions. */
+	u32 attrib_vbo;			/*! Interleaved normals and uvs. */
+	u32 ibo;
+	u32 cmd_buffer;			/*! GL_DRAW_INDIRECT_BUFFER with the commands. */
+	u32 meshlet_buffer;		/*! Shader storage buffer with the meshlets. */
+	u32 cmd_meshlet_buffer;	/*! -"- with the meshlet of each command. */
+	u32 draw_buffer;		/*! Shader storage buffer with the draw data. */
+	u32 bounds_buffer;		/*! Shader storage buffer with the draw bounds. */
+	u32 flags_buffer;		/*! Shader storage buffer with the draw flags. */
+	u32 tex_id;
+	u32 dirty_first, dirty_end;	/*! Draws changed since the last upload. */
+	u32 num_meshes, max_meshes;
+	u32 num_draws, max_draws;
+	u32 num_commands, max_commands;
+	u32 num_meshlets, max_meshlets;
+	u32 num_floats, max_floats;
+	u32 num_indices, max_indices;
+	Mesh *meshes;
+	Meshlet *meshlets;
+	Draw_Command *commands;	/*! One per meshlet of each draw, in draw order. */
+	u32 *cmd_meshlets;		/*! Meshlet of each command. */
+	Draw_Data *draws;
+	Vector_4d *bounds;		/*! World space bounding sphere of each draw. */
+	u32 *draw_meshes;		/*! Mesh index of each draw. */
+	u32 *draw_flags;		/*! DRAW_OCCLUDER, DRAW_OCCLUDED. */
+	float *vertices;		/*! Interleaved position, normal, uv. */
+	u32 *indices;			/*! From the base vertex of their mesh. */
+	u32 index_size;			/*! Bytes per index in the ibo, 1, 2 or 4. */
+} Batch;
+
+#define BATCH_VERTEX_FLOATS		(8U) /* position, normal, uv */
+#define BATCH_ATTRIB_FLOATS		(5U) /* normal, uv */
+#define BATCH_DRAW_BINDING		(0U) /* SSBO binding of the draw data */
+#define BATCH_BOUNDS_BINDING	(1U) /* -"- of the draw bounds */
+#define BATCH_COMMAND_BINDING	(2U) /* -"- of the commands, for culling */
+#define BATCH_FLAGS_BINDING		(3U) /* -"- of the draw flags */
+#define BATCH_MESHLET_BINDING	(7U) /* -"- of the meshlets */
+#define BATCH_CMD_MESHLET_BINDING	(8U) /* -"- of the meshlet of each command */
+
+#endif /* CTOOL_BATCH */
@@ -0,0 +1,251 @@
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "profiler.h"
+#include "clusters.h"
+
+#define CLUSTER_CUTOFF		(256.0f) /* One over the smallest contribution. */
+
+/*! Distance at which the attenuated intensity drops below 1 / 256. */
+static float cluster_light_radius( const Light *l, float far ) {
+	float m = fmaxf( l->intensities.x,
+		fmaxf( l->intensities.y, l->intensities.z ) );
+
+	if( l->intensities.w <= 0.0f ) {
+		return far;
+	}
+	return sqrtf( fmaxf( CLUSTER_CUTOFF * m - 1.0f, 0.0f )
+		/ l->intensities.w );
+}
+
+/*! Spreads the tiles over the part x0, y0 to x1, y1 of the normalized
+	device coordinates, rendered into width x height pixels. */
+void clusters_set_window( Clusters *c, float x0, float y0, float x1,
+	float y1, float width, float height )
+{
+	u32 i;
+
+	c->scale_x = CLUSTER_X / width;
+	c->scale_y = CLUSTER_Y / height;
+
+	for( i = 0; i <= CLUSTER_X; ++i ) {
+		c->tile_x[ i ] = ( x0 + ( x1 - x0 ) * i / CLUSTER_X ) * c->tan_x;
+	}
+	for( i = 0; i <= CLUSTER_Y; ++i ) {
+		c->tile_y[ i ] = ( y0 + ( y1 - y0 ) * i / CLUSTER_Y ) * c->tan_y;
+	}
+}
+
+/*! Derives the froxel grid from the perspective, slices are exponential in
+	depth so the clusters stay roughly cubic. */
+void clusters_setup( Clusters *c, const Perspective *p, float width,
+	float height )
+{
+	float log_range = logf( p->far / p->near );
+	u32 i;
+
+	c->near = p->near;
+	c->far = p->far;
+	c->z_scale = CLUSTER_Z / log_range;
+	c->z_bias = -( CLUSTER_Z * logf( p->near ) ) / log_range;
+	c->tan_x = tanf( 0.5f * p->fov );
+	c->tan_y = c->tan_x / p->view_aspect;
+
+	for( i = 0; i < CLUSTER_Z; ++i ) {
+		c->slice_near[ i ] = p->near * powf( p->far / p->near,
+			( float ) i / CLUSTER_Z );
+		c->slice_far[ i ] = p->near * powf( p->far / p->near,
+			( float ) ( i + 1 ) / CLUSTER_Z );
+	}
+	clusters_set_window( c, -1.0f, -1.0f, 1.0f, 1.0f, width, height );
+	if( !c->indices ) {
+		c->indices = malloc( CLUSTER_Z * CLUSTER_SLICE_INDICES * sizeof( u32 ) );
+	}
+	if( gl_caps.shader_storage && !c->light_buffer ) {
+		u32 buffers[ 3 ];
+		glGenBuffers( 3, buffers );
+		c->light_buffer = buffers[ 0 ];
+		c->grid_buffer = buffers[ 1 ];
+		c->index_buffer = buffers[ 2 ];
+	}
+}
+
+/*! Bins the lights touching one depth slice into its clusters. The view
+	space box of every cluster is tested against four lights at a time. */
+static void cluster_slice_job( void *arg ) {
+	const Cluster_Job *job = arg;
+	Clusters *c = job->clusters;
+	u32 k = job->slice, n = 0, count = 0, l, tx, ty;
+	float dn = c->slice_near[ k ], df = c->slice_far[ k ];
+	float lx[ CLUSTER_MAX_LIGHTS + 3 ], ly[ CLUSTER_MAX_LIGHTS + 3 ];
+	float lr2[ CLUSTER_MAX_LIGHTS + 3 ];	/*! radius^2 - dz^2 */
+	u32 li[ CLUSTER_MAX_LIGHTS + 3 ];
+	u32 *out = c->indices + k * CLUSTER_SLICE_INDICES;
+	PROF_SCOPE( "cluster slice" );
+
+	for( l = 0; l < c->num_lights; ++l ) {
+		const Vector_4d *v = &c->view_lights[ l ];
+		float depth = -v->z;
+		float dz = ( depth < dn ) ? dn - depth
+			: ( ( depth > df ) ? depth - df : 0.0f );
+
+		if( dz <= v->w ) {
+			lx[ n ] = v->x;
+			ly[ n ] = v->y;
+			lr2[ n ] = v->w * v->w - dz * dz;
+			li[ n++ ] = l;
+		}
+	}
+	for( l = n; l & 3; ++l ) { /* padding never passes */
+		lx[ l ] = ly[ l ] = 0.0f;
+		lr2[ l ] = -1.0f;
+	}
+	for( ty = 0; ty < CLUSTER_Y; ++ty ) {
+		float y0 = c->tile_y[ ty ], y1 = c->tile_y[ ty + 1 ];
+		float y_lo = fminf( y0 * dn, y0 * df ), y_hi = fmaxf( y1 * dn, y1 * df );
+
+		for( tx = 0; tx < CLUSTER_X; ++tx ) {
+			float x0 = c->tile_x[ tx ], x1 = c->tile_x[ tx + 1 ];
+			float x_lo = fminf( x0 * dn, x0 * df );
+			float x_hi = fmaxf( x1 * dn, x1 * df );
+			u32 *cell = &c->grid[ 2 * ( tx + CLUSTER_X * ( ty + CLUSTER_Y * k ) ) ];
+			u32 start = count;
+#if defined(__SSE2__)
+			const __m128 zero = _mm_setzero_ps( );
+			__m128 xl = _mm_set1_ps( x_lo ), xh = _mm_set1_ps( x_hi );
+			__m128 yl = _mm_set1_ps( y_lo ), yh = _mm_set1_ps( y_hi );
+
+			for( l = 0; l < n; l += 4 ) {
+				__m128 x = _mm_loadu_ps( lx + l ), y = _mm_loadu_ps( ly + l );
+				__m128 dx = _mm_max_ps( _mm_max_ps( _mm_sub_ps( xl, x ),
+					_mm_sub_ps( x, xh ) ), zero );
+				__m128 dy = _mm_max_ps( _mm_max_ps( _mm_sub_ps( yl, y ),
+					_mm_sub_ps( y, yh ) ), zero );
+				__m128 d2 = _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) );
+				int mask = _mm_movemask_ps(
+					_mm_cmple_ps( d2, _mm_loadu_ps( lr2 + l ) ) );
+
+				while( mask && count < CLUSTER_SLICE_INDICES ) {
+					out[ count++ ] = li[ l + __builtin_ctz( mask ) ];
+					mask &= mask - 1;
+				}
+			}
+#else
+			for( l = 0; l < n; ++l ) {
+				float dx = fmaxf( fmaxf( x_lo - lx[ l ], lx[ l ] - x_hi ), 0.0f );
+				float dy = fmaxf( fmaxf( y_lo - ly[ l ], ly[ l ] - y_hi ), 0.0f );
+
+				if( dx * dx + dy * dy <= lr2[ l ]
+					&& count < CLUSTER_SLICE_INDICES )
+				{
+					out[ count++ ] = li[ l ];
+				}
+			}
+#endif
+			cell[ 0 ] = start;
+			cell[ 1 ] = count - start;
+		}
+	}
+	c->slice_count[ k ] = count;
+}
+
+/*! Moves the point lights into view space and starts one binning job per
+	depth slice. Directional lights (position.w = 0) are skipped. */
+void clusters_begin( Clusters *c, Job_System *js, const Matrix_4x4 *view,
+	const Light *lights, u32 num_lights )
+{
+	u32 i;
+
+	c->jobs = js;
+	c->num_lights = 0;
+
+	for( i = 0; c->indices && i < num_lights
+		&& c->num_lights < CLUSTER_MAX_LIGHTS; ++i )
+	{
+		const Light *l = &lights[ i ];
+		Vector_3d p = { l->position.x, l->position.y, l->position.z };
+		Cluster_Light *cl = &c->lights[ c->num_lights ];
+		Vector_4d *v = &c->view_lights[ c->num_lights ];
+
+		if( 0.0f == l->position.w ) {
+			continue;
+		}
+		cl->position = ( Vector_4d ) { p.x, p.y, p.z,
+			cluster_light_radius( l, c->far ) };
+		cl->intensities = l->intensities;
+		matrix_4x4_transform_point( view, p, v );
+		v->w = cl->position.w;
+		c->num_lights++;
+	}
+	for( i = 0; i < CLUSTER_Z; ++i ) {
+		c->slice_jobs[ i ].clusters = c;
+		c->slice_jobs[ i ].slice = i;
+		jobs_submit( js, &c->counter, cluster_slice_job, &c->slice_jobs[ i ] );
+	}
+}
+
+/*! Waits for the binning jobs and uploads the lights, the grid and the
+	light indices. The slices are uploaded one after another, the offsets in
+	the grid are moved accordingly. */
+void clusters_end( Clusters *c ) {
+	u32 i, k, base = 0;
+	PROF_SCOPE( "clusters end" );
+
+	jobs_wait( c->jobs, &c->counter );
+
+	for( k = 0; k < CLUSTER_Z; ++k ) {
+		u32 *cell = &c->grid[ 2 * CLUSTER_X * CLUSTER_Y * k ];
+
+		for( i = 0; i < CLUSTER_X * CLUSTER_Y; ++i ) {
+			cell[ 2 * i ] += base;
+		}
+		base += c->slice_count[ k ];
+	}
+	if( !c->light_buffer ) {
+		return;
+	}
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, c->light_buffer );
+	glBufferData( GL_SHADER_STORAGE_BUFFER,
+		( c->num_lights ? c->num_lights : 1 ) * sizeof( Cluster_Light ),
+		c->lights, GL_STREAM_DRAW );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, c->grid_buffer );
+	glBufferData( GL_SHADER_STORAGE_BUFFER, sizeof( c->grid ), c->grid,
+		GL_STREAM_DRAW );
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, c->index_buffer );
+	glBufferData( GL_SHADER_STORAGE_BUFFER,
+		( base ? base : 1 ) * sizeof( u32 ), 0, GL_STREAM_DRAW );
+
+	for( k = 0, base = 0; k < CLUSTER_Z; ++k ) {
+		if( c->slice_count[ k ] ) {
+			glBufferSubData( GL_SHADER_STORAGE_BUFFER, base * sizeof( u32 ),
+				c->slice_count[ k ] * sizeof( u32 ),
+				c->indices + k * CLUSTER_SLICE_INDICES );
+		}
+		base += c->slice_count[ k ];
+	}
+	glBindBuffer( GL_SHADER_STORAGE_BUFFER, 0 );
+}
+
+/*! Binds the buffers and sets the grid scale of a clustered program. */
+void clusters_bind( const Clusters *c, const Shader *p ) {
+	glUniform4f( p->uniform_locations[ ULOC_CLUSTER_SCALE ],
+		c->scale_x, c->scale_y, c->z_scale, c->z_bias );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, CLUSTER_LIGHTS_BINDING,
+		c->light_buffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, CLUSTER_GRID_BINDING,
+		c->grid_buffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, CLUSTER_INDEX_BINDING,
+		c->index_buffer );
+}
+
+void clusters_free( Clusters *c ) {
+	u32 buffers[ 3 ] = { c->light_buffer, c->grid_buffer, c->index_buffer };
+
+	if( c->light_buffer ) {
+		glDeleteBuffers( 3, buffers );
+	}
+	free( c->indices );
+	memset( c, 0, sizeof( Clusters ) );
+}
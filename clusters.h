@@ -0,0 +1,50 @@
+#ifndef CTOOL_CLUSTERS
+#define CTOOL_CLUSTERS
+
+#include "types.h"
+#include "3d.h"
+#include "jobs.h"
+
+#define CLUSTER_X				(16U)	/* Froxel grid, tiles in X. */
+#define CLUSTER_Y				(9U)	/* -"- in Y. */
+#define CLUSTER_Z				(24U)	/* Exponential depth slices. */
+#define CLUSTER_COUNT			(CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+#define CLUSTER_MAX_LIGHTS		(1024U)
+#define CLUSTER_SLICE_INDICES	(CLUSTER_X * CLUSTER_Y * 64U)
+#define CLUSTER_LIGHTS_BINDING	(4U) /* SSBO binding of the lights */
+#define CLUSTER_GRID_BINDING	(5U) /* -"- of the offset and count pairs */
+#define CLUSTER_INDEX_BINDING	(6U) /* -"- of the light indices */
+
+typedef struct { /*! Point light as the fragment shader reads it (std430). */
+	Vector_4d position;		/*! World space, w = radius of influence. */
+	Color intensities;		/*! .a = attenuation */
+} Cluster_Light;
+
+typedef struct Clusters Clusters;
+
+typedef struct { /*! Argument of a slice job. */
+	Clusters *clusters;
+	u32 slice;
+} Cluster_Job;
+
+struct Clusters { /*! Lights binned into a view space froxel grid. */
+	float near, far;
+	float z_scale, z_bias;	/*! slice = log( depth ) * z_scale + z_bias */
+	float scale_x, scale_y;	/*! Tiles per pixel. */
+	float tan_x, tan_y;		/*! Half the field of view. */
+	float slice_near[ CLUSTER_Z ], slice_far[ CLUSTER_Z ];
+	float tile_x[ CLUSTER_X + 1 ];	/*! Tile edges, x / depth in view space. */
+	float tile_y[ CLUSTER_Y + 1 ];
+	Job_System *jobs;
+	Job_Counter counter;
+	u32 num_lights;
+	Cluster_Light lights[ CLUSTER_MAX_LIGHTS ];
+	Vector_4d view_lights[ CLUSTER_MAX_LIGHTS ];	/*! View space, w = radius. */
+	u32 grid[ CLUSTER_COUNT * 2 ];	/*! Offset and count of every cluster. */
+	u32 slice_count[ CLUSTER_Z ];
+	u32 *indices;					/*! CLUSTER_SLICE_INDICES per slice. */
+	Cluster_Job slice_jobs[ CLUSTER_Z ];
+	u32 light_buffer, grid_buffer, index_buffer;
+};
+
+#endif /* CTOOL_CLUSTERS */
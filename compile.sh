@@ -1 +1,7 @@
-gcc -Wall -O2 -o test main.c -lm -ldl -lX11 -lXi -lXrandr -lGL
+gcc -Wall -O2 -o test main.c -lm -ldl -lpthread -lX11 -lXi -lXrandr -lGL -lEGL
+gcc -Wall -O2 -o gen_scene tools/gen_scene.c -lm
+gcc -Wall -O2 -o vt_tile tools/vt_tile.c
+gcc -Wall -O2 -o cook tools/cook.c -lm -lpthread
+gcc -Wall -O2 -o import_mesh tools/import_mesh.c -lm -lpthread
+# Instrumented build, GL calls timed and redundant state counted:
+# gcc -Wall -O2 -DGL_LITE_TRACE -o test main.c -lm -ldl -lpthread -lX11 -lXi -lXrandr -lGL -lEGL
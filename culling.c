@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "culling.h"
+#include "batch.h"
+#include "shading.h"
+
+/*! Frustum test of whole draws, sets visible[ i ] to 1 if the sphere i
+	is not flagged occluded and not completely outside one of the planes. */
+void cull_spheres( const Vector_4d planes[ 6 ], const Vector_4d *spheres,
+	const u32 *flags, u32 count, u8 *visible )
+{
+	u32 i;
+	int p;
+
+	for( i = 0; i < count; ++i ) {
+		const Vector_4d *s = &spheres[ i ];
+		visible[ i ] = !( flags[ i ] & DRAW_OCCLUDED );
+
+		for( p = 0; p < 6; ++p ) {
+			const Vector_4d *q = &planes[ p ];
+			if( q->x * s->x + q->y * s->y + q->z * s->z + q->w < -s->w ) {
+				visible[ i ] = 0;
+			}
+		}
+	}
+}
+
+/*! 0 if the sphere s is more than slack outside one of the planes. */
+static int cull_sphere_inside( const Vector_4d planes[ 6 ], Vector_4d s,
+	float slack )
+{
+	int p;
+
+	for( p = 0; p < 6; ++p ) {
+		const Vector_4d *q = &planes[ p ];
+		if( q->x * s.x + q->y * s.y + q->z * s.z + q->w
+			< -s.w - slack * ( 1.0f + s.w ) )
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/*! CPU reference of cull_compute_shader, writes the instance count of
+	every command of b into commands. Meshlets are tested against the
+	planes with their draw, with cones also against eye in world space:
+	a meshlet whose normal cone points away from eye for all of its
+	bounding sphere has only back faces. Mirroring draws skip that test.
+	A slack above 0 keeps the meshlets within it of a plane, below 0 drops
+	them, cull_verify brackets the GPU with both. */
+void cull_commands( const Batch *b, const Vector_4d planes[ 6 ], Vector_3d eye,
+	int cones, float slack, Draw_Command *commands )
+{
+	u32 i, d = 0xFFFFFFFFU;
+	Vector_4d e = { 0.0f, 0.0f, 0.0f, 1.0f };
+	float scale = 1.0f;
+	int cone_test = 0;
+
+	for( i = 0; i < b->num_commands; ++i ) {
+		const Meshlet *m = &b->meshlets[ b->cmd_meshlets[ i ] ];
+		const Matrix_4x4 *model;
+		Vector_4d s;
+
+		if( d != b->commands[ i ].base_instance ) { /* consecutive per draw */
+			Matrix_4x4 inverse;
+			d = b->commands[ i ].base_instance;
+			model = &b->draws[ d ].model;
+
+			/* columns as the shaders read the model matrix */
+			Vector_3d ax = { model->array[ 0 ], model->array[ 1 ],
+				model->array[ 2 ] };
+			Vector_3d ay = { model->array[ 4 ], model->array[ 5 ],
+				model->array[ 6 ] };
+			Vector_3d az = { model->array[ 8 ], model->array[ 9 ],
+				model->array[ 10 ] };
+			Vector_3d n;
+			scale = vector_3d_length( ax );
+			if( vector_3d_length( ay ) > scale ) scale = vector_3d_length( ay );
+			if( vector_3d_length( az ) > scale ) scale = vector_3d_length( az );
+			vector_3d_cross( ay, az, &n );
+			cone_test = cones && vector_3d_dot( ax, n ) > 0.0f
+				&& matrix_4x4_invert( model, &inverse );
+
+			if( cone_test ) { /* eye in model space, where the cones are */
+				matrix_4x4_transform_point( &inverse, eye, &e );
+			}
+		}
+		model = &b->draws[ d ].model;
+		matrix_4x4_transform_point( model, ( Vector_3d ) { m->bounds.x,
+			m->bounds.y, m->bounds.z }, &s );
+		s.w = m->bounds.w * scale;
+		commands[ i ].instance_count = !( b->draw_flags[ d ] & DRAW_OCCLUDED )
+			&& cull_sphere_inside( planes, b->bounds[ d ], slack )
+			&& cull_sphere_inside( planes, s, slack );
+
+		if( commands[ i ].instance_count && cone_test && m->cone.w <= 1.0f )
+		{
+			Vector_3d v = { m->bounds.x - e.x, m->bounds.y - e.y,
+				m->bounds.z - e.z };
+			Vector_3d axis = { m->cone.x, m->cone.y, m->cone.z };
+			float len = vector_3d_length( v );
+
+			if( vector_3d_dot( v, axis ) > m->cone.w * len
+				+ m->bounds.w * ( 1.0f + m->cone.w ) + slack * ( 1.0f + len ) )
+			{
+				commands[ i ].instance_count = 0;
+			}
+		}
+	}
+}
+
+/*! Culls the meshlets of all draws of a batch on the CPU and uploads the
+	commands, for contexts without compute shaders. */
+void cull_batch_cpu( Batch *b, const Vector_4d planes[ 6 ], Vector_3d eye,
+	int cones )
+{
+	batch_update( b );
+	cull_commands( b, planes, eye, cones, 0.0f, b->commands );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, b->cmd_buffer );
+	glBufferSubData( GL_DRAW_INDIRECT_BUFFER, 0,
+		b->num_commands * sizeof( Draw_Command ), b->commands );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+}
+
+/*! Runs the frustum test of all draws and their meshlets of a batch on
+	the GPU, the instance count of each indirect command is set to 0 or 1.
+	With cones set meshlets facing away from eye are dropped too, only
+	while back faces are culled. */
+void cull_batch_gpu( Batch *b, const Shader *p, const Vector_4d planes[ 6 ],
+	Vector_3d eye, int cones )
+{
+	const s16 *uni_loc = p->uniform_locations;
+	batch_update( b );
+	glUseProgram( p->program_id );
+	glUniform1ui( uni_loc[ ULOC_COUNT ], b->num_commands );
+	glUniform4fv( uni_loc[ ULOC_PLANES ], 6, ( const GLfloat * ) planes );
+	glUniform4f( uni_loc[ ULOC_EYE ], eye.x, eye.y, eye.z, cones ? 1.0f : 0.0f );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, BATCH_DRAW_BINDING,
+		b->draw_buffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, BATCH_BOUNDS_BINDING,
+		b->bounds_buffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, BATCH_COMMAND_BINDING,
+		b->cmd_buffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, BATCH_FLAGS_BINDING,
+		b->flags_buffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, BATCH_MESHLET_BINDING,
+		b->meshlet_buffer );
+	glBindBufferBase( GL_SHADER_STORAGE_BUFFER, BATCH_CMD_MESHLET_BINDING,
+		b->cmd_meshlet_buffer );
+	glDispatchCompute( ( b->num_commands + CULL_GROUP_SIZE - 1 )
+		/ CULL_GROUP_SIZE, 1, 1 );
+	glMemoryBarrier( GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT );
+	glUseProgram( 0 );
+}
+
+/*! Reads back the commands written by cull_batch_gpu and compares them
+	with cull_commands. Meshlets within a small epsilon of a plane or of
+	their cone are skipped, the GPU may round them either way. Returns the
+	number of mismatches, -1 if out of memory. This stalls the pipeline. */
+int cull_verify( const Batch *b, const Vector_4d planes[ 6 ], Vector_3d eye,
+	int cones )
+{
+	const float eps = 1e-4f;
+	int mismatches = 0;
+	u32 i, n = b->num_commands;
+	Draw_Command *keep = scratch_alloc( n * sizeof( Draw_Command ) + 1 );
+	Draw_Command *drop = scratch_alloc( n * sizeof( Draw_Command ) + 1 );
+	Draw_Command *commands = scratch_alloc( n * sizeof( Draw_Command ) + 1 );
+
+	if( !keep || !drop || !commands ) {
+		scratch_free( keep );
+		scratch_free( drop );
+		scratch_free( commands );
+		return -1;
+	}
+	cull_commands( b, planes, eye, cones, eps, keep );
+	cull_commands( b, planes, eye, cones, -eps, drop );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, b->cmd_buffer );
+	glGetBufferSubData( GL_DRAW_INDIRECT_BUFFER, 0,
+		n * sizeof( Draw_Command ), commands );
+	glBindBuffer( GL_DRAW_INDIRECT_BUFFER, 0 );
+
+	for( i = 0; i < n; ++i ) {
+		if( keep[ i ].instance_count == drop[ i ].instance_count
+			&& keep[ i ].instance_count != commands[ i ].instance_count )
+		{
+			fprintf( stderr, "cull mismatch: command %u of draw %u cpu %u "
+				"gpu %u\n", i, b->commands[ i ].base_instance,
+				keep[ i ].instance_count, commands[ i ].instance_count );
+			++mismatches;
+		}
+	}
+	scratch_free( keep );
+	scratch_free( drop );
+	scratch_free( commands );
+	return mismatches;
+}
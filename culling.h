@@ -0,0 +1,9 @@
+#ifndef CTOOL_CULLING
+#define CTOOL_CULLING
+
+#include "types.h"
+#include "3d.h"
+
+#define CULL_GROUP_SIZE		(64U) /* local_size_x of cull_compute_shader */
+
+#endif /* CTOOL_CULLING */
@@ -11,6 +11,9 @@
 #include <dlfcn.h>
 #define GLDECL
 #define HC_GL_LIST_WIN32
+#define HC_GL_LIST_CORE_LINUX \
+	GLC( ActiveTexture ) \
+	GLC( BlendEquation )
 #endif /* __linux__ */
 
 #if defined(_WIN32)
@@ -28,35 +31,59 @@ typedef ptrdiff_t GLsizeiptr;
 #define HC_GL_LIST_WIN32 \
 	GLE( void,		ActiveTexture,	GLenum ) \
 	GLE( void,		BlendEquation,	GLenum )
+#define HC_GL_LIST_CORE_LINUX
 
 #endif /* _WIN32 */
 
+#include <stdio.h>
 #include <GL/gl.h>
 
 #define HC_GL_LIST \
 	GLE( void,	AttachShader,		GLuint, GLuint ) \
+	GLE( void,	BeginConditionalRender,	GLuint, GLenum ) \
+	GLE( void,	BeginQuery,			GLenum, GLuint ) \
 	GLE( void,	BindBuffer,			GLenum, GLuint ) \
 	GLE( void,	BindBufferBase,		GLenum, GLuint, GLuint ) \
+	GLE( void,	BindFramebuffer,	GLenum, GLuint ) \
+	GLE( void,	BindRenderbuffer,	GLenum, GLuint ) \
 	GLE( void,	BindVertexArray,	GLuint ) \
+	GLE( void,	BlitFramebuffer,	GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLint, GLbitfield, GLenum ) \
 	GLE( void,	BufferData,			GLenum, GLsizeiptr, const GLvoid *, GLenum ) \
 	GLE( void,	BufferSubData,		GLenum, GLintptr, GLsizeiptr, const GLvoid * ) \
+	GLE( GLenum,	CheckFramebufferStatus,	GLenum ) \
+	GLE( void,	ClearBufferuiv,		GLenum, GLint, const GLuint * ) \
 	GLE( void,	CompileShader,		GLuint ) \
 	GLE( GLuint,	CreateProgram,		void ) \
 	GLE( GLuint,	CreateShader,		GLenum ) \
 	GLE( void,	DeleteBuffers,		GLsizei, GLuint * ) \
+	GLE( void,	DeleteFramebuffers,	GLsizei, const GLuint * ) \
 	GLE( void,	DeleteProgram,		GLuint ) \
+	GLE( void,	DeleteQueries,		GLsizei, const GLuint * ) \
+	GLE( void,	DeleteRenderbuffers,	GLsizei, const GLuint * ) \
+	GLE( void,	DeleteShader,		GLuint ) \
 	GLE( void,	DeleteVertexArrays,	GLsizei, GLuint * ) \
 	GLE( void,	DetachShader,		GLuint, GLuint ) \
+	GLE( void,	DrawElementsBaseVertex,	GLenum, GLsizei, GLenum, const GLvoid *, GLint ) \
 	GLE( void,	EnableVertexAttribArray,	GLuint ) \
+	GLE( void,	EndConditionalRender,	void ) \
+	GLE( void,	EndQuery,			GLenum ) \
+	GLE( void,	FramebufferRenderbuffer,	GLenum, GLenum, GLenum, GLuint ) \
 	GLE( void,	GenBuffers,			GLsizei, GLuint * ) \
+	GLE( void,	GenFramebuffers,	GLsizei, GLuint * ) \
+	GLE( void,	GenQueries,			GLsizei, GLuint * ) \
+	GLE( void,	GenRenderbuffers,	GLsizei, GLuint * ) \
 	GLE( void,	GenVertexArrays,	GLsizei, GLuint * ) \
 	GLE( void,	GenerateMipmap,		GLenum ) \
+	GLE( void,	GetBufferSubData,	GLenum, GLintptr, GLsizeiptr, GLvoid * ) \
 	GLE( void,	GetProgramiv,		GLuint, GLenum, GLint * ) \
 	GLE( void,	GetProgramInfoLog,	GLuint, GLsizei, GLsizei *, GLchar * ) \
+	GLE( void,	GetQueryObjectuiv,	GLuint, GLenum, GLuint * ) \
 	GLE( void,	GetShaderInfoLog,	GLuint, GLsizei, GLsizei *, GLchar * ) \
 	GLE( void,	GetShaderiv,		GLuint, GLenum, GLint * ) \
+	GLE( const GLubyte *,	GetStringi,	GLenum, GLuint ) \
 	GLE( GLint,	GetUniformLocation,	GLuint, const GLchar * ) \
 	GLE( void,	LinkProgram,		GLuint ) \
+	GLE( void,	RenderbufferStorage,	GLenum, GLenum, GLsizei, GLsizei ) \
 	GLE( void,	ShaderSource,		GLuint, GLsizei, const GLchar **, const GLint * ) \
 	GLE( void,	Uniform1i,			GLint, GLint ) \
 	GLE( void,	Uniform2i,			GLint, GLint, GLint ) \
@@ -66,12 +93,72 @@ typedef ptrdiff_t GLsizeiptr;
 	GLE( void,	Uniform2f,			GLint, GLfloat, GLfloat ) \
 	GLE( void,	Uniform3f,			GLint, GLfloat, GLfloat, GLfloat ) \
 	GLE( void,	Uniform3fv,			GLint, GLsizei, const GLfloat * ) \
+	GLE( void,	Uniform4f,			GLint, GLfloat, GLfloat, GLfloat, GLfloat ) \
 	GLE( void,	Uniform4fv,			GLint, GLsizei, const GLfloat * ) \
 	GLE( void,	UniformMatrix4fv,	GLint , GLsizei, GLboolean, const GLfloat * ) \
 	GLE( void,	UseProgram,			GLuint ) \
 	GLE( void,	ValidateProgram,	GLuint ) \
 	GLE( void,	VertexAttribPointer,	GLuint, GLint, GLenum, GLboolean, GLsizei, const GLvoid * )
 
+/* Entry points of newer GL versions, a missing one is left 0. */
+#define HC_GL_LIST_OPTIONAL \
+	GLE( GLenum,	ClientWaitSync,		GLsync, GLbitfield, GLuint64 ) \
+	GLE( void,	CreateBuffers,		GLsizei, GLuint * ) \
+	GLE( void,	CreateTextures,		GLenum, GLsizei, GLuint * ) \
+	GLE( void,	CreateVertexArrays,	GLsizei, GLuint * ) \
+	GLE( void,	DeleteSync,			GLsync ) \
+	GLE( void,	DispatchCompute,	GLuint, GLuint, GLuint ) \
+	GLE( void,	EnableVertexArrayAttrib,	GLuint, GLuint ) \
+	GLE( GLsync,	FenceSync,			GLenum, GLbitfield ) \
+	GLE( void,	GenerateTextureMipmap,	GLuint ) \
+	GLE( void,	GetInteger64v,		GLenum, GLint64 * ) \
+	GLE( void,	GetQueryObjectui64v,	GLuint, GLenum, GLuint64 * ) \
+	GLE( void,	MemoryBarrier,		GLbitfield ) \
+	GLE( void,	MultiDrawElementsIndirect,	GLenum, GLenum, const GLvoid *, GLsizei, GLsizei ) \
+	GLE( void,	NamedBufferStorage,	GLuint, GLsizeiptr, const GLvoid *, GLbitfield ) \
+	GLE( void,	QueryCounter,		GLuint, GLenum ) \
+	GLE( void,	TextureParameterf,	GLuint, GLenum, GLfloat ) \
+	GLE( void,	TextureParameteri,	GLuint, GLenum, GLint ) \
+	GLE( void,	TextureStorage2D,	GLuint, GLsizei, GLenum, GLsizei, GLsizei ) \
+	GLE( void,	TextureSubImage2D,	GLuint, GLint, GLint, GLint, GLsizei, GLsizei, GLenum, GLenum, const GLvoid * ) \
+	GLE( void,	VertexArrayAttribBinding,	GLuint, GLuint, GLuint ) \
+	GLE( void,	VertexArrayAttribFormat,	GLuint, GLuint, GLint, GLenum, GLboolean, GLuint ) \
+	GLE( void,	VertexArrayElementBuffer,	GLuint, GLuint ) \
+	GLE( void,	VertexArrayVertexBuffer,	GLuint, GLuint, GLuint, GLintptr, GLsizei )
+
+/* Entry points linked directly from libGL, listed for the call counters. */
+#define HC_GL_LIST_CORE \
+	GLC( BindTexture ) \
+	GLC( BlendFunc ) \
+	GLC( Clear ) \
+	GLC( ClearColor ) \
+	GLC( ColorMask ) \
+	GLC( CullFace ) \
+	GLC( DepthFunc ) \
+	GLC( DeleteTextures ) \
+	GLC( DepthMask ) \
+	GLC( Disable ) \
+	GLC( DrawElements ) \
+	GLC( Enable ) \
+	GLC( Finish ) \
+	GLC( GenTextures ) \
+	GLC( GetError ) \
+	GLC( GetFloatv ) \
+	GLC( GetIntegerv ) \
+	GLC( GetString ) \
+	GLC( GetTexLevelParameteriv ) \
+	GLC( IsEnabled ) \
+	GLC( PixelStorei ) \
+	GLC( ReadPixels ) \
+	GLC( Scissor ) \
+	GLC( TexEnvi ) \
+	GLC( TexImage1D ) \
+	GLC( TexImage2D ) \
+	GLC( TexParameterf ) \
+	GLC( TexParameteri ) \
+	GLC( TexSubImage2D ) \
+	GLC( Viewport ) \
+	HC_GL_LIST_CORE_LINUX
 
 #define GLE( ret, name, ... ) \
 	typedef ret GLDECL name##proc( __VA_ARGS__ ); \
@@ -79,21 +166,529 @@ typedef ptrdiff_t GLsizeiptr;
 
 HC_GL_LIST
 HC_GL_LIST_WIN32
+HC_GL_LIST_OPTIONAL
+#undef GLE
+
+#define GLE( ret, name, ... ) GL_ID_##name,
+#define GLC( name ) GL_ID_##name,
+enum { /*! Index of every counted entry point in gl_lite_calls. */
+	HC_GL_LIST
+	HC_GL_LIST_WIN32
+	HC_GL_LIST_OPTIONAL
+	HC_GL_LIST_CORE
+	GL_ID_MAX
+};
+#undef GLC
 #undef GLE
 
+typedef struct { /*! GL calls between two gl_lite_end_frame. */
+	GLuint total;
+	GLuint redundant;		/*! Only counted with GL_LITE_TRACE. */
+	double ms;				/*! CPU time in GL calls, -"-. */
+	GLuint calls[ GL_ID_MAX ];
+} GL_Lite_Frame;
+
+/*! Calls per entry point since the last gl_lite_reset_calls, with
+	GL_LITE_TRACE also the redundant state changes and microseconds. */
+extern GLuint gl_lite_calls[ GL_ID_MAX ];
+extern GLuint gl_lite_redundant[ GL_ID_MAX ];
+extern double gl_lite_us[ GL_ID_MAX ];
+extern const char *gl_lite_names[ GL_ID_MAX ];
+extern GL_Lite_Frame gl_lite_frame;		/*! The last frame ended. */
+
+#if defined(GL_LITE_TRACE)
+/* Instrumented build, every call is timed. Needs GCC statement
+	expressions. */
+#define GL_LITE_CALL( name, ... ) ({ \
+	double gl_lite_t_ = gl_lite_now( ); \
+	gl##name( __VA_ARGS__ ); \
+	gl_lite_trace( GL_ID_##name, gl_lite_t_ ); })
+
+#define GL_LITE_CALL_RET( name, ... ) ({ \
+	double gl_lite_t_ = gl_lite_now( ); \
+	__typeof__( gl##name( __VA_ARGS__ ) ) gl_lite_r_ = gl##name( __VA_ARGS__ ); \
+	gl_lite_trace( GL_ID_##name, gl_lite_t_ ); \
+	gl_lite_r_; })
+#else
+#define GL_LITE_CALL( name, ... ) \
+	( ++gl_lite_calls[ GL_ID_##name ], gl##name( __VA_ARGS__ ) )
+#define GL_LITE_CALL_RET GL_LITE_CALL
+#endif /* GL_LITE_TRACE */
+
+/* Every call site goes through the counter, taking the address or
+	assigning the pointer (no parenthesis) is not affected. */
+#define glActiveTexture( ... )		GL_LITE_CALL( ActiveTexture, __VA_ARGS__ )
+#define glAttachShader( ... )		GL_LITE_CALL( AttachShader, __VA_ARGS__ )
+#define glBeginConditionalRender( ... )	GL_LITE_CALL( BeginConditionalRender, __VA_ARGS__ )
+#define glBeginQuery( ... )		GL_LITE_CALL( BeginQuery, __VA_ARGS__ )
+#define glBindBuffer( ... )		GL_LITE_CALL( BindBuffer, __VA_ARGS__ )
+#define glBindBufferBase( ... )	GL_LITE_CALL( BindBufferBase, __VA_ARGS__ )
+#define glBindFramebuffer( ... )	GL_LITE_CALL( BindFramebuffer, __VA_ARGS__ )
+#define glBindRenderbuffer( ... )	GL_LITE_CALL( BindRenderbuffer, __VA_ARGS__ )
+#define glBindTexture( ... )		GL_LITE_CALL( BindTexture, __VA_ARGS__ )
+#define glBindVertexArray( ... )	GL_LITE_CALL( BindVertexArray, __VA_ARGS__ )
+#define glBlendEquation( ... )		GL_LITE_CALL( BlendEquation, __VA_ARGS__ )
+#define glBlendFunc( ... )			GL_LITE_CALL( BlendFunc, __VA_ARGS__ )
+#define glBlitFramebuffer( ... )	GL_LITE_CALL( BlitFramebuffer, __VA_ARGS__ )
+#define glBufferData( ... )		GL_LITE_CALL( BufferData, __VA_ARGS__ )
+#define glBufferSubData( ... )		GL_LITE_CALL( BufferSubData, __VA_ARGS__ )
+#define glCheckFramebufferStatus( ... )	GL_LITE_CALL_RET( CheckFramebufferStatus, __VA_ARGS__ )
+#define glClear( ... )				GL_LITE_CALL( Clear, __VA_ARGS__ )
+#define glClearBufferuiv( ... )	GL_LITE_CALL( ClearBufferuiv, __VA_ARGS__ )
+#define glClearColor( ... )		GL_LITE_CALL( ClearColor, __VA_ARGS__ )
+#define glColorMask( ... )			GL_LITE_CALL( ColorMask, __VA_ARGS__ )
+#define glClientWaitSync( ... )	GL_LITE_CALL_RET( ClientWaitSync, __VA_ARGS__ )
+#define glCompileShader( ... )		GL_LITE_CALL( CompileShader, __VA_ARGS__ )
+#define glCreateBuffers( ... )	GL_LITE_CALL( CreateBuffers, __VA_ARGS__ )
+#define glCreateProgram( ... )		GL_LITE_CALL_RET( CreateProgram, __VA_ARGS__ )
+#define glCreateShader( ... )		GL_LITE_CALL_RET( CreateShader, __VA_ARGS__ )
+#define glCreateTextures( ... )	GL_LITE_CALL( CreateTextures, __VA_ARGS__ )
+#define glCreateVertexArrays( ... )	GL_LITE_CALL( CreateVertexArrays, __VA_ARGS__ )
+#define glCullFace( ... )			GL_LITE_CALL( CullFace, __VA_ARGS__ )
+#define glDeleteBuffers( ... )		GL_LITE_CALL( DeleteBuffers, __VA_ARGS__ )
+#define glDeleteFramebuffers( ... )	GL_LITE_CALL( DeleteFramebuffers, __VA_ARGS__ )
+#define glDeleteProgram( ... )		GL_LITE_CALL( DeleteProgram, __VA_ARGS__ )
+#define glDeleteQueries( ... )		GL_LITE_CALL( DeleteQueries, __VA_ARGS__ )
+#define glDeleteRenderbuffers( ... )	GL_LITE_CALL( DeleteRenderbuffers, __VA_ARGS__ )
+#define glDeleteShader( ... )		GL_LITE_CALL( DeleteShader, __VA_ARGS__ )
+#define glDeleteSync( ... )		GL_LITE_CALL( DeleteSync, __VA_ARGS__ )
+#define glDeleteTextures( ... )	GL_LITE_CALL( DeleteTextures, __VA_ARGS__ )
+#define glDeleteVertexArrays( ... )	GL_LITE_CALL( DeleteVertexArrays, __VA_ARGS__ )
+#define glDepthFunc( ... )			GL_LITE_CALL( DepthFunc, __VA_ARGS__ )
+#define glDepthMask( ... )			GL_LITE_CALL( DepthMask, __VA_ARGS__ )
+#define glDetachShader( ... )		GL_LITE_CALL( DetachShader, __VA_ARGS__ )
+#define glDisable( ... )			GL_LITE_CALL( Disable, __VA_ARGS__ )
+#define glDispatchCompute( ... )	GL_LITE_CALL( DispatchCompute, __VA_ARGS__ )
+#define glDrawElements( ... )		GL_LITE_CALL( DrawElements, __VA_ARGS__ )
+#define glDrawElementsBaseVertex( ... )	GL_LITE_CALL( DrawElementsBaseVertex, __VA_ARGS__ )
+#define glEnable( ... )			GL_LITE_CALL( Enable, __VA_ARGS__ )
+#define glEnableVertexArrayAttrib( ... )	GL_LITE_CALL( EnableVertexArrayAttrib, __VA_ARGS__ )
+#define glEnableVertexAttribArray( ... )	GL_LITE_CALL( EnableVertexAttribArray, __VA_ARGS__ )
+#define glEndConditionalRender( ... )	GL_LITE_CALL( EndConditionalRender, __VA_ARGS__ )
+#define glEndQuery( ... )			GL_LITE_CALL( EndQuery, __VA_ARGS__ )
+#define glFenceSync( ... )			GL_LITE_CALL_RET( FenceSync, __VA_ARGS__ )
+#define glFinish( ... )			GL_LITE_CALL( Finish, __VA_ARGS__ )
+#define glFramebufferRenderbuffer( ... )	GL_LITE_CALL( FramebufferRenderbuffer, __VA_ARGS__ )
+#define glGenBuffers( ... )		GL_LITE_CALL( GenBuffers, __VA_ARGS__ )
+#define glGenerateMipmap( ... )	GL_LITE_CALL( GenerateMipmap, __VA_ARGS__ )
+#define glGenerateTextureMipmap( ... )	GL_LITE_CALL( GenerateTextureMipmap, __VA_ARGS__ )
+#define glGenFramebuffers( ... )	GL_LITE_CALL( GenFramebuffers, __VA_ARGS__ )
+#define glGenQueries( ... )		GL_LITE_CALL( GenQueries, __VA_ARGS__ )
+#define glGenRenderbuffers( ... )	GL_LITE_CALL( GenRenderbuffers, __VA_ARGS__ )
+#define glGenTextures( ... )		GL_LITE_CALL( GenTextures, __VA_ARGS__ )
+#define glGenVertexArrays( ... )	GL_LITE_CALL( GenVertexArrays, __VA_ARGS__ )
+#define glGetBufferSubData( ... )	GL_LITE_CALL( GetBufferSubData, __VA_ARGS__ )
+#define glGetError( ... )			GL_LITE_CALL_RET( GetError, __VA_ARGS__ )
+#define glGetFloatv( ... )			GL_LITE_CALL( GetFloatv, __VA_ARGS__ )
+#define glGetInteger64v( ... )		GL_LITE_CALL( GetInteger64v, __VA_ARGS__ )
+#define glGetIntegerv( ... )		GL_LITE_CALL( GetIntegerv, __VA_ARGS__ )
+#define glGetProgramInfoLog( ... )	GL_LITE_CALL( GetProgramInfoLog, __VA_ARGS__ )
+#define glGetProgramiv( ... )		GL_LITE_CALL( GetProgramiv, __VA_ARGS__ )
+#define glGetQueryObjectui64v( ... )	GL_LITE_CALL( GetQueryObjectui64v, __VA_ARGS__ )
+#define glGetQueryObjectuiv( ... )	GL_LITE_CALL( GetQueryObjectuiv, __VA_ARGS__ )
+#define glGetShaderInfoLog( ... )	GL_LITE_CALL( GetShaderInfoLog, __VA_ARGS__ )
+#define glGetShaderiv( ... )		GL_LITE_CALL( GetShaderiv, __VA_ARGS__ )
+#define glGetString( ... )			GL_LITE_CALL_RET( GetString, __VA_ARGS__ )
+#define glGetStringi( ... )		GL_LITE_CALL_RET( GetStringi, __VA_ARGS__ )
+#define glGetTexLevelParameteriv( ... )	GL_LITE_CALL( GetTexLevelParameteriv, __VA_ARGS__ )
+#define glGetUniformLocation( ... )	GL_LITE_CALL_RET( GetUniformLocation, __VA_ARGS__ )
+#define glIsEnabled( ... )			GL_LITE_CALL_RET( IsEnabled, __VA_ARGS__ )
+#define glLinkProgram( ... )		GL_LITE_CALL( LinkProgram, __VA_ARGS__ )
+#define glMemoryBarrier( ... )		GL_LITE_CALL( MemoryBarrier, __VA_ARGS__ )
+#define glMultiDrawElementsIndirect( ... )	GL_LITE_CALL( MultiDrawElementsIndirect, __VA_ARGS__ )
+#define glNamedBufferStorage( ... )	GL_LITE_CALL( NamedBufferStorage, __VA_ARGS__ )
+#define glPixelStorei( ... )		GL_LITE_CALL( PixelStorei, __VA_ARGS__ )
+#define glQueryCounter( ... )		GL_LITE_CALL( QueryCounter, __VA_ARGS__ )
+#define glReadPixels( ... )		GL_LITE_CALL( ReadPixels, __VA_ARGS__ )
+#define glRenderbufferStorage( ... )	GL_LITE_CALL( RenderbufferStorage, __VA_ARGS__ )
+#define glScissor( ... )			GL_LITE_CALL( Scissor, __VA_ARGS__ )
+#define glShaderSource( ... )		GL_LITE_CALL( ShaderSource, __VA_ARGS__ )
+#define glTexEnvi( ... )			GL_LITE_CALL( TexEnvi, __VA_ARGS__ )
+#define glTexImage1D( ... )		GL_LITE_CALL( TexImage1D, __VA_ARGS__ )
+#define glTexImage2D( ... )		GL_LITE_CALL( TexImage2D, __VA_ARGS__ )
+#define glTexParameterf( ... )		GL_LITE_CALL( TexParameterf, __VA_ARGS__ )
+#define glTexParameteri( ... )		GL_LITE_CALL( TexParameteri, __VA_ARGS__ )
+#define glTexSubImage2D( ... )		GL_LITE_CALL( TexSubImage2D, __VA_ARGS__ )
+#define glTextureParameterf( ... )	GL_LITE_CALL( TextureParameterf, __VA_ARGS__ )
+#define glTextureParameteri( ... )	GL_LITE_CALL( TextureParameteri, __VA_ARGS__ )
+#define glTextureStorage2D( ... )	GL_LITE_CALL( TextureStorage2D, __VA_ARGS__ )
+#define glTextureSubImage2D( ... )	GL_LITE_CALL( TextureSubImage2D, __VA_ARGS__ )
+#define glUniform1f( ... )			GL_LITE_CALL( Uniform1f, __VA_ARGS__ )
+#define glUniform1i( ... )			GL_LITE_CALL( Uniform1i, __VA_ARGS__ )
+#define glUniform1ui( ... )		GL_LITE_CALL( Uniform1ui, __VA_ARGS__ )
+#define glUniform2f( ... )			GL_LITE_CALL( Uniform2f, __VA_ARGS__ )
+#define glUniform2i( ... )			GL_LITE_CALL( Uniform2i, __VA_ARGS__ )
+#define glUniform2ui( ... )		GL_LITE_CALL( Uniform2ui, __VA_ARGS__ )
+#define glUniform3f( ... )			GL_LITE_CALL( Uniform3f, __VA_ARGS__ )
+#define glUniform3fv( ... )		GL_LITE_CALL( Uniform3fv, __VA_ARGS__ )
+#define glUniform4f( ... )			GL_LITE_CALL( Uniform4f, __VA_ARGS__ )
+#define glUniform4fv( ... )		GL_LITE_CALL( Uniform4fv, __VA_ARGS__ )
+#define glUniformMatrix4fv( ... )	GL_LITE_CALL( UniformMatrix4fv, __VA_ARGS__ )
+#define glUseProgram( ... )		GL_LITE_CALL( UseProgram, __VA_ARGS__ )
+#define glValidateProgram( ... )	GL_LITE_CALL( ValidateProgram, __VA_ARGS__ )
+#define glVertexArrayAttribBinding( ... )	GL_LITE_CALL( VertexArrayAttribBinding, __VA_ARGS__ )
+#define glVertexArrayAttribFormat( ... )	GL_LITE_CALL( VertexArrayAttribFormat, __VA_ARGS__ )
+#define glVertexArrayElementBuffer( ... )	GL_LITE_CALL( VertexArrayElementBuffer, __VA_ARGS__ )
+#define glVertexArrayVertexBuffer( ... )	GL_LITE_CALL( VertexArrayVertexBuffer, __VA_ARGS__ )
+#define glVertexAttribPointer( ... )	GL_LITE_CALL( VertexAttribPointer, __VA_ARGS__ )
+#define glViewport( ... )			GL_LITE_CALL( Viewport, __VA_ARGS__ )
+
+#if defined(GL_LITE_TRACE)
+/* State setters compare with the last value set through gl_lite and count
+	a redundant change when it is the same, the call is still made. Their
+	arguments are evaluated twice. Deleting objects forgets all state, the
+	names may be reused. */
+#define GL_LITE_STATE( name, state, key, value, ... ) ({ \
+	gl_lite_state( GL_ID_##name, GL_ID_##state, ( key ), ( GLuint64 ) ( value ) ); \
+	GL_LITE_CALL( name, __VA_ARGS__ ); })
+
+#define GL_LITE_FORGET( name, ... ) ({ \
+	gl_lite_forget_state( ); \
+	GL_LITE_CALL( name, __VA_ARGS__ ); })
+
+#undef glActiveTexture
+#undef glBindBuffer
+#undef glBindBufferBase
+#undef glBindFramebuffer
+#undef glBindTexture
+#undef glBindVertexArray
+#undef glBlendFunc
+#undef glColorMask
+#undef glCullFace
+#undef glDeleteBuffers
+#undef glDeleteFramebuffers
+#undef glDeleteProgram
+#undef glDeleteTextures
+#undef glDeleteVertexArrays
+#undef glDepthFunc
+#undef glDepthMask
+#undef glDisable
+#undef glEnable
+#undef glUseProgram
+#undef glViewport
+
+#define glActiveTexture( u ) \
+	GL_LITE_STATE( ActiveTexture, ActiveTexture, 0, u, u )
+#define glBindBuffer( t, b ) \
+	GL_LITE_STATE( BindBuffer, BindBuffer, t, b, t, b )
+#define glBindBufferBase( t, i, b ) \
+	GL_LITE_STATE( BindBufferBase, BindBufferBase, ( t ) * 256U + ( i ), b, t, i, b )
+#define glBindFramebuffer( t, f ) \
+	GL_LITE_STATE( BindFramebuffer, BindFramebuffer, t, f, t, f )
+#define glBindTexture( t, tex ) \
+	GL_LITE_STATE( BindTexture, BindTexture, t, tex, t, tex )
+#define glBindVertexArray( v ) \
+	GL_LITE_STATE( BindVertexArray, BindVertexArray, 0, v, v )
+#define glBlendFunc( s, d ) \
+	GL_LITE_STATE( BlendFunc, BlendFunc, 0, ( s ) * 65536U + ( d ), s, d )
+#define glColorMask( r, g, b, a ) \
+	GL_LITE_STATE( ColorMask, ColorMask, 0, \
+		( r ) + 2 * ( g ) + 4 * ( b ) + 8 * ( a ), r, g, b, a )
+#define glCullFace( m ) \
+	GL_LITE_STATE( CullFace, CullFace, 0, m, m )
+#define glDepthFunc( f ) \
+	GL_LITE_STATE( DepthFunc, DepthFunc, 0, f, f )
+#define glDepthMask( f ) \
+	GL_LITE_STATE( DepthMask, DepthMask, 0, f, f )
+#define glDisable( c ) \
+	GL_LITE_STATE( Disable, Enable, c, 0, c )
+#define glEnable( c ) \
+	GL_LITE_STATE( Enable, Enable, c, 1, c )
+#define glUseProgram( p ) \
+	GL_LITE_STATE( UseProgram, UseProgram, 0, p, p )
+#define glViewport( x, y, w, h ) \
+	GL_LITE_STATE( Viewport, Viewport, 0, ( ( GLuint64 ) ( x ) << 48 ) \
+		| ( ( GLuint64 ) ( y ) << 32 ) | ( ( GLuint64 ) ( w ) << 16 ) | ( h ), \
+		x, y, w, h )
+
+#define glDeleteBuffers( ... )		GL_LITE_FORGET( DeleteBuffers, __VA_ARGS__ )
+#define glDeleteFramebuffers( ... )	GL_LITE_FORGET( DeleteFramebuffers, __VA_ARGS__ )
+#define glDeleteProgram( ... )		GL_LITE_FORGET( DeleteProgram, __VA_ARGS__ )
+#define glDeleteTextures( ... )	GL_LITE_FORGET( DeleteTextures, __VA_ARGS__ )
+#define glDeleteVertexArrays( ... )	GL_LITE_FORGET( DeleteVertexArrays, __VA_ARGS__ )
+#endif /* GL_LITE_TRACE */
+
+typedef struct { /*! Features of the current context, set by gl_lite_init. */
+	int version;				/*! major * 10 + minor, e.g. 43. */
+	int multi_draw_indirect;	/*! MDI with gl_DrawIDARB available. */
+	int compute_shader;			/*! Compute shaders and SSBO writes. */
+	int shader_storage;			/*! SSBOs in vertex and fragment shaders. */
+	int timer_query;			/*! GL_TIMESTAMP queries and glGetInteger64v. */
+	int direct_state_access;	/*! Create and edit objects without binding,
+									immutable buffer and texture storage. */
+	int fence_sync;				/*! glFenceSync and glClientWaitSync. */
+} GL_Lite_Caps;
+
+extern GL_Lite_Caps gl_caps;
+
 int gl_lite_init( );
+int gl_lite_has_extension( const char *name );
+void gl_lite_reset_calls( void );
+GLuint gl_lite_total_calls( void );
+void gl_lite_end_frame( void );
+double gl_lite_now( void );
+void gl_lite_trace( GLuint id, double start );
+void gl_lite_state( GLuint id, GLuint state, GLuint key, GLuint64 value );
+void gl_lite_forget_state( void );
+void gl_lite_print_summary( FILE *fh );
 
 #endif /* CTOOL_GL_LITE */
 
 #ifdef GL_LITE_IMPL
 
-#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define GL_LITE_STATES	(64U)
+
+typedef struct { /*! Last value of a state set through gl_lite. */
+	GLuint state, key;
+	GLuint64 value;
+} GL_Lite_State;
 
 #define GLE( ret, name, ... ) name##proc * gl##name;
 HC_GL_LIST
 HC_GL_LIST_WIN32
+HC_GL_LIST_OPTIONAL
+#undef GLE
+
+GL_Lite_Caps gl_caps;
+GLuint gl_lite_calls[ GL_ID_MAX ];
+GLuint gl_lite_redundant[ GL_ID_MAX ];
+double gl_lite_us[ GL_ID_MAX ];
+GL_Lite_Frame gl_lite_frame;
+
+static GLuint gl_lite_frame_calls[ GL_ID_MAX ];	/* at the last frame end */
+static GLuint gl_lite_frame_redundant;
+static double gl_lite_frame_us;
+static GLuint gl_lite_frames;
+static GL_Lite_State gl_lite_states[ GL_LITE_STATES ];
+static GLuint gl_lite_num_states;
+static GLuint gl_lite_texture_unit;
+
+#define GLE( ret, name, ... ) #name,
+#define GLC( name ) #name,
+const char *gl_lite_names[ GL_ID_MAX ] = {
+	HC_GL_LIST
+	HC_GL_LIST_WIN32
+	HC_GL_LIST_OPTIONAL
+	HC_GL_LIST_CORE
+};
+#undef GLC
 #undef GLE
 
+void gl_lite_reset_calls( void ) {
+	memset( gl_lite_calls, 0, sizeof( gl_lite_calls ) );
+	memset( gl_lite_redundant, 0, sizeof( gl_lite_redundant ) );
+	memset( gl_lite_us, 0, sizeof( gl_lite_us ) );
+	memset( gl_lite_frame_calls, 0, sizeof( gl_lite_frame_calls ) );
+	gl_lite_frame_redundant = 0;
+	gl_lite_frame_us = 0.0;
+	gl_lite_frames = 0;
+}
+
+GLuint gl_lite_total_calls( void ) {
+	GLuint i, total = 0;
+	for( i = 0; i < GL_ID_MAX; ++i ) {
+		total += gl_lite_calls[ i ];
+	}
+	return total;
+}
+
+/*! Fills gl_lite_frame with the calls since the last call. */
+void gl_lite_end_frame( void ) {
+	GLuint i, redundant = 0;
+	double us = 0.0;
+
+	gl_lite_frame.total = 0;
+	for( i = 0; i < GL_ID_MAX; ++i ) {
+		gl_lite_frame.calls[ i ] = gl_lite_calls[ i ] - gl_lite_frame_calls[ i ];
+		gl_lite_frame.total += gl_lite_frame.calls[ i ];
+		gl_lite_frame_calls[ i ] = gl_lite_calls[ i ];
+		redundant += gl_lite_redundant[ i ];
+		us += gl_lite_us[ i ];
+	}
+	gl_lite_frame.redundant = redundant - gl_lite_frame_redundant;
+	gl_lite_frame.ms = ( us - gl_lite_frame_us ) / 1000.0;
+	gl_lite_frame_redundant = redundant;
+	gl_lite_frame_us = us;
+	++gl_lite_frames;
+}
+
+/*! Microseconds, for the timing of the instrumented build. */
+double gl_lite_now( void ) {
+	struct timespec time;
+	clock_gettime( CLOCK_MONOTONIC, &time );
+	return ( double ) time.tv_sec * 1000000.0 + ( double ) time.tv_nsec / 1000.0;
+}
+
+void gl_lite_trace( GLuint id, double start ) {
+	++gl_lite_calls[ id ];
+	gl_lite_us[ id ] += gl_lite_now( ) - start;
+}
+
+static GL_Lite_State *gl_lite_find( GLuint state, GLuint key ) {
+	GLuint i;
+	for( i = 0; i < gl_lite_num_states; ++i ) {
+		if( gl_lite_states[ i ].state == state
+			&& gl_lite_states[ i ].key == key )
+		{
+			return &gl_lite_states[ i ];
+		}
+	}
+	return 0;
+}
+
+static void gl_lite_forget( GLuint state, GLuint key ) {
+	GL_Lite_State *s = gl_lite_find( state, key );
+
+	if( s ) {
+		*s = gl_lite_states[ --gl_lite_num_states ];
+	}
+}
+
+void gl_lite_forget_state( void ) {
+	gl_lite_num_states = 0;
+}
+
+static void gl_lite_set( GLuint state, GLuint key, GLuint64 value ) {
+	GL_Lite_State *s = gl_lite_find( state, key );
+
+	if( !s && gl_lite_num_states < GL_LITE_STATES ) {
+		s = &gl_lite_states[ gl_lite_num_states++ ];
+		s->state = state;
+		s->key = key;
+	}
+	if( s ) {
+		s->value = value;
+	}
+}
+
+/*! Counts a redundant call of id when the state already has the value.
+	Texture bindings are per unit, a vao brings its own index buffer and
+	an indexed binding also sets the generic one. Read and draw framebuffers
+	are tracked apart like GL does, GL_FRAMEBUFFER_BINDING is the draw one.
+	Binding GL_FRAMEBUFFER sets both and is redundant only if both are. */
+void gl_lite_state( GLuint id, GLuint state, GLuint key, GLuint64 value ) {
+	GL_Lite_State *s;
+
+	if( GL_ID_ActiveTexture == state ) {
+		gl_lite_texture_unit = ( GLuint ) value - GL_TEXTURE0;
+	} else if( GL_ID_BindTexture == state ) {
+		key += gl_lite_texture_unit << 16;
+	} else if( GL_ID_BindFramebuffer == state && GL_FRAMEBUFFER == key ) {
+		GL_Lite_State *r = gl_lite_find( state, GL_READ_FRAMEBUFFER );
+		GL_Lite_State *d = gl_lite_find( state, GL_DRAW_FRAMEBUFFER );
+
+		if( r && d && r->value == value && d->value == value ) {
+			++gl_lite_redundant[ id ];
+			return;
+		}
+		gl_lite_set( state, GL_READ_FRAMEBUFFER, value );
+		gl_lite_set( state, GL_DRAW_FRAMEBUFFER, value );
+		return;
+	}
+	s = gl_lite_find( state, key );
+
+	if( s && s->value == value ) {
+		++gl_lite_redundant[ id ];
+		return;
+	}
+	gl_lite_set( state, key, value );
+
+	if( GL_ID_BindVertexArray == state ) {
+		gl_lite_forget( GL_ID_BindBuffer, GL_ELEMENT_ARRAY_BUFFER );
+	} else if( GL_ID_BindBufferBase == state ) {
+		gl_lite_forget( GL_ID_BindBuffer, key / 256U );
+	}
+}
+
+/*! Calls per frame since gl_lite_reset_calls, with GL_LITE_TRACE also per
+	entry point, the most expensive first. */
+void gl_lite_print_summary( FILE *fh ) {
+	GLuint total = gl_lite_total_calls( );
+	GLuint frames = gl_lite_frames ? gl_lite_frames : 1;
+
+	fprintf( fh, "gl calls: %.1f per frame", ( double ) total / frames );
+#if defined(GL_LITE_TRACE)
+	GLuint i, j, redundant = 0, order[ GL_ID_MAX ];
+	double us = 0.0;
+
+	for( i = 0; i < GL_ID_MAX; ++i ) {
+		redundant += gl_lite_redundant[ i ];
+		us += gl_lite_us[ i ];
+		order[ i ] = i;
+	}
+	fprintf( fh, ", %.1f redundant, %.3f ms (%u frames)\n",
+		( double ) redundant / frames, us / 1000.0 / frames, gl_lite_frames );
+	fprintf( fh, "%-28s %11s %10s %10s %10s\n", "entry point", "calls/frame",
+		"us/frame", "us/call", "redundant" );
+
+	for( i = 0; i < GL_ID_MAX; ++i ) { /* selection sort by time */
+		for( j = i + 1; j < GL_ID_MAX; ++j ) {
+			if( gl_lite_us[ order[ j ] ] > gl_lite_us[ order[ i ] ] ) {
+				GLuint tmp = order[ i ];
+				order[ i ] = order[ j ];
+				order[ j ] = tmp;
+			}
+		}
+		GLuint id = order[ i ];
+		if( gl_lite_calls[ id ] ) {
+			fprintf( fh, "gl%-26s %11.2f %10.2f %10.3f %10.2f\n",
+				gl_lite_names[ id ], ( double ) gl_lite_calls[ id ] / frames,
+				gl_lite_us[ id ] / frames, gl_lite_us[ id ] / gl_lite_calls[ id ],
+				( double ) gl_lite_redundant[ id ] / frames );
+		}
+	}
+#else
+	fprintf( fh, " (%u frames)\n", gl_lite_frames );
+#endif /* GL_LITE_TRACE */
+}
+
+int gl_lite_has_extension( const char *name ) {
+	GLint i, n = 0;
+	glGetIntegerv( GL_NUM_EXTENSIONS, &n );
+
+	for( i = 0; i < n; ++i ) {
+		if( 0 == strcmp( name, ( const char * ) glGetStringi( GL_EXTENSIONS, i ) ) ) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static void gl_lite_detect_caps( void ) {
+	GLint major = 0, minor = 0;
+	glGetIntegerv( GL_MAJOR_VERSION, &major );
+	glGetIntegerv( GL_MINOR_VERSION, &minor );
+	gl_caps.version = major * 10 + minor;
+	gl_caps.multi_draw_indirect = ( 0 != glMultiDrawElementsIndirect )
+		&& ( gl_caps.version >= 43 )
+		&& gl_lite_has_extension( "GL_ARB_shader_draw_parameters" );
+	gl_caps.compute_shader = ( 0 != glDispatchCompute )
+		&& ( 0 != glMemoryBarrier ) && ( gl_caps.version >= 43 );
+	gl_caps.shader_storage = ( gl_caps.version >= 43 );
+	gl_caps.timer_query = ( 0 != glGetInteger64v )
+		&& ( 0 != glGetQueryObjectui64v ) && ( 0 != glQueryCounter )
+		&& ( ( gl_caps.version >= 33 )
+			|| gl_lite_has_extension( "GL_ARB_timer_query" ) );
+	gl_caps.direct_state_access = ( 0 != glCreateBuffers )
+		&& ( 0 != glCreateTextures ) && ( 0 != glCreateVertexArrays )
+		&& ( 0 != glNamedBufferStorage ) && ( 0 != glTextureStorage2D )
+		&& ( 0 != glTextureSubImage2D ) && ( 0 != glTextureParameteri )
+		&& ( 0 != glTextureParameterf ) && ( 0 != glGenerateTextureMipmap )
+		&& ( 0 != glEnableVertexArrayAttrib )
+		&& ( 0 != glVertexArrayAttribBinding )
+		&& ( 0 != glVertexArrayAttribFormat )
+		&& ( 0 != glVertexArrayElementBuffer )
+		&& ( 0 != glVertexArrayVertexBuffer )
+		&& ( ( gl_caps.version >= 45 )
+			|| gl_lite_has_extension( "GL_ARB_direct_state_access" ) );
+	gl_caps.fence_sync = ( 0 != glFenceSync ) && ( 0 != glClientWaitSync )
+		&& ( 0 != glDeleteSync ) && ( ( gl_caps.version >= 32 )
+			|| gl_lite_has_extension( "GL_ARB_sync" ) );
+}
+
 int gl_lite_init( ) {
 #if defined(__linux__)
 
@@ -113,6 +708,12 @@ int gl_lite_init( ) {
 		HC_GL_LIST
 	#undef GLE
 
+	#define GLE( ret, name, ... ) \
+		gl##name = ( name##proc * ) dlsym( libGL, "gl" #name );
+
+		HC_GL_LIST_OPTIONAL
+	#undef GLE
+
 #elif defined(_WIN32)
 
 	HINSTANCE dll = LoadLibraryA( "opengl32.dll" );
@@ -137,9 +738,16 @@ int gl_lite_init( ) {
 		HC_GL_LIST_WIN32
 	#undef GLE
 
+	#define GLE( ret, name, ... ) \
+		gl##name = ( name##proc * ) wglGetProcAddress( "gl" #name );
+
+		HC_GL_LIST_OPTIONAL
+	#undef GLE
+
 #else
 	#error "GL loading for this platform is not implemented!"
 #endif
+	gl_lite_detect_caps( );
 
 	return 1;
 }
@@ -0,0 +1,113 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "handles.h"
+
+#define HANDLE_GENERATIONS	( ( 1U << ( 32U - HANDLE_INDEX_BITS ) ) - 1U )
+
+/*! A new item set to zero, HANDLE_NONE if all HANDLE_MAX_SLOTS are live
+	or out of memory. */
+Handle handle_create( Handle_Table *t ) {
+	u32 slot;
+
+	if( t->count == t->max_items ) { /* items and their slots grow together */
+		u32 n = t->max_items ? 2 * t->max_items : 16;
+		u8 *items = realloc( t->items, ( size_t ) n * t->item_size );
+		if( !items ) return HANDLE_NONE;
+		t->items = items;
+
+		u32 *item_slots = realloc( t->item_slots, n * sizeof( u32 ) );
+		if( !item_slots ) return HANDLE_NONE;
+		t->item_slots = item_slots;
+		t->max_items = n;
+	}
+	if( t->free_slots ) {
+		slot = t->free_slots - 1;
+		t->free_slots = t->slots[ slot ].item;
+	} else if( t->num_slots < HANDLE_MAX_SLOTS ) {
+		if( t->num_slots == t->max_slots ) {
+			u32 n = t->max_slots ? 2 * t->max_slots : 16;
+			Handle_Slot *slots = realloc( t->slots, n * sizeof( Handle_Slot ) );
+			if( !slots ) return HANDLE_NONE;
+			t->slots = slots;
+			t->max_slots = n;
+		}
+		slot = t->num_slots++;
+		t->slots[ slot ].generation = 1;
+	} else {
+		fprintf( stderr, "Error: more than %u %s handles!\n",
+			HANDLE_MAX_SLOTS, t->name );
+		return HANDLE_NONE;
+	}
+	t->slots[ slot ].item = t->count;
+	t->item_slots[ t->count ] = slot;
+	memset( t->items + ( size_t ) t->count * t->item_size, 0, t->item_size );
+	t->count++;
+	return ( t->slots[ slot ].generation << HANDLE_INDEX_BITS ) | slot;
+}
+
+/*! Index of the item of h, -1 if h is stale or HANDLE_NONE. */
+static s32 handle_index( const Handle_Table *t, Handle h ) {
+	u32 slot = h & HANDLE_MAX_SLOTS;
+
+	if( slot >= t->num_slots
+		|| t->slots[ slot ].generation != h >> HANDLE_INDEX_BITS )
+	{
+		return -1;
+	}
+	return ( s32 ) t->slots[ slot ].item;
+}
+
+/*! The item of h, 0 if it was destroyed. */
+void *handle_get( const Handle_Table *t, Handle h ) {
+	s32 i = handle_index( t, h );
+	return ( i < 0 ) ? 0 : t->items + ( size_t ) i * t->item_size;
+}
+
+/*! Item i of the live items, 0 <= i < count. */
+void *handle_item( const Handle_Table *t, u32 i ) {
+	return t->items + ( size_t ) i * t->item_size;
+}
+
+/*! Handle of item i. */
+Handle handle_of( const Handle_Table *t, u32 i ) {
+	u32 slot = t->item_slots[ i ];
+	return ( t->slots[ slot ].generation << HANDLE_INDEX_BITS ) | slot;
+}
+
+/*! Destroys the item of h, the last item takes its place. Returns -1 if h
+	is stale, the table stays unchanged. */
+int handle_destroy( Handle_Table *t, Handle h ) {
+	s32 i = handle_index( t, h );
+	u32 slot = h & HANDLE_MAX_SLOTS, last;
+
+	if( i < 0 ) {
+		return -1;
+	}
+	last = --t->count;
+
+	if( ( u32 ) i != last ) {
+		memcpy( t->items + ( size_t ) i * t->item_size,
+			t->items + ( size_t ) last * t->item_size, t->item_size );
+		t->item_slots[ i ] = t->item_slots[ last ];
+		t->slots[ t->item_slots[ i ] ].item = i;
+	}
+	t->slots[ slot ].generation = t->slots[ slot ].generation
+		% HANDLE_GENERATIONS + 1;
+	t->slots[ slot ].item = t->free_slots;
+	t->free_slots = slot + 1;
+	return 0;
+}
+
+/*! Frees all items, the table is empty again. */
+void handle_table_free( Handle_Table *t ) {
+	free( t->items );
+	free( t->item_slots );
+	free( t->slots );
+	t->items = 0;
+	t->item_slots = 0;
+	t->slots = 0;
+	t->count = t->max_items = 0;
+	t->num_slots = t->max_slots = 0;
+	t->free_slots = 0;
+}
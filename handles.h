@@ -0,0 +1,34 @@
+#ifndef CTOOL_HANDLES
+#define CTOOL_HANDLES
+
+#include "types.h"
+
+#define HANDLE_INDEX_BITS	(20U)	/* Of the slot, the generation above. */
+#define HANDLE_MAX_SLOTS	((1U << HANDLE_INDEX_BITS) - 1U)
+#define HANDLE_NONE			(0U)
+
+typedef u32 Handle; /*! Slot in the low HANDLE_INDEX_BITS, the generation of
+	the slot above. Generations start at 1, no valid handle is 0. */
+
+typedef struct { /*! Where the item of a handle is. */
+	u32 item;				/*! Index while live, next free slot + 1 if not. */
+	u32 generation;			/*! Changes on destroy, stale handles differ. */
+} Handle_Slot;
+
+typedef struct { /*! Items of one type packed at the front of one array and
+	addressed by generational handles. Create appends an item, destroy
+	moves the last one into the hole, both in O(1). Loops over all live
+	items walk items[ 0 .. count ) without any holes. Pointers to items
+	stay valid until the next create or destroy. A table that is zero but
+	for name and item_size is empty. */
+	const char *name;
+	u32 item_size;
+	u32 count, max_items;
+	u8 *items;
+	u32 *item_slots;		/*! Slot of each item. */
+	Handle_Slot *slots;
+	u32 num_slots, max_slots;
+	u32 free_slots;			/*! First free slot + 1, 0 if none. */
+} Handle_Table;
+
+#endif /* CTOOL_HANDLES */
@@ -0,0 +1,352 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "profiler.h"
+#include "headless.h"
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA	(0x31DD)
+#endif
+
+/*! Creates a GL context without any window system (EGL_MESA_platform_
+	surfaceless, e.g. Mesa llvmpipe) and binds an FBO of the given size.
+	Call before gl_lite_init, the FBO is created by headless_setup_fbo. */
+int headless_init( Headless *h, int width, int height ) {
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		( PFNEGLGETPLATFORMDISPLAYEXTPROC ) eglGetProcAddress(
+			"eglGetPlatformDisplayEXT" );
+	EGLint major, minor;
+	const EGLint context_attr[ ] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 5,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK,
+		EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT,
+		EGL_NONE
+	};
+	const EGLint fallback_attr[ ] = { EGL_NONE };
+
+	memset( h, 0, sizeof( Headless ) );
+	h->width = width;
+	h->height = height;
+
+	if( !get_platform_display ) {
+		fprintf( stderr, "Error: eglGetPlatformDisplayEXT not available!\n" );
+		return -1;
+	}
+	h->display = get_platform_display( EGL_PLATFORM_SURFACELESS_MESA,
+		EGL_DEFAULT_DISPLAY, 0 );
+
+	if( EGL_NO_DISPLAY == h->display
+		|| !eglInitialize( h->display, &major, &minor ) )
+	{
+		fprintf( stderr, "Error: no surfaceless EGL display!\n" );
+		return -1;
+	}
+	if( !eglBindAPI( EGL_OPENGL_API ) ) {
+		fprintf( stderr, "Error: EGL has no desktop OpenGL!\n" );
+		return -1;
+	}
+	/* EGL_KHR_no_config_context, no surface needs a matching config. */
+	h->context = eglCreateContext( h->display, ( EGLConfig ) 0,
+		EGL_NO_CONTEXT, context_attr );
+
+	if( EGL_NO_CONTEXT == h->context ) {
+		h->context = eglCreateContext( h->display, ( EGLConfig ) 0,
+			EGL_NO_CONTEXT, fallback_attr );
+	}
+	if( EGL_NO_CONTEXT == h->context || !eglMakeCurrent( h->display,
+		EGL_NO_SURFACE, EGL_NO_SURFACE, h->context ) )
+	{
+		fprintf( stderr, "Error: could not create an EGL context!\n" );
+		return -1;
+	}
+	printf( "Headless EGL %d.%d context obtained.\n", major, minor );
+	return 0;
+}
+
+/*! Color and depth renderbuffers, bound as the draw and read framebuffer.
+	Needs the GL entry points, call after gl_lite_init. */
+int headless_setup_fbo( Headless *h ) {
+	glGenFramebuffers( 1, &h->fbo );
+	glGenRenderbuffers( 2, h->renderbuffers );
+	glBindFramebuffer( GL_FRAMEBUFFER, h->fbo );
+	glBindRenderbuffer( GL_RENDERBUFFER, h->renderbuffers[ 0 ] );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, h->width, h->height );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_RENDERBUFFER, h->renderbuffers[ 0 ] );
+	glBindRenderbuffer( GL_RENDERBUFFER, h->renderbuffers[ 1 ] );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+		h->width, h->height );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+		GL_RENDERBUFFER, h->renderbuffers[ 1 ] );
+	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+
+	if( GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus( GL_FRAMEBUFFER ) ) {
+		fprintf( stderr, "Error: headless framebuffer incomplete!\n" );
+		return -1;
+	}
+	h->pixels = malloc( h->width * h->height * 3 );
+	return h->pixels ? 0 : -1;
+}
+
+/*! Reads the color buffer, this waits for the frame to finish. */
+void headless_read( Headless *h ) {
+	glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+	glReadPixels( 0, 0, h->width, h->height, GL_RGB, GL_UNSIGNED_BYTE,
+		h->pixels );
+}
+
+/*! FNV-1a of the last frame read, for regression checks. */
+u32 headless_checksum( const Headless *h ) {
+	u32 i, hash = 2166136261U;
+
+	for( i = 0; i < ( u32 ) ( h->width * h->height * 3 ); ++i ) {
+		hash = ( hash ^ h->pixels[ i ] ) * 16777619U;
+	}
+	return hash;
+}
+
+/*! Writes the last frame read as binary PPM, top row first. */
+int headless_dump( const Headless *h, const char *file ) {
+	FILE *fh = fopen( file, "wb" );
+	int y;
+
+	if( !fh ) {
+		fprintf( stderr, "Could not write file %s\n", file );
+		return -1;
+	}
+	fprintf( fh, "P6\n%d %d\n255\n", h->width, h->height );
+
+	for( y = h->height - 1; y >= 0; --y ) {
+		fwrite( h->pixels + y * h->width * 3, 3, h->width, fh );
+	}
+	fclose( fh );
+	return 0;
+}
+
+static void headless_write_stats( FILE *fh, const char *name,
+	const Prof_Stats *s, int last )
+{
+	fprintf( fh, "  \"%s\": { \"frames\": %u, \"mean\": %.4f, "
+		"\"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p95\": %.4f, "
+		"\"p99\": %.4f }%s\n", name, s->frames, s->mean, s->min, s->max,
+		s->p50, s->p95, s->p99, last ? "" : "," );
+}
+
+/*! Writes the frame time statistics of the profiler as JSON, to stdout if
+	file is 0. calls are the GL calls per entry point over all frames, 0 if
+	GL was not used. */
+int headless_report( const Headless *h, const char *renderer,
+	const char *file, u32 frames, double seconds, const GLuint *calls )
+{
+	FILE *fh = file ? fopen( file, "w" ) : stdout;
+	Prof_Stats cpu, gpu;
+
+	if( !fh ) {
+		fprintf( stderr, "Could not write file %s\n", file );
+		return -1;
+	}
+	prof_stats( 0, &cpu );
+	prof_stats( 1, &gpu );
+	fprintf( fh, "{\n" );
+	fprintf( fh, "  \"renderer\": \"%s\",\n", renderer );
+	fprintf( fh, "  \"width\": %d,\n  \"height\": %d,\n",
+		h->width, h->height );
+	fprintf( fh, "  \"frames\": %u,\n  \"seconds\": %.4f,\n", frames,
+		seconds );
+	fprintf( fh, "  \"fps\": %.2f,\n", seconds > 0.0 ? frames / seconds : 0.0 );
+	fprintf( fh, "  \"checksum\": \"%08x\",\n", headless_checksum( h ) );
+	headless_write_stats( fh, "cpu_ms", &cpu, 0 );
+	headless_write_stats( fh, "gpu_ms", &gpu, !calls );
+
+	if( calls ) {
+		u32 i, total = 0;
+		for( i = 0; i < GL_ID_MAX; ++i ) {
+			total += calls[ i ];
+		}
+		fprintf( fh, "  \"gl_calls_per_frame\": %.2f,\n",
+			frames ? ( double ) total / frames : 0.0 );
+		fprintf( fh, "  \"gl_calls\": {\n    \"total\": %u", total );
+
+		for( i = 0; i < GL_ID_MAX; ++i ) {
+			if( calls[ i ] ) {
+				fprintf( fh, ",\n    \"gl%s\": %u", gl_lite_names[ i ],
+					calls[ i ] );
+			}
+		}
+		fprintf( fh, "\n  }\n" );
+	}
+	fprintf( fh, "}\n" );
+
+	if( file ) {
+		fclose( fh );
+	}
+	return 0;
+}
+
+/*! Reads the "key": value pairs of a report, values of nested objects as
+	"object.key". Strings lose their quotes. Returns -1 if the file can not
+	be read. */
+static int headless_read_report( const char *file, Report_Value *values,
+	int max )
+{
+	FILE *fh = fopen( file, "r" );
+	char prefix[ REPORT_KEY + 1 ] = "", key[ REPORT_KEY ], *text, *p, *end;
+	long len;
+	int n = 0;
+
+	if( !fh ) {
+		fprintf( stderr, "Could not read file %s\n", file );
+		return -1;
+	}
+	fseek( fh, 0, SEEK_END );
+	len = ftell( fh );
+	fseek( fh, 0, SEEK_SET );
+	text = ( len >= 0 ) ? malloc( len + 1 ) : 0;
+
+	if( !text || len != ( long ) fread( text, 1, len, fh ) ) {
+		fprintf( stderr, "Could not read file %s\n", file );
+		free( text );
+		fclose( fh );
+		return -1;
+	}
+	fclose( fh );
+	text[ len ] = 0;
+
+	for( p = text; *p; ++p ) {
+		if( '}' == *p ) {
+			prefix[ 0 ] = 0;
+		}
+		if( '"' != *p || !( end = strchr( p + 1, '"' ) ) ) {
+			continue;
+		}
+		snprintf( key, REPORT_KEY, "%s%.*s", prefix, ( int ) ( end - p - 1 ),
+			p + 1 );
+		for( p = end + 1; ' ' == *p; ++p );
+		if( ':' != *p ) {
+			--p;
+			continue;
+		}
+		for( ++p; ' ' == *p; ++p );
+
+		if( '{' == *p ) {
+			snprintf( prefix, sizeof( prefix ), "%s.", key );
+		} else if( n < max ) {
+			if( '"' == *p ) {
+				end = strchr( ++p, '"' );
+			} else {
+				end = p + strcspn( p, ",}\n " );
+			}
+			if( !end ) {
+				break;
+			}
+			strcpy( values[ n ].key, key );
+			snprintf( values[ n ].value, REPORT_VALUE, "%.*s",
+				( int ) ( end - p ), p );
+			++n;
+			p = end;
+		}
+	}
+	free( text );
+	return n;
+}
+
+static const Report_Value *headless_find_value( const Report_Value *values,
+	int n, const char *key )
+{
+	int i;
+	for( i = 0; i < n; ++i ) {
+		if( 0 == strcmp( values[ i ].key, key ) ) {
+			return &values[ i ];
+		}
+	}
+	return 0;
+}
+
+/*! Prints the differences of two reports. The checksum, the frame count and
+	the GL call counts have to match, mean and percentile frame times may be
+	up to tolerance percent slower. Query readbacks depend on when the GPU
+	finishes, their counts and the total are only printed. Returns 1 on a
+	regression. */
+int headless_compare( const char *file, const char *baseline,
+	float tolerance )
+{
+	static Report_Value current[ REPORT_MAX_VALUES ], base[ REPORT_MAX_VALUES ];
+	int i, num_current, num_base, failed = 0;
+
+	num_current = headless_read_report( file, current, REPORT_MAX_VALUES );
+	num_base = headless_read_report( baseline, base, REPORT_MAX_VALUES );
+	if( num_current < 0 || num_base < 0 ) {
+		return -1;
+	}
+	printf( "%-36s %14s %14s %8s\n", "baseline vs current", baseline, file,
+		"change" );
+
+	for( i = 0; i < num_base + num_current; ++i ) {
+		const Report_Value *b, *c;
+		const char *key, *status = "";
+		double change = 0.0;
+
+		if( i < num_base ) {
+			key = base[ i ].key;
+		} else { /* keys only in the current report */
+			key = current[ i - num_base ].key;
+			if( headless_find_value( base, num_base, key ) ) {
+				continue;
+			}
+		}
+		b = headless_find_value( base, num_base, key );
+		c = headless_find_value( current, num_current, key );
+
+		if( b && c ) {
+			double vb = atof( b->value ), vc = atof( c->value );
+			change = vb > 0.0 ? 100.0 * ( vc - vb ) / vb : 0.0;
+		}
+		if( 0 == strcmp( key, "checksum" ) || 0 == strcmp( key, "frames" )
+			|| 0 == strncmp( key, "gl_calls.", 9 ) )
+		{
+			int exact = !strstr( key, "GetQueryObject" )
+				&& 0 != strcmp( key, "gl_calls.total" );
+			if( exact && ( !b || !c || 0 != strcmp( b->value, c->value ) ) ) {
+				status = "CHANGED";
+				failed = 1;
+			}
+		} else if( strstr( key, "_ms." ) && !strstr( key, ".min" )
+			&& !strstr( key, ".max" ) && !strstr( key, ".frames" ) )
+		{
+			if( b && c && atof( b->value ) > 0.0 && change > tolerance ) {
+				status = "SLOWER";
+				failed = 1;
+			} else if( change < -tolerance ) {
+				status = "faster";
+			}
+		} else {
+			continue;
+		}
+		printf( "%-36s %14s %14s %7.1f%% %s\n", key, b ? b->value : "-",
+			c ? c->value : "-", change, status );
+	}
+	printf( "%s, tolerance %.1f%%\n", failed ? "REGRESSION" : "ok",
+		tolerance );
+	return failed;
+}
+
+void headless_free( Headless *h ) {
+	if( h->fbo ) {
+		glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+		glDeleteFramebuffers( 1, &h->fbo );
+		glDeleteRenderbuffers( 2, h->renderbuffers );
+	}
+	if( EGL_NO_CONTEXT != h->context ) {
+		eglMakeCurrent( h->display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+			EGL_NO_CONTEXT );
+		eglDestroyContext( h->display, h->context );
+	}
+	if( EGL_NO_DISPLAY != h->display ) {
+		eglTerminate( h->display );
+	}
+	free( h->pixels );
+	memset( h, 0, sizeof( Headless ) );
+}
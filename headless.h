@@ -0,0 +1,25 @@
+#ifndef CTOOL_HEADLESS
+#define CTOOL_HEADLESS
+
+#include <EGL/egl.h>
+#include "types.h"
+
+typedef struct { /*! Surfaceless EGL context rendering into an FBO. */
+	EGLDisplay display;
+	EGLContext context;
+	u32 fbo;
+	u32 renderbuffers[ 2 ];	/*! Color and depth. */
+	int width, height;
+	u8 *pixels;				/*! Last frame read by headless_read, RGB. */
+} Headless;
+
+#define REPORT_KEY			(48U)
+#define REPORT_VALUE		(64U)
+#define REPORT_MAX_VALUES	(256U)
+
+typedef struct { /*! One value of a JSON report, see headless_compare. */
+	char key[ REPORT_KEY ];	/*! Nested keys joined by '.'. */
+	char value[ REPORT_VALUE ];
+} Report_Value;
+
+#endif /* CTOOL_HEADLESS */
@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "input.h"
+
+#define INPUT_MAGIC		"# opengl-test input v1"
+
+int input_record( Input_Recording *r, double time, u32 type, u32 code,
+	u32 shift )
+{
+	Input_Event *e;
+
+	if( r->num_events == r->max_events ) {
+		u32 max = r->max_events ? 2 * r->max_events : 256;
+		Input_Event *events = realloc( r->events, max * sizeof( Input_Event ) );
+		if( !events ) {
+			return -1;
+		}
+		r->events = events;
+		r->max_events = max;
+	}
+	e = &r->events[ r->num_events++ ];
+	e->time = time;
+	e->type = type;
+	e->code = code;
+	e->shift = shift;
+	return 0;
+}
+
+/*! Writes one event per line as text, time in milliseconds. */
+int input_save( const Input_Recording *r, const char *file ) {
+	FILE *fh = fopen( file, "w" );
+	u32 i;
+
+	if( !fh ) {
+		fprintf( stderr, "Could not write file %s\n", file );
+		return -1;
+	}
+	fprintf( fh, "%s\n", INPUT_MAGIC );
+
+	for( i = 0; i < r->num_events; ++i ) {
+		const Input_Event *e = &r->events[ i ];
+		fprintf( fh, "%.3f %u %u %u\n", e->time, e->type, e->code, e->shift );
+	}
+	fclose( fh );
+	return 0;
+}
+
+int input_load( Input_Recording *r, const char *file ) {
+	FILE *fh = fopen( file, "r" );
+	char line[ 128 ];
+	double time, last = 0.0;
+	u32 type, code, shift;
+
+	memset( r, 0, sizeof( Input_Recording ) );
+
+	if( !fh ) {
+		fprintf( stderr, "Could not read file %s\n", file );
+		return -1;
+	}
+	if( !fgets( line, sizeof( line ), fh )
+		|| 0 != strncmp( line, INPUT_MAGIC, strlen( INPUT_MAGIC ) ) )
+	{
+		fprintf( stderr, "%s is no input recording.\n", file );
+		fclose( fh );
+		return -1;
+	}
+	while( fgets( line, sizeof( line ), fh ) ) {
+		if( 4 != sscanf( line, "%lf %u %u %u", &time, &type, &code, &shift ) ) {
+			continue;
+		}
+		if( type > INPUT_END || time < last ) {
+			fprintf( stderr, "%s: event at %.3f out of order.\n", file, time );
+			fclose( fh );
+			return -1;
+		}
+		last = time;
+		if( input_record( r, time, type, code, shift ) < 0 ) {
+			fclose( fh );
+			return -1;
+		}
+	}
+	fclose( fh );
+	return 0;
+}
+
+/*! Milliseconds covered by the recording. */
+double input_duration( const Input_Recording *r ) {
+	return r->num_events ? r->events[ r->num_events - 1 ].time : 0.0;
+}
+
+/*! Frames of INPUT_REPLAY_DT to replay all events, the last one included. */
+u32 input_frames( const Input_Recording *r ) {
+	return ( u32 ) ( input_duration( r ) / INPUT_REPLAY_DT ) + 1;
+}
+
+/*! Returns the next event with a time up to time in out, 0 when there is
+	none. Call until 0 once per frame. */
+int input_next( Input_Recording *r, double time, Input_Event *out ) {
+	if( r->next < r->num_events && r->events[ r->next ].time <= time ) {
+		*out = r->events[ r->next++ ];
+		return 1;
+	}
+	return 0;
+}
+
+void input_free( Input_Recording *r ) {
+	free( r->events );
+	memset( r, 0, sizeof( Input_Recording ) );
+}
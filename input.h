@@ -0,0 +1,28 @@
+#ifndef CTOOL_INPUT
+#define CTOOL_INPUT
+
+#include "types.h"
+
+#define INPUT_REPLAY_DT		(1000.0 / 60.0)	/* Fixed timestep of a replay, ms. */
+
+enum {
+	INPUT_KEY_DOWN,
+	INPUT_KEY_UP,
+	INPUT_BUTTON,
+	INPUT_END			/* Marks the length of the recording. */
+};
+
+typedef struct { /*! One window system event that drives the scene. */
+	double time;		/*! Milliseconds since the start of the recording. */
+	u32 type;
+	u32 code;			/*! KeySym or mouse button. */
+	u32 shift;			/*! Shift was held. */
+} Input_Event;
+
+typedef struct { /*! Events in time order, see input_next for the replay. */
+	u32 num_events, max_events;
+	Input_Event *events;
+	u32 next;			/*! First event not replayed yet. */
+} Input_Recording;
+
+#endif /* CTOOL_INPUT */
@@ -0,0 +1,149 @@
+#include <unistd.h>
+#include "jobs.h"
+
+/*! Runs one job, the lock must be held and is held again on return. */
+static void jobs_run_one( Job_System *js ) {
+	Job job = js->queue[ js->head++ & ( JOBS_QUEUE_SIZE - 1 ) ];
+	pthread_mutex_unlock( &js->lock );
+	job.func( job.arg );
+	pthread_mutex_lock( &js->lock );
+
+	if( 0 == --job.counter->pending ) {
+		pthread_cond_broadcast( &js->done );
+	}
+}
+
+static void *jobs_worker( void *arg ) {
+	Job_System *js = arg;
+	pthread_mutex_lock( &js->lock );
+	arena_set_scratch( &js->scratch[ js->started++ ] );
+
+	while( !js->quit ) {
+		if( js->head != js->tail ) {
+			jobs_run_one( js );
+		} else {
+			pthread_cond_wait( &js->work, &js->lock );
+		}
+	}
+	pthread_mutex_unlock( &js->lock );
+	return 0;
+}
+
+/*! Starts num_threads workers, 0 uses one less than the number of cores
+	and a negative count starts none. With no workers all jobs run inside
+	jobs_wait. */
+int jobs_init( Job_System *js, int num_threads ) {
+	u32 i;
+
+	if( 0 == num_threads ) {
+		num_threads = sysconf( _SC_NPROCESSORS_ONLN ) - 1;
+	}
+	if( num_threads < 0 ) {
+		num_threads = 0;
+	} else if( num_threads > JOBS_MAX_THREADS ) {
+		num_threads = JOBS_MAX_THREADS;
+	}
+	js->head = js->tail = 0;
+	js->quit = 0;
+	js->num_threads = 0;
+	js->started = 0;
+	pthread_mutex_init( &js->lock, 0 );
+	pthread_cond_init( &js->work, 0 );
+	pthread_cond_init( &js->done, 0 );
+
+	for( i = 0; i < ( u32 ) num_threads; ++i ) {
+		if( arena_init( &js->scratch[ i ], ARENA_SCRATCH_SIZE,
+			"worker scratch" ) < 0 )
+		{
+			break;
+		}
+		if( 0 != pthread_create( &js->threads[ i ], 0, jobs_worker, js ) ) {
+			fprintf( stderr, "Error: could not start worker thread %u.\n", i );
+			arena_free( &js->scratch[ i ] );
+			break;
+		}
+		++js->num_threads;
+	}
+	return js->num_threads;
+}
+
+/*! Queues a job and counts it in counter. A full queue runs the job on the
+	calling thread. Jobs may submit further jobs to the same counter. */
+void jobs_submit( Job_System *js, Job_Counter *counter, Job_Func *func,
+	void *arg )
+{
+	pthread_mutex_lock( &js->lock );
+
+	if( js->tail - js->head >= JOBS_QUEUE_SIZE ) {
+		pthread_mutex_unlock( &js->lock );
+		func( arg );
+		return;
+	}
+	++counter->pending;
+	js->queue[ js->tail++ & ( JOBS_QUEUE_SIZE - 1 ) ] =
+		( Job ) { func, arg, counter };
+	pthread_cond_signal( &js->work );
+	pthread_mutex_unlock( &js->lock );
+}
+
+/*! Waits until all jobs of counter finished, runs queued jobs meanwhile. */
+void jobs_wait( Job_System *js, Job_Counter *counter ) {
+	pthread_mutex_lock( &js->lock );
+
+	while( counter->pending ) {
+		if( js->head != js->tail ) {
+			jobs_run_one( js );
+		} else {
+			pthread_cond_wait( &js->done, &js->lock );
+		}
+	}
+	pthread_mutex_unlock( &js->lock );
+}
+
+/*! Number of unfinished jobs of counter, returns without waiting. With no
+	workers one queued job runs on the calling thread. */
+u32 jobs_pending( Job_System *js, Job_Counter *counter ) {
+	u32 pending;
+	pthread_mutex_lock( &js->lock );
+
+	if( !js->num_threads && counter->pending && js->head != js->tail ) {
+		jobs_run_one( js );
+	}
+	pending = counter->pending;
+	pthread_mutex_unlock( &js->lock );
+	return pending;
+}
+
+/*! The scratch arenas of the workers as one, the highest high water mark
+	and all overflows. */
+void jobs_summary( const Job_System *js, FILE *out ) {
+	Arena all = { "worker scratch", 0, ARENA_SCRATCH_SIZE, 0, 0, 0 };
+	u32 i;
+
+	for( i = 0; i < js->num_threads; ++i ) {
+		if( js->scratch[ i ].high_water > all.high_water ) {
+			all.high_water = js->scratch[ i ].high_water;
+		}
+		all.overflows += js->scratch[ i ].overflows;
+	}
+	if( js->num_threads ) {
+		arena_summary( &all, out );
+	}
+}
+
+void jobs_shutdown( Job_System *js ) {
+	u32 i;
+	pthread_mutex_lock( &js->lock );
+	js->quit = 1;
+	pthread_cond_broadcast( &js->work );
+	pthread_mutex_unlock( &js->lock );
+
+	for( i = 0; i < js->num_threads; ++i ) {
+		pthread_join( js->threads[ i ], 0 );
+		arena_free( &js->scratch[ i ] );
+	}
+	pthread_cond_destroy( &js->work );
+	pthread_cond_destroy( &js->done );
+	pthread_mutex_destroy( &js->lock );
+	js->num_threads = 0;
+}
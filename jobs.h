@@ -0,0 +1,36 @@
+#ifndef CTOOL_JOBS
+#define CTOOL_JOBS
+
+#include <pthread.h>
+#include "types.h"
+#include "arena.h"
+
+#define JOBS_MAX_THREADS	(16U)
+#define JOBS_QUEUE_SIZE		(1024U) /* power of two */
+
+typedef void Job_Func( void *arg );
+
+typedef struct { /*! Number of unfinished jobs of a group, see jobs_wait. */
+	u32 pending;
+} Job_Counter;
+
+typedef struct {
+	Job_Func *func;
+	void *arg;
+	Job_Counter *counter;
+} Job;
+
+typedef struct { /*! Fixed pool of worker threads with one shared queue. */
+	pthread_t threads[ JOBS_MAX_THREADS ];
+	Arena scratch[ JOBS_MAX_THREADS ];	/*! Of each worker, see scratch_alloc. */
+	u32 started;				/*! Workers that took their scratch arena. */
+	pthread_mutex_t lock;
+	pthread_cond_t work;		/*! Signaled when a job is queued. */
+	pthread_cond_t done;		/*! Signaled when a counter reaches 0. */
+	u32 num_threads;
+	u32 head, tail;
+	int quit;
+	Job queue[ JOBS_QUEUE_SIZE ];
+} Job_System;
+
+#endif /* CTOOL_JOBS */
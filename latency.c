@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "latency.h"
+
+static double latency_now( void ) {
+	struct timespec time;
+	clock_gettime( CLOCK_MONOTONIC, &time );
+	return ( double ) time.tv_sec * 1000.0 + ( double ) time.tv_nsec / 1000000.0;
+}
+
+/*! At most frames_in_flight frames are queued after the swap, 1 gives the
+	lowest latency at the cost of the CPU and GPU overlap. Needs
+	gl_caps.fence_sync. */
+void latency_init( Latency *l, u32 frames_in_flight ) {
+	memset( l, 0, sizeof( Latency ) );
+	l->frames_in_flight = ( frames_in_flight < 1 ) ? 1
+		: ( frames_in_flight > LATENCY_MAX_IN_FLIGHT ) ? LATENCY_MAX_IN_FLIGHT
+		: frames_in_flight;
+	l->input_time = -1.0;
+}
+
+/*! Notes input for the frame being built, the first event counts. */
+void latency_input( Latency *l ) {
+	if( l->input_time < 0.0 ) {
+		l->input_time = latency_now( );
+	}
+}
+
+/*! Samples the latency of the oldest frame, its fence has signaled. */
+static void latency_retire( Latency *l ) {
+	double input_time = l->input_times[ l->first ];
+
+	if( input_time >= 0.0 ) {
+		l->samples[ l->num_samples++ % LATENCY_HISTORY ] =
+			latency_now( ) - input_time;
+	}
+	glDeleteSync( l->fences[ l->first ] );
+	l->first = ( l->first + 1 ) % LATENCY_MAX_IN_FLIGHT;
+	l->count--;
+}
+
+/*! Retires the frames the GPU has finished without blocking, so their
+	latency does not include the CPU work of later frames. Fences signal
+	in order, the first pending one ends the poll. */
+static void latency_poll( Latency *l ) {
+	while( l->count ) {
+		GLenum status = glClientWaitSync( l->fences[ l->first ],
+			GL_SYNC_FLUSH_COMMANDS_BIT, 0 );
+
+		if( GL_ALREADY_SIGNALED != status
+			&& GL_CONDITION_SATISFIED != status )
+		{
+			return;
+		}
+		latency_retire( l );
+	}
+}
+
+/*! Waits for the oldest fence and retires its frame. */
+static void latency_block( Latency *l ) {
+	GLenum status;
+
+	do {
+		status = glClientWaitSync( l->fences[ l->first ],
+			GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000 );
+	} while( GL_TIMEOUT_EXPIRED == status );
+
+	latency_retire( l );
+}
+
+/*! Blocks until less than frames_in_flight frames are queued. Call before
+	reading the input, so the view is built from the freshest events. */
+void latency_wait( Latency *l ) {
+	latency_poll( l );
+
+	while( l->count >= l->frames_in_flight ) {
+		latency_block( l );
+	}
+}
+
+/*! Fences the frame after the swap. */
+void latency_frame_end( Latency *l ) {
+	u32 i;
+
+	latency_poll( l );
+	i = ( l->first + l->count ) % LATENCY_MAX_IN_FLIGHT;
+	l->fences[ i ] = glFenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+	l->input_times[ i ] = l->input_time;
+	l->input_time = -1.0;
+	l->count++;
+}
+
+/*! Prints the percentiles of the input to present latency. The frame is
+	counted as presented when the CPU first sees its fence signaled, the
+	fences are polled at the start and at the end of every frame. */
+void latency_summary( Latency *l, FILE *out ) {
+	float samples[ LATENCY_HISTORY ], p[ 3 ];
+	u32 n = ( l->num_samples < LATENCY_HISTORY ) ? l->num_samples
+		: LATENCY_HISTORY;
+
+	memcpy( samples, l->samples, n * sizeof( float ) );
+	prof_percentiles( samples, n, p );
+	fprintf( out, "input latency ms: p50 %.3f p95 %.3f p99 %.3f "
+		"(%u frames, %u in flight)\n", p[ 0 ], p[ 1 ], p[ 2 ], n,
+		l->frames_in_flight );
+}
+
+/*! Waits for the frames still in flight, their latency is sampled. */
+void latency_free( Latency *l ) {
+	while( l->count ) {
+		latency_block( l );
+	}
+}
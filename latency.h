@@ -0,0 +1,21 @@
+#ifndef CTOOL_LATENCY
+#define CTOOL_LATENCY
+
+#include "types.h"
+
+#define LATENCY_MAX_IN_FLIGHT	(4U)	/* Fenced frames the CPU may run ahead. */
+#define LATENCY_HISTORY			(1024U)	/* Samples in the statistics ring. */
+
+typedef struct { /*! Limits the frames queued after the swap with fences and
+	measures the time from the first input of a frame until the GPU
+	finished it. */
+	u32 frames_in_flight;
+	GLsync fences[ LATENCY_MAX_IN_FLIGHT ];
+	double input_times[ LATENCY_MAX_IN_FLIGHT ];	/*! < 0 without input. */
+	u32 first, count;			/*! Ring of the pending fences. */
+	double input_time;			/*! First input of the frame being built. */
+	u32 num_samples;
+	float samples[ LATENCY_HISTORY ];	/*! Milliseconds, a ring. */
+} Latency;
+
+#endif /* CTOOL_LATENCY */
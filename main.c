@@ -1,10 +1,12 @@
-/* gcc -Wall -O2 -o test main.c -lm -ldl -lX11 -lXi -lXrandr -lGL */
+/* gcc -Wall -O2 -o test main.c -lm -ldl -lpthread -lX11 -lXi -lXrandr -lGL -lEGL */
 // https://github.com/unaugmented/opengl-test
 
 #include <malloc.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 #include <X11/extensions/Xrandr.h>
@@ -12,8 +14,26 @@
 #include "types.h"
 #include "gl_lite.c"
 #include "3d.c"
+#include "arena.c"
+#include "handles.c"
 #include "shading.c"
+#include "mob.c"
 #include "assets.c"
+#include "batch.c"
+#include "culling.c"
+#include "jobs.c"
+#include "profiler.c"
+#include "occlusion.c"
+#include "occlusion_query.c"
+#include "clusters.c"
+#include "headless.c"
+#include "swrast.c"
+#include "input.c"
+#include "scene.c"
+#include "latency.c"
+#include "virtual_texture.c"
+#include "pan_cache.c"
+#include "reload.c"
 
 //------------------------------------------------------------------------------
 
@@ -25,19 +45,50 @@ enum { /*! Handle standard mouse with 3 buttons. */
 	MOUSE_UP
 };
 
-enum {
-	SHAPE_PLANE,
-	SHAPE_MAX
+enum { /* Occlusion culling of the static batch. */
+	OCCLUSION_NONE,
+	OCCLUSION_SOFTWARE,
+	OCCLUSION_QUERIES
 };
 
-enum {
-	TEXTURE_BLUEPRINT,
-	TEXTURE_MAX
-};
+#define SIM_TICK_MS		( 1000.0 / 120.0 ) /* 120 Hz simulation. */
+#define SIM_MAX_TICKS	(4U) /* Per frame, the rest of a longer one is dropped. */
 
 //------------------------------------------------------------------------------
 
 static int camera_changed;
+static int verify_cull = 0; /* Compare GPU culling with the CPU reference. */
+static int occlusion_mode = OCCLUSION_SOFTWARE;
+static int depth_prepass = 1; /* Lay down depth before the lit pass. */
+static int profile = 0; /* --profile, frame time percentiles at exit. */
+static const char *trace_file = 0; /* --trace, Chrome trace JSON at exit. */
+static int headless = 0; /* --headless, surfaceless EGL and an FBO. */
+static u32 headless_frames = 300; /* --frames */
+static const char *dump_dir = 0; /* --dump, every frame as PPM. */
+static const char *report_file = 0; /* --report, JSON, default stdout. */
+static int software = 0; /* --software, CPU rasterizer, no GL at all. */
+static int bench_software = 0; /* --bench-software, throughput per thread. */
+static const char *record_file = 0; /* --record, input events at exit. */
+static const char *replay_file = 0; /* --replay, fixed timestep run. */
+static const char *baseline_file = 0; /* --baseline, report to compare. */
+static float tolerance = 10.0f; /* --tolerance, slower frame times in %. */
+static Input_Recording input;
+static const char *scene_file = 0; /* --scene, instead of the plane. */
+static int direct_state_access = 1; /* --no-dsa, bind to edit objects. */
+static int on_demand = 0; /* --on-demand, sleep until something changes. */
+static int redraw = 1; /* Input, expose or new assets, render a frame. */
+static int low_latency = 0; /* --low-latency, fences and late input. */
+static u32 frames_in_flight = 1; /* --frames-in-flight, with low_latency. */
+static int swap_interval = 0; /* --swap-interval, -1 adaptive vsync. */
+static int swap_control = 0; /* Set the swap interval, else driver default. */
+static Latency latency;
+static const char *vt_file = 0; /* --virtual-texture, pages on the plane. */
+static Virtual_Texture vt;
+static int pan = 0; /* --pan-cache, blit the plane while panning. */
+static Pan_Cache pan_cache;
+static int watch = 0; /* --watch, reload assets changed on disk. */
+static Reload reload;
+static Scene scene;
 static int cull = 0;
 static int cur_angle = 0;
 static int width = 800; // 16 : 9
@@ -56,18 +107,38 @@ static const Vector_3d Z_AXIS = { 0.0f, 0.0f, 1.0f };
 static double timer_start;
 static double timer_end;
 static double delta_t = 0.0f;
+static double sim_accumulator = 0.0; /* Frame time not simulated yet. */
+static Camera camera_previous; /* State before the last tick. */
+static Vector_3d plane_previous;
+static Vector_3d plane_interpolated; /* Rendered, between the last ticks. */
 static float speeds[ 6 ];
 static float cam_angles[ 3 ];
 
 static Camera camera;
-static Vao vaos[ SHAPE_MAX ];
-static Texture textures[ TEXTURE_MAX ];
+static Handle_Table vaos = { "vao", sizeof( Vao ) };
+static Handle plane_vao;
+static Batch static_batch; /* All opaque static meshes, one texture. */
+static int plane_draw;
+static Job_System jobs;
+static Arena frame_arena; /* Per frame lists, reset after the swap. */
+static Arena scratch; /* Of the main thread, workers have their own. */
+static Occlusion occlusion;
+static Occlusion_Queries occlusion_queries;
+static Handle_Table textures = { "texture", sizeof( Texture ) };
+static Handle batch_texture; /* Sampled by the static batch. */
+static Handle_Table images = { "image", sizeof( Image ) }; /* Pixels for the
+	software rasterizer. */
+static Handle batch_image;
+static Swrast swrast;
 static Vector_3d plane_position;
 static Quaternion plane_rotation;
 static Perspective perspective;
 static Matrix_4x4 view_matrix;
 static Matrix_4x4 projection_matrix;
 static Directional_Light sun;
+static Clusters clusters;
+static Light point_lights[ CLUSTER_MAX_LIGHTS ];
+static u32 num_point_lights = 0; /* --lights N */
 
 //------------------------------------------------------------------------------
 
@@ -131,6 +202,9 @@ void print_mat( const char *msg, const Matrix_4x4 *m, int prec ) {
 }
 
 void opengl_setup( void ) {
+	if( !direct_state_access ) {
+		gl_caps.direct_state_access = 0;
+	}
 	glClearColor( 0.0f, 0.0f, 0.0f, 1.0f );
 	glEnable( GL_DEPTH_TEST );
 	glDepthFunc( GL_LEQUAL );
@@ -159,8 +233,11 @@ void setup_perspective( float width, float height ) {
 	camera.position.z = 6.0f;
 	quaternion_from_euler_v( &camera.rotation, rot );
 	quaternion_normalize( &camera.rotation );
+	camera_previous = camera;
+	sim_accumulator = 0.0;
 
 	camera_changed = 1;
+	clusters_setup( &clusters, &perspective, width, height );
 
 	print_mat( "projection matrix", &projection_matrix, 2 );
 }
@@ -172,6 +249,29 @@ void setup_light( void ) {
 	sun.position = ( Vector_3d ) { .x = 0.0f, .y = 10.0f, .z = 0.0f };
 	sun.intensities = ( Color ) { 255.0f, 255.0f, 255.0f, 127.0f };
 	sun.ambient_coefficient = 0.008f; // 80 %
+
+	/* Point lights on a grid just above the plane, colors from a fixed
+		seed. Height and attenuation shrink with the spacing, so the number
+		of lights reaching a pixel stays the same. */
+	u32 i, side = ( u32 ) ceilf( sqrtf( ( float ) num_point_lights ) );
+	u32 seed = 1;
+	float h = side ? 1.0f / side : 0.0f;
+
+	for( i = 0; i < num_point_lights; ++i ) {
+		Light *l = &point_lights[ i ];
+		float c[ 3 ];
+		int j;
+
+		for( j = 0; j < 3; ++j ) {
+			seed = seed * 1103515245U + 12345U;
+			c[ j ] = 0.2f + 0.8f * ( float ) ( ( seed >> 16 ) & 0x7FFF ) / 32767.0f;
+		}
+		l->position = ( Vector_4d ) {
+			-1.0f + 2.0f * ( ( i % side ) + 0.5f ) / side,
+			-1.0f + 2.0f * ( ( i / side ) + 0.5f ) / side, -1.0f + h, 1.0f };
+		l->intensities = ( Color ) { c[ 0 ], c[ 1 ], c[ 2 ], 4.0f / ( h * h ) };
+		l->ambient_coefficient = 0.0f;
+	}
 }
 
 int upd_cur_angle( int dir ) {
@@ -211,27 +311,64 @@ void rotate_camera( double dt ) {
 	}
 }
 
-void update_camera( double dt ) {
+/*! One fixed step of the camera movement. */
+void simulate_tick( void ) {
+	camera_previous = camera;
+	plane_previous = plane_position;
+
+	if( speeds[ 0 ] || speeds[ 1 ] || speeds[ 2 ] || speeds[ 3 ] ) {
+//		rotate_camera( SIM_TICK_MS );
+		translate_camera( SIM_TICK_MS );
+	}
+}
+
+/*! Whether the next frame differs from the last one without new input,
+	the camera still moves or is interpolated towards the last tick. */
+int simulation_active( void ) {
+	return speeds[ 0 ] || speeds[ 1 ] || speeds[ 2 ] || speeds[ 3 ]
+		|| memcmp( &camera, &camera_previous, sizeof( Camera ) )
+		|| memcmp( &plane_position, &plane_previous, sizeof( Vector_3d ) );
+}
+
+/*! Runs the simulation in fixed ticks for the frame time dt and builds the
+	view from the camera interpolated between the last two ticks. At most
+	SIM_MAX_TICKS run per frame, so a heavy frame does not pile up more
+	catch-up work for the next one. */
+void update_simulation( double dt ) {
+	Camera c;
+	u32 ticks = 0;
+	float alpha;
+	sim_accumulator += dt;
+
+	while( sim_accumulator >= SIM_TICK_MS && ticks < SIM_MAX_TICKS ) {
+		simulate_tick( );
+		sim_accumulator -= SIM_TICK_MS;
+		++ticks;
+	}
+	if( sim_accumulator >= SIM_TICK_MS ) {
+		sim_accumulator = fmod( sim_accumulator, SIM_TICK_MS );
+	}
+	alpha = sim_accumulator / SIM_TICK_MS;
+	vector_3d_sub( camera.position, camera_previous.position, &c.position );
+	vector_3d_add_scaled( camera_previous.position, c.position, &c.position,
+		alpha );
+	quaternion_slerp( &camera_previous.rotation, &camera.rotation,
+		&c.rotation, alpha );
+	quaternion_normalize( &c.rotation );
+	vector_3d_sub( plane_position, plane_previous, &plane_interpolated );
+	vector_3d_add_scaled( plane_previous, plane_interpolated,
+		&plane_interpolated, alpha );
+
+	quaternion_to_matrix( &c.rotation, &view_matrix );
+	matrix_4x4_set_neg_translation_v( &view_matrix, c.position );
+
 	if( camera_changed ) {
-//		rotate_camera( dt );
-		translate_camera( dt );
-		quaternion_to_matrix( &camera.rotation, &view_matrix );
-		matrix_4x4_set_neg_translation_v( &view_matrix, camera.position );
 		camera_changed = 0;
 		print_mat( "view matrix", &view_matrix, 2 );
 	}
 }
 
-void render( double dt ) {
-	glViewport( 0, 0, width, height );
-	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-
-	Vao *obj = &vaos[ SHAPE_PLANE ];
-	glActiveTexture( GL_TEXTURE0 );
-	glBindVertexArray( obj->vao );
-	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, obj->ind );
-
-	Shader *p = &programs[ PROGRAM_MODEL ];
+void set_frame_uniforms( const Shader *p ) {
 	const s16 *uni_loc = p->uniform_locations;
 	glUseProgram( p->program_id );
 	glUniform1i( uni_loc[ ULOC_TEXTURE0 ], 0 );
@@ -245,17 +382,197 @@ void render( double dt ) {
 		( GLfloat * ) &sun.intensities );
 	glUniform1f( uni_loc[ ULOC_AMBIENT_COEFF ], sun.ambient_coefficient );
 
-	Matrix_4x4 rotation;
+	if( gl_caps.shader_storage ) {
+		clusters_bind( &clusters, p );
+	}
+}
+
+/*! Uses a depth only program and turns off color writes. The lit pass
+	after end_depth_prepass only shades the pixels that passed. */
+void begin_depth_prepass( const Shader *p ) {
+	const s16 *uni_loc = p->uniform_locations;
+	glUseProgram( p->program_id );
+	glUniformMatrix4fv( uni_loc[ ULOC_VIEW ], 1, GL_FALSE,
+		( GLfloat* ) &view_matrix );
+	glUniformMatrix4fv( uni_loc[ ULOC_PROJECTION ], 1, GL_FALSE,
+		( GLfloat* ) &projection_matrix );
+	glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+}
+
+void end_depth_prepass( void ) {
+	glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+	glDepthMask( GL_FALSE );
+}
+
+/*! Renders the static batch draw by draw with occlusion queries. */
+void render_queried( const Matrix_4x4 *view_projection ) {
+	Vector_4d planes[ 6 ];
+	u32 n = static_batch.num_draws;
+	u8 *in_frustum = arena_alloc( &frame_arena, n + 1 );
+
+	if( !in_frustum ) {
+		return;
+	}
+	frustum_planes( view_projection, planes );
+	cull_spheres( planes, static_batch.bounds, static_batch.draw_flags, n,
+		in_frustum );
+	set_frame_uniforms( program( PROGRAM_MODEL ) );
+	prof_gpu_begin( "queried pass" );
+	oq_render( &occlusion_queries, &static_batch, in_frustum,
+		program( PROGRAM_MODEL ), program( PROGRAM_BBOX ),
+		&view_matrix, &projection_matrix );
+	prof_gpu_end( );
+	glUseProgram( 0 );
+	DEBUG_GL;
+}
+
+void render( double dt ) {
+	Matrix_4x4 rotation, view_projection;
+	PROF_SCOPE( "render" );
 	quaternion_to_matrix( &plane_rotation, &rotation );
-	matrix_4x4_set_translation_v( &rotation, plane_position );
+	matrix_4x4_set_translation_v( &rotation, plane_interpolated );
+	matrix_4x4_mul_matrix( &view_matrix, &projection_matrix, &view_projection );
 
 //	print_mat( "model matrix", &rotation, 2 );
 
-	glBindTexture( GL_TEXTURE_2D, textures[ TEXTURE_BLUEPRINT ].tex_id );
+	/* The occluders rasterize on the workers while the GPU still works on
+		the previous frame. */
+	if( plane_draw >= 0 ) {
+		batch_set_model( &static_batch, plane_draw, &rotation );
+	}
+	if( OCCLUSION_SOFTWARE == occlusion_mode ) {
+		occlusion_begin( &occlusion, &jobs, &static_batch, &view_projection );
+	}
+	if( gl_caps.shader_storage ) {
+		clusters_begin( &clusters, &jobs, &view_matrix, point_lights,
+			num_point_lights );
+	}
+	glViewport( 0, 0, width, height );
+	glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+	glActiveTexture( GL_TEXTURE0 );
+
+	if( OCCLUSION_SOFTWARE == occlusion_mode ) {
+		occlusion_end( &occlusion );
+		occlusion_cull( &occlusion, &static_batch );
+	}
+	if( gl_caps.shader_storage ) {
+		clusters_end( &clusters );
+	}
+	if( OCCLUSION_QUERIES == occlusion_mode && !vt_file ) {
+		render_queried( &view_projection );
+		return;
+	}
+	if( gl_caps.multi_draw_indirect && static_batch.num_draws && !vt_file ) {
+		Vector_4d planes[ 6 ], e;
+		Matrix_4x4 inverse_view;
+
+		matrix_4x4_invert( &view_matrix, &inverse_view );
+		matrix_4x4_transform_point( &inverse_view,
+			( Vector_3d ) { 0.0f, 0.0f, 0.0f }, &e );
+		frustum_planes( &view_projection, planes );
+		Vector_3d eye = { e.x, e.y, e.z };
+
+		/* back-facing meshlets only go while GL culls back faces */
+		if( gl_caps.compute_shader ) {
+			prof_gpu_begin( "cull" );
+			cull_batch_gpu( &static_batch, program( PROGRAM_CULL ), planes,
+				eye, cull );
+			prof_gpu_end( );
+
+			int mismatches = verify_cull
+				? cull_verify( &static_batch, planes, eye, cull ) : 0;
+
+			if( mismatches < 0 ) {
+				fprintf( stderr, "Out of memory verifying the culling.\n" );
+			} else if( mismatches ) {
+				fprintf( stderr, "Error: GPU and CPU culling differ!\n" );
+			}
+		} else {
+			cull_batch_cpu( &static_batch, planes, eye, cull );
+		}
+		if( depth_prepass ) {
+			prof_gpu_begin( "depth prepass" );
+			begin_depth_prepass( program( PROGRAM_DEPTH_MDI ) );
+			batch_render_depth( &static_batch );
+			end_depth_prepass( );
+			prof_gpu_end( );
+		}
+		prof_gpu_begin( "lit pass" );
+		set_frame_uniforms( program( PROGRAM_MODEL_MDI ) );
+		batch_render( &static_batch );
+		glDepthMask( GL_TRUE );
+		prof_gpu_end( );
+		glUseProgram( 0 );
+		DEBUG_GL;
+		return;
+	}
+	if( plane_draw < 0 ) { /* a --scene without multi draw indirect */
+		render_queried( &view_projection );
+		return;
+	}
+	Vao *obj = handle_get( &vaos, plane_vao );
+	Shader *p;
+	const s16 *uni_loc;
+
+	if( !obj || ( static_batch.draw_flags[ plane_draw ] & DRAW_OCCLUDED ) ) {
+		return;
+	}
+
+	if( vt_file ) { /* loads the pages of the last frame, then asks again */
+		vt_update( &vt );
+		if( vt.num_requests ) {
+			redraw = 1;
+		}
+		prof_gpu_begin( "vt feedback" );
+		p = program( PROGRAM_VT_FEEDBACK );
+		uni_loc = p->uniform_locations;
+		vt_begin_feedback( &vt, p );
+		glUniformMatrix4fv( uni_loc[ ULOC_VIEW ], 1, GL_FALSE,
+			( GLfloat* ) &view_matrix );
+		glUniformMatrix4fv( uni_loc[ ULOC_PROJECTION ], 1, GL_FALSE,
+			( GLfloat* ) &projection_matrix );
+		glUniformMatrix4fv( uni_loc[ ULOC_MODEL ], 1, GL_TRUE,
+			( GLfloat* ) &rotation );
+		glBindVertexArray( obj->vao );
+		glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, obj->ind );
+		glDrawElements( GL_TRIANGLES, obj->len, index_type( obj->index_size ),
+			0 );
+		vt_end_feedback( &vt, width, height );
+		prof_gpu_end( );
+	}
+	if( depth_prepass ) {
+		prof_gpu_begin( "depth prepass" );
+		p = program( PROGRAM_DEPTH );
+		begin_depth_prepass( p );
+		glUniformMatrix4fv( p->uniform_locations[ ULOC_MODEL ], 1, GL_TRUE,
+			( GLfloat* ) &rotation );
+		glBindVertexArray( obj->depth_vao );
+		glDrawElements( GL_TRIANGLES, obj->len, index_type( obj->index_size ),
+			0 );
+		end_depth_prepass( );
+		prof_gpu_end( );
+	}
+	prof_gpu_begin( "lit pass" );
+	glBindVertexArray( obj->vao );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, obj->ind );
+
+	p = program( vt_file ? PROGRAM_VT : PROGRAM_MODEL );
+	uni_loc = p->uniform_locations;
+	set_frame_uniforms( p );
+
+	if( vt_file ) {
+		vt_bind( &vt, p );
+	} else {
+		const Texture *tex = handle_get( &textures, batch_texture );
+		glBindTexture( GL_TEXTURE_2D, tex->tex_id );
+	}
 	glUniform2f( uni_loc[ ULOC_ATLAS ], 1.0f, 0.0f );
 	glUniformMatrix4fv( uni_loc[ ULOC_MODEL ],	1, GL_TRUE,
 		( GLfloat* ) &rotation );
-	glDrawElements( GL_TRIANGLES, obj->len, GL_UNSIGNED_SHORT, 0 );
+	glDrawElements( GL_TRIANGLES, obj->len, index_type( obj->index_size ),
+		0 );
+	glDepthMask( GL_TRUE );
+	prof_gpu_end( );
 
 	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
 	glBindVertexArray( 0 );
@@ -263,33 +580,185 @@ void render( double dt ) {
 	DEBUG_GL;
 }
 
-int load_assets( void ) {
-	int skinned = 0;
-	u16 v_size = 0, i_size = 0;
+/*! Renders the plane through the pan cache. The rects of the cache that
+	need drawing go through render() with the globals switched to the size,
+	projection and view of the cache. */
+void render_panned( double dt ) {
+	Matrix_4x4 rotation, model, view = view_matrix;
+	Matrix_4x4 projection = projection_matrix;
+	int view_width = width, view_height = height;
+	float ndc[ 4 ];
+	u32 i, n;
+
+	quaternion_to_matrix( &plane_rotation, &rotation );
+	matrix_4x4_set_translation_v( &rotation, plane_interpolated );
+	matrix_4x4_transpose( &rotation, &model );
+	n = pan_cache_update( &pan_cache, &model, &view, &projection );
+
+	if( n ) {
+		view_matrix = pan_cache.view;
+		projection_matrix = pan_cache.cache_projection;
+		width = pan_cache.width;
+		height = pan_cache.height;
+		pan_cache_window( &pan_cache, ndc );
+		clusters_set_window( &clusters, ndc[ 0 ], ndc[ 1 ], ndc[ 2 ], ndc[ 3 ],
+			width, height );
+
+		for( i = 0; i < n; ++i ) {
+			pan_cache_begin_rect( &pan_cache, i );
+			render( dt );
+			pan_cache_end_rect( &pan_cache );
+		}
+		view_matrix = view;
+		projection_matrix = projection;
+		width = view_width;
+		height = view_height;
+		clusters_set_window( &clusters, -1.0f, -1.0f, 1.0f, 1.0f, width,
+			height );
+	}
+	prof_gpu_begin( "pan blit" );
+	pan_cache_present( &pan_cache );
+	prof_gpu_end( );
+	DEBUG_GL;
+}
+
+/*! Indices packed into the smallest type for num_floats of a mob, give
+	the result back with scratch_free. 0 if out of memory. */
+void *pack_indices( u32 num_floats, u32 i_size, const u32 *i_data,
+	u32 *index_size )
+{
+	void *packed;
+
+	*index_size = mob_index_size( num_floats / MOB_VERTEX_FLOATS );
+	packed = scratch_alloc( i_size * *index_size + 1 );
+
+	if( packed ) {
+		mob_pack_indices( i_data, i_size, *index_size, packed );
+	}
+	return packed;
+}
+
+int load_plane( void ) {
+	int skinned = 0, layout = VBO_INTERLEAVED;
+	u32 v_size = 0, i_size = 0, index_size, num_meshlets = 0;
 	float *v_data = 0;
-	u16 *i_data = 0;
+	u32 *i_data = 0;
+	MOB_Meshlet *meshlets = 0;
 	char buffer[ 256 ];
 	snprintf( buffer, 256, "%s", "assets/plane.mob" );
-	read_mob( buffer, &v_size, &v_data, &i_size, &i_data, &skinned );
+	read_mob( buffer, &v_size, &v_data, &i_size, &i_data, &skinned,
+		&layout, &meshlets, &num_meshlets );
 
 	if( v_data && i_data ) {
-		mk_indexed_model( &vaos[ SHAPE_PLANE ],
-			v_size, v_data,	sizeof( u16 ), i_size, i_data,
-			GL_STATIC_DRAW, skinned );
+		void *packed = software ? 0
+			: pack_indices( v_size, i_size, i_data, &index_size );
 
-		free( v_data );
-		free( i_data );
+		if( packed && ( plane_vao = handle_create( &vaos ) ) ) {
+			mk_indexed_model( handle_get( &vaos, plane_vao ), layout,
+				v_size, v_data,	index_size, i_size, packed,
+				watch ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW, skinned );
+		}
+		scratch_free( packed );
 
 		Vector_3d u = { 0.0f, 0.0f, 0.0f };
 		quaternion_from_euler_v( &plane_rotation, u );
 		plane_position = ( Vector_3d ) { 0.0f, 0.0f, -1.0f };
+		plane_previous = plane_interpolated = plane_position;
+
+		Matrix_4x4 model;
+		quaternion_to_matrix( &plane_rotation, &model );
+		matrix_4x4_set_translation_v( &model, plane_position );
+		int mesh = batch_add_mesh( &static_batch, layout, v_size, v_data,
+			i_size, i_data, meshlets, num_meshlets );
+		plane_draw = ( mesh < 0 ) ? -1
+			: batch_add_draw( &static_batch, mesh, &model );
+		if( plane_draw >= 0 ) {
+			batch_set_flags( &static_batch, plane_draw, DRAW_OCCLUDER );
+		}
+
+		free( v_data );
+		free( i_data );
+		free( meshlets );
+
+		if( plane_draw < 0 ) {
+			return -1;
+		}
 	} else {
 		return -1;
 	}
+	return 0;
+}
+
+/*! Adds every object of --scene as one draw to the static batch, the
+	lights replace the grid of setup_light. */
+int load_scene( void ) {
+	int skinned = 0, layout = VBO_INTERLEAVED, mesh;
+	u32 v_size = 0, i_size = 0, num_meshlets = 0;
+	float *v_data;
+	u32 *i_data;
+	MOB_Meshlet *meshlets;
+	u32 i, j;
+
+	if( scene_load( &scene, scene_file ) < 0 ) {
+		return -1;
+	}
+	/* meshes are appended in order, draws refer to them by index */
+	for( i = 0; i < scene.num_meshes; ++i ) {
+		v_data = 0, i_data = 0, meshlets = 0;
+		read_mob( scene.meshes[ i ], &v_size, &v_data, &i_size, &i_data,
+			&skinned, &layout, &meshlets, &num_meshlets );
+		mesh = ( v_data && i_data ) ? batch_add_mesh( &static_batch, layout,
+			v_size, v_data, i_size, i_data, meshlets, num_meshlets ) : -1;
+		free( v_data );
+		free( i_data );
+		free( meshlets );
 
-	Texture *tex = &textures[ TEXTURE_BLUEPRINT ];
-	memset( &buffer, 0, sizeof( char ) * 256 );
-	snprintf( buffer,256, "%s", "assets/blueprint.ktx" );
+		if( mesh != ( int ) ( static_batch.num_meshes - 1 ) || mesh < 0 ) {
+			fprintf( stderr, "Could not load mesh %s\n", scene.meshes[ i ] );
+			return -1;
+		}
+	}
+	for( i = 0; i < scene.objects.count; ++i ) {
+		const Scene_Object *o = pool_item( &scene.objects, i );
+		Quaternion q;
+		Matrix_4x4 model;
+
+		quaternion_from_euler_v( &q, o->angles );
+		quaternion_normalize( &q );
+		quaternion_to_matrix( &q, &model );
+		for( j = 0; j < 12; ++j ) {
+			if( 3 != j % 4 ) {
+				model.array[ j ] *= o->scale;
+			}
+		}
+		matrix_4x4_set_translation_v( &model, o->position );
+
+		if( batch_add_draw( &static_batch, o->mesh, &model ) < 0 ) {
+			return -1;
+		}
+		if( o->occluder ) {
+			batch_set_flags( &static_batch, i, DRAW_OCCLUDER );
+		}
+	}
+	num_point_lights = ( scene.num_lights < CLUSTER_MAX_LIGHTS ) ?
+		scene.num_lights : CLUSTER_MAX_LIGHTS;
+	memcpy( point_lights, scene.lights, num_point_lights * sizeof( Light ) );
+	plane_draw = -1;
+	return 0;
+}
+
+/*! Size and loading time of --scene, for the scaling sweeps. */
+void print_scene( double start ) {
+	if( scene_file ) {
+		printf( "Scene %s: %u objects, %u meshes, %u indices, %u textures, "
+			"%u lights, loaded in %.1f ms.\n", scene_file, scene.objects.count,
+			scene.num_meshes, static_batch.num_indices, scene.num_textures,
+			num_point_lights, milliseconds( ) - start );
+	}
+}
+
+/*! Creates a texture for the batch from a ktx file. */
+int load_texture( const char *file, Texture *tex ) {
 	u32 id = 0;
 	GLint min_filter = GL_LINEAR_MIPMAP_LINEAR;
 	GLint mag_filter = GL_LINEAR;
@@ -297,7 +766,7 @@ int load_assets( void ) {
 	GLint wrap_t = GL_REPEAT;
 	int img_width, img_height;
 
-	if( load_ktx( buffer, &id, min_filter, mag_filter, wrap_s, wrap_t,
+	if( load_ktx( file, &id, min_filter, mag_filter, wrap_s, wrap_t,
 		&img_width, &img_height, KTX_UNPACK_ALIGNMENT ) < 0 )
 	{
 		return -1;
@@ -307,18 +776,693 @@ int load_assets( void ) {
 	tex->height = img_height;
 	tex->scale_x = 1;
 	tex->scale_y = 1;
+	return 0;
+}
+
+/*! Watches the files load_assets read, texture is the one of the batch. */
+int start_watching( const char *texture ) {
+	u32 i;
+
+	if( reload_init( &reload ) < 0
+		|| reload_watch( &reload, texture, RELOAD_TEXTURE,
+		batch_texture ) < 0 )
+	{
+		return -1;
+	}
+	if( shader_dir && reload_watch_shaders( &reload, shader_dir ) < 0 ) {
+		return -1;
+	}
+	if( !scene_file ) {
+		return reload_watch( &reload, "assets/plane.mob", RELOAD_MESH, 0 );
+	}
+	for( i = 0; i < scene.num_meshes; ++i ) {
+		if( reload_watch( &reload, scene.meshes[ i ], RELOAD_MESH, i ) < 0 ) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int load_assets( void ) {
+	double start = milliseconds( );
+	char buffer[ 256 ];
+	u32 i;
+
+	if( ( scene_file ? load_scene( ) : load_plane( ) ) < 0 ) {
+		return -1;
+	}
+	memset( &buffer, 0, sizeof( char ) * 256 );
+	snprintf( buffer,256, "%s", scene.num_textures ? scene.textures[ 0 ]
+		: "assets/blueprint.ktx" );
+
+	if( software ) { /* the batch stays on the CPU */
+		batch_image = handle_create( &images );
+
+		if( !batch_image
+			|| load_ktx_image( buffer, handle_get( &images, batch_image ) ) < 0 )
+		{
+			return -1;
+		}
+		print_scene( start );
+		return 0;
+	}
+	/* The batch samples the first texture, the others are only loaded. */
+	for( i = 0; i < scene.num_textures || !i; ++i ) {
+		Handle h = handle_create( &textures );
 
+		if( !h || load_texture( i ? scene.textures[ i ] : buffer,
+			handle_get( &textures, h ) ) < 0 )
+		{
+			return -1;
+		}
+		if( !i ) {
+			batch_texture = h;
+		}
+	}
+	if( vt_file && vt_init( &vt, vt_file, width, height ) < 0 ) {
+		return -1;
+	}
+	if( pan && pan_cache_init( &pan_cache, width, height ) < 0 ) {
+		return -1;
+	}
+	if( watch && start_watching( buffer ) < 0 ) {
+		return -1;
+	}
+	static_batch.tex_id =
+		( ( Texture * ) handle_get( &textures, batch_texture ) )->tex_id;
+	if( batch_upload( &static_batch,
+		watch ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW ) < 0 )
+	{
+		return -1;
+	}
+	oq_init( &occlusion_queries );
+
+	print_scene( start );
 	return 0;
 }
 
+/*! Copies a file read again into the objects loaded from it. Returns -1
+	if they would have to be created again, only textures are. */
+int apply_reload( const Reload_File *f ) {
+	Texture *tex = handle_get( &textures, f->index );
+	const Vao *obj = handle_get( &vaos, plane_vao );
+
+	if( RELOAD_TEXTURE == f->kind ) {
+		if( !tex ) {
+			return -1;
+		}
+		if( update_texture( tex, &f->image ) < 0 ) { /* new size */
+			GLuint old = tex->tex_id;
+
+			if( load_texture( f->path, tex ) < 0 ) {
+				return -1;
+			}
+			glDeleteTextures( 1, &old );
+			if( f->index == batch_texture ) {
+				static_batch.tex_id = tex->tex_id;
+			}
+		}
+		printf( "Reloaded %s\n", f->path );
+		return 0;
+	}
+	if( ( !scene_file && f->layout != obj->layout )
+		|| batch_update_mesh( &static_batch, f->index, f->layout, f->v_size,
+		f->v_data, f->i_size, f->i_data, f->meshlets, f->num_meshlets ) < 0 )
+	{
+		fprintf( stderr, "Mesh %s changed its size, layout or meshlets, "
+			"restart to load it.\n", f->path );
+		return -1;
+	}
+	if( !scene_file ) {
+		u32 index_size;
+		void *packed = pack_indices( f->v_size, f->i_size, f->i_data,
+			&index_size );
+
+		if( !packed || index_size != obj->index_size ) {
+			scratch_free( packed );
+			return -1;
+		}
+		update_indexed_model( obj, f->v_size, f->v_data, index_size,
+			f->i_size, packed );
+		scratch_free( packed );
+	}
+	printf( "Reloaded %s\n", f->path );
+	return 0;
+}
+
+/*! Applies the assets and shaders changed on disk, 1 if any did. */
+int update_reload( void ) {
+	Reload_File *f;
+	int changed = 0;
+
+	reload_poll( &reload, &jobs );
+
+	while( ( f = reload_next( &reload ) ) ) {
+		reload_release( &reload, f,
+			( f->result < 0 ) ? -1 : apply_reload( f ) );
+		changed = 1;
+	}
+	if( reload_shaders( &reload ) ) {
+		if( reinit_shaders( ) < 0 ) {
+			fprintf( stderr, "Shaders of %s not built, keeping the old "
+				"ones.\n", shader_dir );
+			reload.failures++;
+		} else {
+			reload.shaders++;
+			changed = 1;
+		}
+	}
+	if( changed ) { /* the cache holds the old plane */
+		pan_cache.valid = 0;
+	}
+	return changed;
+}
+
+/*! Applies one recorded or live event, returns 0 on Escape. */
+int handle_input( const Input_Event *e ) {
+	u32 key_sym = e->code;
+
+	if( INPUT_BUTTON == e->type ) {
+		if( MOUSE_UP == e->code ) {
+			plane_position.z += 0.1;
+		} else if( MOUSE_DOWN == e->code ) {
+			plane_position.z -= 0.1;
+		}
+	} else if( INPUT_KEY_UP == e->type ) {
+		if( ( XK_W == key_sym ) || ( XK_S == key_sym ) ) {
+			speeds[ 1 ] = 0.0f;
+			camera_changed = 1;
+		} else if( ( XK_A == key_sym ) || ( XK_D == key_sym ) ) {
+			speeds[ 3 ] = 0.0f;
+			camera_changed = 1;
+		}
+	} else if( INPUT_KEY_DOWN == e->type ) {
+		if( XK_space <= key_sym && XK_asciitilde >= key_sym ) {
+			if( XK_W == key_sym ) {
+				speeds[ 1 ] = -MOVEMENT_SPEED;
+				camera_changed = 1;
+			} else if( XK_A == key_sym ) {
+				speeds[ 3 ] = -STRIDE_SPEED;
+				camera_changed = 1;
+			} else if( XK_S == key_sym ) {
+				speeds[ 1 ] = MOVEMENT_SPEED;
+				camera_changed = 1;
+			} else if( XK_D == key_sym ) {
+				speeds[ 3 ] = STRIDE_SPEED;
+				camera_changed = 1;
+			}
+		} else if( XK_Escape == key_sym ) {
+			return 0;
+		} else if( ( XK_minus == key_sym )
+			|| ( XK_KP_Subtract == key_sym ) )
+		{
+			if( e->shift ) {
+				cur_angle = upd_cur_angle( -1 );
+			} else {
+				if( 0 == cur_angle ) {
+					mx -= 1.0f;
+				} else {
+					my -= 1.0f;
+				}
+//				speeds[ 5 ] = ROTATION_SPEED;
+				camera_changed = 1;
+
+				cam_angles[ cur_angle ] -= radians( 1.0f );
+				Vector_3d v = {
+					cam_angles[ 0 ], cam_angles[ 1 ], cam_angles[ 2 ] };
+				quaternion_from_euler_v( &camera.rotation, v );
+				quaternion_normalize( &camera.rotation );
+			}
+		} else if( ( XK_plus == key_sym )
+			|| ( XK_KP_Add == key_sym ) )
+		{
+			if( e->shift ) {
+				cur_angle = upd_cur_angle( 1 );
+			} else {
+
+				if( 0 == cur_angle ) {
+					mx += 1.0f;
+				} else {
+					my += 1.0f;
+				}
+//				speeds[ 5 ] = ROTATION_SPEED;
+				camera_changed = 1;
+				cam_angles[ cur_angle ] += radians( 1.0f );
+				Vector_3d v = {
+					cam_angles[ 0 ], cam_angles[ 1 ], cam_angles[ 2 ] };
+				quaternion_from_euler_v( &camera.rotation, v );
+				quaternion_normalize( &camera.rotation );
+			}
+		} else if( XK_F12 == key_sym ) {
+			toggle_culling( );
+		}
+	}
+	return 1;
+}
+
+/*! Loads --replay and returns the number of frames to render, or the
+	--frames count without a replay. */
+int setup_replay( u32 *frames ) {
+	*frames = headless_frames;
+	if( !replay_file ) {
+		return 0;
+	}
+	if( input_load( &input, replay_file ) < 0 ) {
+		return -1;
+	}
+	*frames = input_frames( &input );
+	printf( "Replaying %u events over %u frames.\n", input.num_events,
+		*frames );
+	return 0;
+}
+
+/*! Feeds the recorded events up to the start of the frame and sets the
+	fixed timestep, so every replay renders the same camera path. */
+void replay_step( u32 frame ) {
+	Input_Event e;
+	while( input_next( &input, frame * INPUT_REPLAY_DT, &e ) ) {
+		handle_input( &e );
+	}
+	delta_t = INPUT_REPLAY_DT;
+}
+
+/*! Wall clock delta_t of the last frame, unless replaying. */
+void advance_timer( void ) {
+	timer_end = milliseconds( );
+	if( !replay_file ) {
+		delta_t = timer_end - timer_start;
+	}
+	timer_start = timer_end;
+}
+
+typedef void Swap_Interval_Proc( Display *, GLXDrawable, int );
+
+/*! Sets the swap interval with GLX_EXT_swap_control. Adaptive vsync, -1,
+	needs GLX_EXT_swap_control_tear and falls back to 1 without it. */
+void set_swap_interval( Display *display, Window window, int interval ) {
+	const char *ext = glXQueryExtensionsString( display,
+		DefaultScreen( display ) );
+	Swap_Interval_Proc *swap_interval_ext = ( Swap_Interval_Proc * )
+		glXGetProcAddressARB( ( const GLubyte * ) "glXSwapIntervalEXT" );
+
+	if( !ext || !strstr( ext, "GLX_EXT_swap_control" ) || !swap_interval_ext ) {
+		fprintf( stderr, "GLX_EXT_swap_control not available.\n" );
+		return;
+	}
+	if( ( interval < 0 ) && !strstr( ext, "GLX_EXT_swap_control_tear" ) ) {
+		interval = -interval;
+	}
+	swap_interval_ext( display, window, interval );
+	printf( "Swap interval %d.\n", interval );
+}
+
 //------------------------------------------------------------------------------
 
+void finish_profiling( void ) {
+	if( !software ) {
+		glFinish( );
+	}
+	prof_shutdown( );
+	prof_summary( stdout );
+	if( !software ) {
+		gl_lite_print_summary( stdout );
+	}
+	if( vt_file ) {
+		vt_summary( &vt, stdout );
+	}
+	if( pan ) {
+		pan_cache_summary( &pan_cache, stdout );
+	}
+	arena_summary( &frame_arena, stdout );
+	arena_summary( &scratch, stdout );
+	jobs_summary( &jobs, stdout );
+	if( scene_file ) {
+		pool_summary( &scene.objects, stdout );
+	}
+	if( trace_file ) {
+		prof_write_trace( trace_file );
+	}
+}
+
+/*! Compares the --report with the --baseline, 1 on a regression. */
+int compare_baseline( void ) {
+	if( !baseline_file ) {
+		return 0;
+	}
+	return headless_compare( report_file, baseline_file, tolerance );
+}
+
+/*! Renders a fixed number of frames into an FBO without any window system
+	and reports the frame times. */
+int run_headless( void ) {
+	Headless hl;
+	char buffer[ 256 ];
+	GLuint calls[ GL_ID_MAX ];
+	u32 frame, frames;
+	int result = -1, gl_ready = 0;
+
+	jobs_init( &jobs, 0 );
+
+	if( headless_init( &hl, width, height ) < 0 || gl_lite_init( ) < 0 ) {
+		goto last;
+	}
+	gl_ready = 1;
+
+	if( headless_setup_fbo( &hl ) < 0 ) {
+		goto last;
+	}
+	opengl_setup( );
+	if( init_shaders( ) < 0 ) {
+		goto last;
+	}
+	prof_init( 0 != trace_file );
+	setup_perspective( ( float ) width, ( float ) height );
+	setup_light( );
+
+	if( 0 != load_assets( ) || setup_replay( &frames ) < 0 ) {
+		goto last;
+	}
+	gl_lite_reset_calls( );
+	double start = milliseconds( );
+	timer_start = start;
+
+	for( frame = 0; frame < frames; ++frame ) {
+		if( replay_file ) {
+			replay_step( frame );
+		}
+		if( watch ) {
+			update_reload( );
+		}
+		prof_frame_begin( );
+		update_simulation( delta_t );
+		if( pan ) {
+			render_panned( delta_t );
+		} else {
+			render( delta_t );
+		}
+
+		if( dump_dir ) {
+			headless_read( &hl );
+			snprintf( buffer, 256, "%s/frame_%05u.ppm", dump_dir, frame );
+			headless_dump( &hl, buffer );
+		}
+		prof_frame_end( );
+		gl_lite_end_frame( );
+		arena_reset( &frame_arena );
+		advance_timer( );
+	}
+	memcpy( calls, gl_lite_calls, sizeof( calls ) );
+	glFinish( );
+	double seconds = ( milliseconds( ) - start ) / 1000.0;
+
+	finish_profiling( );
+	headless_read( &hl );
+	headless_report( &hl, ( const char * ) glGetString( GL_RENDERER ),
+		report_file, frames, seconds, calls );
+	result = compare_baseline( );
+last:
+	if( gl_ready ) {
+		prof_free( );
+		oq_free( &occlusion_queries );
+		clusters_free( &clusters );
+		batch_free( &static_batch );
+		vt_free( &vt );
+		pan_cache_free( &pan_cache );
+		handle_table_free( &vaos );
+		handle_table_free( &textures );
+	}
+	if( watch ) {
+		reload_summary( &reload, stdout );
+	}
+	reload_free( &reload, &jobs );
+	jobs_shutdown( &jobs );
+	occlusion_free( &occlusion );
+	input_free( &input );
+	scene_free( &scene );
+	headless_free( &hl );
+	return result;
+}
+
+/*! Same scene as render() on the software rasterizer, lit by the sun. */
+void render_software( void ) {
+	Matrix_4x4 rotation;
+	Light light = {
+		{ sun.position.x, sun.position.y, sun.position.z, 1.0f },
+		sun.intensities, sun.ambient_coefficient };
+	PROF_SCOPE( "render" );
+	quaternion_to_matrix( &plane_rotation, &rotation );
+	matrix_4x4_set_translation_v( &rotation, plane_interpolated );
+	if( plane_draw >= 0 ) {
+		batch_set_model( &static_batch, plane_draw, &rotation );
+	}
+	swrast_render( &swrast, &jobs, &frame_arena, &static_batch,
+		handle_get( &images, batch_image ), &view_matrix, &projection_matrix,
+		&light );
+}
+
+/*! Sets up the scene for the software rasterizer. The Headless only holds
+	the pixels for the dumps and the report, no context is created. */
+int setup_software( Headless *hl ) {
+	memset( hl, 0, sizeof( Headless ) );
+	hl->width = width;
+	hl->height = height;
+	hl->pixels = malloc( width * height * 3 );
+
+	if( !hl->pixels || swrast_init( &swrast, width, height ) < 0 ) {
+		return -1;
+	}
+	setup_perspective( ( float ) width, ( float ) height );
+	setup_light( );
+	return load_assets( );
+}
+
+void free_software( Headless *hl ) {
+	u32 i;
+
+	swrast_free( &swrast );
+	clusters_free( &clusters );
+	batch_free( &static_batch );
+	for( i = 0; i < images.count; ++i ) {
+		free( ( ( Image * ) handle_item( &images, i ) )->pixels );
+	}
+	handle_table_free( &images );
+	scene_free( &scene );
+	headless_free( hl );
+}
+
+/*! Like run_headless, with the software rasterizer instead of GL. */
+int run_software( void ) {
+	Headless hl;
+	char buffer[ 256 ];
+	u32 frame, frames;
+	int result = -1;
+
+	jobs_init( &jobs, 0 );
+	prof_init( 0 != trace_file );
+
+	if( setup_software( &hl ) < 0 || setup_replay( &frames ) < 0 ) {
+		goto last;
+	}
+	double start = milliseconds( );
+	timer_start = start;
+
+	for( frame = 0; frame < frames; ++frame ) {
+		if( replay_file ) {
+			replay_step( frame );
+		}
+		prof_frame_begin( );
+		update_simulation( delta_t );
+		render_software( );
+
+		if( dump_dir ) {
+			swrast_read( &swrast, hl.pixels );
+			snprintf( buffer, 256, "%s/frame_%05u.ppm", dump_dir, frame );
+			headless_dump( &hl, buffer );
+		}
+		prof_frame_end( );
+		arena_reset( &frame_arena );
+		advance_timer( );
+	}
+	double seconds = ( milliseconds( ) - start ) / 1000.0;
+
+	finish_profiling( );
+	swrast_read( &swrast, hl.pixels );
+	snprintf( buffer, 256, "software rasterizer, %u threads",
+		jobs.num_threads + 1 );
+	headless_report( &hl, buffer, report_file, frames, seconds, 0 );
+	result = compare_baseline( );
+last:
+	prof_free( );
+	jobs_shutdown( &jobs );
+	input_free( &input );
+	free_software( &hl );
+	return result;
+}
+
+/*! Renders --frames frames on the software rasterizer with 1, 2, 4 ...
+	threads up to the number of cores and prints the throughput of each.
+	The checksum has to be the same for every thread count. */
+int run_software_bench( void ) {
+	u32 cores = sysconf( _SC_NPROCESSORS_ONLN ), threads, next, frame;
+	double base = 0.0;
+	Headless hl;
+
+	if( cores > JOBS_MAX_THREADS + 1 ) {
+		cores = JOBS_MAX_THREADS + 1;
+	}
+	if( setup_software( &hl ) < 0 ) {
+		free_software( &hl );
+		return -1;
+	}
+	update_simulation( 0.0 );
+	printf( "%7s %9s %9s %10s %16s %9s %8s\n", "threads", "ms/frame",
+		"Mtris/s", "Mpixels/s", "Mpixels/s/thread", "checksum", "speedup" );
+
+	for( threads = 1; threads <= cores; threads = next ) {
+		u64 tris = 0, pixels = 0;
+
+		jobs_init( &jobs, threads > 1 ? ( int ) threads - 1 : -1 );
+		render_software( ); /* warm up the allocations */
+		arena_reset( &frame_arena );
+		double start = milliseconds( );
+
+		for( frame = 0; frame < headless_frames; ++frame ) {
+			render_software( );
+			arena_reset( &frame_arena );
+			tris += swrast.triangles;
+			pixels += swrast.pixels;
+		}
+		double ms = milliseconds( ) - start;
+		jobs_shutdown( &jobs );
+		swrast_read( &swrast, hl.pixels );
+
+		if( 1 == threads ) {
+			base = ms;
+		}
+		printf( "%7u %9.3f %9.2f %10.2f %16.2f  %08x %8.2f\n", threads,
+			ms / headless_frames, tris / ( ms * 1000.0 ),
+			pixels / ( ms * 1000.0 ), pixels / ( ms * 1000.0 * threads ),
+			headless_checksum( &hl ), base / ms );
+
+		next = 2 * threads;
+		if( threads < cores && next > cores ) {
+			next = cores;
+		}
+	}
+	free_software( &hl );
+	return 0;
+}
+
 int main( int argc, char** argv ) {
 	Display *xlib_display = 0;
 	Window xlib_window;
 	XVisualInfo *xlib_visual_info;
 	Atom wm_delete;
 	char kbd_buffer[ 16 ];
+	int i;
+
+	for( i = 1; i < argc; ++i ) {
+		if( 0 == strcmp( argv[ i ], "--verify-cull" ) ) {
+			verify_cull = 1;
+		} else if( 0 == strcmp( argv[ i ], "--no-occlusion" ) ) {
+			occlusion_mode = OCCLUSION_NONE;
+		} else if( 0 == strcmp( argv[ i ], "--occlusion-queries" ) ) {
+			occlusion_mode = OCCLUSION_QUERIES;
+		} else if( 0 == strcmp( argv[ i ], "--no-prepass" ) ) {
+			depth_prepass = 0;
+		} else if( 0 == strcmp( argv[ i ], "--no-dsa" ) ) {
+			direct_state_access = 0;
+		} else if( 0 == strcmp( argv[ i ], "--on-demand" ) ) {
+			on_demand = 1;
+		} else if( 0 == strcmp( argv[ i ], "--low-latency" ) ) {
+			low_latency = 1;
+			if( !swap_control ) {
+				swap_interval = -1;
+				swap_control = 1;
+			}
+		} else if( 0 == strcmp( argv[ i ], "--frames-in-flight" )
+			&& i + 1 < argc )
+		{
+			low_latency = 1;
+			frames_in_flight = strtoul( argv[ ++i ], 0, 10 );
+		} else if( 0 == strcmp( argv[ i ], "--swap-interval" ) && i + 1 < argc ) {
+			swap_interval = strtol( argv[ ++i ], 0, 10 );
+			swap_control = 1;
+		} else if( 0 == strcmp( argv[ i ], "--profile" ) ) {
+			profile = 1;
+		} else if( 0 == strcmp( argv[ i ], "--trace" ) && i + 1 < argc ) {
+			profile = 1;
+			trace_file = argv[ ++i ];
+		} else if( 0 == strcmp( argv[ i ], "--headless" ) ) {
+			headless = 1;
+		} else if( 0 == strcmp( argv[ i ], "--frames" ) && i + 1 < argc ) {
+			headless_frames = strtoul( argv[ ++i ], 0, 10 );
+		} else if( 0 == strcmp( argv[ i ], "--dump" ) && i + 1 < argc ) {
+			dump_dir = argv[ ++i ];
+		} else if( 0 == strcmp( argv[ i ], "--report" ) && i + 1 < argc ) {
+			report_file = argv[ ++i ];
+		} else if( 0 == strcmp( argv[ i ], "--software" ) ) {
+			software = 1;
+		} else if( 0 == strcmp( argv[ i ], "--bench-software" ) ) {
+			software = 1;
+			bench_software = 1;
+		} else if( 0 == strcmp( argv[ i ], "--record" ) && i + 1 < argc ) {
+			record_file = argv[ ++i ];
+		} else if( 0 == strcmp( argv[ i ], "--replay" ) && i + 1 < argc ) {
+			replay_file = argv[ ++i ];
+		} else if( 0 == strcmp( argv[ i ], "--baseline" ) && i + 1 < argc ) {
+			baseline_file = argv[ ++i ];
+		} else if( 0 == strcmp( argv[ i ], "--tolerance" ) && i + 1 < argc ) {
+			tolerance = strtof( argv[ ++i ], 0 );
+		} else if( 0 == strcmp( argv[ i ], "--scene" ) && i + 1 < argc ) {
+			scene_file = argv[ ++i ];
+		} else if( 0 == strcmp( argv[ i ], "--watch" ) ) {
+			watch = 1;
+		} else if( 0 == strcmp( argv[ i ], "--shader-dir" ) && i + 1 < argc ) {
+			shader_dir = argv[ ++i ];
+		} else if( 0 == strcmp( argv[ i ], "--pan-cache" ) ) {
+			pan = 1;
+		} else if( 0 == strcmp( argv[ i ], "--virtual-texture" )
+			&& i + 1 < argc )
+		{
+			vt_file = argv[ ++i ];
+		} else if( 0 == strcmp( argv[ i ], "--lights" ) && i + 1 < argc ) {
+			num_point_lights = strtoul( argv[ ++i ], 0, 10 );
+			if( num_point_lights > CLUSTER_MAX_LIGHTS ) {
+				num_point_lights = CLUSTER_MAX_LIGHTS;
+			}
+		}
+	}
+	if( baseline_file && !report_file ) {
+		fprintf( stderr, "Error: --baseline needs a --report file!\n" );
+		return -1;
+	}
+	if( vt_file && ( scene_file || software ) ) {
+		fprintf( stderr, "Error: --virtual-texture needs the plane on GL!\n" );
+		return -1;
+	}
+	if( pan && ( scene_file || software || vt_file ) ) {
+		fprintf( stderr, "Error: --pan-cache needs the plane on GL!\n" );
+		return -1;
+	}
+	if( ( watch || shader_dir ) && software ) {
+		fprintf( stderr, "Error: --watch and --shader-dir need GL!\n" );
+		return -1;
+	}
+	if( arena_init( &frame_arena, ARENA_FRAME_SIZE, "frame" ) < 0
+		|| arena_init( &scratch, ARENA_SCRATCH_SIZE, "main scratch" ) < 0 )
+	{
+		return -1;
+	}
+	arena_set_scratch( &scratch );
+
+	if( bench_software || software || headless ) { /* no window */
+		int result = bench_software ? ( run_software_bench( ) < 0 ? -1 : 0 )
+			: software ? run_software( ) : run_headless( );
+		arena_free( &scratch );
+		arena_free( &frame_arena );
+		return result;
+	}
 	xlib_display = XOpenDisplay( 0 );
 
 	if( !xlib_display ) {
@@ -376,118 +1520,143 @@ int main( int argc, char** argv ) {
 	} else {
 		printf( "Indirect GLX rendering context obtained.\n" );
 	}
+	jobs_init( &jobs, 0 );
 	opengl_setup( );
 	init_shaders( );
+	if( profile ) {
+		prof_init( 0 != trace_file );
+	}
 	setup_perspective( ( float ) width, ( float ) height );
 	setup_light( );
 
 	if( 0 != load_assets( ) ) {
 		return -1;
 	}
+	gl_lite_reset_calls( );
+
+	if( swap_control ) {
+		set_swap_interval( xlib_display, xlib_window, swap_interval );
+	}
+	if( low_latency && !gl_caps.fence_sync ) {
+		fprintf( stderr, "No fence sync, --low-latency ignored.\n" );
+		low_latency = 0;
+	}
+	if( low_latency ) {
+		latency_init( &latency, frames_in_flight );
+	}
 
 	int run = 1;
 	timer_start = milliseconds( );
+	double record_start = timer_start;
 
 	while( run ) {
+		if( low_latency ) { /* throttle first, then sample the input */
+			latency_wait( &latency );
+		}
+		if( on_demand && !redraw && !simulation_active( )
+			&& !XPending( xlib_display ) )
+		{ /* XPending flushed the requests, sleep until the server sends
+			or a watched file changes, wake up to check running loads. */
+			struct pollfd fds[ 2 ] = {
+				{ ConnectionNumber( xlib_display ), POLLIN, 0 },
+				{ reload.fd, POLLIN, 0 } };
+			poll( fds, watch ? 2 : 1, reload_busy( &reload ) ? 1 : -1 );
+			timer_start = milliseconds( );
+		}
 		while( XPending( xlib_display ) ) {
 			KeySym key_sym;
 			XEvent event;
+			Input_Event input_event = { 0.0, INPUT_END, 0, 0 };
 			XNextEvent( xlib_display, &event );
 
 			switch( event.type ) {
 				case Expose: {
 					XWindowAttributes window_attr;
 					XGetWindowAttributes( xlib_display, xlib_window, &window_attr );
+					redraw = 1;
 				} break;
 				case ButtonPress: {
-					if( MOUSE_UP == event.xbutton.button ) {
-						plane_position.z += 0.1;
-					} else if( MOUSE_DOWN == event.xbutton.button ) {
-						plane_position.z -= 0.1;
-					}
+					input_event.type = INPUT_BUTTON;
+					input_event.code = event.xbutton.button;
+					input_event.shift = 0;
 				} break;
+				case KeyPress:
 				case KeyRelease: {
-					if( ( XK_W == key_sym ) || ( XK_S == key_sym ) ) {
-						speeds[ 1 ] = 0.0f;
-						camera_changed = 1;
-					} else if( ( XK_A == key_sym ) || ( XK_D == key_sym ) ) {
-						speeds[ 3 ] = 0.0f;
-						camera_changed = 1;
-					}
-				} break;
-				case KeyPress: {
 					XLookupString( &event.xkey, kbd_buffer, 16, &key_sym, 0 );
-					if( XK_space <= key_sym && XK_asciitilde >= key_sym ) {
-						if( XK_W == key_sym ) {
-							speeds[ 1 ] = -MOVEMENT_SPEED;
-							camera_changed = 1;
-						} else if( XK_A == key_sym ) {
-							speeds[ 3 ] = -STRIDE_SPEED;
-							camera_changed = 1;
-						} else if( XK_S == key_sym ) {
-							speeds[ 1 ] = MOVEMENT_SPEED;
-							camera_changed = 1;
-						} else if( XK_D == key_sym ) {
-							speeds[ 3 ] = STRIDE_SPEED;
-							camera_changed = 1;
-						}
-					} else if( XK_Escape == key_sym ) {
-						run = 0;
-					} else if( ( XK_minus == key_sym )
-						|| ( XK_KP_Subtract == key_sym ) )
-					{
-						if( ShiftMask & event.xkey.state ) {
-							cur_angle = upd_cur_angle( -1 );
-						} else {
-							if( 0 == cur_angle ) {
-								mx -= 1.0f;
-							} else {
-								my -= 1.0f;
-							}
-//							speeds[ 5 ] = ROTATION_SPEED;
-							camera_changed = 1;
-
-							cam_angles[ cur_angle ] -= radians( 1.0f );
-							Vector_3d v = {
-								cam_angles[ 0 ], cam_angles[ 1 ], cam_angles[ 2 ] };
-							quaternion_from_euler_v( &camera.rotation, v );
-							quaternion_normalize( &camera.rotation );
-						}
-					} else if( ( XK_plus == key_sym )
-						|| ( XK_KP_Add == key_sym ) )
-					{
-						if( ShiftMask & event.xkey.state ) {
-							cur_angle = upd_cur_angle( 1 );
-						} else {
-
-							if( 0 == cur_angle ) {
-								mx += 1.0f;
-							} else {
-								my += 1.0f;
-							}
-//							speeds[ 5 ] = ROTATION_SPEED;
-							camera_changed = 1;
-							cam_angles[ cur_angle ] += radians( 1.0f );
-							Vector_3d v = {
-								cam_angles[ 0 ], cam_angles[ 1 ], cam_angles[ 2 ] };
-							quaternion_from_euler_v( &camera.rotation, v );
-							quaternion_normalize( &camera.rotation );
-						}
-					} else if( XK_F12 == key_sym ) {
-						toggle_culling( );
-					}
+					input_event.type = ( KeyPress == event.type ) ?
+						INPUT_KEY_DOWN : INPUT_KEY_UP;
+					input_event.code = key_sym;
+					input_event.shift = ( ShiftMask & event.xkey.state ) ? 1 : 0;
 				} break;
 			}
+			if( INPUT_END != input_event.type ) {
+				input_event.time = milliseconds( ) - record_start;
+				if( record_file ) {
+					input_record( &input, input_event.time, input_event.type,
+						input_event.code, input_event.shift );
+				}
+				if( !handle_input( &input_event ) ) {
+					run = 0;
+				}
+				if( low_latency ) {
+					latency_input( &latency );
+				}
+				redraw = 1;
+			}
 		}
-		if( run ) {
-			update_camera( delta_t );
-			render( delta_t );
+		if( watch && update_reload( ) ) {
+			redraw = 1;
+		}
+		if( run && ( !on_demand || redraw || simulation_active( ) ) ) {
+			redraw = 0;
+			prof_frame_begin( );
+			update_simulation( delta_t );
+			if( pan ) {
+				render_panned( delta_t );
+			} else {
+				render( delta_t );
+			}
+			prof_begin( "swap" );
 			glXSwapBuffers( xlib_display, xlib_window );
-			timer_end = milliseconds( );
-			delta_t = timer_end - timer_start;
-			timer_start = timer_end;
+			if( low_latency ) {
+				latency_frame_end( &latency );
+			}
+			prof_end( );
+			prof_frame_end( );
+			gl_lite_end_frame( );
+			arena_reset( &frame_arena );
+			advance_timer( );
 		}
 	}
+	if( low_latency ) {
+		latency_free( &latency );
+		latency_summary( &latency, stdout );
+	}
+	if( profile ) {
+		finish_profiling( );
+		prof_free( );
+	}
+	if( record_file ) {
+		input_record( &input, milliseconds( ) - record_start, INPUT_END, 0, 0 );
+		input_save( &input, record_file );
+		input_free( &input );
+	}
+	if( watch ) {
+		reload_summary( &reload, stdout );
+	}
+	reload_free( &reload, &jobs );
+	jobs_shutdown( &jobs );
+	occlusion_free( &occlusion );
+	oq_free( &occlusion_queries );
+	clusters_free( &clusters );
+	batch_free( &static_batch );
+	vt_free( &vt );
+	pan_cache_free( &pan_cache );
+	handle_table_free( &vaos );
+	handle_table_free( &textures );
+	scene_free( &scene );
+	arena_free( &scratch );
+	arena_free( &frame_arena );
 	XFree( xlib_visual_info );
 	XDestroyWindow( xlib_display, xlib_window );
 	XCloseDisplay( xlib_display );
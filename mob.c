@@ -0,0 +1,255 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "assets.h"
+
+#define MOB_VERTEX_FLOATS		(8U) /* position, normal, uv */
+
+/*! Copies vertex i of a mob vertex array in any layout to out, interleaved
+	as position, normal and uv. */
+void mob_vertex( int layout, u32 num_vertices, const float *v_data, u32 i,
+	float *out )
+{
+	if( VBO_INTERLEAVED == layout ) {
+		memcpy( out, v_data + i * MOB_VERTEX_FLOATS,
+			MOB_VERTEX_FLOATS * sizeof( float ) );
+	} else { /* positions, normals and uvs in three blocks */
+		memcpy( out, v_data + i * 3, 3 * sizeof( float ) );
+		memcpy( out + 3, v_data + num_vertices * 3 + i * 3,
+			3 * sizeof( float ) );
+		memcpy( out + 6, v_data + num_vertices * 6 + i * 2,
+			2 * sizeof( float ) );
+	}
+}
+
+/*! Smallest index in bytes able to address num_vertices: 1, 2 or 4. */
+u32 mob_index_size( u32 num_vertices ) {
+	return ( num_vertices <= 0x100 ) ? 1 : ( num_vertices <= 0x10000 ) ? 2 : 4;
+}
+
+/*! Copies count indices into out as integers of size bytes, out may be
+	indices. */
+void mob_pack_indices( const u32 *indices, u32 count, u32 size, void *out ) {
+	u32 i;
+
+	if( 4 == size ) {
+		memmove( out, indices, count * sizeof( u32 ) );
+	} else if( 2 == size ) {
+		for( i = 0; i < count; ++i ) {
+			( ( u16 * ) out )[ i ] = indices[ i ];
+		}
+	} else {
+		for( i = 0; i < count; ++i ) {
+			( ( u8 * ) out )[ i ] = indices[ i ];
+		}
+	}
+}
+
+/*! Writes the header of a mob with num_vertices in layout and num_indices
+	into header, MOB_MAX_HEADER bytes. Meshes version 141 can hold with 16
+	bit indices keep it, all others get MOB_VERSION_LARGE and the smallest
+	index, with meshlets MOB_VERSION_MESHLETS. Returns the size of the
+	header, *index_size the bytes of each index that follows the vertices. */
+u32 mob_write_header( u8 *header, int layout, u32 num_vertices,
+	u32 num_indices, u32 num_meshlets, u32 *index_size )
+{
+	MOB_Header h;
+	MOB_Sizes s;
+
+	memset( &h, 0, sizeof( h ) );
+	memset( &s, 0, sizeof( s ) );
+	h.type = layout;
+
+	if( VBO_INTERLEAVED == layout ) {
+		s.vertex_size = num_vertices * MOB_VERTEX_FLOATS;
+	} else {
+		s.vertex_size = s.normal_size = 3 * num_vertices;
+		s.coord_size = 2 * num_vertices;
+	}
+	s.index_size = num_indices;
+	s.index_bytes = *index_size = mob_index_size( num_vertices );
+
+	if( 2 == s.index_bytes && s.vertex_size <= 0xFFFF
+		&& num_indices <= 0xFFFF && !num_meshlets )
+	{
+		h.version = MOB_VERSION;
+		h.vertex_size = s.vertex_size;
+		h.normal_size = s.normal_size;
+		h.coord_size = s.coord_size;
+		h.index_size = num_indices;
+		memcpy( header, &h, sizeof( h ) );
+		return sizeof( h );
+	}
+	h.version = num_meshlets ? MOB_VERSION_MESHLETS : MOB_VERSION_LARGE;
+	memcpy( header, &h, sizeof( h ) );
+	memcpy( header + sizeof( h ), &s, sizeof( s ) );
+
+	if( !num_meshlets ) {
+		return sizeof( h ) + sizeof( s );
+	}
+	memcpy( header + sizeof( h ) + sizeof( s ), &num_meshlets, 4 );
+	return MOB_MAX_HEADER;
+}
+
+/*! Reads a mob file. Interleaved files store vertex_size floats of
+	position, normal and uv per vertex. Separate and blocked files store
+	vertex_size floats of positions, normal_size floats of normals and
+	coord_size floats of uvs as consecutive blocks; v_data holds them in
+	that order and layout receives the header type. Indices of any size
+	are returned as u32, v_data and i_data stay untouched on failure. The
+	meshlets of the file go to meshlets if it is not 0, *num_meshlets is 0
+	without. */
+void read_mob( const char* file, u32* v_size, float** v_data,
+	u32* i_size, u32** i_data, int* skinned, int *layout,
+	MOB_Meshlet **meshlets, u32 *num_meshlets )
+{
+	long len, tmp_v, tmp_i, tmp_m;
+	u32 num_floats, num_vertices, i, count = 0;
+	MOB_Header header;
+	MOB_Sizes s;
+	u8 *buffer1 = 0, *buffer2 = 0;
+	u32 *indices = 0;
+	MOB_Meshlet *buffer3 = 0;
+	long offset = sizeof( MOB_Header );
+
+	FILE *fh = fopen( file, "rb" );
+	if( !fh ) {
+		fprintf( stderr, "Could not read file %s\n", file );
+		return;
+	}
+	fseek( fh, 0, SEEK_END );
+	len = ftell( fh );
+	fseek( fh, 0, SEEK_SET );
+	memset( &header, 0, sizeof( header ) );
+	fread( &header, 1, sizeof( MOB_Header ), fh );
+
+	if( MOB_VERSION == header.version ) {
+		s = ( MOB_Sizes ) { header.vertex_size, header.normal_size,
+			header.coord_size, header.index_size, sizeof( u16 ) };
+	} else if( ( MOB_VERSION_LARGE == header.version
+		|| MOB_VERSION_MESHLETS == header.version )
+		&& 1 == fread( &s, sizeof( s ), 1, fh )
+		&& ( 1 == s.index_bytes || 2 == s.index_bytes || 4 == s.index_bytes )
+		&& ( MOB_VERSION_LARGE == header.version
+		|| 1 == fread( &count, 4, 1, fh ) ) )
+	{
+		offset += sizeof( s ) + ( ( MOB_VERSION_LARGE == header.version )
+			? 0 : 4 );
+	} else {
+		fprintf( stderr, "Version %u invalid.\n", header.version );
+		goto last;
+	}
+	if( VBO_INTERLEAVED == header.type ) {
+		num_floats = s.vertex_size;
+		num_vertices = s.vertex_size / MOB_VERTEX_FLOATS;
+	} else if( ( VBO_SEPARATE == header.type )
+		|| ( VBO_BLOCKED == header.type ) )
+	{
+		num_vertices = s.vertex_size / 3;
+		num_floats = s.vertex_size + s.normal_size + s.coord_size;
+
+		if( ( s.vertex_size != 3 * num_vertices )
+			|| ( s.normal_size != 3 * num_vertices )
+			|| ( s.coord_size != 2 * num_vertices ) )
+		{
+			fprintf( stderr, "Stream sizes %" PRIu32 ", %" PRIu32 ", %" PRIu32
+				" inconsistent.\n", s.vertex_size, s.normal_size,
+				s.coord_size );
+			goto last;
+		}
+	} else {
+		fprintf( stderr, "Type %u invalid.\n", header.type );
+		goto last;
+	}
+	tmp_v = ( long ) num_floats * sizeof( float );
+	tmp_i = ( long ) s.index_size * s.index_bytes;
+	tmp_m = ( long ) count * sizeof( MOB_Meshlet );
+
+	if( len != ( offset + tmp_i + tmp_v + tmp_m ) ) {
+		fprintf( stderr, "File length %lu inconsistent, vertex size: %"
+			PRIu32 ", index size: %" PRIu32  ".\n",
+			len, s.vertex_size, s.index_size );
+		goto last;
+	}
+	buffer1 = calloc( num_floats + 1, sizeof( float ) );
+	buffer2 = ( 4 == s.index_bytes ) ? calloc( s.index_size + 1, 4 )
+		: scratch_alloc( ( size_t ) s.index_size * s.index_bytes + 1 );
+	indices = ( 4 == s.index_bytes ) ? ( u32 * ) buffer2
+		: calloc( s.index_size + 1, sizeof( u32 ) );
+	long read = buffer1 ? ( long ) fread( buffer1, 1, tmp_v, fh ) : 0;
+
+	if( read != tmp_v ) {
+		fprintf( stderr,
+			"Expected to read %ld bytes for vertices, but got %ld\n",
+			tmp_v, read );
+		goto last;
+	}
+	read = ( buffer2 && indices ) ? ( long ) fread( buffer2, 1, tmp_i, fh ) : 0;
+
+	if( read != tmp_i ) {
+		fprintf( stderr,
+			"Expected to read %ld bytes for indices, but got %ld\n",
+			tmp_i, read );
+		goto last;
+	}
+	for( i = 0; i < s.index_size; ++i ) {
+		indices[ i ] = ( 1 == s.index_bytes ) ? buffer2[ i ]
+			: ( 2 == s.index_bytes ) ? ( ( u16 * ) buffer2 )[ i ]
+			: indices[ i ];
+
+		if( indices[ i ] >= num_vertices ) {
+			fprintf( stderr, "Index %u of %s out of range.\n", i, file );
+			goto last;
+		}
+	}
+	if( meshlets && count ) {
+		buffer3 = malloc( tmp_m );
+		read = buffer3 ? ( long ) fread( buffer3, 1, tmp_m, fh ) : 0;
+
+		if( read != tmp_m ) {
+			fprintf( stderr,
+				"Expected to read %ld bytes for meshlets, but got %ld\n",
+				tmp_m, read );
+			goto last;
+		}
+		for( i = 0; i < count; ++i ) {
+			if( buffer3[ i ].index_count % 3
+				|| buffer3[ i ].index_count > s.index_size
+				|| buffer3[ i ].first_index
+				> s.index_size - buffer3[ i ].index_count )
+			{
+				fprintf( stderr, "Meshlet %u of %s out of range.\n", i,
+					file );
+				goto last;
+			}
+		}
+		*meshlets = buffer3;
+		*num_meshlets = count;
+		buffer3 = 0;
+	} else if( num_meshlets ) {
+		*num_meshlets = 0;
+	}
+	*v_data = ( float* ) buffer1;
+	*i_data = indices;
+	*skinned = header.num_joints;
+	*layout = header.type;
+	*v_size = num_floats;
+	*i_size = s.index_size;
+
+	if( indices == ( u32 * ) buffer2 ) { /* read in place */
+		buffer2 = 0;
+	}
+	buffer1 = 0;
+	indices = 0;
+last:
+	fclose( fh );
+	free( buffer1 );
+	free( buffer3 );
+	if( indices != ( u32 * ) buffer2 ) { /* narrower indices on scratch */
+		free( indices );
+		scratch_free( buffer2 );
+	} else {
+		free( buffer2 );
+	}
+}
@@ -0,0 +1,351 @@
+#include <float.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "profiler.h"
+#include "occlusion.h"
+
+#define OCC_NEAR_W		(1e-3f)
+
+/*! Sets up the edge and depth equations of a clip space triangle. Triangles
+	reaching in front of the near plane are dropped, the GPU clips them and
+	they would occlude too much. Both windings are kept. */
+static void occ_add_triangle( Occlusion *o, const Vector_4d *c ) {
+	float x[ 3 ], y[ 3 ], z[ 3 ];
+	int i;
+
+	for( i = 0; i < 3; ++i ) {
+		if( c[ i ].w < OCC_NEAR_W || c[ i ].z < -c[ i ].w ) {
+			return;
+		}
+		float oo_w = 1.0f / c[ i ].w;
+		x[ i ] = ( c[ i ].x * oo_w * 0.5f + 0.5f ) * OCC_WIDTH;
+		y[ i ] = ( c[ i ].y * oo_w * 0.5f + 0.5f ) * OCC_HEIGHT;
+		z[ i ] = c[ i ].z * oo_w;
+	}
+	float area = ( x[ 1 ] - x[ 0 ] ) * ( y[ 2 ] - y[ 0 ] )
+		- ( x[ 2 ] - x[ 0 ] ) * ( y[ 1 ] - y[ 0 ] );
+
+	if( area < 0.0f ) { /* make it counter clockwise */
+		float t;
+		t = x[ 1 ], x[ 1 ] = x[ 2 ], x[ 2 ] = t;
+		t = y[ 1 ], y[ 1 ] = y[ 2 ], y[ 2 ] = t;
+		t = z[ 1 ], z[ 1 ] = z[ 2 ], z[ 2 ] = t;
+		area = -area;
+	}
+	if( area < 1e-6f ) {
+		return;
+	}
+	float x0 = fminf( x[ 0 ], fminf( x[ 1 ], x[ 2 ] ) );
+	float x1 = fmaxf( x[ 0 ], fmaxf( x[ 1 ], x[ 2 ] ) );
+	float y0 = fminf( y[ 0 ], fminf( y[ 1 ], y[ 2 ] ) );
+	float y1 = fmaxf( y[ 0 ], fmaxf( y[ 1 ], y[ 2 ] ) );
+
+	if( x1 < 0.0f || y1 < 0.0f || x0 >= OCC_WIDTH || y0 >= OCC_HEIGHT ) {
+		return;
+	}
+	if( o->num_tris == o->max_tris ) {
+		u32 n = o->max_tris ? 2 * o->max_tris : 256;
+		Occ_Triangle *tris = realloc( o->tris, n * sizeof( Occ_Triangle ) );
+		if( !tris ) return;
+		o->tris = tris;
+		o->max_tris = n;
+	}
+	Occ_Triangle *t = &o->tris[ o->num_tris++ ];
+	float oo_area = 1.0f / area;
+	t->zx = t->zy = t->zc = 0.0f;
+
+	for( i = 0; i < 3; ++i ) { /* edge opposite of vertex i */
+		int j = ( i + 1 ) % 3, k = ( i + 2 ) % 3;
+		t->a[ i ] = y[ j ] - y[ k ];
+		t->b[ i ] = x[ k ] - x[ j ];
+		t->c[ i ] = -( t->a[ i ] * x[ j ] + t->b[ i ] * y[ j ] );
+		t->zx += t->a[ i ] * z[ i ] * oo_area;
+		t->zy += t->b[ i ] * z[ i ] * oo_area;
+		t->zc += t->c[ i ] * z[ i ] * oo_area;
+	}
+	t->x0 = x0 < 0.0f ? 0 : ( s16 ) x0;
+	t->y0 = y0 < 0.0f ? 0 : ( s16 ) y0;
+	t->x1 = x1 >= OCC_WIDTH ? OCC_WIDTH - 1 : ( s16 ) x1;
+	t->y1 = y1 >= OCC_HEIGHT ? OCC_HEIGHT - 1 : ( s16 ) y1;
+}
+
+/*! Rasterizes the triangles of one tile and builds its min/max depth.
+	Pixel centers on an edge count as inside, so shared edges of a mesh
+	leave no cracks. */
+static void occ_tile_job( void *arg ) {
+	const Occ_Tile_Job *job = arg;
+	Occlusion *o = job->occ;
+	u32 tx = job->tile % OCC_TILES_X, ty = job->tile / OCC_TILES_X;
+	int px0 = tx * OCC_TILE_W, py0 = ty * OCC_TILE_H;
+	int px1 = px0 + OCC_TILE_W - 1, py1 = py0 + OCC_TILE_H - 1;
+	u32 n;
+	int x, y;
+	PROF_SCOPE( "occlusion tile" );
+
+	for( y = py0; y <= py1; ++y ) {
+		float *row = &o->depth[ y * OCC_WIDTH + px0 ];
+		for( x = 0; x < ( int ) OCC_TILE_W; ++x ) row[ x ] = 1.0f;
+	}
+	for( n = o->bin_start[ job->tile ]; n < o->bin_start[ job->tile + 1 ]; ++n ) {
+		const Occ_Triangle *t = &o->tris[ o->bin_tris[ n ] ];
+		int x0 = t->x0 > px0 ? t->x0 & ~3 : px0;
+		int x1 = t->x1 < px1 ? t->x1 : px1;
+		int y0 = t->y0 > py0 ? t->y0 : py0;
+		int y1 = t->y1 < py1 ? t->y1 : py1;
+
+		for( y = y0; y <= y1; ++y ) {
+			float py = y + 0.5f;
+			float *row = &o->depth[ y * OCC_WIDTH ];
+#if defined(__SSE2__)
+			const __m128 zero = _mm_setzero_ps( );
+			const __m128 step = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+			__m128 a0 = _mm_set1_ps( t->a[ 0 ] );
+			__m128 a1 = _mm_set1_ps( t->a[ 1 ] );
+			__m128 a2 = _mm_set1_ps( t->a[ 2 ] );
+			__m128 zx = _mm_set1_ps( t->zx );
+			__m128 r0 = _mm_set1_ps( t->b[ 0 ] * py + t->c[ 0 ] );
+			__m128 r1 = _mm_set1_ps( t->b[ 1 ] * py + t->c[ 1 ] );
+			__m128 r2 = _mm_set1_ps( t->b[ 2 ] * py + t->c[ 2 ] );
+			__m128 rz = _mm_set1_ps( t->zy * py + t->zc );
+
+			for( x = x0; x <= x1; x += 4 ) {
+				__m128 px = _mm_add_ps( _mm_set1_ps( ( float ) x ), step );
+				__m128 e0 = _mm_add_ps( _mm_mul_ps( a0, px ), r0 );
+				__m128 e1 = _mm_add_ps( _mm_mul_ps( a1, px ), r1 );
+				__m128 e2 = _mm_add_ps( _mm_mul_ps( a2, px ), r2 );
+				__m128 in = _mm_and_ps( _mm_cmpge_ps( e0, zero ),
+					_mm_and_ps( _mm_cmpge_ps( e1, zero ),
+						_mm_cmpge_ps( e2, zero ) ) );
+
+				if( 0 == _mm_movemask_ps( in ) ) continue;
+				__m128 z = _mm_add_ps( _mm_mul_ps( zx, px ), rz );
+				__m128 d = _mm_loadu_ps( row + x );
+				z = _mm_min_ps( z, d );
+				_mm_storeu_ps( row + x,
+					_mm_or_ps( _mm_and_ps( in, z ), _mm_andnot_ps( in, d ) ) );
+			}
+#else
+			for( x = x0; x <= x1; ++x ) {
+				float px = x + 0.5f;
+				if( t->a[ 0 ] * px + t->b[ 0 ] * py + t->c[ 0 ] < 0.0f
+					|| t->a[ 1 ] * px + t->b[ 1 ] * py + t->c[ 1 ] < 0.0f
+					|| t->a[ 2 ] * px + t->b[ 2 ] * py + t->c[ 2 ] < 0.0f )
+				{
+					continue;
+				}
+				float z = t->zx * px + t->zy * py + t->zc;
+				if( z < row[ x ] ) row[ x ] = z;
+			}
+#endif
+		}
+	}
+	float tile_min = FLT_MAX, tile_max = -FLT_MAX;
+	u32 bx, by;
+
+	for( by = py0 / OCC_BLOCK; by <= py1 / OCC_BLOCK; ++by ) {
+		for( bx = px0 / OCC_BLOCK; bx <= px1 / OCC_BLOCK; ++bx ) {
+			float lo = FLT_MAX, hi = -FLT_MAX;
+
+			for( y = by * OCC_BLOCK; y < ( int ) ( ( by + 1 ) * OCC_BLOCK ); ++y ) {
+				const float *row = &o->depth[ y * OCC_WIDTH + bx * OCC_BLOCK ];
+				for( x = 0; x < ( int ) OCC_BLOCK; ++x ) {
+					lo = fminf( lo, row[ x ] );
+					hi = fmaxf( hi, row[ x ] );
+				}
+			}
+			o->block_min[ by * OCC_BLOCKS_X + bx ] = lo;
+			o->block_max[ by * OCC_BLOCKS_X + bx ] = hi;
+			tile_min = fminf( tile_min, lo );
+			tile_max = fmaxf( tile_max, hi );
+		}
+	}
+	o->tile_min[ job->tile ] = tile_min;
+	o->tile_max[ job->tile ] = tile_max;
+}
+
+/*! Transforms the occluders, bins their triangles into tiles and submits
+	one job per tile. */
+static void occ_setup_job( void *arg ) {
+	Occlusion *o = arg;
+	const Batch *b = o->batch;
+	u32 d, i, tile, total = 0;
+	u32 counts[ OCC_TILES_X * OCC_TILES_Y ] = { 0 };
+	PROF_SCOPE( "occlusion setup" );
+	o->num_tris = 0;
+
+	for( d = 0; d < b->num_draws; ++d ) {
+		if( !( b->draw_flags[ d ] & DRAW_OCCLUDER ) ) {
+			continue;
+		}
+		const Mesh *m = &b->meshes[ b->draw_meshes[ d ] ];
+		const u32 *idx = b->indices + m->first_index;
+		Matrix_4x4 mvp;
+		matrix_4x4_mul_matrix( &b->draws[ d ].model, &o->view_projection,
+			&mvp );
+
+		for( i = 0; i + 2 < m->index_count; i += 3 ) {
+			Vector_4d c[ 3 ];
+			int k;
+			for( k = 0; k < 3; ++k ) {
+				const float *v = b->vertices
+					+ ( idx[ i + k ] + m->base_vertex ) * BATCH_VERTEX_FLOATS;
+				matrix_4x4_transform_point( &mvp,
+					( Vector_3d ) { v[ 0 ], v[ 1 ], v[ 2 ] }, &c[ k ] );
+			}
+			occ_add_triangle( o, c );
+		}
+	}
+	for( i = 0; i < o->num_tris; ++i ) {
+		const Occ_Triangle *t = &o->tris[ i ];
+		u32 tx, ty;
+		for( ty = t->y0 / OCC_TILE_H; ty <= t->y1 / OCC_TILE_H; ++ty ) {
+			for( tx = t->x0 / OCC_TILE_W; tx <= t->x1 / OCC_TILE_W; ++tx ) {
+				++counts[ ty * OCC_TILES_X + tx ];
+				++total;
+			}
+		}
+	}
+	if( total > o->max_bins ) {
+		u32 *bins = realloc( o->bin_tris, total * sizeof( u32 ) );
+		if( !bins ) {
+			total = 0;
+			o->num_tris = 0;
+			memset( counts, 0, sizeof( counts ) );
+		} else {
+			o->bin_tris = bins;
+			o->max_bins = total;
+		}
+	}
+	o->bin_start[ 0 ] = 0;
+	for( tile = 0; tile < OCC_TILES_X * OCC_TILES_Y; ++tile ) {
+		o->bin_start[ tile + 1 ] = o->bin_start[ tile ] + counts[ tile ];
+		counts[ tile ] = o->bin_start[ tile ];
+	}
+	for( i = 0; i < o->num_tris; ++i ) {
+		const Occ_Triangle *t = &o->tris[ i ];
+		u32 tx, ty;
+		for( ty = t->y0 / OCC_TILE_H; ty <= t->y1 / OCC_TILE_H; ++ty ) {
+			for( tx = t->x0 / OCC_TILE_W; tx <= t->x1 / OCC_TILE_W; ++tx ) {
+				o->bin_tris[ counts[ ty * OCC_TILES_X + tx ]++ ] = i;
+			}
+		}
+	}
+	for( tile = 0; tile < OCC_TILES_X * OCC_TILES_Y; ++tile ) {
+		o->tile_jobs[ tile ].occ = o;
+		o->tile_jobs[ tile ].tile = tile;
+		jobs_submit( o->jobs, &o->counter, occ_tile_job, &o->tile_jobs[ tile ] );
+	}
+}
+
+/*! Starts rasterizing the occluders of a batch on the job system. The
+	caller may keep issuing GL work until occlusion_end. */
+void occlusion_begin( Occlusion *o, Job_System *js, const Batch *b,
+	const Matrix_4x4 *view_projection )
+{
+	o->view_projection = *view_projection;
+	o->batch = b;
+	o->jobs = js;
+	o->counter.pending = 0;
+	jobs_submit( js, &o->counter, occ_setup_job, o );
+}
+
+void occlusion_end( Occlusion *o ) {
+	PROF_SCOPE( "occlusion end" );
+	jobs_wait( o->jobs, &o->counter );
+}
+
+/*! Tests the screen rectangle and nearest depth of a sphere against the
+	tile and block depth ranges. Returns 0 if it is completely hidden. */
+static int occ_sphere_visible( const Occlusion *o, const Vector_4d *s ) {
+	float x0 = FLT_MAX, y0 = FLT_MAX, x1 = -FLT_MAX, y1 = -FLT_MAX;
+	float z_near = FLT_MAX;
+	int i;
+
+	for( i = 0; i < 8; ++i ) {
+		Vector_4d c;
+		Vector_3d p = {
+			s->x + ( ( i & 1 ) ? s->w : -s->w ),
+			s->y + ( ( i & 2 ) ? s->w : -s->w ),
+			s->z + ( ( i & 4 ) ? s->w : -s->w ) };
+		matrix_4x4_transform_point( &o->view_projection, p, &c );
+
+		if( c.w < OCC_NEAR_W ) {
+			return 1;
+		}
+		float oo_w = 1.0f / c.w;
+		float x = ( c.x * oo_w * 0.5f + 0.5f ) * OCC_WIDTH;
+		float y = ( c.y * oo_w * 0.5f + 0.5f ) * OCC_HEIGHT;
+		x0 = fminf( x0, x );
+		x1 = fmaxf( x1, x );
+		y0 = fminf( y0, y );
+		y1 = fmaxf( y1, y );
+		z_near = fminf( z_near, c.z * oo_w );
+	}
+	if( x1 < 0.0f || y1 < 0.0f || x0 >= OCC_WIDTH || y0 >= OCC_HEIGHT ) {
+		return 1; /* left to frustum culling */
+	}
+	int ix0 = x0 < 0.0f ? 0 : ( int ) x0;
+	int iy0 = y0 < 0.0f ? 0 : ( int ) y0;
+	int ix1 = x1 >= OCC_WIDTH ? OCC_WIDTH - 1 : ( int ) x1;
+	int iy1 = y1 >= OCC_HEIGHT ? OCC_HEIGHT - 1 : ( int ) y1;
+	int tx, ty, bx, by;
+
+	for( ty = iy0 / OCC_TILE_H; ty <= iy1 / ( int ) OCC_TILE_H; ++ty ) {
+		for( tx = ix0 / OCC_TILE_W; tx <= ix1 / ( int ) OCC_TILE_W; ++tx ) {
+			u32 tile = ty * OCC_TILES_X + tx;
+
+			if( z_near <= o->tile_min[ tile ] ) {
+				return 1;
+			}
+			if( z_near > o->tile_max[ tile ] ) {
+				continue;
+			}
+			int bx0 = tx * ( OCC_TILE_W / OCC_BLOCK );
+			int by0 = ty * ( OCC_TILE_H / OCC_BLOCK );
+			int bx1 = bx0 + OCC_TILE_W / OCC_BLOCK - 1;
+			int by1 = by0 + OCC_TILE_H / OCC_BLOCK - 1;
+			if( bx0 < ix0 / ( int ) OCC_BLOCK ) bx0 = ix0 / OCC_BLOCK;
+			if( by0 < iy0 / ( int ) OCC_BLOCK ) by0 = iy0 / OCC_BLOCK;
+			if( bx1 > ix1 / ( int ) OCC_BLOCK ) bx1 = ix1 / OCC_BLOCK;
+			if( by1 > iy1 / ( int ) OCC_BLOCK ) by1 = iy1 / OCC_BLOCK;
+
+			for( by = by0; by <= by1; ++by ) {
+				for( bx = bx0; bx <= bx1; ++bx ) {
+					if( z_near <= o->block_max[ by * OCC_BLOCKS_X + bx ] ) {
+						return 1;
+					}
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+/*! Flags every draw of the batch hidden behind the occluders with
+	DRAW_OCCLUDED. Occlusion_end must have been called. Returns the number
+	of occluded draws. */
+u32 occlusion_cull( const Occlusion *o, Batch *b ) {
+	u32 d, occluded = 0;
+
+	for( d = 0; d < b->num_draws; ++d ) {
+		u32 flags = b->draw_flags[ d ] & ~DRAW_OCCLUDED;
+
+		if( !occ_sphere_visible( o, &b->bounds[ d ] ) ) {
+			flags |= DRAW_OCCLUDED;
+			++occluded;
+		}
+		batch_set_flags( b, d, flags );
+	}
+	return occluded;
+}
+
+void occlusion_free( Occlusion *o ) {
+	free( o->tris );
+	free( o->bin_tris );
+	o->tris = 0;
+	o->bin_tris = 0;
+	o->max_tris = o->max_bins = 0;
+}
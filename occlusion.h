@@ -0,0 +1,50 @@
+#ifndef CTOOL_OCCLUSION
+#define CTOOL_OCCLUSION
+
+#include "types.h"
+#include "3d.h"
+#include "jobs.h"
+#include "batch.h"
+
+#define OCC_WIDTH			(256U)	/* Resolution of the occlusion buffer. */
+#define OCC_HEIGHT			(144U)
+#define OCC_TILE_W			(32U)	/* One job rasterizes one tile. */
+#define OCC_TILE_H			(16U)
+#define OCC_TILES_X			(OCC_WIDTH / OCC_TILE_W)
+#define OCC_TILES_Y			(OCC_HEIGHT / OCC_TILE_H)
+#define OCC_BLOCK			(8U)	/* Min/max depth of 8 x 8 pixels. */
+#define OCC_BLOCKS_X		(OCC_WIDTH / OCC_BLOCK)
+#define OCC_BLOCKS_Y		(OCC_HEIGHT / OCC_BLOCK)
+
+typedef struct { /*! Screen space triangle with edge and depth equations. */
+	float a[ 3 ], b[ 3 ], c[ 3 ];	/*! e_i( x, y ) = a_i * x + b_i * y + c_i */
+	float zx, zy, zc;				/*! z / w = zx * x + zy * y + zc */
+	s16 x0, y0, x1, y1;				/*! Bounding box in pixels, inclusive. */
+} Occ_Triangle;
+
+typedef struct Occlusion Occlusion;
+
+typedef struct { /*! Argument of a tile job. */
+	Occlusion *occ;
+	u32 tile;
+} Occ_Tile_Job;
+
+struct Occlusion { /*! Depth only software rasterizer for occluders. */
+	Matrix_4x4 view_projection;
+	const Batch *batch;
+	Job_System *jobs;
+	Job_Counter counter;
+	u32 num_tris, max_tris;
+	Occ_Triangle *tris;
+	u32 *bin_tris;					/*! Triangle indices, grouped by tile. */
+	u32 bin_start[ OCC_TILES_X * OCC_TILES_Y + 1 ];
+	u32 max_bins;
+	float depth[ OCC_WIDTH * OCC_HEIGHT ];
+	float block_min[ OCC_BLOCKS_X * OCC_BLOCKS_Y ];
+	float block_max[ OCC_BLOCKS_X * OCC_BLOCKS_Y ];
+	float tile_min[ OCC_TILES_X * OCC_TILES_Y ];
+	float tile_max[ OCC_TILES_X * OCC_TILES_Y ];
+	Occ_Tile_Job tile_jobs[ OCC_TILES_X * OCC_TILES_Y ];
+};
+
+#endif /* CTOOL_OCCLUSION */
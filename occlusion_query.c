@@ -0,0 +1,218 @@
+#include <stdlib.h>
+#include <string.h>
+#include "occlusion_query.h"
+#include "batch.h"
+#include "shading.h"
+
+/*! Creates the unit cube drawn for the queries. */
+void oq_init( Occlusion_Queries *oq ) {
+	static const float corners[ ] = {
+		-1.0f, -1.0f, -1.0f,   1.0f, -1.0f, -1.0f,
+		-1.0f,  1.0f, -1.0f,   1.0f,  1.0f, -1.0f,
+		-1.0f, -1.0f,  1.0f,   1.0f, -1.0f,  1.0f,
+		-1.0f,  1.0f,  1.0f,   1.0f,  1.0f,  1.0f
+	};
+	static const u16 faces[ ] = {
+		0, 2, 1, 1, 2, 3,   4, 5, 6, 5, 7, 6,
+		0, 1, 4, 1, 5, 4,   2, 6, 3, 3, 6, 7,
+		0, 4, 2, 2, 4, 6,   1, 3, 5, 3, 7, 5
+	};
+	memset( oq, 0, sizeof( Occlusion_Queries ) );
+	glGenVertexArrays( 1, &oq->box_vao );
+	glGenBuffers( 2, oq->box_buffers );
+	glBindVertexArray( oq->box_vao );
+	glBindBuffer( GL_ARRAY_BUFFER, oq->box_buffers[ 0 ] );
+	glBufferData( GL_ARRAY_BUFFER, sizeof( corners ), corners, GL_STATIC_DRAW );
+	glEnableVertexAttribArray( 0 );
+	glVertexAttribPointer( 0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof( float ), 0 );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, oq->box_buffers[ 1 ] );
+	glBufferData( GL_ELEMENT_ARRAY_BUFFER, sizeof( faces ), faces,
+		GL_STATIC_DRAW );
+	glBindVertexArray( 0 );
+	glBindBuffer( GL_ARRAY_BUFFER, 0 );
+	glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+}
+
+/*! Makes sure there is one query per draw, new draws start visible. Their
+	re-tests are spread over OQ_REQUERY_FRAMES frames. */
+static int oq_reserve( Occlusion_Queries *oq, u32 num_draws ) {
+	u32 i;
+
+	if( num_draws <= oq->num_states ) {
+		return 0;
+	}
+	Query_State *states = realloc( oq->states,
+		num_draws * sizeof( Query_State ) );
+	if( !states ) return -1;
+	oq->states = states;
+
+	for( i = oq->num_states; i < num_draws; ++i ) {
+		memset( &states[ i ], 0, sizeof( Query_State ) );
+		glGenQueries( 1, &states[ i ].query );
+		states[ i ].visible = 1;
+		states[ i ].confirmed = oq->frame - i % OQ_REQUERY_FRAMES; /* stagger */
+	}
+	oq->num_states = num_draws;
+	return 0;
+}
+
+static void oq_draw( const Batch *b, u32 d, const s16 *uni_loc ) {
+	const Mesh *m = &b->meshes[ b->draw_meshes[ d ] ];
+	glUniformMatrix4fv( uni_loc[ ULOC_MODEL ], 1, GL_FALSE,
+		( const GLfloat * ) &b->draws[ d ].model );
+	glDrawElementsBaseVertex( GL_TRIANGLES, m->index_count,
+		index_type( b->index_size ),
+		( const GLvoid * ) ( ( size_t ) m->first_index * b->index_size ),
+		m->base_vertex );
+}
+
+static void oq_bind_model( const Batch *b, const Shader *model ) {
+	glUseProgram( model->program_id );
+	glBindVertexArray( b->vao );
+}
+
+/*! A box crossing the near plane gets clipped and cannot be queried. */
+static int oq_box_clipped( const Matrix_4x4 *view_projection,
+	const Vector_4d *s )
+{
+	int i;
+
+	for( i = 0; i < 8; ++i ) {
+		Vector_3d p = {
+			s->x + ( ( i & 1 ) ? s->w : -s->w ),
+			s->y + ( ( i & 2 ) ? s->w : -s->w ),
+			s->z + ( ( i & 4 ) ? s->w : -s->w ) };
+		Vector_4d c;
+		matrix_4x4_transform_point( view_projection, p, &c );
+		if( c.z < -c.w ) return 1;
+	}
+	return 0;
+}
+
+/*! Renders the draws of a batch with occlusion queries. Results are only
+	read once they are available, at the earliest one frame later, so the
+	CPU never waits for the GPU. Draws known to be visible are drawn first
+	and skip the query for OQ_REQUERY_FRAMES frames. The others draw their
+	bounding box into a query, with color and depth writes off, and are
+	drawn under conditional rendering on the outcome. The model program
+	must be bound with its frame uniforms set, the bbox program gets view
+	and projection here. */
+void oq_render( Occlusion_Queries *oq, const Batch *b, const u8 *in_frustum,
+	const Shader *model, const Shader *bbox, const Matrix_4x4 *view,
+	const Matrix_4x4 *projection )
+{
+	const s16 *uni_loc = model->uniform_locations;
+	const s16 *box_loc = bbox->uniform_locations;
+	GLboolean culling = glIsEnabled( GL_CULL_FACE );
+	Matrix_4x4 view_projection;
+	u32 d;
+
+	matrix_4x4_mul_matrix( view, projection, &view_projection );
+
+	if( oq_reserve( oq, b->num_draws ) < 0 ) {
+		return;
+	}
+	++oq->frame;
+	oq->num_queries = oq->num_conditional = oq->num_culled = 0;
+
+	for( d = 0; d < b->num_draws; ++d ) { /* collect finished results */
+		Query_State *q = &oq->states[ d ];
+		GLuint available = 0, samples = 0;
+
+		if( !q->pending || q->issued == oq->frame ) {
+			continue;
+		}
+		glGetQueryObjectuiv( q->query, GL_QUERY_RESULT_AVAILABLE, &available );
+
+		if( available ) {
+			glGetQueryObjectuiv( q->query, GL_QUERY_RESULT, &samples );
+			q->pending = 0;
+			q->visible = ( 0 != samples );
+			if( q->visible ) q->confirmed = oq->frame;
+		}
+	}
+	glBindTexture( GL_TEXTURE_2D, b->tex_id );
+	glBindVertexArray( b->vao );
+
+	for( d = 0; d < b->num_draws; ++d ) { /* visible set, fills depth */
+		const Query_State *q = &oq->states[ d ];
+		if( in_frustum[ d ] && !q->pending && q->visible ) {
+			oq_draw( b, d, uni_loc );
+		}
+	}
+	for( d = 0; d < b->num_draws; ++d ) {
+		Query_State *q = &oq->states[ d ];
+		u32 age = oq->frame - q->confirmed;
+
+		if( !in_frustum[ d ] ) {
+			continue;
+		}
+		if( q->pending ) { /* result still in flight */
+			oq_bind_model( b, model );
+			glBeginConditionalRender( q->query, GL_QUERY_NO_WAIT );
+			oq_draw( b, d, uni_loc );
+			glEndConditionalRender( );
+			++oq->num_conditional;
+			continue;
+		}
+		if( q->visible && age < OQ_REQUERY_FRAMES ) {
+			continue; /* temporal coherence, drawn above */
+		}
+		const Vector_4d *s = &b->bounds[ d ];
+
+		if( oq_box_clipped( &view_projection, s ) ) {
+			if( !q->visible ) {
+				oq_bind_model( b, model );
+				oq_draw( b, d, uni_loc );
+			}
+			q->visible = 1;
+			q->confirmed = oq->frame;
+			continue;
+		}
+		if( !q->visible ) {
+			++oq->num_culled;
+		}
+		glUseProgram( bbox->program_id );
+		glUniformMatrix4fv( box_loc[ ULOC_VIEW ], 1, GL_FALSE,
+			( const GLfloat * ) view );
+		glUniformMatrix4fv( box_loc[ ULOC_PROJECTION ], 1, GL_FALSE,
+			( const GLfloat * ) projection );
+		glUniform3f( box_loc[ ULOC_TRANSLATION ], s->x, s->y, s->z );
+		glUniform1f( box_loc[ ULOC_RADIUS ], s->w );
+		glColorMask( GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE );
+		glDepthMask( GL_FALSE );
+		glDisable( GL_CULL_FACE );
+		glBindVertexArray( oq->box_vao );
+		glBeginQuery( GL_ANY_SAMPLES_PASSED, q->query );
+		glDrawElements( GL_TRIANGLES, 36, GL_UNSIGNED_SHORT, 0 );
+		glEndQuery( GL_ANY_SAMPLES_PASSED );
+		glColorMask( GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE );
+		glDepthMask( GL_TRUE );
+		if( culling ) glEnable( GL_CULL_FACE );
+		q->pending = 1;
+		q->issued = oq->frame;
+
+		if( !q->visible ) { /* the GPU decides, without a read back */
+			oq_bind_model( b, model );
+			glBeginConditionalRender( q->query, GL_QUERY_WAIT );
+			oq_draw( b, d, uni_loc );
+			glEndConditionalRender( );
+			++oq->num_conditional;
+		}
+		++oq->num_queries;
+	}
+	glUseProgram( model->program_id );
+	glBindVertexArray( 0 );
+}
+
+void oq_free( Occlusion_Queries *oq ) {
+	u32 i;
+
+	for( i = 0; i < oq->num_states; ++i ) {
+		glDeleteQueries( 1, &oq->states[ i ].query );
+	}
+	free( oq->states );
+	glDeleteVertexArrays( 1, &oq->box_vao );
+	glDeleteBuffers( 2, oq->box_buffers );
+	memset( oq, 0, sizeof( Occlusion_Queries ) );
+}
@@ -0,0 +1,28 @@
+#ifndef CTOOL_OCCLUSION_QUERY
+#define CTOOL_OCCLUSION_QUERY
+
+#include "types.h"
+
+#define OQ_REQUERY_FRAMES	(16U) /* Visible draws are re-tested this often. */
+
+typedef struct { /*! Occlusion query state of one draw. */
+	u32 query;			/*! GL_ANY_SAMPLES_PASSED query object. */
+	u32 issued;			/*! Frame the pending query was issued in. */
+	u32 confirmed;		/*! Frame the draw was last known visible. */
+	u8 pending;			/*! The result has not been read back yet. */
+	u8 visible;			/*! Last read back result. */
+	u8 pad_unused[ 2 ];
+} Query_State;
+
+typedef struct { /*! Hardware occlusion culling of the draws of a batch. */
+	u32 frame;
+	u32 num_states;
+	Query_State *states;
+	u32 box_vao;
+	u32 box_buffers[ 2 ];
+	u32 num_queries;		/*! Queries issued in the last frame. */
+	u32 num_conditional;	/*! Draws rendered conditionally. */
+	u32 num_culled;			/*! Draws skipped on a read back result. */
+} Occlusion_Queries;
+
+#endif /* CTOOL_OCCLUSION_QUERY */
@@ -0,0 +1,254 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pan_cache.h"
+
+/*! Creates the two cache framebuffers for a width x height view. Call
+	pan_cache_free also on failure. */
+int pan_cache_init( Pan_Cache *pc, int width, int height ) {
+	GLint target_fbo;
+	int result = 0;
+	u32 i;
+
+	memset( pc, 0, sizeof( Pan_Cache ) );
+	pc->view_width = width;
+	pc->view_height = height;
+	pc->margin_x = width / PAN_CACHE_MARGIN;
+	pc->margin_y = height / PAN_CACHE_MARGIN;
+	pc->width = width + 2 * pc->margin_x;
+	pc->height = height + 2 * pc->margin_y;
+
+	glGetIntegerv( GL_FRAMEBUFFER_BINDING, &target_fbo );
+	glGenFramebuffers( 2, pc->fbo );
+	glGenRenderbuffers( 2, pc->color );
+	glGenRenderbuffers( 2, pc->depth );
+
+	for( i = 0; i < 2 && !result; ++i ) {
+		glBindRenderbuffer( GL_RENDERBUFFER, pc->color[ i ] );
+		glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, pc->width,
+			pc->height );
+		glBindRenderbuffer( GL_RENDERBUFFER, pc->depth[ i ] );
+		glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+			pc->width, pc->height );
+		glBindFramebuffer( GL_FRAMEBUFFER, pc->fbo[ i ] );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+			GL_RENDERBUFFER, pc->color[ i ] );
+		glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+			GL_RENDERBUFFER, pc->depth[ i ] );
+
+		if( GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus( GL_FRAMEBUFFER ) ) {
+			fprintf( stderr, "Error: pan cache FBO incomplete!\n" );
+			result = -1;
+		}
+	}
+	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+	glBindFramebuffer( GL_FRAMEBUFFER, target_fbo );
+	return result;
+}
+
+void pan_cache_free( Pan_Cache *pc ) {
+	if( pc->fbo[ 0 ] ) {
+		glDeleteFramebuffers( 2, pc->fbo );
+		glDeleteRenderbuffers( 2, pc->color );
+		glDeleteRenderbuffers( 2, pc->depth );
+	}
+	memset( pc, 0, sizeof( Pan_Cache ) );
+}
+
+/*! Window position and normalized depth of the point p through mvp, 0
+	behind the eye. */
+static int pan_cache_project( const Matrix_4x4 *mvp, Vector_3d p, int width,
+	int height, float *out )
+{
+	Vector_4d c;
+	matrix_4x4_transform_point( mvp, p, &c );
+
+	if( c.w <= 0.0f ) {
+		return 0;
+	}
+	out[ 0 ] = ( c.x / c.w * 0.5f + 0.5f ) * width;
+	out[ 1 ] = ( c.y / c.w * 0.5f + 0.5f ) * height;
+	out[ 2 ] = c.z / c.w;
+	return 1;
+}
+
+/*! How far the plane moved on the screen from the reference view to view,
+	-1 unless all of it moved the same and kept its depth. The plane lies
+	in its x, y plane, four of its points fix the mapping between the
+	views. */
+static int pan_cache_shift( const Pan_Cache *pc, const Matrix_4x4 *view,
+	float *shift )
+{
+	static const Vector_3d points[ 4 ] = {
+		{ 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f },
+		{ 1.0f, 1.0f, 0.0f } };
+	Matrix_4x4 view_projection, reference, current;
+	float a[ 3 ], b[ 3 ];
+	u32 i;
+
+	matrix_4x4_mul_matrix( &pc->view, &pc->projection, &view_projection );
+	matrix_4x4_mul_matrix( &pc->model, &view_projection, &reference );
+	matrix_4x4_mul_matrix( view, &pc->projection, &view_projection );
+	matrix_4x4_mul_matrix( &pc->model, &view_projection, &current );
+
+	for( i = 0; i < 4; ++i ) {
+		if( !pan_cache_project( &reference, points[ i ], pc->view_width,
+			pc->view_height, a ) || !pan_cache_project( &current, points[ i ],
+			pc->view_width, pc->view_height, b ) )
+		{
+			return -1;
+		}
+		if( fabsf( b[ 2 ] - a[ 2 ] ) > PAN_CACHE_DEPTH_TOLERANCE ) {
+			return -1;
+		}
+		if( 0 == i ) {
+			shift[ 0 ] = b[ 0 ] - a[ 0 ];
+			shift[ 1 ] = b[ 1 ] - a[ 1 ];
+		} else if( fabsf( b[ 0 ] - a[ 0 ] - shift[ 0 ] ) > PAN_CACHE_TOLERANCE
+			|| fabsf( b[ 1 ] - a[ 1 ] - shift[ 1 ] ) > PAN_CACHE_TOLERANCE )
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*! Narrows the reference projection to the part of the view the cache
+	covers, the rows of x and y get the scale and offset of the window. */
+static void pan_cache_set_projection( Pan_Cache *pc ) {
+	const Matrix_4x4 *p = &pc->projection;
+	Matrix_4x4 *c = &pc->cache_projection;
+	float ax = ( float ) pc->view_width / pc->width;
+	float ay = ( float ) pc->view_height / pc->height;
+	float bx = -2.0f * pc->origin_x / pc->width;
+	float by = -2.0f * pc->origin_y / pc->height;
+
+	*c = *p;
+	c->_00 = ax * p->_00 + bx * p->_30;
+	c->_01 = ax * p->_01 + bx * p->_31;
+	c->_02 = ax * p->_02 + bx * p->_32;
+	c->_03 = ax * p->_03 + bx * p->_33;
+	c->_10 = ay * p->_10 + by * p->_30;
+	c->_11 = ay * p->_11 + by * p->_31;
+	c->_12 = ay * p->_12 + by * p->_32;
+	c->_13 = ay * p->_13 + by * p->_33;
+}
+
+/*! Copies the cache moved by dx, dy pixels into the other framebuffer and
+	leaves the strips it does not cover to render. */
+static void pan_cache_scroll( Pan_Cache *pc, s32 dx, s32 dy ) {
+	s32 w = pc->width - abs( dx ), h = pc->height - abs( dy );
+	s32 sx = ( dx > 0 ) ? dx : 0, sy = ( dy > 0 ) ? dy : 0;
+	s32 tx = ( dx > 0 ) ? 0 : -dx, ty = ( dy > 0 ) ? 0 : -dy;
+
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, pc->fbo[ pc->current ] );
+	glBindFramebuffer( GL_DRAW_FRAMEBUFFER, pc->fbo[ pc->current ^ 1 ] );
+	glBlitFramebuffer( sx, sy, sx + w, sy + h, tx, ty, tx + w, ty + h,
+		GL_COLOR_BUFFER_BIT, GL_NEAREST );
+	glBindFramebuffer( GL_FRAMEBUFFER, pc->target_fbo );
+
+	pc->current ^= 1;
+	pc->origin_x += dx;
+	pc->origin_y += dy;
+	pan_cache_set_projection( pc );
+
+	if( dx ) {
+		pc->rects[ pc->num_rects++ ] = ( Pan_Rect ) {
+			( dx > 0 ) ? w : 0, 0, abs( dx ), pc->height };
+	}
+	if( dy ) {
+		pc->rects[ pc->num_rects++ ] = ( Pan_Rect ) {
+			tx, ( dy > 0 ) ? h : 0, w, abs( dy ) };
+	}
+	pc->scrolls++;
+}
+
+/*! Decides how the frame for the plane model and view comes from the
+	cache, all matrices as uploaded. Returns the number of rects to render
+	from the reference view, see pan_cache_begin_rect, 0 when the cache
+	only gets blitted. Call pan_cache_present after them. */
+u32 pan_cache_update( Pan_Cache *pc, const Matrix_4x4 *model,
+	const Matrix_4x4 *view, const Matrix_4x4 *projection )
+{
+	GLint target_fbo;
+	float shift[ 2 ] = { 0.0f, 0.0f };
+	s32 dx, dy;
+
+	glGetIntegerv( GL_FRAMEBUFFER_BINDING, &target_fbo );
+	pc->target_fbo = target_fbo;
+	pc->num_rects = 0;
+
+	if( pc->valid && !memcmp( model, &pc->model, sizeof( Matrix_4x4 ) )
+		&& !memcmp( projection, &pc->projection, sizeof( Matrix_4x4 ) )
+		&& pan_cache_shift( pc, view, shift ) >= 0 )
+	{ /* the view starts where the plane came from, to a whole pixel */
+		pc->offset_x = -( s32 ) lrintf( shift[ 0 ] );
+		pc->offset_y = -( s32 ) lrintf( shift[ 1 ] );
+		dx = pc->offset_x - pc->origin_x;
+		dy = pc->offset_y - pc->origin_y;
+
+		if( abs( dx ) <= pc->margin_x && abs( dy ) <= pc->margin_y ) {
+			pc->hits++;
+			return 0;
+		}
+		if( abs( dx ) < pc->width && abs( dy ) < pc->height ) {
+			pan_cache_scroll( pc, dx, dy );
+			return pc->num_rects;
+		}
+	}
+	pc->model = *model;
+	pc->view = *view;
+	pc->projection = *projection;
+	pc->origin_x = pc->origin_y = pc->offset_x = pc->offset_y = 0;
+	pc->valid = 1;
+	pan_cache_set_projection( pc );
+	pc->rects[ 0 ] = ( Pan_Rect ) { 0, 0, pc->width, pc->height };
+	pc->num_rects = 1;
+	pc->renders++;
+	return 1;
+}
+
+/*! The part x0, y0 to x1, y1 of the normalized device coordinates of the
+	reference view the cache covers. */
+void pan_cache_window( const Pan_Cache *pc, float *ndc ) {
+	ndc[ 0 ] = 2.0f * ( pc->origin_x - pc->margin_x ) / pc->view_width - 1.0f;
+	ndc[ 1 ] = 2.0f * ( pc->origin_y - pc->margin_y ) / pc->view_height - 1.0f;
+	ndc[ 2 ] = ndc[ 0 ] + 2.0f * pc->width / pc->view_width;
+	ndc[ 3 ] = ndc[ 1 ] + 2.0f * pc->height / pc->view_height;
+}
+
+/*! Binds the cache and limits rendering to rect i, draw with
+	cache_projection and the reference view. */
+void pan_cache_begin_rect( Pan_Cache *pc, u32 i ) {
+	const Pan_Rect *r = &pc->rects[ i ];
+
+	glBindFramebuffer( GL_FRAMEBUFFER, pc->fbo[ pc->current ] );
+	glEnable( GL_SCISSOR_TEST );
+	glScissor( r->x, r->y, r->width, r->height );
+	pc->rendered_pixels += ( u64 ) r->width * r->height;
+}
+
+void pan_cache_end_rect( Pan_Cache *pc ) {
+	glDisable( GL_SCISSOR_TEST );
+	glBindFramebuffer( GL_FRAMEBUFFER, pc->target_fbo );
+}
+
+/*! Blits the view at its offset into the framebuffer bound before
+	pan_cache_update. */
+void pan_cache_present( const Pan_Cache *pc ) {
+	s32 x = pc->offset_x - pc->origin_x + pc->margin_x;
+	s32 y = pc->offset_y - pc->origin_y + pc->margin_y;
+
+	glBindFramebuffer( GL_READ_FRAMEBUFFER, pc->fbo[ pc->current ] );
+	glBindFramebuffer( GL_DRAW_FRAMEBUFFER, pc->target_fbo );
+	glBlitFramebuffer( x, y, x + pc->view_width, y + pc->view_height, 0, 0,
+		pc->view_width, pc->view_height, GL_COLOR_BUFFER_BIT, GL_NEAREST );
+	glBindFramebuffer( GL_FRAMEBUFFER, pc->target_fbo );
+}
+
+void pan_cache_summary( const Pan_Cache *pc, FILE *out ) {
+	fprintf( out, "pan cache: %u cached, %u scrolls, %u full renders, "
+		"%.2f Mpixels rendered\n", pc->hits, pc->scrolls, pc->renders,
+		pc->rendered_pixels / 1000000.0 );
+}
@@ -0,0 +1,42 @@
+#ifndef CTOOL_PAN_CACHE
+#define CTOOL_PAN_CACHE
+
+#include "types.h"
+#include "3d.h"
+
+#define PAN_CACHE_MARGIN			(4U)		/* 1 / 4 of the view per side. */
+#define PAN_CACHE_TOLERANCE			(0.0625f)	/* Pixels off a pure shift. */
+#define PAN_CACHE_DEPTH_TOLERANCE	(1e-4f)		/* Normalized depth change. */
+
+typedef struct { /*! Part of the cache to render, in its pixels. */
+	s32 x, y, width, height;
+} Pan_Rect;
+
+typedef struct { /*! The plane rendered into a texture larger than the
+	view. As long as the view only moves parallel to the plane, the plane
+	shifts on the screen without changing, the cache is blitted at the
+	shift. When the view leaves the cache, the overlap is copied into the
+	other texture centered on the view and only the exposed strips are
+	rendered. Any other change of the view, plane or projection renders the
+	whole cache.
+
+	Positions are in pixels of the reference view, the one the cache was
+	rendered from. The cache covers the view at origin plus the margins. */
+	u32 fbo[ 2 ], color[ 2 ], depth[ 2 ];
+	u32 current;				/*! Texture holding the cache. */
+	int view_width, view_height;
+	int width, height;			/*! View plus margins. */
+	int margin_x, margin_y;
+	int valid;
+	Matrix_4x4 model, view, projection;	/*! Of the reference view. */
+	Matrix_4x4 cache_projection;	/*! projection covering the cache. */
+	s32 origin_x, origin_y;		/*! Of the view the cache is centered on. */
+	s32 offset_x, offset_y;		/*! Of the current view. */
+	Pan_Rect rects[ 2 ];		/*! To render after pan_cache_update. */
+	u32 num_rects;
+	s32 target_fbo;				/*! Bound before pan_cache_update. */
+	u32 hits, scrolls, renders;
+	u64 rendered_pixels;
+} Pan_Cache;
+
+#endif /* CTOOL_PAN_CACHE */
@@ -0,0 +1,341 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "profiler.h"
+
+static Profiler profiler;
+static __thread Prof_Thread *prof_thread;
+
+static double prof_now( void ) {
+	struct timespec time;
+	clock_gettime( CLOCK_MONOTONIC, &time );
+	return ( double ) time.tv_sec * 1000000.0 + ( double ) time.tv_nsec / 1000.0;
+}
+
+/*! Enables the profiler. With trace set the markers are kept for
+	prof_write_trace, otherwise only the frame statistics. */
+void prof_init( int trace ) {
+	u32 i;
+
+	pthread_mutex_init( &profiler.lock, 0 );
+	profiler.trace = trace;
+	profiler.gpu = gl_caps.timer_query;
+
+	for( i = 0; i < PROF_HISTORY; ++i ) {
+		profiler.history[ i ].cpu_ms = profiler.history[ i ].gpu_ms = -1.0f;
+	}
+	if( profiler.gpu ) {
+		for( i = 0; i < PROF_GPU_FRAMES; ++i ) {
+			Prof_Gpu_Frame *f = &profiler.gpu_frames[ i ];
+			glGenQueries( 2, f->frame_stamps );
+			glGenQueries( 2 * PROF_GPU_RANGES, f->stamps );
+		}
+		if( trace ) {
+			profiler.gpu_events = malloc( PROF_MAX_EVENTS * sizeof( Prof_Event ) );
+		}
+	}
+	profiler.enabled = 1;
+}
+
+/*! Markers of the calling thread, registered on first use. */
+static Prof_Thread *prof_get_thread( void ) {
+	if( !prof_thread ) {
+		pthread_mutex_lock( &profiler.lock );
+
+		if( profiler.num_threads < PROF_MAX_THREADS ) {
+			Prof_Thread *t = &profiler.threads[ profiler.num_threads ];
+			t->id = profiler.num_threads++;
+			if( profiler.trace ) {
+				t->events = malloc( PROF_MAX_EVENTS * sizeof( Prof_Event ) );
+			}
+			prof_thread = t;
+		}
+		pthread_mutex_unlock( &profiler.lock );
+	}
+	return prof_thread;
+}
+
+/*! Opens a CPU marker on the calling thread. name must be a literal or
+	outlive the profiler. Returns 0, for PROF_SCOPE. */
+int prof_begin( const char *name ) {
+	Prof_Thread *t;
+
+	if( !profiler.enabled || !( t = prof_get_thread( ) ) ) {
+		return 0;
+	}
+	if( t->depth < PROF_MAX_DEPTH ) {
+		t->names[ t->depth ] = name;
+		t->starts[ t->depth ] = prof_now( );
+	}
+	t->depth++;
+	return 0;
+}
+
+/*! Closes the innermost CPU marker of the calling thread. */
+void prof_end( void ) {
+	Prof_Thread *t = prof_thread;
+
+	if( !profiler.enabled || !t || !t->depth ) {
+		return;
+	}
+	t->depth--;
+
+	if( t->depth < PROF_MAX_DEPTH && t->events
+		&& t->num_events < PROF_MAX_EVENTS )
+	{
+		Prof_Event *e = &t->events[ t->num_events++ ];
+		e->name = t->names[ t->depth ];
+		e->start = t->starts[ t->depth ];
+		e->duration = prof_now( ) - e->start;
+	}
+}
+
+void prof_scope_end( int *unused ) {
+	( void ) unused;
+	prof_end( );
+}
+
+/*! Opens a GPU marker, a GL_TIMESTAMP query is issued at both ends. */
+void prof_gpu_begin( const char *name ) {
+	Prof_Gpu_Frame *f = &profiler.gpu_frames[ profiler.frame % PROF_GPU_FRAMES ];
+
+	if( !profiler.enabled || !profiler.gpu ) {
+		return;
+	}
+	if( f->num_ranges < PROF_GPU_RANGES && f->depth < PROF_MAX_DEPTH ) {
+		glQueryCounter( f->stamps[ 2 * f->num_ranges ], GL_TIMESTAMP );
+		f->names[ f->num_ranges ] = name;
+		f->stack[ f->depth ] = f->num_ranges++;
+	} else if( f->depth < PROF_MAX_DEPTH ) {
+		f->stack[ f->depth ] = PROF_GPU_RANGES; /* dropped */
+	}
+	f->depth++;
+}
+
+void prof_gpu_end( void ) {
+	Prof_Gpu_Frame *f = &profiler.gpu_frames[ profiler.frame % PROF_GPU_FRAMES ];
+
+	if( !profiler.enabled || !profiler.gpu || !f->depth ) {
+		return;
+	}
+	f->depth--;
+
+	if( f->depth < PROF_MAX_DEPTH && f->stack[ f->depth ] < PROF_GPU_RANGES ) {
+		glQueryCounter( f->stamps[ 2 * f->stack[ f->depth ] + 1 ], GL_TIMESTAMP );
+	}
+}
+
+/*! Reads the queries of a finished frame. Without wait nothing is read
+	until the last query is available, so the CPU never stalls on the GPU. */
+static int prof_gpu_resolve( Prof_Gpu_Frame *f, int wait ) {
+	GLuint available = 1;
+	GLuint64 t0, t1;
+	u32 i;
+
+	if( !wait ) {
+		glGetQueryObjectuiv( f->frame_stamps[ 1 ], GL_QUERY_RESULT_AVAILABLE,
+			&available );
+	}
+	if( !available ) {
+		return 0;
+	}
+	glGetQueryObjectui64v( f->frame_stamps[ 0 ], GL_QUERY_RESULT, &t0 );
+	glGetQueryObjectui64v( f->frame_stamps[ 1 ], GL_QUERY_RESULT, &t1 );
+
+	if( profiler.frame - f->frame < PROF_HISTORY ) {
+		profiler.history[ f->frame % PROF_HISTORY ].gpu_ms =
+			( float ) ( ( t1 - t0 ) / 1000000.0 );
+	}
+	for( i = 0; profiler.gpu_events && i < f->num_ranges; ++i ) {
+		if( profiler.num_gpu_events == PROF_MAX_EVENTS ) {
+			break;
+		}
+		Prof_Event *e = &profiler.gpu_events[ profiler.num_gpu_events++ ];
+		glGetQueryObjectui64v( f->stamps[ 2 * i ], GL_QUERY_RESULT, &t0 );
+		glGetQueryObjectui64v( f->stamps[ 2 * i + 1 ], GL_QUERY_RESULT, &t1 );
+		e->name = f->names[ i ];
+		e->start = f->cpu_start + ( ( s64 ) t0 - f->gpu_start ) / 1000.0;
+		e->duration = ( ( s64 ) t1 - ( s64 ) t0 ) / 1000.0;
+	}
+	f->pending = 0;
+	return 1;
+}
+
+/*! Starts a frame: reads back older frames that are done and opens the
+	frame marker and the frame timestamp query. */
+void prof_frame_begin( void ) {
+	u32 i;
+
+	if( !profiler.enabled ) {
+		return;
+	}
+	if( profiler.gpu ) {
+		Prof_Gpu_Frame *f;
+		GLint64 now;
+
+		for( i = 0; i < PROF_GPU_FRAMES; ++i ) { /* oldest first */
+			f = &profiler.gpu_frames[ ( profiler.frame + i ) % PROF_GPU_FRAMES ];
+			if( f->pending && !prof_gpu_resolve( f, 0 ) ) {
+				break;
+			}
+		}
+		f = &profiler.gpu_frames[ profiler.frame % PROF_GPU_FRAMES ];
+		f->pending = 0; /* still busy after PROF_GPU_FRAMES, dropped */
+		f->frame = profiler.frame;
+		f->num_ranges = f->depth = 0;
+		glGetInteger64v( GL_TIMESTAMP, &now );
+		f->gpu_start = now;
+		f->cpu_start = prof_now( );
+		glQueryCounter( f->frame_stamps[ 0 ], GL_TIMESTAMP );
+	}
+	profiler.frame_start = prof_now( );
+	prof_begin( "frame" );
+}
+
+void prof_frame_end( void ) {
+	if( !profiler.enabled ) {
+		return;
+	}
+	prof_end( );
+	profiler.history[ profiler.frame % PROF_HISTORY ] = ( Prof_Frame_Stat ) {
+		( float ) ( ( prof_now( ) - profiler.frame_start ) / 1000.0 ), -1.0f };
+
+	if( profiler.gpu ) {
+		Prof_Gpu_Frame *f =
+			&profiler.gpu_frames[ profiler.frame % PROF_GPU_FRAMES ];
+		glQueryCounter( f->frame_stamps[ 1 ], GL_TIMESTAMP );
+		f->pending = 1;
+	}
+	profiler.frame++;
+}
+
+static int prof_compare( const void *a, const void *b ) {
+	float x = *( const float * ) a, y = *( const float * ) b;
+	return ( x > y ) - ( x < y );
+}
+
+/*! p50, p95 and p99 of n samples, the samples get sorted. */
+void prof_percentiles( float *samples, u32 n, float out[ 3 ] ) {
+	const float p[ 3 ] = { 0.50f, 0.95f, 0.99f };
+	u32 i;
+
+	qsort( samples, n, sizeof( float ), prof_compare );
+
+	for( i = 0; i < 3; ++i ) {
+		out[ i ] = n ? samples[ ( u32 ) ( p[ i ] * ( n - 1 ) + 0.5f ) ] : 0.0f;
+	}
+}
+
+/*! Statistics of the CPU or GPU frame times in the ring. */
+void prof_stats( int gpu, Prof_Stats *out ) {
+	float samples[ PROF_HISTORY ], p[ 3 ], sum = 0.0f;
+	u32 i, n = 0;
+
+	for( i = 0; i < PROF_HISTORY; ++i ) {
+		const Prof_Frame_Stat *s = &profiler.history[ i ];
+		float v = gpu ? s->gpu_ms : s->cpu_ms;
+		if( v >= 0.0f ) {
+			samples[ n++ ] = v;
+			sum += v;
+		}
+	}
+	prof_percentiles( samples, n, p );
+	out->frames = n;
+	out->p50 = p[ 0 ];
+	out->p95 = p[ 1 ];
+	out->p99 = p[ 2 ];
+	out->mean = n ? sum / n : 0.0f;
+	out->min = n ? samples[ 0 ] : 0.0f;
+	out->max = n ? samples[ n - 1 ] : 0.0f;
+}
+
+/*! Prints the percentiles of the frames in the statistics ring. */
+void prof_summary( FILE *out ) {
+	Prof_Stats cpu, gpu;
+
+	prof_stats( 0, &cpu );
+	prof_stats( 1, &gpu );
+	fprintf( out, "cpu ms: p50 %.3f p95 %.3f p99 %.3f (%u frames)\n",
+		cpu.p50, cpu.p95, cpu.p99, cpu.frames );
+	fprintf( out, "gpu ms: p50 %.3f p95 %.3f p99 %.3f (%u frames)\n",
+		gpu.p50, gpu.p95, gpu.p99, gpu.frames );
+}
+
+static void prof_write_events( FILE *fh, const Prof_Event *events, u32 n,
+	int pid, u32 tid, int *first )
+{
+	u32 i;
+
+	for( i = 0; i < n; ++i ) {
+		fprintf( fh, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+			"\"ts\":%.3f,\"dur\":%.3f}", *first ? "" : ",", events[ i ].name,
+			pid, tid, events[ i ].start, events[ i ].duration );
+		*first = 0;
+	}
+}
+
+/*! Writes the CPU markers of every thread and the GPU markers as Chrome
+	trace JSON (chrome://tracing, Perfetto). The GPU timestamps are moved
+	onto the CPU clock with the pair sampled at every frame start. */
+int prof_write_trace( const char *file ) {
+	FILE *fh = fopen( file, "w" );
+	int first = 1;
+	u32 i;
+
+	if( !fh ) {
+		fprintf( stderr, "Could not write file %s\n", file );
+		return -1;
+	}
+	fprintf( fh, "{\"traceEvents\":[" );
+	fprintf( fh, "\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,"
+		"\"args\":{\"name\":\"CPU\"}},"
+		"\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":2,"
+		"\"args\":{\"name\":\"GPU\"}}" );
+	first = 0;
+
+	for( i = 0; i < profiler.num_threads; ++i ) {
+		const Prof_Thread *t = &profiler.threads[ i ];
+		prof_write_events( fh, t->events, t->num_events, 1, t->id, &first );
+	}
+	prof_write_events( fh, profiler.gpu_events, profiler.num_gpu_events, 2, 0,
+		&first );
+	fprintf( fh, "\n]}\n" );
+	fclose( fh );
+	return 0;
+}
+
+/*! Waits for the frames still in flight, the GPU must be idle. */
+void prof_shutdown( void ) {
+	u32 i;
+
+	if( !profiler.enabled ) {
+		return;
+	}
+	for( i = 0; profiler.gpu && i < PROF_GPU_FRAMES; ++i ) {
+		Prof_Gpu_Frame *f =
+			&profiler.gpu_frames[ ( profiler.frame + i ) % PROF_GPU_FRAMES ];
+		if( f->pending ) {
+			prof_gpu_resolve( f, 1 );
+		}
+	}
+}
+
+void prof_free( void ) {
+	u32 i;
+
+	for( i = 0; i < profiler.num_threads; ++i ) {
+		free( profiler.threads[ i ].events );
+	}
+	for( i = 0; profiler.gpu && i < PROF_GPU_FRAMES; ++i ) {
+		Prof_Gpu_Frame *f = &profiler.gpu_frames[ i ];
+		glDeleteQueries( 2, f->frame_stamps );
+		glDeleteQueries( 2 * PROF_GPU_RANGES, f->stamps );
+	}
+	free( profiler.gpu_events );
+
+	if( profiler.enabled ) {
+		pthread_mutex_destroy( &profiler.lock );
+	}
+	memset( &profiler, 0, sizeof( Profiler ) );
+}
@@ -0,0 +1,76 @@
+#ifndef CTOOL_PROFILER
+#define CTOOL_PROFILER
+
+#include <pthread.h>
+#include "types.h"
+
+#define PROF_MAX_THREADS	(17U)		/* Main thread plus the workers. */
+#define PROF_MAX_DEPTH		(32U)		/* Nesting of markers per thread. */
+#define PROF_MAX_EVENTS		(1U << 16)	/* Trace events kept per thread. */
+#define PROF_GPU_FRAMES		(4U)		/* Frames in flight before readback. */
+#define PROF_GPU_RANGES		(32U)		/* GPU markers per frame. */
+#define PROF_HISTORY		(1024U)		/* Frames in the statistics ring. */
+
+typedef struct { /*! Complete event, "ph": "X" in the trace. */
+	const char *name;
+	double start;			/*! Microseconds. */
+	double duration;
+} Prof_Event;
+
+typedef struct { /*! Markers of one thread, only that thread writes. */
+	u32 id;
+	u32 depth;
+	const char *names[ PROF_MAX_DEPTH ];
+	double starts[ PROF_MAX_DEPTH ];
+	u32 num_events;
+	Prof_Event *events;
+} Prof_Thread;
+
+typedef struct { /*! Timer queries of one frame, read back frames later. */
+	u32 frame_stamps[ 2 ];	/*! GL_TIMESTAMP at frame begin and end. */
+	u32 stamps[ 2 * PROF_GPU_RANGES ];	/*! GL_TIMESTAMP begin and end. */
+	const char *names[ PROF_GPU_RANGES ];
+	u32 num_ranges;
+	u32 stack[ PROF_MAX_DEPTH ];
+	u32 depth;
+	u32 frame;
+	double cpu_start;		/*! CPU time when gpu_start was sampled. */
+	s64 gpu_start;			/*! GL_TIMESTAMP in nanoseconds. */
+	int pending;
+} Prof_Gpu_Frame;
+
+typedef struct {
+	float cpu_ms;
+	float gpu_ms;			/*! < 0 until the timer queries are read. */
+} Prof_Frame_Stat;
+
+typedef struct { /*! Summary of the frames in the statistics ring. */
+	u32 frames;
+	float p50, p95, p99;
+	float mean, min, max;
+} Prof_Stats;
+
+typedef struct {
+	int enabled;
+	int trace;				/*! Keep events for prof_write_trace. */
+	int gpu;				/*! Timer queries available. */
+	pthread_mutex_t lock;	/*! Guards the thread registration. */
+	u32 num_threads;
+	Prof_Thread threads[ PROF_MAX_THREADS ];
+	double frame_start;
+	u32 frame;
+	Prof_Gpu_Frame gpu_frames[ PROF_GPU_FRAMES ];
+	u32 num_gpu_events;
+	Prof_Event *gpu_events;
+	Prof_Frame_Stat history[ PROF_HISTORY ];
+} Profiler;
+
+#define PROF_CONCAT2(a, b) a##b
+#define PROF_CONCAT(a, b) PROF_CONCAT2(a, b)
+
+/*! Marker that ends with the enclosing block. */
+#define PROF_SCOPE(name) \
+	int PROF_CONCAT(prof_scope_, __LINE__) \
+		__attribute__((cleanup(prof_scope_end))) = prof_begin( name )
+
+#endif /* CTOOL_PROFILER */
@@ -0,0 +1,211 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "reload.h"
+
+#define RELOAD_EVENTS	( IN_CLOSE_WRITE | IN_MOVED_TO )
+
+int reload_init( Reload *r ) {
+	memset( r, 0, sizeof( Reload ) );
+	r->shader_dir = -1;
+	r->fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+
+	if( r->fd < 0 ) {
+		fprintf( stderr, "Could not start inotify: %s\n", strerror( errno ) );
+		return -1;
+	}
+	return 0;
+}
+
+/*! Watch descriptor of a directory, inotify returns the same one for a
+	directory watched before. */
+static s32 reload_add_dir( Reload *r, const char *dir ) {
+	s32 wd = inotify_add_watch( r->fd, dir, RELOAD_EVENTS );
+
+	if( wd < 0 ) {
+		fprintf( stderr, "Could not watch %s: %s\n", dir, strerror( errno ) );
+	}
+	return wd;
+}
+
+/*! Reads path again when it changes, kind and index tell the caller of
+	reload_next where its data goes. */
+int reload_watch( Reload *r, const char *path, u32 kind, u32 index ) {
+	const char *slash = strrchr( path, '/' );
+	char dir[ RELOAD_PATH ];
+	Reload_File *f;
+
+	if( r->num_files == RELOAD_MAX_FILES || strlen( path ) >= RELOAD_PATH ) {
+		fprintf( stderr, "Could not watch %s, too many files.\n", path );
+		return -1;
+	}
+	f = &r->files[ r->num_files ];
+	memset( f, 0, sizeof( Reload_File ) );
+	snprintf( f->path, RELOAD_PATH, "%s", path );
+	snprintf( dir, RELOAD_PATH, "%.*s", slash ? ( int ) ( slash - path ) : 1,
+		slash ? path : "." );
+	f->name = slash ? f->path + ( slash - path ) + 1 : f->path;
+	f->kind = kind;
+	f->index = index;
+	f->dir = reload_add_dir( r, dir );
+
+	if( f->dir < 0 ) {
+		return -1;
+	}
+	r->num_files++;
+	return 0;
+}
+
+/*! Any file written in dir sets off reload_shaders. */
+int reload_watch_shaders( Reload *r, const char *dir ) {
+	r->shader_dir = reload_add_dir( r, dir );
+	return ( r->shader_dir < 0 ) ? -1 : 0;
+}
+
+/*! Job reading a changed file, everything up to the GL upload. */
+static void reload_load( void *arg ) {
+	Reload_File *f = arg;
+
+	if( RELOAD_MESH == f->kind ) {
+		read_mob( f->path, &f->v_size, &f->v_data, &f->i_size, &f->i_data,
+			&f->skinned, &f->layout, &f->meshlets, &f->num_meshlets );
+		f->result = ( f->v_data && f->i_data ) ? 0 : -1;
+	} else {
+		f->result = load_ktx_image( f->path, &f->image );
+	}
+}
+
+/*! Marks the files called name in the directory of wd as changed. */
+static void reload_mark( Reload *r, s32 wd, const char *name ) {
+	u32 i;
+
+	if( wd == r->shader_dir ) {
+		r->shaders_changed = 1;
+	}
+	for( i = 0; i < r->num_files; ++i ) {
+		Reload_File *f = &r->files[ i ];
+
+		if( f->dir != wd || strcmp( f->name, name ) ) {
+			continue;
+		}
+		if( RELOAD_IDLE == f->state ) {
+			f->state = RELOAD_CHANGED;
+		} else if( RELOAD_CHANGED != f->state ) {
+			f->again = 1;
+		}
+	}
+}
+
+/*! Reads the pending events without blocking and starts a job for each
+	changed file. Once all jobs finished their files are handed out by
+	reload_next. */
+void reload_poll( Reload *r, Job_System *js ) {
+	char buffer[ 4096 ]
+		__attribute__ ( ( aligned( __alignof__( struct inotify_event ) ) ) );
+	const struct inotify_event *e;
+	ssize_t len;
+	u32 i;
+
+	while( ( len = read( r->fd, buffer, sizeof( buffer ) ) ) > 0 ) {
+		for( i = 0; i < ( u32 ) len; i += sizeof( *e ) + e->len ) {
+			e = ( const struct inotify_event * ) ( buffer + i );
+			reload_mark( r, e->wd, e->len ? e->name : "" );
+		}
+	}
+	for( i = 0; i < r->num_files; ++i ) {
+		Reload_File *f = &r->files[ i ];
+
+		if( RELOAD_CHANGED == f->state ) {
+			f->state = RELOAD_LOADING;
+			jobs_submit( js, &r->counter, reload_load, f );
+		}
+	}
+	if( !jobs_pending( js, &r->counter ) ) { /* the jobs are done writing */
+		for( i = 0; i < r->num_files; ++i ) {
+			if( RELOAD_LOADING == r->files[ i ].state ) {
+				r->files[ i ].state = RELOAD_LOADED;
+			}
+		}
+	}
+}
+
+/*! Next file read again, 0 if none. Its data stays valid until
+	reload_release. */
+Reload_File *reload_next( Reload *r ) {
+	u32 i;
+
+	for( i = 0; i < r->num_files; ++i ) {
+		if( RELOAD_LOADED == r->files[ i ].state ) {
+			return &r->files[ i ];
+		}
+	}
+	return 0;
+}
+
+/*! Frees the data of f, result is whether the caller could use it. A file
+	written again while it was loading gets read once more. */
+void reload_release( Reload *r, Reload_File *f, int result ) {
+	if( result < 0 ) {
+		r->failures++;
+	} else if( RELOAD_MESH == f->kind ) {
+		r->meshes++;
+	} else {
+		r->textures++;
+	}
+	free( f->v_data );
+	free( f->i_data );
+	free( f->meshlets );
+	free( f->image.pixels );
+	f->v_data = 0;
+	f->i_data = 0;
+	f->meshlets = 0;
+	memset( &f->image, 0, sizeof( Image ) );
+	f->state = f->again ? RELOAD_CHANGED : RELOAD_IDLE;
+	f->again = 0;
+}
+
+/*! 1 while files are read, reload_poll has to be called again even if no
+	event arrives. */
+int reload_busy( const Reload *r ) {
+	u32 i;
+
+	for( i = 0; i < r->num_files; ++i ) {
+		if( RELOAD_IDLE != r->files[ i ].state ) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*! 1 once after the shader directory changed. */
+int reload_shaders( Reload *r ) {
+	int changed = r->shaders_changed;
+	r->shaders_changed = 0;
+	return changed;
+}
+
+void reload_summary( const Reload *r, FILE *out ) {
+	fprintf( out, "hot reload: %u meshes, %u textures, %u shader rebuilds, "
+		"%u failed\n", r->meshes, r->textures, r->shaders, r->failures );
+}
+
+/*! Waits for the running jobs, call before jobs_shutdown. */
+void reload_free( Reload *r, Job_System *js ) {
+	u32 i;
+
+	if( r->fd > 0 ) {
+		jobs_wait( js, &r->counter );
+		close( r->fd );
+	}
+	for( i = 0; i < r->num_files; ++i ) {
+		free( r->files[ i ].v_data );
+		free( r->files[ i ].i_data );
+		free( r->files[ i ].meshlets );
+		free( r->files[ i ].image.pixels );
+	}
+	memset( r, 0, sizeof( Reload ) );
+	r->fd = -1;
+}
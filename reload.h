@@ -0,0 +1,55 @@
+#ifndef CTOOL_RELOAD
+#define CTOOL_RELOAD
+
+#include "types.h"
+#include "assets.h"
+#include "jobs.h"
+
+#define RELOAD_MAX_FILES	(64U)
+#define RELOAD_PATH			(256U)
+
+enum { /* what a watched file holds */
+	RELOAD_MESH,			/*! Mob file, index is the mesh of the batch. */
+	RELOAD_TEXTURE,			/*! Ktx file, index is the texture handle. */
+	RELOAD_SHADER			/*! Any file of the shader directory. */
+};
+
+enum { /* state of a watched file */
+	RELOAD_IDLE,
+	RELOAD_CHANGED,			/*! Written, not loaded yet. */
+	RELOAD_LOADING,			/*! Job reading it on a worker. */
+	RELOAD_LOADED			/*! Waits for reload_next on the main thread. */
+};
+
+typedef struct { /*! A file loaded at startup and where its data went. */
+	char path[ RELOAD_PATH ];
+	const char *name;		/*! Inside path, after the directory. */
+	s32 dir;				/*! Watch descriptor of the directory. */
+	u32 kind;
+	u32 index;
+	u32 state;
+	int again;				/*! Written again while loading. */
+	int result;				/*! Of the load, -1 keeps the old data. */
+	u32 v_size, i_size;		/*! read_mob */
+	int layout, skinned;
+	float *v_data;
+	u32 *i_data;
+	MOB_Meshlet *meshlets;
+	u32 num_meshlets;
+	Image image;			/*! load_ktx_image, mip-maps built on the job. */
+} Reload_File;
+
+typedef struct { /*! Watches the directories of the assets with inotify.
+	Files written or moved into place are read again by jobs on the worker
+	threads, the main thread only copies the results into the existing GL
+	objects. Writes to the shader directory rebuild all programs. */
+	int fd;					/*! inotify, non-blocking, -1 if not watching. */
+	s32 shader_dir;			/*! Watch descriptor, -1 without. */
+	int shaders_changed;
+	Reload_File files[ RELOAD_MAX_FILES ];
+	u32 num_files;
+	Job_Counter counter;
+	u32 meshes, textures, shaders, failures;
+} Reload;
+
+#endif /* CTOOL_RELOAD */
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scene.h"
+
+#define SCENE_MAGIC		"# opengl-test scene v1"
+
+/*! Returns the element n of an array, grown by doubling, or 0. */
+static void *scene_grow( void **data, u32 *max, u32 n, size_t size ) {
+	if( n >= *max ) {
+		u32 m = *max ? 2 * *max : 16;
+		void *tmp = realloc( *data, m * size );
+		if( !tmp ) {
+			return 0;
+		}
+		*data = tmp;
+		*max = m;
+	}
+	return ( u8 * ) *data + n * size;
+}
+
+void scene_free( Scene *s ) {
+	free( s->meshes );
+	free( s->textures );
+	pool_free( &s->objects );
+	free( s->lights );
+	memset( s, 0, sizeof( Scene ) );
+}
+
+/*! Reads a scene description:
+
+		mesh <file>
+		texture <file>
+		object <mesh> <texture> <x y z> <heading attitude bank> <scale> <occluder>
+		light <x y z> <r g b> <attenuation>
+
+	Files are relative to the scene file, lines starting with # are
+	comments. */
+int scene_load( Scene *s, const char *file ) {
+	FILE *fh = fopen( file, "r" );
+	const char *slash = strrchr( file, '/' );
+	int dir_len = slash ? ( int ) ( slash - file + 1 ) : 0;
+	char line[ 512 ], name[ SCENE_PATH ];
+	u32 line_number = 1, num_objects = 0;
+
+	memset( s, 0, sizeof( Scene ) );
+
+	if( !fh ) {
+		fprintf( stderr, "Could not read file %s\n", file );
+		return -1;
+	}
+	if( !fgets( line, sizeof( line ), fh )
+		|| 0 != strncmp( line, SCENE_MAGIC, strlen( SCENE_MAGIC ) ) )
+	{
+		fprintf( stderr, "%s is no scene file.\n", file );
+		fclose( fh );
+		return -1;
+	}
+	long body = ftell( fh );
+
+	while( fgets( line, sizeof( line ), fh ) ) { /* size of the pool */
+		num_objects += ( 0 == strncmp( line, "object ", 7 ) );
+	}
+	if( pool_init( &s->objects, sizeof( Scene_Object ), num_objects,
+		"scene object" ) < 0 )
+	{
+		fclose( fh );
+		return -1;
+	}
+	fseek( fh, body, SEEK_SET );
+
+	while( fgets( line, sizeof( line ), fh ) ) {
+		int ok = 1;
+		++line_number;
+
+		if( 0 == strncmp( line, "object ", 7 ) ) {
+			Scene_Object *o = pool_alloc( &s->objects );
+			ok = o && 10 == sscanf( line + 7, "%u %u %f %f %f %f %f %f %f %u",
+				&o->mesh, &o->texture, &o->position.x, &o->position.y,
+				&o->position.z, &o->angles.x, &o->angles.y, &o->angles.z,
+				&o->scale, &o->occluder );
+			ok = ok && o->mesh < s->num_meshes
+				&& ( o->texture < s->num_textures || !s->num_textures );
+		} else if( 0 == strncmp( line, "light ", 6 ) ) {
+			Light *l = scene_grow( ( void ** ) &s->lights, &s->max_lights,
+				s->num_lights, sizeof( Light ) );
+			ok = l && 7 == sscanf( line + 6, "%f %f %f %f %f %f %f",
+				&l->position.x, &l->position.y, &l->position.z,
+				&l->intensities.x, &l->intensities.y, &l->intensities.z,
+				&l->intensities.w );
+			if( ok ) {
+				l->position.w = 1.0f;
+				l->ambient_coefficient = 0.0f;
+				++s->num_lights;
+			}
+		} else if( 0 == strncmp( line, "mesh ", 5 )
+			|| 0 == strncmp( line, "texture ", 8 ) )
+		{
+			int mesh = ( 'm' == line[ 0 ] );
+			char ( *path )[ SCENE_PATH ] = mesh ?
+				scene_grow( ( void ** ) &s->meshes, &s->max_meshes,
+					s->num_meshes, SCENE_PATH ) :
+				scene_grow( ( void ** ) &s->textures, &s->max_textures,
+					s->num_textures, SCENE_PATH );
+			ok = path && 1 == sscanf( line + ( mesh ? 5 : 8 ), "%255s", name )
+				&& dir_len + strlen( name ) < SCENE_PATH;
+			if( ok ) {
+				memcpy( *path, file, dir_len );
+				memcpy( *path + dir_len, name, strlen( name ) + 1 );
+				if( mesh ) {
+					++s->num_meshes;
+				} else {
+					++s->num_textures;
+				}
+			}
+		} else if( '#' != line[ 0 ] && '\n' != line[ 0 ] ) {
+			ok = 0;
+		}
+		if( !ok ) {
+			fprintf( stderr, "%s:%u: invalid line.\n", file, line_number );
+			fclose( fh );
+			scene_free( s );
+			return -1;
+		}
+	}
+	fclose( fh );
+	return 0;
+}
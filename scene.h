@@ -0,0 +1,30 @@
+#ifndef CTOOL_SCENE
+#define CTOOL_SCENE
+
+#include "types.h"
+#include "3d.h"
+#include "arena.h"
+
+#define SCENE_PATH		(256U)
+
+typedef struct { /*! One draw of a mesh, see tools/gen_scene.c. */
+	u32 mesh;
+	u32 texture;
+	Vector_3d position;
+	Vector_3d angles;		/*! Heading, attitude, bank in radians. */
+	float scale;
+	u32 occluder;			/*! Rasterized by the software occlusion pass. */
+} Scene_Object;
+
+typedef struct { /*! Contents of a scene file, the paths relative to the
+	working directory. */
+	u32 num_meshes, max_meshes;
+	u32 num_textures, max_textures;
+	u32 num_lights, max_lights;
+	char ( *meshes )[ SCENE_PATH ];
+	char ( *textures )[ SCENE_PATH ];
+	Pool objects;			/*! Scene_Object, the first count in file order. */
+	Light *lights;			/*! Point lights, attenuation in .a. */
+} Scene;
+
+#endif /* CTOOL_SCENE */
@@ -1,18 +1,29 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "types.h"
 #include "shading.h"
+#include "handles.h"
 
-static Shader programs[ PROGRAM_MAX ];
+static Handle_Table programs = { "program", sizeof( Shader ) };
+static Handle builtin_programs[ PROGRAM_MAX ]; /* Created by init_shaders. */
+static const char *shader_dir = 0; /* --shader-dir, sources to edit. */
+static char *shader_files[ 32 ]; /* Read from shader_dir while building. */
+static u32 num_shader_files;
 
 static const char *uniforms[ ] = {
 	"ambient_coeff",
 	"atlas",
+	"cluster_scale",
 	"color_bg",
 	"color_fg",
+	"eye",
+	"count",
 	"flags",
 	"intensities",
 	"location",
 	"model",
+	"planes",
 	"projection",
 	"radius",
 	"scale",
@@ -20,11 +31,14 @@ static const char *uniforms[ ] = {
 	"texture1",
 	"texture2",
 	"translation",
-	"view"
+	"view",
+	"vt_cache",
+	"vt_params"
 };
 
+/* inverse() needs GLSL 1.40, stricter drivers (Mesa) reject it in 1.30. */
 const char model_vertex_shader[ ] =
-"#version 130\n"
+"#version 140\n"
 "in vec3 vertex;"
 "in vec3 normal;"
 "in vec2 uv;"
@@ -32,23 +46,64 @@ const char model_vertex_shader[ ] =
 "out vec3 to_camera;"
 "out vec3 to_light;"
 "out vec3 n_surface;"
+"out vec3 position;"
+"out float view_depth;"
 "uniform vec2 atlas;"
 "uniform mat4 model;"
 "uniform mat4 view;"
 "uniform mat4 projection;"
 "uniform vec3 location;"
 "uniform vec4 intensities;"
+"invariant gl_Position;"
 "void main( void ) {"
 "vec4 world_pos = model * vec4( vertex, 1.0 );"
 "gl_Position = projection * view * world_pos;"
 "to_light = location.xyz - world_pos.xyz;"
 "to_camera = ( inverse( view ) * vec4( 0, 0, 0, 1 ) ).xyz -world_pos.xyz;"
 "n_surface = ( model * vec4( normal, 0 ) ).xyz;"
+"position = world_pos.xyz;"
+"view_depth = -( view * world_pos ).z;"
 "coords = uv;"
 //"coords = uv / atlas.x + atlas.y;"
 "}"
 ;
 
+/* Same as model_vertex_shader, the model matrix comes from the draw data
+	of a batch. Every meshlet has its own command, their base instance
+	selects the draw. */
+const char model_mdi_vertex_shader[ ] =
+"#version 430\n"
+"#extension GL_ARB_shader_draw_parameters : require\n"
+"layout( location = 0 ) in vec3 vertex;"
+"layout( location = 1 ) in vec3 normal;"
+"layout( location = 2 ) in vec2 uv;"
+"out vec2 coords;"
+"out vec3 to_camera;"
+"out vec3 to_light;"
+"out vec3 n_surface;"
+"out vec3 position;"
+"out float view_depth;"
+"struct Draw_Data { mat4 model; };"
+"layout( std430, binding = 0 ) readonly buffer draw_data {"
+"Draw_Data draws[ ];"
+"};"
+"uniform mat4 view;"
+"uniform mat4 projection;"
+"uniform vec3 location;"
+"invariant gl_Position;"
+"void main( void ) {"
+"mat4 model = draws[ gl_BaseInstanceARB ].model;"
+"vec4 world_pos = model * vec4( vertex, 1.0 );"
+"gl_Position = projection * view * world_pos;"
+"to_light = location.xyz - world_pos.xyz;"
+"to_camera = ( inverse( view ) * vec4( 0, 0, 0, 1 ) ).xyz -world_pos.xyz;"
+"n_surface = ( model * vec4( normal, 0 ) ).xyz;"
+"position = world_pos.xyz;"
+"view_depth = -( view * world_pos ).z;"
+"coords = uv;"
+"}"
+;
+
 const char model_fragment_shader[ ] =
 "#version 130\n"
 "in vec2 coords;"
@@ -89,6 +144,292 @@ const char model_fragment_shader[ ] =
 "}"
 ;
 
+/* Virtual texture lookups, see virtual_texture.h. scale is the part of the
+	virtual texture covered by the image, vt_params holds its texels and
+	pages per side, the last level and the level of detail bias. The level
+	comes from the unclamped coords, the quads on the edges of the image
+	would get no derivatives. */
+#define VT_SHADER_COMMON \
+"uniform vec2 scale;" \
+"uniform vec4 vt_params;" \
+"vec2 vt_coords( void ) {" \
+"return clamp( coords, 0.0, 1.0 ) * scale;" \
+"}" \
+"float vt_level( void ) {" \
+"vec2 t = coords * scale * vt_params.x;" \
+"vec2 dx = dFdx( t ), dy = dFdy( t );" \
+"float d = max( dot( dx, dx ), dot( dy, dy ) );" \
+"return clamp( floor( 0.5 * log2( d ) + vt_params.w ), 0.0, vt_params.z );" \
+"}" \
+"ivec2 vt_page( vec2 v, float level ) {" \
+"ivec2 p = min( ivec2( v * vt_params.y ), ivec2( vt_params.y ) - 1 );" \
+"return p >> int( level );" \
+"}"
+
+/* Same as model_fragment_shader, texture0 is the page cache and texture1
+	the indirection. vt_cache holds the size of a slot and the border and
+	payload of a page in it, relative to the cache. */
+const char vt_fragment_shader[ ] =
+"#version 130\n"
+"in vec2 coords;"
+"in vec3 to_camera;"
+"in vec3 to_light;"
+"in vec3 n_surface;"
+"out vec4 pixel_color;"
+"uniform sampler2D texture0;"
+"uniform sampler2D texture1;"
+"uniform vec4 vt_cache;"
+"uniform vec4 intensities;"
+"uniform float ambient_coeff;"
+VT_SHADER_COMMON
+"vec4 vt_texture( void ) {"
+"vec2 v = vt_coords( );"
+"float level = vt_level( );"
+"vec4 e = floor( texelFetch( texture1, vt_page( v, level ), int( level ) )"
+" * 255.0 + 0.5 );"
+"vec2 in_page = fract( v * vt_params.y / exp2( e.z ) );"
+"vec2 uv = ( e.xy + vt_cache.z + in_page * vt_cache.w ) * vt_cache.xy;"
+"return textureLod( texture0, uv, 0.0 );"
+"}"
+"void main( void ) {"
+"vec3 unit_sn = normalize( n_surface );"
+"vec3 unit_lv = normalize( to_light );"
+"vec3 unit_cv = normalize( to_camera );"
+"float dist = length( to_light );"
+"float af = 1.0 / ( 1.0 + intensities.a * pow( dist, 2.0 ) );"
+"float dp = dot( unit_sn, unit_lv );"
+"float bright = max( 0.0, dp );"
+"vec4 sample = vt_texture( );"
+"vec3 color = sample.rgb * intensities.rgb;"
+"vec3 diffuse = bright * color;"
+"float damp = 0.0;"
+"if( dp > 0.0 ) {"
+"vec3 refl = reflect( -unit_lv, unit_sn );"
+"float spec = max( 0.0, dot( refl, unit_cv ) );"
+"int shini = 1;"
+"damp = pow( spec, shini );"
+"}"
+"vec3 specular = damp * color;"
+"vec3 ambient = ambient_coeff * color;"
+"vec3 tmp = ambient + af * ( diffuse + specular );"
+"pixel_color = vec4( tmp, sample.a );"
+"}"
+;
+
+/* Writes the page every pixel of vt_fragment_shader needs, read back by
+	vt_update. Alpha 0 marks the pixels without geometry. */
+const char vt_feedback_fragment_shader[ ] =
+"#version 130\n"
+"in vec2 coords;"
+"out uvec4 feedback;"
+VT_SHADER_COMMON
+"void main( void ) {"
+"vec2 v = vt_coords( );"
+"float level = vt_level( );"
+"feedback = uvec4( uvec2( vt_page( v, level ) ), uint( level ), 1u );"
+"}"
+;
+
+/* Same as model_fragment_shader plus the point lights of the froxel that
+	holds the pixel. Grid size and bindings as in clusters.h. */
+const char clustered_fragment_shader[ ] =
+"#version 430\n"
+"in vec2 coords;"
+"in vec3 to_camera;"
+"in vec3 to_light;"
+"in vec3 n_surface;"
+"in vec3 position;"
+"in float view_depth;"
+"out vec4 pixel_color;"
+"struct Point_Light { vec4 position; vec4 intensities; };"
+"layout( std430, binding = 4 ) readonly buffer cluster_lights {"
+"Point_Light lights[ ];"
+"};"
+"layout( std430, binding = 5 ) readonly buffer cluster_grid {"
+"uvec2 grid[ ];"
+"};"
+"layout( std430, binding = 6 ) readonly buffer cluster_indices {"
+"uint indices[ ];"
+"};"
+"const uvec3 dims = uvec3( 16, 9, 24 );"
+"uniform sampler2D texture0;"
+"uniform vec4 intensities;"
+"uniform float ambient_coeff;"
+"uniform vec4 cluster_scale;"
+"vec3 shade( vec3 color, vec3 unit_sn, vec3 unit_cv, vec3 unit_lv ) {"
+"float dp = dot( unit_sn, unit_lv );"
+"vec3 diffuse = max( 0.0, dp ) * color;"
+"float damp = 0.0;"
+"if( dp > 0.0 ) {"
+"vec3 refl = reflect( -unit_lv, unit_sn );"
+"float spec = max( 0.0, dot( refl, unit_cv ) );"
+"int shini = 1;"
+"damp = pow( spec, shini );"
+"}"
+"return diffuse + damp * color;"
+"}"
+"void main( void ) {"
+"vec3 unit_sn = normalize( n_surface );"
+"vec3 unit_cv = normalize( to_camera );"
+"float dist = length( to_light );"
+"float af = 1.0 / ( 1.0 + intensities.a * pow( dist, 2.0 ) );"
+"vec4 texel = texture( texture0, coords );"
+"vec3 color = texel.rgb * intensities.rgb;"
+"vec3 tmp = ambient_coeff * color"
+" + af * shade( color, unit_sn, unit_cv, normalize( to_light ) );"
+"vec3 f = vec3( gl_FragCoord.xy * cluster_scale.xy,"
+" log( max( view_depth, 1e-4 ) ) * cluster_scale.z + cluster_scale.w );"
+"uvec3 c = uvec3( clamp( ivec3( f ), ivec3( 0 ), ivec3( dims ) - 1 ) );"
+"uvec2 range = grid[ c.x + dims.x * ( c.y + dims.y * c.z ) ];"
+"for( uint i = range.x; i < range.x + range.y; ++i ) {"
+"Point_Light l = lights[ indices[ i ] ];"
+"vec3 lv = l.position.xyz - position;"
+"float d = length( lv );"
+"float w = clamp( 1.0 - pow( d / l.position.w, 4.0 ), 0.0, 1.0 );"
+"float a = w * w / ( 1.0 + l.intensities.a * d * d );"
+"tmp += a * shade( texel.rgb * l.intensities.rgb, unit_sn, unit_cv,"
+" lv / max( d, 1e-4 ) );"
+"}"
+"pixel_color = vec4( tmp, texel.a );"
+"}"
+;
+
+/* Depth pre-pass, only the position stream is read. gl_Position must be
+	computed exactly like in the model shaders for the GL_LEQUAL test of the
+	lit pass. */
+const char depth_vertex_shader[ ] =
+"#version 130\n"
+"in vec3 vertex;"
+"uniform mat4 model;"
+"uniform mat4 view;"
+"uniform mat4 projection;"
+"invariant gl_Position;"
+"void main( void ) {"
+"vec4 world_pos = model * vec4( vertex, 1.0 );"
+"gl_Position = projection * view * world_pos;"
+"}"
+;
+
+const char depth_mdi_vertex_shader[ ] =
+"#version 430\n"
+"#extension GL_ARB_shader_draw_parameters : require\n"
+"layout( location = 0 ) in vec3 vertex;"
+"struct Draw_Data { mat4 model; };"
+"layout( std430, binding = 0 ) readonly buffer draw_data {"
+"Draw_Data draws[ ];"
+"};"
+"uniform mat4 view;"
+"uniform mat4 projection;"
+"invariant gl_Position;"
+"void main( void ) {"
+"mat4 model = draws[ gl_BaseInstanceARB ].model;"
+"vec4 world_pos = model * vec4( vertex, 1.0 );"
+"gl_Position = projection * view * world_pos;"
+"}"
+;
+
+const char depth_fragment_shader[ ] =
+"#version 130\n"
+"void main( void ) {"
+"}"
+;
+
+/* Box around a bounding sphere for occlusion queries, nothing is written. */
+const char bbox_vertex_shader[ ] =
+"#version 130\n"
+"in vec3 vertex;"
+"uniform mat4 view;"
+"uniform mat4 projection;"
+"uniform vec3 translation;"
+"uniform float radius;"
+"void main( void ) {"
+"gl_Position = projection * view * vec4( vertex * radius + translation, 1.0 );"
+"}"
+;
+
+const char bbox_fragment_shader[ ] =
+"#version 130\n"
+"out vec4 pixel_color;"
+"void main( void ) {"
+"pixel_color = vec4( 1.0 );"
+"}"
+;
+
+/* Frustum test of the draw bounds of a batch and of the bounds of each
+	meshlet, writes the instance count of every indirect draw command.
+	Draws flagged DRAW_OCCLUDED are dropped, with eye.w = 1 also meshlets
+	whose normal cone faces away from the eye. Same as cull_commands. */
+const char cull_compute_shader[ ] =
+"#version 430\n"
+"layout( local_size_x = 64 ) in;"
+"struct Command {"
+"uint count;"
+"uint instance_count;"
+"uint first_index;"
+"int base_vertex;"
+"uint base_instance;"
+"};"
+"struct Meshlet {"
+"vec4 bounds;"
+"vec4 cone;"
+"uint first_index;"
+"uint index_count;"
+"};"
+"layout( std430, binding = 0 ) readonly buffer draw_data {"
+"mat4 models[ ];"
+"};"
+"layout( std430, binding = 1 ) readonly buffer draw_bounds {"
+"vec4 bounds[ ];"
+"};"
+"layout( std430, binding = 2 ) buffer draw_commands {"
+"Command commands[ ];"
+"};"
+"layout( std430, binding = 3 ) readonly buffer draw_flags {"
+"uint flags[ ];"
+"};"
+"layout( std430, binding = 7 ) readonly buffer meshlet_data {"
+"Meshlet meshlets[ ];"
+"};"
+"layout( std430, binding = 8 ) readonly buffer command_meshlets {"
+"uint cmd_meshlets[ ];"
+"};"
+"uniform uint count;"
+"uniform vec4 planes[ 6 ];"
+"uniform vec4 eye;"
+"bool outside( vec4 s ) {"
+"for( int p = 0; p < 6; ++p ) {"
+"if( dot( planes[ p ].xyz, s.xyz ) + planes[ p ].w < -s.w ) {"
+"return true;"
+"}"
+"}"
+"return false;"
+"}"
+"void main( void ) {"
+"uint i = gl_GlobalInvocationID.x;"
+"if( i >= count ) {"
+"return;"
+"}"
+"uint d = commands[ i ].base_instance;"
+"Meshlet m = meshlets[ cmd_meshlets[ i ] ];"
+"mat4 model = models[ d ];"
+"float scale = max( length( model[ 0 ].xyz ),"
+"max( length( model[ 1 ].xyz ), length( model[ 2 ].xyz ) ) );"
+"vec4 s = vec4( ( model * vec4( m.bounds.xyz, 1.0 ) ).xyz,"
+"m.bounds.w * scale );"
+"uint visible = ( 0u != ( flags[ d ] & 2u ) || outside( bounds[ d ] )"
+"|| outside( s ) ) ? 0u : 1u;"
+"if( 1u == visible && eye.w > 0.0 && m.cone.w <= 1.0"
+"&& determinant( mat3( model ) ) > 0.0 ) {"
+"vec3 v = m.bounds.xyz - ( inverse( model ) * vec4( eye.xyz, 1.0 ) ).xyz;"
+"if( dot( v, m.cone.xyz )"
+"> m.cone.w * length( v ) + m.bounds.w * ( 1.0 + m.cone.w ) ) {"
+"visible = 0u;"
+"}"
+"}"
+"commands[ i ].instance_count = visible;"
+"}"
+;
+
 //------------------------------------------------------------------------------
 
 inline
@@ -117,8 +458,8 @@ int init_shader( Shader *p, const GLchar *v_data,
 	int attach_geometry = ( 0 != g_data );
 	GLsizei len;
 	s32 status;
-	u32 program_id;
-	u32 sources[ 3 ];
+	u32 program_id = 0;
+	u32 sources[ 3 ] = { 0, 0, 0 };
 	sources[ 0 ] = glCreateShader( GL_VERTEX_SHADER );
 	sources[ 2 ] = glCreateShader( GL_FRAGMENT_SHADER );
 
@@ -150,7 +491,12 @@ int init_shader( Shader *p, const GLchar *v_data,
 	}
 	glLinkProgram( program_id );
 	glGetProgramiv( program_id, GL_LINK_STATUS, &status );
+	glDetachShader( program_id, sources[ 0 ] );
+	glDetachShader( program_id, sources[ 2 ] );
 
+	if( attach_geometry ) {
+		glDetachShader( program_id, sources[ 1 ] );
+	}
 	if( !status ) {
 		GLchar log[ 256 ];
 		glGetProgramInfoLog( program_id, 256, &len, log );
@@ -158,12 +504,6 @@ int init_shader( Shader *p, const GLchar *v_data,
 		result = -1;
 		goto last;
 	}
-	glDetachShader( program_id, sources[ 0 ] );
-	glDetachShader( program_id, sources[ 2 ] );
-
-	if( attach_geometry ) {
-		glDetachShader( program_id, sources[ 1 ] );
-	}
 	glValidateProgram( program_id );
 	glGetProgramiv( program_id, GL_VALIDATE_STATUS, &status );
 
@@ -171,27 +511,121 @@ int init_shader( Shader *p, const GLchar *v_data,
 		fprintf( stderr, "Error: program validation failed!\n" );
 		result = -1;
 	}
+last: /* the program keeps the linked code, the shaders are not needed */
+	glDeleteShader( sources[ 0 ] );
+	glDeleteShader( sources[ 1 ] );
+	glDeleteShader( sources[ 2 ] );
+
+	if( ( -1 != result ) && ( 0 != program_id ) ) {
+		p->program_id = program_id;
+	} else if( 0 != program_id ) {
+		glDeleteProgram( program_id );
+	}
+	return result;
+}
+
+static
+int init_compute_shader( Shader *p, const GLchar *c_data ) {
+	int result = 0;
+	GLsizei len;
+	s32 status;
+	u32 program_id = 0;
+	u32 source = glCreateShader( GL_COMPUTE_SHADER );
+
+	if( 0 != ( result = shader_compile( source, c_data ) ) ) {
+		goto last;
+	}
+	program_id = glCreateProgram( );
+
+	if( 0 == program_id ) {
+		fprintf( stderr, "Error: glCreateProgram() for program failed!\n" );
+		result = -1;
+		goto last;
+	}
+	glAttachShader( program_id, source );
+	glLinkProgram( program_id );
+	glGetProgramiv( program_id, GL_LINK_STATUS, &status );
+	glDetachShader( program_id, source );
+
+	if( !status ) {
+		GLchar log[ 256 ];
+		glGetProgramInfoLog( program_id, 256, &len, log );
+		fprintf( stderr, "glLinkProgram(): %s\n", log );
+		result = -1;
+	}
 last:
-	if( ( -1 != result ) && ( 0 != program_id ) ) p->program_id = program_id;
+	glDeleteShader( source );
+
+	if( ( -1 != result ) && ( 0 != program_id ) ) {
+		p->program_id = program_id;
+	} else if( 0 != program_id ) {
+		glDeleteProgram( program_id );
+	}
 	return result;
 }
 
 //------------------------------------------------------------------------------
 
-int init_shaders( void ) {
+/*! Source name.glsl from shader_dir if there is one, else the built in
+	source, which is written there to start editing from. */
+static const GLchar *shader_source( const char *name, const GLchar *source ) {
+	char path[ 256 ];
+	char *data;
+	long len;
+	FILE *fh;
+
+	if( !shader_dir || 32 == num_shader_files ) {
+		return source;
+	}
+	snprintf( path, 256, "%s/%s.glsl", shader_dir, name );
+	fh = fopen( path, "r" );
+
+	if( !fh ) {
+		if( ( fh = fopen( path, "w" ) ) ) {
+			fputs( source, fh );
+			fclose( fh );
+		}
+		return source;
+	}
+	fseek( fh, 0, SEEK_END );
+	len = ftell( fh );
+	fseek( fh, 0, SEEK_SET );
+	data = ( len >= 0 ) ? malloc( len + 1 ) : 0;
+
+	if( !data || len != ( long ) fread( data, 1, len, fh ) ) {
+		fprintf( stderr, "Could not read file %s\n", path );
+		free( data );
+		fclose( fh );
+		return source;
+	}
+	fclose( fh );
+	data[ len ] = 0;
+	shader_files[ num_shader_files++ ] = data;
+	return data;
+}
+
+/*! The built-in program id, one of PROGRAM_*. */
+Shader *program( u32 id ) {
+	return handle_get( &programs, builtin_programs[ id ] );
+}
+
+static int build_shaders( void ) {
 #define DEF_LOC(x) p->uniform_locations[(x)] = \
 	(s16) glGetUniformLocation(p->program_id, uniforms[(x)]);
+#define SRC(x) shader_source( #x, x )
 
 	Shader *p;
 
-	p = &programs[ PROGRAM_MODEL ];
+	p = program( PROGRAM_MODEL );
 
-	if( init_shader( p,
-		model_vertex_shader, model_fragment_shader, 0 ) < 0 )
+	if( init_shader( p, SRC( model_vertex_shader ), gl_caps.shader_storage
+		? SRC( clustered_fragment_shader ) : SRC( model_fragment_shader ),
+		0 ) < 0 )
 	{
 		return -1;
 	}
 	p->num_tex_bindings = 1;
+	DEF_LOC( ULOC_CLUSTER_SCALE );
 	DEF_LOC( ULOC_MODEL );
 	DEF_LOC( ULOC_VIEW );
 	DEF_LOC( ULOC_PROJECTION );
@@ -200,6 +634,154 @@ int init_shaders( void ) {
 	DEF_LOC( ULOC_LOCATION );
 	DEF_LOC( ULOC_INTENSITIES );
 	DEF_LOC( ULOC_AMBIENT_COEFF );
+
+	if( gl_caps.multi_draw_indirect ) {
+		p = program( PROGRAM_MODEL_MDI );
+
+		if( init_shader( p, SRC( model_mdi_vertex_shader ),
+			gl_caps.shader_storage ? SRC( clustered_fragment_shader )
+			: SRC( model_fragment_shader ), 0 ) < 0 )
+		{
+			return -1;
+		}
+		p->num_tex_bindings = 1;
+		DEF_LOC( ULOC_CLUSTER_SCALE );
+		DEF_LOC( ULOC_VIEW );
+		DEF_LOC( ULOC_PROJECTION );
+		DEF_LOC( ULOC_TEXTURE0 );
+		DEF_LOC( ULOC_LOCATION );
+		DEF_LOC( ULOC_INTENSITIES );
+		DEF_LOC( ULOC_AMBIENT_COEFF );
+	}
+	p = program( PROGRAM_DEPTH );
+
+	if( init_shader( p, SRC( depth_vertex_shader ),
+		SRC( depth_fragment_shader ), 0 ) < 0 )
+	{
+		return -1;
+	}
+	DEF_LOC( ULOC_MODEL );
+	DEF_LOC( ULOC_VIEW );
+	DEF_LOC( ULOC_PROJECTION );
+
+	if( gl_caps.multi_draw_indirect ) {
+		p = program( PROGRAM_DEPTH_MDI );
+
+		if( init_shader( p, SRC( depth_mdi_vertex_shader ),
+			SRC( depth_fragment_shader ), 0 ) < 0 )
+		{
+			return -1;
+		}
+		DEF_LOC( ULOC_VIEW );
+		DEF_LOC( ULOC_PROJECTION );
+	}
+	p = program( PROGRAM_VT );
+
+	if( init_shader( p, SRC( model_vertex_shader ),
+		SRC( vt_fragment_shader ), 0 ) < 0 )
+	{
+		return -1;
+	}
+	p->num_tex_bindings = 2;
+	DEF_LOC( ULOC_CLUSTER_SCALE );
+	DEF_LOC( ULOC_MODEL );
+	DEF_LOC( ULOC_VIEW );
+	DEF_LOC( ULOC_PROJECTION );
+	DEF_LOC( ULOC_TEXTURE0 );
+	DEF_LOC( ULOC_TEXTURE1 );
+	DEF_LOC( ULOC_LOCATION );
+	DEF_LOC( ULOC_INTENSITIES );
+	DEF_LOC( ULOC_AMBIENT_COEFF );
+	DEF_LOC( ULOC_SCALE );
+	DEF_LOC( ULOC_VT_CACHE );
+	DEF_LOC( ULOC_VT_PARAMS );
+
+	p = program( PROGRAM_VT_FEEDBACK );
+
+	if( init_shader( p, SRC( model_vertex_shader ),
+		SRC( vt_feedback_fragment_shader ), 0 ) < 0 )
+	{
+		return -1;
+	}
+	DEF_LOC( ULOC_MODEL );
+	DEF_LOC( ULOC_VIEW );
+	DEF_LOC( ULOC_PROJECTION );
+	DEF_LOC( ULOC_SCALE );
+	DEF_LOC( ULOC_VT_PARAMS );
+
+	p = program( PROGRAM_BBOX );
+
+	if( init_shader( p, SRC( bbox_vertex_shader ),
+		SRC( bbox_fragment_shader ), 0 ) < 0 )
+	{
+		return -1;
+	}
+	DEF_LOC( ULOC_VIEW );
+	DEF_LOC( ULOC_PROJECTION );
+	DEF_LOC( ULOC_TRANSLATION );
+	DEF_LOC( ULOC_RADIUS );
+
+	if( gl_caps.compute_shader ) {
+		p = program( PROGRAM_CULL );
+
+		if( init_compute_shader( p, SRC( cull_compute_shader ) ) < 0 ) {
+			return -1;
+		}
+		DEF_LOC( ULOC_COUNT );
+		DEF_LOC( ULOC_PLANES );
+		DEF_LOC( ULOC_EYE );
+	}
 #undef DEF_LOC
+#undef SRC
 	return 0;
 }
+
+/*! Builds the built-in programs, their handles are created on the first
+	call. */
+int init_shaders( void ) {
+	int result;
+	u32 i;
+
+	for( i = 0; i < PROGRAM_MAX; ++i ) {
+		if( !handle_get( &programs, builtin_programs[ i ] ) ) {
+			builtin_programs[ i ] = handle_create( &programs );
+		}
+		if( !builtin_programs[ i ] ) {
+			return -1;
+		}
+	}
+	result = build_shaders( );
+
+	while( num_shader_files ) {
+		free( shader_files[ --num_shader_files ] );
+	}
+	return result;
+}
+
+/*! Builds all programs again, for sources changed in shader_dir. The old
+	programs are deleted on success, on failure they stay in use. */
+int reinit_shaders( void ) {
+	u32 i, n = programs.count;
+	Shader *old = scratch_alloc( n * sizeof( Shader ) + 1 );
+	Shader *p = ( Shader * ) programs.items;
+	int result;
+
+	if( !old ) {
+		return -1;
+	}
+	memcpy( old, p, n * sizeof( Shader ) );
+	result = init_shaders( );
+
+	for( i = 0; i < n; ++i ) {
+		u32 drop = ( result < 0 ) ? p[ i ].program_id : old[ i ].program_id;
+
+		if( drop && p[ i ].program_id != old[ i ].program_id ) {
+			glDeleteProgram( drop );
+		}
+	}
+	if( result < 0 ) {
+		memcpy( p, old, n * sizeof( Shader ) );
+	}
+	scratch_free( old );
+	return result;
+}
@@ -3,18 +3,29 @@
 
 enum {
 	PROGRAM_MODEL,
+	PROGRAM_MODEL_MDI,
+	PROGRAM_CULL,
+	PROGRAM_BBOX,
+	PROGRAM_DEPTH,
+	PROGRAM_DEPTH_MDI,
+	PROGRAM_VT,
+	PROGRAM_VT_FEEDBACK,
 	PROGRAM_MAX
 };
 
 enum { /* uniform locations */
 	ULOC_AMBIENT_COEFF,
 	ULOC_ATLAS,
+	ULOC_CLUSTER_SCALE,
 	ULOC_COLOR_BG,
 	ULOC_COLOR_FG,
+	ULOC_EYE,
+	ULOC_COUNT,
 	ULOC_FLAGS,
 	ULOC_INTENSITIES,
 	ULOC_LOCATION,
 	ULOC_MODEL,
+	ULOC_PLANES,
 	ULOC_PROJECTION,
 	ULOC_RADIUS,
 	ULOC_SCALE,
@@ -23,7 +34,9 @@ enum { /* uniform locations */
 	ULOC_TEXTURE2,
 	ULOC_TRANSLATION,
 	ULOC_VIEW,
-	ULOC_MAX // 16 assigned
+	ULOC_VT_CACHE,
+	ULOC_VT_PARAMS,
+	ULOC_MAX // 22 assigned
 };
 
 typedef struct {
@@ -0,0 +1,712 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "profiler.h"
+#include "swrast.h"
+
+#define SWR_CLEAR_COLOR		(0xFF000000U) /* Opaque black, as glClearColor. */
+
+void swrast_free( Swrast *s ) {
+	u32 k;
+
+	for( k = 0; k < s->max_chunks; ++k ) {
+		free( s->chunks[ k ].tris );
+		free( s->chunks[ k ].bin_tris );
+		free( s->chunks[ k ].bin_start );
+	}
+	free( s->chunks );
+	free( s->tile_jobs );
+	free( s->color );
+	free( s->depth );
+	memset( s, 0, sizeof( Swrast ) );
+}
+
+/*! Allocates the color and depth buffers, padded to whole 2 x 2 quads. */
+int swrast_init( Swrast *s, int width, int height ) {
+	memset( s, 0, sizeof( Swrast ) );
+	s->width = width;
+	s->height = height;
+	s->stride = ( width + 1 ) & ~1;
+	s->rows = ( height + 1 ) & ~1;
+	s->tiles_x = ( s->stride + SWR_TILE_W - 1 ) / SWR_TILE_W;
+	s->tiles_y = ( s->rows + SWR_TILE_H - 1 ) / SWR_TILE_H;
+	s->cull_back = 1;
+	s->color = malloc( s->stride * s->rows * sizeof( u32 ) );
+	s->depth = malloc( s->stride * s->rows * sizeof( float ) );
+	s->tile_jobs = calloc( s->tiles_x * s->tiles_y, sizeof( Swr_Tile_Job ) );
+
+	if( !s->color || !s->depth || !s->tile_jobs ) {
+		fprintf( stderr, "Error: no memory for the software rasterizer!\n" );
+		swrast_free( s );
+		return -1;
+	}
+	return 0;
+}
+
+/*! Triangles a draw contributes, occluded draws are skipped. */
+static u32 swr_draw_tris( const Batch *b, u32 draw ) {
+	if( b->draw_flags[ draw ] & DRAW_OCCLUDED ) {
+		return 0;
+	}
+	return b->meshes[ b->draw_meshes[ draw ] ].index_count / 3;
+}
+
+/*! Clips a triangle against the near plane ( z = -w ), the result is a
+	convex polygon of up to four vertices. Returns the vertex count. */
+static u32 swr_clip_near( const Swr_Vertex *in, Swr_Vertex *out ) {
+	u32 i, k, n = 0;
+
+	for( i = 0; i < 3; ++i ) {
+		const Swr_Vertex *p = &in[ i ], *q = &in[ ( i + 1 ) % 3 ];
+		float dp = p->clip.z + p->clip.w, dq = q->clip.z + q->clip.w;
+
+		if( dp >= 0.0f ) {
+			out[ n++ ] = *p;
+		}
+		if( ( dp >= 0.0f ) != ( dq >= 0.0f ) ) {
+			Swr_Vertex *v = &out[ n++ ];
+			float t = dp / ( dp - dq );
+
+			v->clip.x = p->clip.x + t * ( q->clip.x - p->clip.x );
+			v->clip.y = p->clip.y + t * ( q->clip.y - p->clip.y );
+			v->clip.z = p->clip.z + t * ( q->clip.z - p->clip.z );
+			v->clip.w = p->clip.w + t * ( q->clip.w - p->clip.w );
+			for( k = 0; k < SWR_ATTRIBS; ++k ) {
+				v->attribs[ k ] = p->attribs[ k ]
+					+ t * ( q->attribs[ k ] - p->attribs[ k ] );
+			}
+		}
+	}
+	return n;
+}
+
+/*! Sets up the edges and the value planes of a clipped triangle. Clockwise
+	triangles are dropped with cull_back, otherwise turned around. */
+static void swr_add_triangle( const Swrast *s, Swr_Chunk *ch,
+	const Swr_Vertex *v[ 3 ] )
+{
+	float x[ 3 ], y[ 3 ], oow[ 3 ], q[ SWR_PLANES ][ 3 ];
+	u32 i, p;
+
+	for( i = 0; i < 3; ++i ) {
+		oow[ i ] = 1.0f / v[ i ]->clip.w;
+		x[ i ] = ( v[ i ]->clip.x * oow[ i ] * 0.5f + 0.5f ) * s->width;
+		y[ i ] = ( v[ i ]->clip.y * oow[ i ] * 0.5f + 0.5f ) * s->height;
+	}
+	float area = ( x[ 1 ] - x[ 0 ] ) * ( y[ 2 ] - y[ 0 ] )
+		- ( x[ 2 ] - x[ 0 ] ) * ( y[ 1 ] - y[ 0 ] );
+
+	if( area < 0.0f ) {
+		const Swr_Vertex *tv;
+		float t;
+
+		if( s->cull_back ) {
+			return;
+		}
+		t = x[ 1 ], x[ 1 ] = x[ 2 ], x[ 2 ] = t;
+		t = y[ 1 ], y[ 1 ] = y[ 2 ], y[ 2 ] = t;
+		t = oow[ 1 ], oow[ 1 ] = oow[ 2 ], oow[ 2 ] = t;
+		tv = v[ 1 ], v[ 1 ] = v[ 2 ], v[ 2 ] = tv;
+		area = -area;
+	}
+	if( area < 1e-8f ) {
+		return;
+	}
+	float x0 = fminf( x[ 0 ], fminf( x[ 1 ], x[ 2 ] ) );
+	float x1 = fmaxf( x[ 0 ], fmaxf( x[ 1 ], x[ 2 ] ) );
+	float y0 = fminf( y[ 0 ], fminf( y[ 1 ], y[ 2 ] ) );
+	float y1 = fmaxf( y[ 0 ], fmaxf( y[ 1 ], y[ 2 ] ) );
+
+	if( x1 < 0.0f || y1 < 0.0f || x0 >= s->width || y0 >= s->height ) {
+		return;
+	}
+	if( ch->num_tris == ch->max_tris ) {
+		u32 n = ch->max_tris ? 2 * ch->max_tris : 256;
+		Swr_Triangle *tris = realloc( ch->tris, n * sizeof( Swr_Triangle ) );
+		if( !tris ) return;
+		ch->tris = tris;
+		ch->max_tris = n;
+	}
+	Swr_Triangle *t = &ch->tris[ ch->num_tris++ ];
+	float oo_area = 1.0f / area;
+
+	for( i = 0; i < 3; ++i ) {
+		q[ 0 ][ i ] = v[ i ]->clip.z * oow[ i ];
+		q[ 1 ][ i ] = oow[ i ];
+		for( p = 0; p < SWR_ATTRIBS; ++p ) {
+			q[ 2 + p ][ i ] = v[ i ]->attribs[ p ] * oow[ i ];
+		}
+	}
+	memset( t->planes, 0, sizeof( t->planes ) );
+
+	for( i = 0; i < 3; ++i ) { /* edge opposite of vertex i */
+		u32 j = ( i + 1 ) % 3, k = ( i + 2 ) % 3;
+		t->a[ i ] = y[ j ] - y[ k ];
+		t->b[ i ] = x[ k ] - x[ j ];
+		t->c[ i ] = -( t->a[ i ] * x[ j ] + t->b[ i ] * y[ j ] );
+
+		for( p = 0; p < SWR_PLANES; ++p ) {
+			float f = q[ p ][ i ] * oo_area;
+			t->planes[ p ][ 0 ] += t->a[ i ] * f;
+			t->planes[ p ][ 1 ] += t->b[ i ] * f;
+			t->planes[ p ][ 2 ] += t->c[ i ] * f;
+		}
+	}
+	t->x0 = x0 < 0.0f ? 0 : ( s16 ) x0;
+	t->y0 = y0 < 0.0f ? 0 : ( s16 ) y0;
+	t->x1 = x1 >= s->width ? s->width - 1 : ( s16 ) x1;
+	t->y1 = y1 >= s->height ? s->height - 1 : ( s16 ) y1;
+}
+
+/*! Transforms, clips and sets up a range of input triangles, then bins
+	them into the tiles they touch. */
+static void swr_setup_job( void *arg ) {
+	Swr_Chunk *ch = arg;
+	const Swrast *s = ch->swr;
+	const Batch *b = s->batch;
+	u32 num_tiles = s->tiles_x * s->tiles_y;
+	u32 d = ch->first_draw, tri = ch->first_tri, n, i, k, tile, total = 0;
+	PROF_SCOPE( "swrast setup" );
+	ch->num_tris = 0;
+
+	for( n = 0; n < ch->num_input; ++n, ++tri ) {
+		while( tri >= swr_draw_tris( b, d ) ) {
+			++d;
+			tri = 0;
+		}
+		const Mesh *m = &b->meshes[ b->draw_meshes[ d ] ];
+		const Matrix_4x4 *model = &b->draws[ d ].model;
+		const u32 *idx = b->indices + m->first_index + 3 * tri;
+		Swr_Vertex in[ 3 ], out[ 4 ];
+
+		for( i = 0; i < 3; ++i ) {
+			const float *v = b->vertices
+				+ ( idx[ i ] + m->base_vertex ) * BATCH_VERTEX_FLOATS;
+			float *a = in[ i ].attribs;
+			Vector_3d p = { v[ 0 ], v[ 1 ], v[ 2 ] };
+			Vector_4d w;
+
+			matrix_4x4_transform_point( &s->mvps[ d ], p, &in[ i ].clip );
+			matrix_4x4_transform_point( model, p, &w );
+			a[ 0 ] = w.x;
+			a[ 1 ] = w.y;
+			a[ 2 ] = w.z;
+			a[ 3 ] = model->_00 * v[ 3 ] + model->_01 * v[ 4 ] + model->_02 * v[ 5 ];
+			a[ 4 ] = model->_10 * v[ 3 ] + model->_11 * v[ 4 ] + model->_12 * v[ 5 ];
+			a[ 5 ] = model->_20 * v[ 3 ] + model->_21 * v[ 4 ] + model->_22 * v[ 5 ];
+			a[ 6 ] = v[ 6 ];
+			a[ 7 ] = v[ 7 ];
+		}
+		u32 c = swr_clip_near( in, out );
+
+		for( k = 1; k + 1 < c; ++k ) { /* fan */
+			const Swr_Vertex *fan[ 3 ] = { &out[ 0 ], &out[ k ], &out[ k + 1 ] };
+			swr_add_triangle( s, ch, fan );
+		}
+	}
+	memset( ch->bin_start, 0, ( num_tiles + 1 ) * sizeof( u32 ) );
+
+	for( i = 0; i < ch->num_tris; ++i ) {
+		const Swr_Triangle *t = &ch->tris[ i ];
+		u32 tx, ty;
+		for( ty = t->y0 / SWR_TILE_H; ty <= t->y1 / SWR_TILE_H; ++ty ) {
+			for( tx = t->x0 / SWR_TILE_W; tx <= t->x1 / SWR_TILE_W; ++tx ) {
+				++ch->bin_start[ ty * s->tiles_x + tx + 1 ];
+				++total;
+			}
+		}
+	}
+	if( total > ch->max_bins ) {
+		u32 *bins = realloc( ch->bin_tris, total * sizeof( u32 ) );
+		if( !bins ) {
+			ch->num_tris = 0;
+			memset( ch->bin_start, 0, ( num_tiles + 1 ) * sizeof( u32 ) );
+			return;
+		}
+		ch->bin_tris = bins;
+		ch->max_bins = total;
+	}
+	for( tile = 0; tile < num_tiles; ++tile ) {
+		ch->bin_start[ tile + 1 ] += ch->bin_start[ tile ];
+	}
+	for( i = 0; i < ch->num_tris; ++i ) { /* bin_start[ t ] ends at t + 1 */
+		const Swr_Triangle *t = &ch->tris[ i ];
+		u32 tx, ty;
+		for( ty = t->y0 / SWR_TILE_H; ty <= t->y1 / SWR_TILE_H; ++ty ) {
+			for( tx = t->x0 / SWR_TILE_W; tx <= t->x1 / SWR_TILE_W; ++tx ) {
+				ch->bin_tris[ ch->bin_start[ ty * s->tiles_x + tx ]++ ] = i;
+			}
+		}
+	}
+	for( tile = num_tiles; tile > 0; --tile ) {
+		ch->bin_start[ tile ] = ch->bin_start[ tile - 1 ];
+	}
+	ch->bin_start[ 0 ] = 0;
+}
+
+/*! Bilinear sample of one mip-map level with GL_REPEAT. */
+static void swr_sample_level( const Image *img, u32 level, float u, float v,
+	float *out )
+{
+	int w = img->width >> level, h = img->height >> level;
+	if( !w ) w = 1;
+	if( !h ) h = 1;
+	float x = ( u - floorf( u ) ) * w - 0.5f;
+	float y = ( v - floorf( v ) ) * h - 0.5f;
+	float fx = floorf( x ), fy = floorf( y );
+	float tx = x - fx, ty = y - fy;
+	int x0 = ( int ) fx, y0 = ( int ) fy, x1, y1, i;
+	const u8 *pixels = img->pixels + img->offsets[ level ];
+
+	if( x0 < 0 ) x0 = w - 1;
+	if( y0 < 0 ) y0 = h - 1;
+	x1 = ( x0 + 1 < w ) ? x0 + 1 : 0;
+	y1 = ( y0 + 1 < h ) ? y0 + 1 : 0;
+
+	const u8 *p00 = pixels + ( y0 * w + x0 ) * 4;
+	const u8 *p01 = pixels + ( y0 * w + x1 ) * 4;
+	const u8 *p10 = pixels + ( y1 * w + x0 ) * 4;
+	const u8 *p11 = pixels + ( y1 * w + x1 ) * 4;
+
+	for( i = 0; i < 4; ++i ) {
+		float top = p00[ i ] + tx * ( p01[ i ] - p00[ i ] );
+		float bottom = p10[ i ] + tx * ( p11[ i ] - p10[ i ] );
+		out[ i ] = ( top + ty * ( bottom - top ) ) * ( 1.0f / 255.0f );
+	}
+}
+
+/*! Level of detail, log2 of the texels per pixel, from the derivatives of
+	the texture coordinates. */
+static float swr_lod( const Image *img, float dudx, float dvdx, float dudy,
+	float dvdy )
+{
+	float w = img->width, h = img->height;
+	float rx = dudx * dudx * w * w + dvdx * dvdx * h * h;
+	float ry = dudy * dudy * w * w + dvdy * dvdy * h * h;
+	return 0.5f * log2f( fmaxf( fmaxf( rx, ry ), 1e-20f ) );
+}
+
+/*! GL_LINEAR_MIPMAP_LINEAR minification, GL_LINEAR magnification. */
+static void swr_sample( const Image *img, float u, float v, float lod,
+	float *out )
+{
+	u32 last = img->num_levels - 1, level, i;
+	float a[ 4 ], f;
+
+	if( lod <= 0.0f || 0 == last ) {
+		swr_sample_level( img, 0, u, v, out );
+		return;
+	}
+	if( lod >= last ) {
+		swr_sample_level( img, last, u, v, out );
+		return;
+	}
+	level = ( u32 ) lod;
+	f = lod - level;
+	swr_sample_level( img, level, u, v, a );
+	swr_sample_level( img, level + 1, u, v, out );
+
+	for( i = 0; i < 4; ++i ) {
+		out[ i ] = a[ i ] + f * ( out[ i ] - a[ i ] );
+	}
+}
+
+#if defined(__SSE2__)
+/*! Evaluates a plane at the four pixels of a quad. */
+static inline __m128 swr_plane( const float *p, __m128 x, __m128 y ) {
+	return _mm_add_ps( _mm_add_ps( _mm_mul_ps( _mm_set1_ps( p[ 0 ] ), x ),
+		_mm_mul_ps( _mm_set1_ps( p[ 1 ] ), y ) ), _mm_set1_ps( p[ 2 ] ) );
+}
+
+static inline __m128 swr_dot( __m128 ax, __m128 ay, __m128 az,
+	__m128 bx, __m128 by, __m128 bz )
+{
+	return _mm_add_ps( _mm_add_ps( _mm_mul_ps( ax, bx ), _mm_mul_ps( ay, by ) ),
+		_mm_mul_ps( az, bz ) );
+}
+
+/*! Lighting of model_fragment_shader for the four pixels of a quad, blended
+	over dst with GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA. v holds the
+	interpolated attributes. Returns the RGBA8 pixels. */
+static __m128i swr_shade_quad( const Swrast *s, const __m128 *v,
+	__m128i dst )
+{
+	const Light *l = &s->light;
+	const __m128 zero = _mm_setzero_ps( ), one = _mm_set1_ps( 1.0f );
+	const __m128 tiny = _mm_set1_ps( 1e-20f );
+	const __m128i byte = _mm_set1_epi32( 0xFF );
+	float texels[ 4 ][ 4 ], u[ 4 ], tv[ 4 ], lod;
+	int i;
+
+	_mm_storeu_ps( u, v[ 6 ] );
+	_mm_storeu_ps( tv, v[ 7 ] );
+	lod = swr_lod( s->texture, u[ 1 ] - u[ 0 ], tv[ 1 ] - tv[ 0 ],
+		u[ 2 ] - u[ 0 ], tv[ 2 ] - tv[ 0 ] );
+
+	for( i = 0; i < 4; ++i ) { /* one gather per pixel */
+		swr_sample( s->texture, u[ i ], tv[ i ], lod, texels[ i ] );
+	}
+	__m128 tr = _mm_loadu_ps( texels[ 0 ] ), tg = _mm_loadu_ps( texels[ 1 ] );
+	__m128 tb = _mm_loadu_ps( texels[ 2 ] ), ta = _mm_loadu_ps( texels[ 3 ] );
+	_MM_TRANSPOSE4_PS( tr, tg, tb, ta );
+
+	__m128 lx = _mm_sub_ps( _mm_set1_ps( l->position.x ), v[ 0 ] );
+	__m128 ly = _mm_sub_ps( _mm_set1_ps( l->position.y ), v[ 1 ] );
+	__m128 lz = _mm_sub_ps( _mm_set1_ps( l->position.z ), v[ 2 ] );
+	__m128 cx = _mm_sub_ps( _mm_set1_ps( s->eye.x ), v[ 0 ] );
+	__m128 cy = _mm_sub_ps( _mm_set1_ps( s->eye.y ), v[ 1 ] );
+	__m128 cz = _mm_sub_ps( _mm_set1_ps( s->eye.z ), v[ 2 ] );
+	__m128 nx = v[ 3 ], ny = v[ 4 ], nz = v[ 5 ];
+	__m128 dist2 = swr_dot( lx, ly, lz, lx, ly, lz );
+	__m128 f;
+
+	f = _mm_div_ps( one, _mm_sqrt_ps( _mm_max_ps( dist2, tiny ) ) );
+	lx = _mm_mul_ps( lx, f ), ly = _mm_mul_ps( ly, f ), lz = _mm_mul_ps( lz, f );
+	f = _mm_div_ps( one, _mm_sqrt_ps(
+		_mm_max_ps( swr_dot( cx, cy, cz, cx, cy, cz ), tiny ) ) );
+	cx = _mm_mul_ps( cx, f ), cy = _mm_mul_ps( cy, f ), cz = _mm_mul_ps( cz, f );
+	f = _mm_div_ps( one, _mm_sqrt_ps(
+		_mm_max_ps( swr_dot( nx, ny, nz, nx, ny, nz ), tiny ) ) );
+	nx = _mm_mul_ps( nx, f ), ny = _mm_mul_ps( ny, f ), nz = _mm_mul_ps( nz, f );
+
+	/* reflect( -l, n ) . c = 2 ( n . l ) ( n . c ) - l . c */
+	__m128 af = _mm_div_ps( one, _mm_add_ps( one,
+		_mm_mul_ps( _mm_set1_ps( l->intensities.w ), dist2 ) ) );
+	__m128 dp = swr_dot( nx, ny, nz, lx, ly, lz );
+	__m128 spec = _mm_sub_ps(
+		_mm_mul_ps( _mm_add_ps( dp, dp ), swr_dot( nx, ny, nz, cx, cy, cz ) ),
+		swr_dot( lx, ly, lz, cx, cy, cz ) );
+	spec = _mm_and_ps( _mm_cmpgt_ps( dp, zero ), _mm_max_ps( spec, zero ) );
+	__m128 k = _mm_add_ps( _mm_set1_ps( l->ambient_coefficient ),
+		_mm_mul_ps( af, _mm_add_ps( _mm_max_ps( dp, zero ), spec ) ) );
+
+	__m128 src[ 4 ] = {
+		_mm_mul_ps( tr, _mm_mul_ps( _mm_set1_ps( l->intensities.x ), k ) ),
+		_mm_mul_ps( tg, _mm_mul_ps( _mm_set1_ps( l->intensities.y ), k ) ),
+		_mm_mul_ps( tb, _mm_mul_ps( _mm_set1_ps( l->intensities.z ), k ) ),
+		ta };
+	__m128 alpha = _mm_min_ps( _mm_max_ps( ta, zero ), one );
+	__m128 beta = _mm_sub_ps( one, alpha );
+	__m128i out = _mm_setzero_si128( );
+
+	for( i = 0; i < 4; ++i ) {
+		__m128 d = _mm_cvtepi32_ps(
+			_mm_and_si128( _mm_srli_epi32( dst, 8 * i ), byte ) );
+		__m128 c = _mm_min_ps( _mm_max_ps( src[ i ], zero ), one );
+		c = _mm_add_ps( _mm_mul_ps( _mm_mul_ps( c, _mm_set1_ps( 255.0f ) ),
+			alpha ), _mm_mul_ps( d, beta ) );
+		out = _mm_or_si128( out,
+			_mm_slli_epi32( _mm_cvtps_epi32( c ), 8 * i ) );
+	}
+	return out;
+}
+
+/*! Rasterizes a triangle inside a rectangle of a tile, x0 and y0 even, in
+	2 x 2 quads. Lanes are ( x, y ), ( x + 1, y ), ( x, y + 1 ),
+	( x + 1, y + 1 ). Returns the number of pixels shaded. */
+static u32 swr_raster( Swrast *s, const Swr_Triangle *t, int x0, int y0,
+	int x1, int y1 )
+{
+	const __m128 zero = _mm_setzero_ps( ), one = _mm_set1_ps( 1.0f );
+	const __m128 off_x = _mm_setr_ps( 0.5f, 1.5f, 0.5f, 1.5f );
+	const __m128 off_y = _mm_setr_ps( 0.5f, 0.5f, 1.5f, 1.5f );
+	__m128 a0 = _mm_set1_ps( t->a[ 0 ] );
+	__m128 a1 = _mm_set1_ps( t->a[ 1 ] );
+	__m128 a2 = _mm_set1_ps( t->a[ 2 ] );
+	u32 pixels = 0, i;
+	int x, y;
+
+	for( y = y0; y <= y1; y += 2 ) {
+		__m128 py = _mm_add_ps( _mm_set1_ps( ( float ) y ), off_y );
+		__m128 r0 = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( t->b[ 0 ] ), py ),
+			_mm_set1_ps( t->c[ 0 ] ) );
+		__m128 r1 = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( t->b[ 1 ] ), py ),
+			_mm_set1_ps( t->c[ 1 ] ) );
+		__m128 r2 = _mm_add_ps( _mm_mul_ps( _mm_set1_ps( t->b[ 2 ] ), py ),
+			_mm_set1_ps( t->c[ 2 ] ) );
+		float *d0 = s->depth + y * s->stride, *d1 = d0 + s->stride;
+		u32 *c0 = s->color + y * s->stride, *c1 = c0 + s->stride;
+
+		for( x = x0; x <= x1; x += 2 ) {
+			__m128 px = _mm_add_ps( _mm_set1_ps( ( float ) x ), off_x );
+			__m128 in = _mm_and_ps(
+				_mm_cmpge_ps( _mm_add_ps( _mm_mul_ps( a0, px ), r0 ), zero ),
+				_mm_and_ps(
+					_mm_cmpge_ps( _mm_add_ps( _mm_mul_ps( a1, px ), r1 ), zero ),
+					_mm_cmpge_ps( _mm_add_ps( _mm_mul_ps( a2, px ), r2 ), zero ) ) );
+
+			if( 0 == _mm_movemask_ps( in ) ) continue;
+			__m128 z = swr_plane( t->planes[ 0 ], px, py );
+			__m128 d = _mm_castsi128_ps( _mm_unpacklo_epi64(
+				_mm_loadl_epi64( ( const __m128i * ) ( d0 + x ) ),
+				_mm_loadl_epi64( ( const __m128i * ) ( d1 + x ) ) ) );
+			in = _mm_and_ps( in, _mm_cmple_ps( z, d ) );
+			int mask = _mm_movemask_ps( in );
+
+			if( 0 == mask ) continue;
+			__m128i di = _mm_castps_si128(
+				_mm_or_ps( _mm_and_ps( in, z ), _mm_andnot_ps( in, d ) ) );
+			_mm_storel_epi64( ( __m128i * ) ( d0 + x ), di );
+			_mm_storel_epi64( ( __m128i * ) ( d1 + x ),
+				_mm_unpackhi_epi64( di, di ) );
+
+			__m128 w = _mm_div_ps( one, swr_plane( t->planes[ 1 ], px, py ) );
+			__m128 v[ SWR_ATTRIBS ];
+			for( i = 0; i < SWR_ATTRIBS; ++i ) {
+				v[ i ] = _mm_mul_ps( swr_plane( t->planes[ 2 + i ], px, py ), w );
+			}
+			__m128i dst = _mm_unpacklo_epi64(
+				_mm_loadl_epi64( ( const __m128i * ) ( c0 + x ) ),
+				_mm_loadl_epi64( ( const __m128i * ) ( c1 + x ) ) );
+			__m128i c = swr_shade_quad( s, v, dst );
+			__m128i keep = _mm_castps_si128( in );
+			c = _mm_or_si128( _mm_and_si128( keep, c ),
+				_mm_andnot_si128( keep, dst ) );
+			_mm_storel_epi64( ( __m128i * ) ( c0 + x ), c );
+			_mm_storel_epi64( ( __m128i * ) ( c1 + x ), _mm_unpackhi_epi64( c, c ) );
+			pixels += __builtin_popcount( mask );
+		}
+	}
+	return pixels;
+}
+#else
+static inline float swr_plane( const float *p, float x, float y ) {
+	return p[ 0 ] * x + p[ 1 ] * y + p[ 2 ];
+}
+
+/*! Same as the SSE2 swr_shade_quad for one pixel, the derivatives of the
+	texture coordinates in du and dv. */
+static u32 swr_shade_pixel( const Swrast *s, const float *v, const float *du,
+	const float *dv, u32 dst )
+{
+	const Light *l = &s->light;
+	Vector_3d lv = { l->position.x - v[ 0 ], l->position.y - v[ 1 ],
+		l->position.z - v[ 2 ] };
+	Vector_3d cv = { s->eye.x - v[ 0 ], s->eye.y - v[ 1 ], s->eye.z - v[ 2 ] };
+	Vector_3d n = { v[ 3 ], v[ 4 ], v[ 5 ] };
+	float dist2 = vector_3d_dot( lv, lv ), texel[ 4 ], src[ 4 ];
+	u32 out = 0;
+	int i;
+
+	swr_sample( s->texture, v[ 6 ], v[ 7 ],
+		swr_lod( s->texture, du[ 0 ], dv[ 0 ], du[ 1 ], dv[ 1 ] ), texel );
+	vector_3d_scale( &lv, 1.0f / sqrtf( fmaxf( dist2, 1e-20f ) ) );
+	vector_3d_scale( &cv, 1.0f / sqrtf( fmaxf( vector_3d_dot( cv, cv ), 1e-20f ) ) );
+	vector_3d_scale( &n, 1.0f / sqrtf( fmaxf( vector_3d_dot( n, n ), 1e-20f ) ) );
+
+	float af = 1.0f / ( 1.0f + l->intensities.w * dist2 );
+	float dp = vector_3d_dot( n, lv );
+	float spec = 2.0f * dp * vector_3d_dot( n, cv ) - vector_3d_dot( lv, cv );
+	spec = ( dp > 0.0f ) ? fmaxf( spec, 0.0f ) : 0.0f;
+	float k = l->ambient_coefficient + af * ( fmaxf( dp, 0.0f ) + spec );
+	float alpha = fminf( fmaxf( texel[ 3 ], 0.0f ), 1.0f );
+
+	src[ 0 ] = texel[ 0 ] * l->intensities.x * k;
+	src[ 1 ] = texel[ 1 ] * l->intensities.y * k;
+	src[ 2 ] = texel[ 2 ] * l->intensities.z * k;
+	src[ 3 ] = texel[ 3 ];
+
+	for( i = 0; i < 4; ++i ) {
+		float c = fminf( fmaxf( src[ i ], 0.0f ), 1.0f ) * 255.0f * alpha
+			+ ( float ) ( ( dst >> ( 8 * i ) ) & 0xFF ) * ( 1.0f - alpha );
+		out |= ( u32 ) lrintf( c ) << ( 8 * i );
+	}
+	return out;
+}
+
+static u32 swr_raster( Swrast *s, const Swr_Triangle *t, int x0, int y0,
+	int x1, int y1 )
+{
+	u32 pixels = 0, i;
+	int x, y;
+
+	for( y = y0; y <= y1; ++y ) {
+		float py = y + 0.5f;
+		float *depth = s->depth + y * s->stride;
+		u32 *color = s->color + y * s->stride;
+
+		for( x = x0; x <= x1; ++x ) {
+			float px = x + 0.5f, v[ SWR_ATTRIBS ], du[ 2 ], dv[ 2 ];
+			if( t->a[ 0 ] * px + t->b[ 0 ] * py + t->c[ 0 ] < 0.0f
+				|| t->a[ 1 ] * px + t->b[ 1 ] * py + t->c[ 1 ] < 0.0f
+				|| t->a[ 2 ] * px + t->b[ 2 ] * py + t->c[ 2 ] < 0.0f )
+			{
+				continue;
+			}
+			float z = swr_plane( t->planes[ 0 ], px, py );
+			if( z > depth[ x ] ) continue;
+			float w = 1.0f / swr_plane( t->planes[ 1 ], px, py );
+
+			for( i = 0; i < SWR_ATTRIBS; ++i ) {
+				v[ i ] = swr_plane( t->planes[ 2 + i ], px, py ) * w;
+			}
+			for( i = 0; i < 2; ++i ) { /* next pixel in x and in y */
+				float nx = px + ( 0 == i ), ny = py + ( 1 == i );
+				float nw = 1.0f / swr_plane( t->planes[ 1 ], nx, ny );
+				du[ i ] = swr_plane( t->planes[ 8 ], nx, ny ) * nw - v[ 6 ];
+				dv[ i ] = swr_plane( t->planes[ 9 ], nx, ny ) * nw - v[ 7 ];
+			}
+			depth[ x ] = z;
+			color[ x ] = swr_shade_pixel( s, v, du, dv, color[ x ] );
+			++pixels;
+		}
+	}
+	return pixels;
+}
+#endif
+
+/*! Clears one tile and draws the triangles of every chunk binned into it,
+	in submission order. */
+static void swr_tile_job( void *arg ) {
+	Swr_Tile_Job *job = arg;
+	Swrast *s = job->swr;
+	u32 tx = job->tile % s->tiles_x, ty = job->tile / s->tiles_x;
+	int px0 = tx * SWR_TILE_W, py0 = ty * SWR_TILE_H;
+	int px1 = px0 + SWR_TILE_W > ( u32 ) s->stride ? s->stride - 1
+		: px0 + ( int ) SWR_TILE_W - 1;
+	int py1 = py0 + SWR_TILE_H > ( u32 ) s->rows ? s->rows - 1
+		: py0 + ( int ) SWR_TILE_H - 1;
+	u32 k, n, pixels = 0;
+	int x, y;
+	PROF_SCOPE( "swrast tile" );
+
+	for( y = py0; y <= py1; ++y ) {
+		float *depth = s->depth + y * s->stride;
+		u32 *color = s->color + y * s->stride;
+		for( x = px0; x <= px1; ++x ) {
+			depth[ x ] = 1.0f;
+			color[ x ] = SWR_CLEAR_COLOR;
+		}
+	}
+	for( k = 0; k < s->num_chunks; ++k ) {
+		const Swr_Chunk *ch = &s->chunks[ k ];
+
+		for( n = ch->bin_start[ job->tile ]; n < ch->bin_start[ job->tile + 1 ];
+			++n )
+		{
+			const Swr_Triangle *t = &ch->tris[ ch->bin_tris[ n ] ];
+			int x0 = t->x0 > px0 ? t->x0 & ~1 : px0;
+			int x1 = t->x1 < px1 ? t->x1 : px1;
+			int y0 = t->y0 > py0 ? t->y0 & ~1 : py0;
+			int y1 = t->y1 < py1 ? t->y1 : py1;
+
+			pixels += swr_raster( s, t, x0, y0, x1, y1 );
+		}
+	}
+	job->pixels = pixels;
+}
+
+/*! Makes room for num_chunks setup jobs. Returns -1 if out of memory. */
+static int swr_grow_chunks( Swrast *s, u32 num_chunks ) {
+	u32 k, num_tiles = s->tiles_x * s->tiles_y;
+
+	if( num_chunks <= s->max_chunks ) {
+		return 0;
+	}
+	Swr_Chunk *chunks = realloc( s->chunks, num_chunks * sizeof( Swr_Chunk ) );
+	if( !chunks ) return -1;
+	s->chunks = chunks;
+
+	for( k = s->max_chunks; k < num_chunks; ++k ) {
+		memset( &chunks[ k ], 0, sizeof( Swr_Chunk ) );
+		chunks[ k ].bin_start = malloc( ( num_tiles + 1 ) * sizeof( u32 ) );
+		if( !chunks[ k ].bin_start ) return -1;
+		s->max_chunks = k + 1;
+	}
+	return 0;
+}
+
+/*! Renders the draws of a batch that are not DRAW_OCCLUDED with the texture
+	and the light of model_fragment_shader, view and projection as uploaded
+	by render(). Chunks of triangles are set up on the job system, then one
+	job shades each tile. Returns when the frame is complete, the per draw
+	matrices stay on frame until it is reset. */
+void swrast_render( Swrast *s, Job_System *js, Arena *frame, const Batch *b,
+	const Image *texture, const Matrix_4x4 *view,
+	const Matrix_4x4 *projection, const Light *light )
+{
+	u32 d, k, start = 0, total = 0, num_chunks;
+	u32 num_tiles = s->tiles_x * s->tiles_y;
+	Matrix_4x4 inverse;
+	Vector_4d eye;
+	PROF_SCOPE( "swrast render" );
+
+	s->batch = b;
+	s->texture = texture;
+	s->light = *light;
+	s->jobs = js;
+	s->counter.pending = 0;
+	matrix_4x4_mul_matrix( view, projection, &s->view_projection );
+	matrix_4x4_invert( view, &inverse );
+	matrix_4x4_transform_point( &inverse, ( Vector_3d ) { 0.0f, 0.0f, 0.0f },
+		&eye );
+	s->eye = ( Vector_3d ) { eye.x, eye.y, eye.z };
+
+	s->mvps = arena_alloc( frame, b->num_draws * sizeof( Matrix_4x4 ) );
+
+	if( !s->mvps ) {
+		fprintf( stderr, "Error: no frame memory for %u draws!\n",
+			b->num_draws );
+		return;
+	}
+	for( d = 0; d < b->num_draws; ++d ) {
+		matrix_4x4_mul_matrix( &b->draws[ d ].model, &s->view_projection,
+			&s->mvps[ d ] );
+		total += swr_draw_tris( b, d );
+	}
+	num_chunks = ( total + SWR_CHUNK_TRIS - 1 ) / SWR_CHUNK_TRIS;
+
+	if( swr_grow_chunks( s, num_chunks ) < 0 ) {
+		fprintf( stderr, "Error: no memory for %u triangles!\n", total );
+		return;
+	}
+	s->num_chunks = num_chunks;
+
+	for( d = 0, k = 0; d < b->num_draws; ++d ) {
+		u32 end = start + swr_draw_tris( b, d );
+
+		while( k < num_chunks && k * SWR_CHUNK_TRIS < end ) {
+			Swr_Chunk *ch = &s->chunks[ k ];
+			ch->swr = s;
+			ch->first_draw = d;
+			ch->first_tri = k * SWR_CHUNK_TRIS - start;
+			ch->num_input = total - k * SWR_CHUNK_TRIS < SWR_CHUNK_TRIS
+				? total - k * SWR_CHUNK_TRIS : SWR_CHUNK_TRIS;
+			jobs_submit( js, &s->counter, swr_setup_job, ch );
+			++k;
+		}
+		start = end;
+	}
+	jobs_wait( js, &s->counter );
+
+	for( k = 0, s->triangles = 0; k < num_chunks; ++k ) {
+		s->triangles += s->chunks[ k ].num_tris;
+	}
+	for( k = 0; k < num_tiles; ++k ) {
+		s->tile_jobs[ k ].swr = s;
+		s->tile_jobs[ k ].tile = k;
+		jobs_submit( js, &s->counter, swr_tile_job, &s->tile_jobs[ k ] );
+	}
+	jobs_wait( js, &s->counter );
+
+	for( k = 0, s->pixels = 0; k < num_tiles; ++k ) {
+		s->pixels += s->tile_jobs[ k ].pixels;
+	}
+}
+
+/*! Copies the last frame as RGB, bottom row first like glReadPixels. */
+void swrast_read( const Swrast *s, u8 *rgb ) {
+	int x, y;
+
+	for( y = 0; y < s->height; ++y ) {
+		const u32 *row = s->color + y * s->stride;
+		for( x = 0; x < s->width; ++x, rgb += 3 ) {
+			rgb[ 0 ] = row[ x ] & 0xFF;
+			rgb[ 1 ] = ( row[ x ] >> 8 ) & 0xFF;
+			rgb[ 2 ] = ( row[ x ] >> 16 ) & 0xFF;
+		}
+	}
+}
@@ -0,0 +1,71 @@
+#ifndef CTOOL_SWRAST
+#define CTOOL_SWRAST
+
+#include "types.h"
+#include "3d.h"
+#include "arena.h"
+#include "jobs.h"
+#include "batch.h"
+#include "assets.h"
+
+#define SWR_TILE_W			(64U)	/* One job shades one tile, both even. */
+#define SWR_TILE_H			(32U)
+#define SWR_CHUNK_TRIS		(512U)	/* Input triangles per setup job. */
+#define SWR_ATTRIBS			(8U)	/* World position, normal, uv. */
+#define SWR_PLANES			(2U + SWR_ATTRIBS) /* z / w, 1 / w, attributes */
+
+typedef struct { /*! Clip space vertex with the inputs of the shading. */
+	Vector_4d clip;
+	float attribs[ SWR_ATTRIBS ];
+} Swr_Vertex;
+
+typedef struct { /*! Screen space triangle. Edges and interpolated values
+	are planes v( x, y ) = dx * x + dy * y + c, the attributes are divided
+	by w for perspective correction. */
+	float a[ 3 ], b[ 3 ], c[ 3 ];	/*! e_i( x, y ) = a_i * x + b_i * y + c_i */
+	float planes[ SWR_PLANES ][ 3 ];
+	s16 x0, y0, x1, y1;				/*! Bounding box in pixels, inclusive. */
+} Swr_Triangle;
+
+typedef struct Swrast Swrast;
+
+typedef struct { /*! Triangles set up by one job, binned into the tiles. */
+	Swrast *swr;
+	u32 first_draw, first_tri;		/*! Start of the input range. */
+	u32 num_input;
+	u32 num_tris, max_tris;
+	Swr_Triangle *tris;
+	u32 *bin_tris, max_bins;		/*! Triangle indices, grouped by tile. */
+	u32 *bin_start;					/*! num_tiles + 1 */
+} Swr_Chunk;
+
+typedef struct { /*! Argument of a tile job. */
+	Swrast *swr;
+	u32 tile;
+	u32 pixels;						/*! Shaded in the last frame. */
+} Swr_Tile_Job;
+
+struct Swrast { /*! Tile based rasterizer with the lighting of
+	model_fragment_shader, renders a batch on the job system. */
+	int width, height;
+	int stride, rows;				/*! Padded to whole 2 x 2 quads. */
+	u32 tiles_x, tiles_y;
+	u32 *color;						/*! RGBA8, bottom row first like GL. */
+	float *depth;					/*! z / w, cleared to 1. */
+	int cull_back;					/*! Drop clockwise triangles. */
+	const Batch *batch;
+	const Image *texture;
+	Light light;
+	Vector_3d eye;
+	Matrix_4x4 view_projection;
+	Matrix_4x4 *mvps;				/*! Per draw MVP, on the frame arena. */
+	Job_System *jobs;
+	Job_Counter counter;
+	u32 num_chunks, max_chunks;
+	Swr_Chunk *chunks;
+	Swr_Tile_Job *tile_jobs;
+	u64 triangles;					/*! Set up in the last frame. */
+	u64 pixels;						/*! Passed the depth test -"-. */
+};
+
+#endif /* CTOOL_SWRAST */
@@ -0,0 +1,1065 @@
+/* gcc -Wall -O2 -o cook tools/cook.c -lm -lpthread */
+
+/*
+	Cooks the source assets of a directory tree into the runtime formats:
+
+		cook <source dir> <out dir> [-j threads] [-v] [--force]
+
+		*.mob		any layout -> interleaved, equal vertices merged, the
+					triangles ordered for the post-transform vertex cache
+					(Forsyth), the vertices in the order of first use and
+					indices of 8, 16 or 32 bits, the fewest that reach them;
+					meshlets of consecutive triangles with their bounding
+					sphere and normal cone for culling them one by one
+		*.ppm		binary PPM (P6) -> RGBA8 ktx as load_ktx reads it
+		scene files	texture names follow the ppm -> ktx renaming, cooked
+					after the files they name
+		others		copied
+
+	Every output has a key, the hash of its input, the recipe and
+	COOK_VERSION, for a scene also the keys of the files it names.
+	<out dir>/.cook keeps the key and the size, modification time and hash
+	of each input: inputs with the same size and time are not hashed again,
+	outputs with the same key are not cooked again. Hashing and cooking run
+	on the job system with a worker per core. Outputs are written next to
+	their place and renamed, --watch of the test sees them complete.
+*/
+
+#include <dirent.h>
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include "../types.h"
+#include "../assets.h"
+#include "../arena.c"
+#include "../jobs.c"
+#include "../mob.c"
+
+#define COOK_VERSION		(1U)	/* Bump to cook everything again. */
+#define COOK_PATH			(256U)
+#define COOK_CACHE_FILE		".cook"
+#define COOK_SCENE_MAGIC	"# opengl-test scene v1"
+#define COOK_CACHE_SIZE		(32U)	/* Vertices of the modeled cache. */
+#define COOK_FIFO_SIZE		(16U)	/* For the ACMR printed with -v. */
+#define COOK_UNSIGNED_BYTE	(0x1401U)
+#define COOK_RGBA			(0x1908U)
+#define COOK_RGBA8			(0x8058U)
+
+enum { /* recipes, their number is part of the key */
+	RECIPE_COPY,
+	RECIPE_MESH,
+	RECIPE_TEXTURE,
+	RECIPE_SCENE
+};
+
+static const u32 recipe_versions[ ] = { 1, 3, 1, 1 };
+
+enum { /* state of a node */
+	COOK_UP_TO_DATE,
+	COOK_OUTDATED,
+	COOK_DONE,
+	COOK_FAILED
+};
+
+typedef struct { /*! One source file and the output cooked from it. */
+	char path[ COOK_PATH ];		/*! Relative to the source directory. */
+	char out[ COOK_PATH ];		/*! Relative to the output directory. */
+	u32 recipe;
+	u32 state;
+	s64 size, mtime;			/*! Of the source, mtime in ns. */
+	u64 hash;					/*! Of the source contents. */
+	u64 key;					/*! Of the output. */
+	int cached;					/*! In the cache file. */
+	u32 cached_recipe;
+	s64 cached_size, cached_mtime;
+	u64 cached_hash, cached_key;
+	char ( *dep_names )[ COOK_PATH ];	/*! Named by a scene. */
+	u32 *deps, num_deps;		/*! Nodes of the dep_names. */
+	char note[ 96 ];			/*! Printed with -v. */
+} Cook_Node;
+
+typedef struct {
+	const char *src, *dst;
+	Cook_Node *nodes;
+	u32 num_nodes, max_nodes;
+	int verbose, force;
+	Job_System jobs;
+} Cook;
+
+typedef struct { /*! A node and the cook it belongs to, argument of jobs. */
+	Cook *c;
+	Cook_Node *n;
+} Cook_Job;
+
+//------------------------------------------------------------------------------
+
+static u64 cook_hash( u64 h, const void *data, size_t size ) { /* FNV-1a */
+	const u8 *p = data;
+	size_t i;
+
+	for( i = 0; i < size; ++i ) {
+		h = ( h ^ p[ i ] ) * 0x100000001B3ULL;
+	}
+	return h;
+}
+
+#define COOK_HASH_SEED	(0xCBF29CE484222325ULL)
+
+static s64 cook_mtime( const struct stat *st ) {
+	return ( s64 ) st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
+static double cook_milliseconds( void ) {
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+/*! Whole file in memory, size in *size, 0 on failure. */
+static u8 *cook_read( const char *file, size_t *size ) {
+	FILE *fh = fopen( file, "rb" );
+	u8 *data = 0;
+	long len;
+
+	if( fh && !fseek( fh, 0, SEEK_END ) && ( len = ftell( fh ) ) >= 0
+		&& !fseek( fh, 0, SEEK_SET ) && ( data = malloc( len + 1 ) )
+		&& ( size_t ) len == fread( data, 1, len, fh ) )
+	{
+		data[ len ] = 0;
+		*size = len;
+		fclose( fh );
+		return data;
+	}
+	fprintf( stderr, "Could not read file %s\n", file );
+	free( data );
+	if( fh ) {
+		fclose( fh );
+	}
+	return 0;
+}
+
+/*! Writes the parts next to file and renames it into place. */
+static int cook_write( const char *file, const void **parts,
+	const size_t *sizes, u32 num_parts )
+{
+	char tmp[ 2 * COOK_PATH + 8 ];
+	FILE *fh;
+	u32 i;
+	int ok;
+
+	snprintf( tmp, sizeof( tmp ), "%s.tmp", file );
+	fh = fopen( tmp, "wb" );
+	ok = ( 0 != fh );
+
+	for( i = 0; ok && i < num_parts; ++i ) {
+		ok = !sizes[ i ] || 1 == fwrite( parts[ i ], sizes[ i ], 1, fh );
+	}
+	if( fh && fclose( fh ) ) {
+		ok = 0;
+	}
+	if( !ok || rename( tmp, file ) ) {
+		fprintf( stderr, "Could not write file %s\n", file );
+		remove( tmp );
+		return -1;
+	}
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+
+/*! Average post-transform cache misses per triangle of a FIFO cache. */
+static float cook_acmr( const u32 *indices, u32 num_indices ) {
+	u32 fifo[ COOK_FIFO_SIZE ], head = 0, used = 0, misses = 0, i, j;
+
+	for( i = 0; i < num_indices; ++i ) {
+		for( j = 0; j < used && fifo[ j ] != indices[ i ]; ++j );
+
+		if( j == used ) {
+			fifo[ head ] = indices[ i ];
+			head = ( head + 1 ) % COOK_FIFO_SIZE;
+			used += ( used < COOK_FIFO_SIZE );
+			++misses;
+		}
+	}
+	return num_indices ? 3.0f * misses / num_indices : 0.0f;
+}
+
+/*! Score of a vertex for Forsyth's linear-speed vertex cache optimization,
+	recent vertices and vertices with few triangles left rank higher. */
+static float cook_vertex_score( s32 position, u32 remaining ) {
+	float score = 0.0f;
+
+	if( !remaining ) {
+		return -1.0f;
+	}
+	if( position >= 0 ) {
+		if( position < 3 ) { /* the last triangle, no gain in reusing it */
+			score = 0.75f;
+		} else {
+			float s = 1.0f - ( position - 3 ) / ( float ) ( COOK_CACHE_SIZE - 3 );
+			score = s * sqrtf( s );
+		}
+	}
+	return score + 2.0f / sqrtf( ( float ) remaining );
+}
+
+/*! Orders the triangles for the post-transform cache in place. */
+static int cook_order_triangles( u32 *indices, u32 num_indices,
+	u32 num_vertices )
+{
+	u32 num_tris = num_indices / 3, i, j, k, t;
+	u32 *offsets = calloc( num_vertices + 1, sizeof( u32 ) );
+	u32 *remaining = calloc( num_vertices, sizeof( u32 ) );
+	u32 *adjacent = malloc( num_indices * sizeof( u32 ) );
+	s32 *positions = malloc( num_vertices * sizeof( s32 ) );
+	float *scores = malloc( num_vertices * sizeof( float ) );
+	float *tri_scores = malloc( num_tris * sizeof( float ) );
+	u8 *emitted = calloc( num_tris, 1 );
+	u32 *out = malloc( num_indices * sizeof( u32 ) );
+	u32 cache[ COOK_CACHE_SIZE + 3 ], cached = 0, next = 0;
+	int result = -1;
+
+	if( !offsets || !remaining || !adjacent || !positions || !scores
+		|| !tri_scores || !emitted || !out )
+	{
+		goto last;
+	}
+	for( i = 0; i < num_indices; ++i ) {
+		remaining[ indices[ i ] ]++;
+	}
+	for( i = 0; i < num_vertices; ++i ) {
+		offsets[ i + 1 ] = offsets[ i ] + remaining[ i ];
+		positions[ i ] = -1;
+		scores[ i ] = cook_vertex_score( -1, remaining[ i ] );
+		remaining[ i ] = 0;
+	}
+	for( i = 0; i < num_indices; ++i ) { /* triangles of each vertex */
+		u32 v = indices[ i ];
+		adjacent[ offsets[ v ] + remaining[ v ]++ ] = i / 3;
+	}
+	for( t = 0; t < num_tris; ++t ) {
+		tri_scores[ t ] = scores[ indices[ 3 * t ] ]
+			+ scores[ indices[ 3 * t + 1 ] ] + scores[ indices[ 3 * t + 2 ] ];
+	}
+	for( k = 0; k < num_tris; ++k ) {
+		s32 best = -1;
+		float best_score = -1.0f;
+
+		/* the best triangle of the cached vertices, else a full scan */
+		for( i = 0; i < cached; ++i ) {
+			u32 v = cache[ i ];
+			for( j = offsets[ v ]; j < offsets[ v ] + remaining[ v ]; ++j ) {
+				if( tri_scores[ adjacent[ j ] ] > best_score ) {
+					best_score = tri_scores[ adjacent[ j ] ];
+					best = adjacent[ j ];
+				}
+			}
+		}
+		for( ; best < 0 && next < num_tris; ++next ) {
+			if( !emitted[ next ] ) {
+				best = next;
+			}
+		}
+		t = best;
+		emitted[ t ] = 1;
+		memcpy( out + 3 * k, indices + 3 * t, 3 * sizeof( u32 ) );
+
+		/* the vertices of t move to the front of the cache */
+		for( i = 0; i < 3; ++i ) {
+			u32 v = indices[ 3 * t + i ];
+			s32 p = positions[ v ];
+
+			for( j = offsets[ v ]; j < offsets[ v ] + remaining[ v ]; ++j ) {
+				if( adjacent[ j ] == t ) { /* drop t from the adjacency */
+					adjacent[ j ] = adjacent[ offsets[ v ] + --remaining[ v ] ];
+					break;
+				}
+			}
+			if( p < 0 ) {
+				p = cached++;
+			}
+			memmove( cache + 1, cache, p * sizeof( u32 ) );
+			cache[ 0 ] = v;
+
+			for( j = 0; j <= ( u32 ) p; ++j ) {
+				positions[ cache[ j ] ] = j;
+			}
+		}
+		/* scores of the cache and of the vertices pushed out of it */
+		for( i = 0; i < cached; ++i ) {
+			u32 v = cache[ i ];
+
+			if( i >= COOK_CACHE_SIZE ) {
+				positions[ v ] = -1;
+			}
+			scores[ v ] = cook_vertex_score( positions[ v ], remaining[ v ] );
+		}
+		for( i = 0; i < cached; ++i ) {
+			u32 v = cache[ i ];
+			for( j = offsets[ v ]; j < offsets[ v ] + remaining[ v ]; ++j ) {
+				const u32 *tri = indices + 3 * adjacent[ j ];
+				tri_scores[ adjacent[ j ] ] = scores[ tri[ 0 ] ]
+					+ scores[ tri[ 1 ] ] + scores[ tri[ 2 ] ];
+			}
+		}
+		if( cached > COOK_CACHE_SIZE ) {
+			cached = COOK_CACHE_SIZE;
+		}
+	}
+	memcpy( indices, out, num_indices * sizeof( u32 ) );
+	result = 0;
+last:
+	free( offsets );
+	free( remaining );
+	free( adjacent );
+	free( positions );
+	free( scores );
+	free( tri_scores );
+	free( emitted );
+	free( out );
+	return result;
+}
+
+/*! Interleaves the vertices and merges equal ones, returns their number
+	or -1. remap receives the new index of each old vertex. */
+static s32 cook_weld( int layout, const float *data, u32 n,
+	float *vertices, u32 *remap )
+{
+	u32 size = 16, i, j, count = 0;
+	s32 *table;
+
+	while( size < 2 * n ) {
+		size *= 2;
+	}
+	if( !( table = malloc( size * sizeof( s32 ) ) ) ) {
+		return -1;
+	}
+	memset( table, 0xFF, size * sizeof( s32 ) );
+
+	for( i = 0; i < n; ++i ) {
+		float v[ MOB_VERTEX_FLOATS ];
+
+		mob_vertex( layout, n, data, i, v );
+		j = cook_hash( COOK_HASH_SEED, v, sizeof( v ) ) & ( size - 1 );
+
+		while( table[ j ] >= 0 && memcmp( vertices + table[ j ]
+			* MOB_VERTEX_FLOATS, v, sizeof( v ) ) )
+		{
+			j = ( j + 1 ) & ( size - 1 );
+		}
+		if( table[ j ] < 0 ) {
+			table[ j ] = count;
+			memcpy( vertices + count++ * MOB_VERTEX_FLOATS, v, sizeof( v ) );
+		}
+		remap[ i ] = table[ j ];
+	}
+	free( table );
+	return count;
+}
+
+/*! Sphere around the center of the bounds of the vertices of a meshlet
+	and the cone of its face normals. Degenerate triangles have no normal,
+	normals wider than a hemisphere no cone. */
+static void cook_meshlet_bounds( MOB_Meshlet *m, const u32 *indices,
+	const float *vertices )
+{
+	float lo[ 3 ], hi[ 3 ], axis[ 3 ] = { 0.0f, 0.0f, 0.0f }, r2 = 0.0f;
+	float min_dot = 1.0f, len;
+	u32 i, k;
+
+	for( i = 0; i < m->index_count; ++i ) {
+		const float *v = vertices + indices[ m->first_index + i ]
+			* MOB_VERTEX_FLOATS;
+		for( k = 0; k < 3; ++k ) {
+			lo[ k ] = ( !i || v[ k ] < lo[ k ] ) ? v[ k ] : lo[ k ];
+			hi[ k ] = ( !i || v[ k ] > hi[ k ] ) ? v[ k ] : hi[ k ];
+		}
+	}
+	for( k = 0; k < 3; ++k ) {
+		m->bounds[ k ] = 0.5f * ( lo[ k ] + hi[ k ] );
+	}
+	for( i = 0; i < m->index_count; ++i ) {
+		const float *v = vertices + indices[ m->first_index + i ]
+			* MOB_VERTEX_FLOATS;
+		float d[ 3 ] = { v[ 0 ] - m->bounds[ 0 ], v[ 1 ] - m->bounds[ 1 ],
+			v[ 2 ] - m->bounds[ 2 ] };
+		len = d[ 0 ] * d[ 0 ] + d[ 1 ] * d[ 1 ] + d[ 2 ] * d[ 2 ];
+		r2 = ( len > r2 ) ? len : r2;
+	}
+	m->bounds[ 3 ] = sqrtf( r2 );
+
+	/* the axis is the mean of the unit normals, the cone reaches the one
+		furthest from it */
+	for( k = 0; k < 2; ++k ) {
+		for( i = 0; i < m->index_count; i += 3 ) {
+			const u32 *tri = indices + m->first_index + i;
+			const float *a = vertices + tri[ 0 ] * MOB_VERTEX_FLOATS;
+			const float *b = vertices + tri[ 1 ] * MOB_VERTEX_FLOATS;
+			const float *c = vertices + tri[ 2 ] * MOB_VERTEX_FLOATS;
+			float e0[ 3 ] = { b[ 0 ] - a[ 0 ], b[ 1 ] - a[ 1 ], b[ 2 ] - a[ 2 ] };
+			float e1[ 3 ] = { c[ 0 ] - a[ 0 ], c[ 1 ] - a[ 1 ], c[ 2 ] - a[ 2 ] };
+			float n[ 3 ] = { e0[ 1 ] * e1[ 2 ] - e0[ 2 ] * e1[ 1 ],
+				e0[ 2 ] * e1[ 0 ] - e0[ 0 ] * e1[ 2 ],
+				e0[ 0 ] * e1[ 1 ] - e0[ 1 ] * e1[ 0 ] };
+
+			len = sqrtf( n[ 0 ] * n[ 0 ] + n[ 1 ] * n[ 1 ] + n[ 2 ] * n[ 2 ] );
+			if( len <= 0.0f ) {
+				continue;
+			}
+			if( !k ) {
+				axis[ 0 ] += n[ 0 ] / len;
+				axis[ 1 ] += n[ 1 ] / len;
+				axis[ 2 ] += n[ 2 ] / len;
+			} else {
+				float d = ( n[ 0 ] * axis[ 0 ] + n[ 1 ] * axis[ 1 ]
+					+ n[ 2 ] * axis[ 2 ] ) / len;
+				min_dot = ( d < min_dot ) ? d : min_dot;
+			}
+		}
+		if( !k ) {
+			len = sqrtf( axis[ 0 ] * axis[ 0 ] + axis[ 1 ] * axis[ 1 ]
+				+ axis[ 2 ] * axis[ 2 ] );
+			if( len <= 0.0f ) {
+				min_dot = 0.0f;
+				break;
+			}
+			axis[ 0 ] /= len, axis[ 1 ] /= len, axis[ 2 ] /= len;
+		}
+	}
+	memcpy( m->cone, axis, sizeof( axis ) );
+	m->cone[ 3 ] = ( min_dot > 0.0f ) ? sqrtf( 1.0f - min_dot * min_dot )
+		: 2.0f;
+}
+
+/*! Splits the triangles in their order into meshlets of at most
+	MOB_MESHLET_VERTICES vertices and MOB_MESHLET_TRIANGLES triangles.
+	The cache order keeps them compact. stamps holds a u32 per vertex.
+	Returns their number. */
+static u32 cook_meshlets( const u32 *indices, u32 num_indices,
+	const float *vertices, u32 vertex_count, u32 *stamps,
+	MOB_Meshlet *meshlets )
+{
+	u32 count = 0, num_vertices = 0, i, k;
+	MOB_Meshlet *m = meshlets;
+
+	memset( stamps, 0, vertex_count * sizeof( u32 ) );
+
+	for( i = 0; i < num_indices; i += 3 ) {
+		u32 added = 0;
+
+		for( k = 0; k < 3; ++k ) {
+			added += ( stamps[ indices[ i + k ] ] != count );
+		}
+		if( !count || m->index_count == 3 * MOB_MESHLET_TRIANGLES
+			|| num_vertices + added > MOB_MESHLET_VERTICES )
+		{
+			m = &meshlets[ count++ ];
+			m->first_index = i;
+			m->index_count = 0;
+			num_vertices = 0;
+		}
+		for( k = 0; k < 3; ++k ) {
+			if( stamps[ indices[ i + k ] ] != count ) {
+				stamps[ indices[ i + k ] ] = count;
+				++num_vertices;
+			}
+		}
+		m->index_count += 3;
+	}
+	for( i = 0; i < count; ++i ) {
+		cook_meshlet_bounds( &meshlets[ i ], indices, vertices );
+	}
+	return count;
+}
+
+/*! Mob of any layout into an interleaved mob ready for the vertex cache
+	and the vertex fetch, with the smallest indices for its vertices. */
+static int cook_mesh( Cook_Node *node, const char *in, const char *out ) {
+	u32 v_size = 0, i_size = 0, n, i, count, num_vertices, index_size;
+	u32 header_size, num_meshlets;
+	u8 header[ MOB_MAX_HEADER ];
+	int skinned = 0, layout = 0, result = -1;
+	s32 welded;
+	float *data = 0, *vertices = 0, *sorted = 0;
+	u32 *remap = 0, *order = 0, *indices = 0;
+	void *packed = 0;
+	MOB_Meshlet *meshlets = 0;
+
+	read_mob( in, &v_size, &data, &i_size, &indices, &skinned, &layout, 0,
+		0 );
+
+	if( !data || !indices ) {
+		goto last;
+	}
+	if( skinned || i_size % 3 ) {
+		fprintf( stderr, "%s is no static mob file.\n", in );
+		goto last;
+	}
+	n = v_size / MOB_VERTEX_FLOATS;
+	vertices = malloc( n * MOB_VERTEX_FLOATS * sizeof( float ) + 1 );
+	sorted = malloc( n * MOB_VERTEX_FLOATS * sizeof( float ) + 1 );
+	remap = malloc( n * sizeof( u32 ) + 1 );
+	order = malloc( n * sizeof( u32 ) + 1 );
+	packed = malloc( i_size * sizeof( u32 ) + 1 );
+	meshlets = malloc( ( i_size / 3 + 1 ) * sizeof( MOB_Meshlet ) );
+
+	if( !vertices || !sorted || !remap || !order || !packed || !meshlets ) {
+		goto last;
+	}
+	float before = cook_acmr( indices, i_size );
+
+	welded = cook_weld( layout, data, n, vertices, remap );
+	if( welded < 0 ) {
+		goto last;
+	}
+	num_vertices = welded;
+
+	for( i = 0; i < i_size; ++i ) {
+		indices[ i ] = remap[ indices[ i ] ];
+	}
+	if( cook_order_triangles( indices, i_size, num_vertices ) < 0 ) {
+		goto last;
+	}
+	/* vertices in the order the triangles use them, unused ones dropped */
+	memset( order, 0xFF, num_vertices * sizeof( u32 ) );
+
+	for( i = 0, count = 0; i < i_size; ++i ) {
+		u32 v = indices[ i ];
+
+		if( 0xFFFFFFFFU == order[ v ] ) {
+			order[ v ] = count;
+			memcpy( sorted + count++ * MOB_VERTEX_FLOATS,
+				vertices + v * MOB_VERTEX_FLOATS,
+				MOB_VERTEX_FLOATS * sizeof( float ) );
+		}
+		indices[ i ] = order[ v ];
+	}
+	num_meshlets = cook_meshlets( indices, i_size, sorted, count, remap,
+		meshlets );
+	header_size = mob_write_header( header, VBO_INTERLEAVED, count, i_size,
+		num_meshlets, &index_size );
+	mob_pack_indices( indices, i_size, index_size, packed );
+
+	const void *parts[ 4 ] = { header, sorted, packed, meshlets };
+	size_t sizes[ 4 ] = { header_size,
+		( size_t ) count * MOB_VERTEX_FLOATS * sizeof( float ),
+		( size_t ) i_size * index_size,
+		num_meshlets * sizeof( MOB_Meshlet ) };
+
+	if( cook_write( out, parts, sizes, 4 ) < 0 ) {
+		goto last;
+	}
+	snprintf( node->note, sizeof( node->note ), "%u -> %u vertices, %u bit "
+		"indices, %u meshlets, ACMR %.3f -> %.3f", n, count, 8 * index_size,
+		num_meshlets, before, cook_acmr( indices, i_size ) );
+	result = 0;
+last:
+	free( data );
+	free( vertices );
+	free( sorted );
+	free( remap );
+	free( order );
+	free( indices );
+	free( packed );
+	free( meshlets );
+	return result;
+}
+
+/*! Binary PPM into an RGBA8 ktx of one level. */
+static int cook_texture( Cook_Node *node, const char *in, const char *out ) {
+	const u8 identifier[ 12 ] = {
+		0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+	};
+	u32 width = 0, height = 0, max = 0, bytes, i;
+	size_t size;
+	int offset = 0, result = -1;
+	KTX_Header header;
+	u8 *file = cook_read( in, &size ), *pixels = 0;
+
+	if( !file ) {
+		return -1;
+	}
+	if( 3 != sscanf( ( const char * ) file, "P6 %u %u %u%n", &width, &height,
+		&max, &offset ) || 255 != max || !width || !height
+		|| size < offset + 1 + ( size_t ) width * height * 3 )
+	{
+		fprintf( stderr, "%s is no binary 8 bit PPM.\n", in );
+		goto last;
+	}
+	bytes = width * height * 4;
+
+	if( !( pixels = malloc( bytes ) ) ) {
+		goto last;
+	}
+	for( i = 0; i < width * height; ++i ) { /* one whitespace after max */
+		memcpy( pixels + 4 * i, file + offset + 1 + 3 * i, 3 );
+		pixels[ 4 * i + 3 ] = 255;
+	}
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.identifier, identifier, 12 );
+	header.endianess = 0x04030201;
+	header.type = COOK_UNSIGNED_BYTE;
+	header.type_size = 1;
+	header.format = COOK_RGBA;
+	header.internal_format = COOK_RGBA8;
+	header.base_internal_format = COOK_RGBA;
+	header.pixel_width = width;
+	header.pixel_height = height;
+	header.num_faces = 1;
+	header.num_mipmap_levels = 1;
+
+	const void *parts[ 3 ] = { &header, &bytes, pixels };
+	size_t sizes[ 3 ] = { sizeof( header ), 4, bytes };
+	result = cook_write( out, parts, sizes, 3 );
+	snprintf( node->note, sizeof( node->note ), "%u x %u texels", width,
+		height );
+last:
+	free( file );
+	free( pixels );
+	return result;
+}
+
+/*! Name of the output of a source file, ppm become ktx. */
+static void cook_output_name( const char *path, char *out ) {
+	size_t len = strlen( path );
+
+	snprintf( out, COOK_PATH, "%s", path );
+	if( len > 4 && !strcmp( path + len - 4, ".ppm" ) ) {
+		memcpy( out + len - 4, ".ktx", 4 );
+	}
+}
+
+/*! Scene file with the texture names of the cooked files. */
+static int cook_scene( Cook_Node *node, const char *in, const char *out ) {
+	size_t size, used = 0, cap;
+	char *file = ( char * ) cook_read( in, &size ), *line, *end, *text;
+	char name[ COOK_PATH ];
+	int result = -1;
+
+	if( !file ) {
+		return -1;
+	}
+	cap = size + 2; /* ktx as long as ppm, maybe a last newline */
+	text = malloc( cap );
+
+	for( line = file; text && line < file + size; line = end + 1 ) {
+		end = strchr( line, '\n' );
+		if( !end ) {
+			end = file + size;
+		}
+		*end = 0;
+
+		if( !strncmp( line, "texture ", 8 ) ) {
+			cook_output_name( line + 8, name );
+			used += snprintf( text + used, cap - used, "texture %s\n", name );
+		} else {
+			used += snprintf( text + used, cap - used, "%s\n", line );
+		}
+	}
+	if( text ) {
+		const void *parts[ 1 ] = { text };
+		result = cook_write( out, parts, &used, 1 );
+	}
+	free( text );
+	free( file );
+	return result;
+}
+
+//------------------------------------------------------------------------------
+
+static int cook_compare( const void *a, const void *b ) {
+	return strcmp( ( ( const Cook_Node * ) a )->path,
+		( ( const Cook_Node * ) b )->path );
+}
+
+static Cook_Node *cook_find( Cook *c, const char *path ) {
+	Cook_Node key;
+	snprintf( key.path, COOK_PATH, "%s", path );
+	return bsearch( &key, c->nodes, c->num_nodes, sizeof( Cook_Node ),
+		cook_compare );
+}
+
+/*! Adds the files below dir, relative to the source directory, and
+	creates the directories of the outputs. */
+static int cook_walk( Cook *c, const char *dir ) {
+	char path[ 2 * COOK_PATH ], rel[ COOK_PATH ];
+	struct dirent *e;
+	struct stat st;
+	DIR *d;
+	int result = 0;
+
+	snprintf( path, sizeof( path ), "%s/%s", c->dst, dir );
+	if( mkdir( path, 0755 ) < 0 && EEXIST != errno ) {
+		fprintf( stderr, "Could not create directory %s\n", path );
+		return -1;
+	}
+	snprintf( path, sizeof( path ), "%s/%s", c->src, dir );
+	if( !( d = opendir( path ) ) ) {
+		fprintf( stderr, "Could not read directory %s\n", path );
+		return -1;
+	}
+	while( !result && ( e = readdir( d ) ) ) {
+		size_t len = strlen( e->d_name );
+
+		if( '.' == e->d_name[ 0 ] || ( len > 4
+			&& !strcmp( e->d_name + len - 4, ".tmp" ) ) )
+		{
+			continue;
+		}
+		if( snprintf( rel, COOK_PATH, "%s%s%s", dir, *dir ? "/" : "",
+			e->d_name ) >= ( int ) COOK_PATH )
+		{
+			fprintf( stderr, "Path of %s too long.\n", e->d_name );
+			continue;
+		}
+		snprintf( path, sizeof( path ), "%s/%s", c->src, rel );
+
+		if( stat( path, &st ) < 0 ) {
+			continue;
+		}
+		if( S_ISDIR( st.st_mode ) ) {
+			result = cook_walk( c, rel );
+			continue;
+		}
+		if( !S_ISREG( st.st_mode ) ) {
+			continue;
+		}
+		if( c->num_nodes == c->max_nodes ) {
+			u32 m = c->max_nodes ? 2 * c->max_nodes : 256;
+			Cook_Node *tmp = realloc( c->nodes, m * sizeof( Cook_Node ) );
+			if( !tmp ) {
+				result = -1;
+				break;
+			}
+			c->nodes = tmp;
+			c->max_nodes = m;
+		}
+		Cook_Node *n = &c->nodes[ c->num_nodes++ ];
+		memset( n, 0, sizeof( Cook_Node ) );
+		snprintf( n->path, COOK_PATH, "%s", rel );
+		cook_output_name( rel, n->out );
+		n->size = st.st_size;
+		n->mtime = cook_mtime( &st );
+		n->recipe = ( len > 4 && !strcmp( e->d_name + len - 4, ".mob" ) )
+			? RECIPE_MESH : ( strcmp( n->out, n->path ) ? RECIPE_TEXTURE
+			: RECIPE_COPY );
+	}
+	closedir( d );
+	return result;
+}
+
+/*! Reads the cache file of the output directory, a missing one is empty. */
+static void cook_load_cache( Cook *c ) {
+	char file[ COOK_PATH + 16 ], path[ COOK_PATH ];
+	unsigned long long key, hash;
+	long long size, mtime;
+	unsigned recipe;
+	FILE *fh;
+
+	snprintf( file, sizeof( file ), "%s/%s", c->dst, COOK_CACHE_FILE );
+	if( !( fh = fopen( file, "r" ) ) ) {
+		return;
+	}
+	while( 6 == fscanf( fh, "%llx %lld %lld %llx %u %255[^\n]", &key, &size,
+		&mtime, &hash, &recipe, path ) )
+	{
+		Cook_Node *n = cook_find( c, path );
+		if( n && recipe <= RECIPE_SCENE ) {
+			n->cached_recipe = recipe;
+			n->cached = 1;
+			n->cached_key = key;
+			n->cached_size = size;
+			n->cached_mtime = mtime;
+			n->cached_hash = hash;
+		}
+	}
+	fclose( fh );
+}
+
+static int cook_save_cache( Cook *c ) {
+	char file[ COOK_PATH + 16 ], tmp[ COOK_PATH + 32 ];
+	FILE *fh;
+	u32 i;
+
+	snprintf( file, sizeof( file ), "%s/%s", c->dst, COOK_CACHE_FILE );
+	snprintf( tmp, sizeof( tmp ), "%s.tmp", file );
+	if( !( fh = fopen( tmp, "w" ) ) ) {
+		fprintf( stderr, "Could not write file %s\n", tmp );
+		return -1;
+	}
+	for( i = 0; i < c->num_nodes; ++i ) {
+		const Cook_Node *n = &c->nodes[ i ];
+
+		if( COOK_FAILED != n->state ) {
+			fprintf( fh, "%016llx %lld %lld %016llx %u %s\n",
+				( unsigned long long ) n->key, ( long long ) n->size,
+				( long long ) n->mtime, ( unsigned long long ) n->hash,
+				n->recipe, n->path );
+		}
+	}
+	if( fclose( fh ) || rename( tmp, file ) ) {
+		fprintf( stderr, "Could not write file %s\n", file );
+		return -1;
+	}
+	return 0;
+}
+
+/*! 1 if the source has the size and time it had in the cache. */
+static int cook_unchanged( const Cook_Node *n ) {
+	return n->cached && n->cached_size == n->size
+		&& n->cached_mtime == n->mtime;
+}
+
+/*! Job hashing a source whose size or time changed. Scenes are always
+	read, for the names of their meshes and textures. */
+static void cook_hash_job( void *arg ) {
+	Cook_Job *j = arg;
+	Cook_Node *n = j->n;
+	char path[ 2 * COOK_PATH ];
+	size_t size, count = 0;
+	u8 *data;
+
+	snprintf( path, sizeof( path ), "%s/%s", j->c->src, n->path );
+	if( cook_unchanged( n ) && RECIPE_SCENE != n->cached_recipe ) {
+		n->hash = n->cached_hash;
+		n->recipe = n->cached_recipe;
+		return;
+	}
+	if( !( data = cook_read( path, &size ) ) ) {
+		n->state = COOK_FAILED;
+		return;
+	}
+	n->hash = cook_hash( COOK_HASH_SEED, data, size );
+
+	/* any file might be a scene, only their first line tells */
+	if( !strncmp( ( const char * ) data, COOK_SCENE_MAGIC,
+		strlen( COOK_SCENE_MAGIC ) ) )
+	{
+		const char *dir = strrchr( n->path, '/' );
+		int dir_len = dir ? ( int ) ( dir - n->path + 1 ) : 0;
+		char *line, *end, name[ COOK_PATH ];
+
+		n->recipe = RECIPE_SCENE;
+		for( line = ( char * ) data; line < ( char * ) data + size;
+			line = end + 1 )
+		{
+			if( !( end = strchr( line, '\n' ) ) ) {
+				end = ( char * ) data + size;
+			}
+			if( ( strncmp( line, "mesh ", 5 ) && strncmp( line, "texture ", 8 ) )
+				|| 1 != sscanf( line, "%*s %255s", name ) )
+			{
+				continue;
+			}
+			if( count == n->num_deps ) {
+				count = count ? 2 * count : 16;
+				void *tmp = realloc( n->dep_names, count * COOK_PATH );
+				if( !tmp ) {
+					n->state = COOK_FAILED;
+					break;
+				}
+				n->dep_names = tmp;
+			}
+			if( snprintf( n->dep_names[ n->num_deps++ ], COOK_PATH, "%.*s%s",
+				dir_len, n->path, name ) >= ( int ) COOK_PATH )
+			{
+				fprintf( stderr, "Path of %s too long.\n", name );
+				n->state = COOK_FAILED;
+			}
+		}
+	}
+	free( data );
+}
+
+/*! Job cooking one outdated node. */
+static void cook_job( void *arg ) {
+	Cook_Job *j = arg;
+	Cook_Node *n = j->n;
+	char in[ 2 * COOK_PATH ], out[ 2 * COOK_PATH ];
+	int result = -1;
+	u32 i;
+
+	snprintf( in, sizeof( in ), "%s/%s", j->c->src, n->path );
+	snprintf( out, sizeof( out ), "%s/%s", j->c->dst, n->out );
+
+	for( i = 0; i < n->num_deps; ++i ) {
+		if( COOK_FAILED == j->c->nodes[ n->deps[ i ] ].state ) {
+			fprintf( stderr, "%s names %s which failed.\n", n->path,
+				j->c->nodes[ n->deps[ i ] ].path );
+			n->state = COOK_FAILED;
+			return;
+		}
+	}
+	switch( n->recipe ) {
+		case RECIPE_MESH: result = cook_mesh( n, in, out ); break;
+		case RECIPE_TEXTURE: result = cook_texture( n, in, out ); break;
+		case RECIPE_SCENE: result = cook_scene( n, in, out ); break;
+		default: {
+			size_t size;
+			u8 *data = cook_read( in, &size );
+			const void *parts[ 1 ] = { data };
+			result = data ? cook_write( out, parts, &size, 1 ) : -1;
+			free( data );
+		}
+	}
+	n->state = ( result < 0 ) ? COOK_FAILED : COOK_DONE;
+}
+
+/*! Key of a node from its hash, recipe and dependencies, which have their
+	keys already. */
+static void cook_key( Cook *c, Cook_Node *n ) {
+	u32 version[ 3 ] = { COOK_VERSION, n->recipe,
+		recipe_versions[ n->recipe ] };
+	u32 i;
+
+	n->key = cook_hash( COOK_HASH_SEED, &n->hash, sizeof( n->hash ) );
+	n->key = cook_hash( n->key, version, sizeof( version ) );
+
+	for( i = 0; i < n->num_deps; ++i ) {
+		n->key = cook_hash( n->key, &c->nodes[ n->deps[ i ] ].key, sizeof( u64 ) );
+	}
+}
+
+/*! Cooks the outdated nodes of one level of the graph, the scenes or
+	what they name. */
+static void cook_level( Cook *c, Cook_Job *jobs, int scenes ) {
+	Job_Counter counter = { 0 };
+	char out[ 2 * COOK_PATH ];
+	struct stat st;
+	u32 i;
+
+	for( i = 0; i < c->num_nodes; ++i ) {
+		Cook_Node *n = &c->nodes[ i ];
+
+		if( ( RECIPE_SCENE == n->recipe ) != scenes
+			|| COOK_FAILED == n->state )
+		{
+			continue;
+		}
+		cook_key( c, n );
+		snprintf( out, sizeof( out ), "%s/%s", c->dst, n->out );
+
+		if( !c->force && n->cached && n->key == n->cached_key
+			&& !stat( out, &st ) )
+		{
+			n->state = COOK_UP_TO_DATE;
+			continue;
+		}
+		n->state = COOK_OUTDATED;
+		jobs[ i ] = ( Cook_Job ) { c, n };
+		jobs_submit( &c->jobs, &counter, cook_job, &jobs[ i ] );
+	}
+	jobs_wait( &c->jobs, &counter );
+}
+
+static int cook( Cook *c ) {
+	Job_Counter counter = { 0 };
+	Cook_Job *jobs = 0;
+	u32 i, j, counts[ COOK_FAILED + 1 ] = { 0 }, hashed = 0;
+	double start = cook_milliseconds( );
+	int result = -1;
+
+	if( mkdir( c->dst, 0755 ) < 0 && EEXIST != errno ) {
+		fprintf( stderr, "Could not create directory %s\n", c->dst );
+		return -1;
+	}
+	if( cook_walk( c, "" ) < 0 ) {
+		goto last;
+	}
+	qsort( c->nodes, c->num_nodes, sizeof( Cook_Node ), cook_compare );
+	cook_load_cache( c );
+
+	if( !( jobs = malloc( ( c->num_nodes + 1 ) * sizeof( Cook_Job ) ) ) ) {
+		goto last;
+	}
+	for( i = 0; i < c->num_nodes; ++i ) {
+		Cook_Node *n = &c->nodes[ i ];
+		hashed += !cook_unchanged( n );
+		jobs[ i ] = ( Cook_Job ) { c, n };
+		jobs_submit( &c->jobs, &counter, cook_hash_job, &jobs[ i ] );
+	}
+	jobs_wait( &c->jobs, &counter );
+
+	/* the edges of the graph, scenes to what they name */
+	for( i = 0; i < c->num_nodes; ++i ) {
+		Cook_Node *n = &c->nodes[ i ];
+
+		if( n->num_deps && !( n->deps = malloc( n->num_deps * sizeof( u32 ) ) ) ) {
+			goto last;
+		}
+		for( j = 0; j < n->num_deps; ++j ) {
+			Cook_Node *d = cook_find( c, n->dep_names[ j ] );
+
+			if( !d || RECIPE_SCENE == d->recipe ) {
+				fprintf( stderr, "%s names %s which is no mesh or texture.\n",
+					n->path, n->dep_names[ j ] );
+				n->state = COOK_FAILED;
+				n->num_deps = j;
+				break;
+			}
+			n->deps[ j ] = d - c->nodes;
+		}
+	}
+	cook_level( c, jobs, 0 );
+	cook_level( c, jobs, 1 );
+
+	for( i = 0; i < c->num_nodes; ++i ) {
+		const Cook_Node *n = &c->nodes[ i ];
+		counts[ n->state ]++;
+
+		if( c->verbose && COOK_DONE == n->state ) {
+			printf( "cooked %s%s%s\n", n->out, *n->note ? ": " : "", n->note );
+		}
+	}
+	result = cook_save_cache( c );
+	printf( "%u files, %u hashed, %u cooked, %u up to date, %u failed in "
+		"%.1f ms with %u threads\n", c->num_nodes, hashed,
+		counts[ COOK_DONE ], counts[ COOK_UP_TO_DATE ], counts[ COOK_FAILED ],
+		cook_milliseconds( ) - start, c->jobs.num_threads + 1 );
+	if( counts[ COOK_FAILED ] ) {
+		result = -1;
+	}
+last:
+	for( i = 0; i < c->num_nodes; ++i ) {
+		free( c->nodes[ i ].dep_names );
+		free( c->nodes[ i ].deps );
+	}
+	free( jobs );
+	free( c->nodes );
+	return result;
+}
+
+int main( int argc, char **argv ) {
+	Cook c;
+	int i, threads = 0, result;
+
+	memset( &c, 0, sizeof( Cook ) );
+
+	for( i = 1; i < argc; ++i ) {
+		if( 0 == strcmp( argv[ i ], "-j" ) && i + 1 < argc ) {
+			threads = atoi( argv[ ++i ] );
+		} else if( 0 == strcmp( argv[ i ], "-v" ) ) {
+			c.verbose = 1;
+		} else if( 0 == strcmp( argv[ i ], "--force" ) ) {
+			c.force = 1;
+		} else if( !c.src ) {
+			c.src = argv[ i ];
+		} else {
+			c.dst = argv[ i ];
+		}
+	}
+	if( !c.src || !c.dst ) {
+		fprintf( stderr, "usage: %s <source dir> <out dir> [-j threads] [-v] "
+			"[--force]\n", argv[ 0 ] );
+		return -1;
+	}
+	/* the calling thread cooks in jobs_wait, -j 1 starts no workers */
+	jobs_init( &c.jobs, ( threads > 1 ) ? threads - 1 : -threads );
+	result = cook( &c );
+	jobs_shutdown( &c.jobs );
+	return result < 0 ? -1 : 0;
+}
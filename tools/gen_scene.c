@@ -0,0 +1,319 @@
+/* gcc -Wall -O2 -o gen_scene tools/gen_scene.c -lm */
+
+/*
+	Writes a synthetic scene for scaling benchmarks, all of it derived from
+	one seed:
+
+		<dir>/mesh_000.mob ...		lumpy spheres, interleaved MOB files
+		<dir>/texture_000.ktx ...	RGBA8 KTX files
+		<dir>/scene.txt				objects and point lights, see scene.c
+
+	The objects fill a box in front of the camera with a constant density,
+	so the visible fraction stays similar from 10 to 1M objects.
+*/
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "../types.h"
+#include "../assets.h"
+#include "../arena.c"
+#include "../mob.c"
+
+#define GEN_MAX_RINGS		(1024U)	/* 8M triangles, 32 bit indices */
+#define GEN_SPACING			(1.5f)	/* Average distance between objects. */
+#define GEN_RADIUS			(0.5f)	/* Mesh radius before the object scale. */
+#define GEN_UNSIGNED_BYTE	(0x1401U)
+#define GEN_RGBA			(0x1908U)
+#define GEN_RGBA8			(0x8058U)
+
+typedef struct {
+	const char *dir;
+	u32 objects;
+	u32 triangles;		/*! Per mesh. */
+	u32 meshes;			/*! Distinct meshes the objects share. */
+	u32 textures;
+	u32 texture_size;
+	u32 lights;
+	u32 seed;
+} Gen_Options;
+
+static u32 gen_rand( u32 *seed ) { /* same LCG as setup_light */
+	*seed = *seed * 1103515245U + 12345U;
+	return ( *seed >> 16 ) & 0x7FFF;
+}
+
+static float gen_randf( u32 *seed, float min, float max ) {
+	return min + ( max - min ) * ( float ) gen_rand( seed ) / 32767.0f;
+}
+
+/*! UV sphere with rings * 2 rings quads, the radius displaced by a few
+	seeded waves. Normals are the average of the face normals. */
+static int gen_mesh( const char *file, u32 triangles, u32 *seed ) {
+	u32 rings = ( u32 ) ( sqrtf( triangles / 4.0f ) + 0.5f );
+	u32 segments, num_vertices, num_indices, header_size, index_size, i, j, k;
+	float phase[ 3 ], freq[ 3 ], amp = gen_randf( seed, 0.05f, 0.25f );
+	u8 header[ MOB_MAX_HEADER ];
+
+	if( rings < 2 ) rings = 2;
+	if( rings > GEN_MAX_RINGS ) rings = GEN_MAX_RINGS;
+	segments = 2 * rings;
+	num_vertices = ( rings + 1 ) * ( segments + 1 );
+	num_indices = 6 * rings * segments;
+
+	for( k = 0; k < 3; ++k ) {
+		phase[ k ] = gen_randf( seed, 0.0f, 6.2832f );
+		freq[ k ] = gen_randf( seed, 1.0f, 5.0f );
+	}
+	float *v = calloc( num_vertices * 8, sizeof( float ) );
+	u32 *idx = malloc( num_indices * sizeof( u32 ) );
+	if( !v || !idx ) {
+		free( v );
+		free( idx );
+		return -1;
+	}
+	for( i = 0; i <= rings; ++i ) {
+		float theta = 3.14159265f * i / rings;
+
+		for( j = 0; j <= segments; ++j ) {
+			float phi = 6.2831853f * ( j % segments ) / segments;
+			float n[ 3 ] = {
+				sinf( theta ) * cosf( phi ), cosf( theta ),
+				sinf( theta ) * sinf( phi ) };
+			float r = 1.0f;
+			float *p = v + ( i * ( segments + 1 ) + j ) * 8;
+
+			for( k = 0; k < 3; ++k ) {
+				r += amp * sinf( freq[ k ] * n[ k ] + phase[ k ] ) / 3.0f;
+			}
+			p[ 0 ] = GEN_RADIUS * r * n[ 0 ];
+			p[ 1 ] = GEN_RADIUS * r * n[ 1 ];
+			p[ 2 ] = GEN_RADIUS * r * n[ 2 ];
+			p[ 6 ] = ( float ) j / segments;
+			p[ 7 ] = ( float ) i / rings;
+		}
+	}
+	for( i = 0, k = 0; i < rings; ++i ) {
+		for( j = 0; j < segments; ++j ) {
+			u32 a = i * ( segments + 1 ) + j, b = a + segments + 1;
+			u32 quad[ 6 ] = { a, a + 1, b, a + 1, b + 1, b };
+			memcpy( idx + k, quad, sizeof( quad ) );
+			k += 6;
+		}
+	}
+	for( k = 0; k < num_indices; k += 3 ) { /* accumulate face normals */
+		float *a = v + idx[ k ] * 8, *b = v + idx[ k + 1 ] * 8;
+		float *c = v + idx[ k + 2 ] * 8;
+		float e0[ 3 ], e1[ 3 ], n[ 3 ];
+
+		for( j = 0; j < 3; ++j ) {
+			e0[ j ] = b[ j ] - a[ j ];
+			e1[ j ] = c[ j ] - a[ j ];
+		}
+		n[ 0 ] = e0[ 1 ] * e1[ 2 ] - e0[ 2 ] * e1[ 1 ];
+		n[ 1 ] = e0[ 2 ] * e1[ 0 ] - e0[ 0 ] * e1[ 2 ];
+		n[ 2 ] = e0[ 0 ] * e1[ 1 ] - e0[ 1 ] * e1[ 0 ];
+
+		for( j = 0; j < 3; ++j ) {
+			a[ 3 + j ] += n[ j ];
+			b[ 3 + j ] += n[ j ];
+			c[ 3 + j ] += n[ j ];
+		}
+	}
+	for( i = 0; i < num_vertices; ++i ) {
+		float *n = v + i * 8 + 3;
+		float l = sqrtf( n[ 0 ] * n[ 0 ] + n[ 1 ] * n[ 1 ] + n[ 2 ] * n[ 2 ] );
+		if( l > 0.0f ) {
+			n[ 0 ] /= l, n[ 1 ] /= l, n[ 2 ] /= l;
+		} else { /* poles, all faces degenerate */
+			n[ 0 ] = 0.0f, n[ 1 ] = ( i < segments + 1 ) ? 1.0f : -1.0f;
+		}
+	}
+	header_size = mob_write_header( header, VBO_INTERLEAVED, num_vertices,
+		num_indices, 0, &index_size );
+	mob_pack_indices( idx, num_indices, index_size, idx ); /* narrows in place */
+
+	FILE *fh = fopen( file, "wb" );
+	if( !fh ) {
+		fprintf( stderr, "Could not write file %s\n", file );
+		free( v );
+		free( idx );
+		return -1;
+	}
+	fwrite( header, header_size, 1, fh );
+	fwrite( v, sizeof( float ), num_vertices * 8, fh );
+	fwrite( idx, index_size, num_indices, fh );
+	fclose( fh );
+	free( v );
+	free( idx );
+	return 2 * rings * segments;
+}
+
+/*! Checker board of two seeded colors with a noise pattern on top. */
+static int gen_texture( const char *file, u32 size, u32 *seed ) {
+	const u8 identifier[ 12 ] = {
+		0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+	};
+	u32 x, y, k, bytes = size * size * 4, cell = size / 8;
+	u8 colors[ 2 ][ 3 ];
+	KTX_Header header;
+
+	for( k = 0; k < 6; ++k ) {
+		colors[ k / 3 ][ k % 3 ] = 64 + gen_rand( seed ) % 192;
+	}
+	u8 *pixels = malloc( bytes );
+	if( !pixels ) {
+		return -1;
+	}
+	for( y = 0; y < size; ++y ) {
+		for( x = 0; x < size; ++x ) {
+			const u8 *c = colors[ ( x / cell + y / cell ) & 1 ];
+			u8 *p = pixels + ( y * size + x ) * 4;
+			int noise = ( int ) ( gen_rand( seed ) & 31 ) - 16;
+
+			for( k = 0; k < 3; ++k ) {
+				int value = c[ k ] + noise;
+				p[ k ] = value < 0 ? 0 : ( value > 255 ? 255 : value );
+			}
+			p[ 3 ] = 255;
+		}
+	}
+	memset( &header, 0, sizeof( header ) );
+	memcpy( header.identifier, identifier, 12 );
+	header.endianess = 0x04030201;
+	header.type = GEN_UNSIGNED_BYTE;
+	header.type_size = 1;
+	header.format = GEN_RGBA;
+	header.internal_format = GEN_RGBA8;
+	header.base_internal_format = GEN_RGBA;
+	header.pixel_width = size;
+	header.pixel_height = size;
+	header.num_faces = 1;
+	header.num_mipmap_levels = 1;
+
+	FILE *fh = fopen( file, "wb" );
+	if( !fh ) {
+		fprintf( stderr, "Could not write file %s\n", file );
+		free( pixels );
+		return -1;
+	}
+	fwrite( &header, sizeof( header ), 1, fh );
+	fwrite( &bytes, 4, 1, fh );
+	fwrite( pixels, 1, bytes, fh );
+	fclose( fh );
+	free( pixels );
+	return 0;
+}
+
+static int gen_scene( const Gen_Options *o ) {
+	char file[ 512 ];
+	u32 seed = o->seed, i;
+	int triangles = 0;
+	float extent = 0.5f * GEN_SPACING * cbrtf( ( float ) o->objects );
+
+	if( mkdir( o->dir, 0755 ) < 0 && EEXIST != errno ) {
+		fprintf( stderr, "Could not create directory %s\n", o->dir );
+		return -1;
+	}
+	for( i = 0; i < o->meshes; ++i ) {
+		snprintf( file, 512, "%s/mesh_%03u.mob", o->dir, i );
+		if( ( triangles = gen_mesh( file, o->triangles, &seed ) ) < 0 ) {
+			return -1;
+		}
+	}
+	for( i = 0; i < o->textures; ++i ) {
+		snprintf( file, 512, "%s/texture_%03u.ktx", o->dir, i );
+		if( gen_texture( file, o->texture_size, &seed ) < 0 ) {
+			return -1;
+		}
+	}
+	snprintf( file, 512, "%s/scene.txt", o->dir );
+	FILE *fh = fopen( file, "w" );
+	if( !fh ) {
+		fprintf( stderr, "Could not write file %s\n", file );
+		return -1;
+	}
+	fprintf( fh, "# opengl-test scene v1\n" );
+	fprintf( fh, "# objects %u triangles %d meshes %u textures %u lights %u "
+		"seed %u\n", o->objects, triangles, o->meshes, o->textures,
+		o->lights, o->seed );
+
+	for( i = 0; i < o->meshes; ++i ) {
+		fprintf( fh, "mesh mesh_%03u.mob\n", i );
+	}
+	for( i = 0; i < o->textures; ++i ) {
+		fprintf( fh, "texture texture_%03u.ktx\n", i );
+	}
+	/* mesh texture x y z heading attitude bank scale occluder */
+	for( i = 0; i < o->objects; ++i ) {
+		u32 mesh = gen_rand( &seed ) % o->meshes;
+		u32 texture = o->textures ? gen_rand( &seed ) % o->textures : 0;
+		float x = gen_randf( &seed, -extent, extent );
+		float y = gen_randf( &seed, -extent, extent );
+		float z = gen_randf( &seed, -2.0f * extent, 0.0f ) - 1.0f;
+		float h = gen_randf( &seed, 0.0f, 6.2832f );
+		float a = gen_randf( &seed, 0.0f, 6.2832f );
+		float b = gen_randf( &seed, 0.0f, 6.2832f );
+		float s = gen_randf( &seed, 0.5f, 1.5f );
+		u32 occluder = ( s > 1.4f ); /* the biggest tenth */
+
+		fprintf( fh, "object %u %u %.4f %.4f %.4f %.4f %.4f %.4f %.4f %u\n",
+			mesh, texture, x, y, z, h, a, b, s, occluder );
+	}
+	/* x y z r g b attenuation */
+	for( i = 0; i < o->lights; ++i ) {
+		float x = gen_randf( &seed, -extent, extent );
+		float y = gen_randf( &seed, -extent, extent );
+		float z = gen_randf( &seed, -2.0f * extent, 0.0f ) - 1.0f;
+		float r = gen_randf( &seed, 0.2f, 1.0f );
+		float g = gen_randf( &seed, 0.2f, 1.0f );
+		float b = gen_randf( &seed, 0.2f, 1.0f );
+
+		fprintf( fh, "light %.4f %.4f %.4f %.3f %.3f %.3f %.4f\n",
+			x, y, z, r, g, b, 4.0f / ( GEN_SPACING * GEN_SPACING ) );
+	}
+	fclose( fh );
+	printf( "%s: %u objects, %u meshes of %d triangles, %u textures, "
+		"%u lights, seed %u\n", file, o->objects, o->meshes, triangles,
+		o->textures, o->lights, o->seed );
+	return 0;
+}
+
+int main( int argc, char **argv ) {
+	Gen_Options o = { 0, 1000, 1000, 4, 4, 256, 16, 1 };
+	int i;
+
+	for( i = 1; i < argc; ++i ) {
+		if( '-' != argv[ i ][ 0 ] ) {
+			o.dir = argv[ i ];
+		} else if( i + 1 >= argc ) {
+			break;
+		} else if( 0 == strcmp( argv[ i ], "--objects" ) ) {
+			o.objects = strtoul( argv[ ++i ], 0, 10 );
+		} else if( 0 == strcmp( argv[ i ], "--triangles" ) ) {
+			o.triangles = strtoul( argv[ ++i ], 0, 10 );
+		} else if( 0 == strcmp( argv[ i ], "--meshes" ) ) {
+			o.meshes = strtoul( argv[ ++i ], 0, 10 );
+		} else if( 0 == strcmp( argv[ i ], "--textures" ) ) {
+			o.textures = strtoul( argv[ ++i ], 0, 10 );
+		} else if( 0 == strcmp( argv[ i ], "--texture-size" ) ) {
+			o.texture_size = strtoul( argv[ ++i ], 0, 10 );
+		} else if( 0 == strcmp( argv[ i ], "--lights" ) ) {
+			o.lights = strtoul( argv[ ++i ], 0, 10 );
+		} else if( 0 == strcmp( argv[ i ], "--seed" ) ) {
+			o.seed = strtoul( argv[ ++i ], 0, 10 );
+		}
+	}
+	if( !o.dir || !o.meshes || o.texture_size < 8
+		|| ( o.texture_size & ( o.texture_size - 1 ) ) )
+	{
+		fprintf( stderr, "usage: %s <dir> [--objects N] [--triangles M] "
+			"[--meshes D] [--textures K] [--texture-size power of two] "
+			"[--lights L] [--seed S]\n", argv[ 0 ] );
+		return -1;
+	}
+	return gen_scene( &o ) < 0 ? -1 : 0;
+}
@@ -0,0 +1,1518 @@
+/* gcc -Wall -O2 -o import_mesh tools/import_mesh.c -lm -lpthread */
+
+/*
+	Imports Wavefront OBJ and glTF 2.0 meshes as interleaved mob files:
+
+		import_mesh <in.obj|in.gltf|in.glb> <out.mob> [-j threads] [-v]
+
+	OBJ files are split into chunks at line starts. A first pass over all
+	chunks counts their positions, coordinates, normals and triangles, the
+	sums place every chunk in the shared arrays and a second pass parses
+	the chunks straight into their place, both passes on the job system.
+	Numbers are read eight digits at a time inside a 64 bit register.
+	Faces are triangulated as fans, negative indices count back from the
+	current line.
+
+	glTF files are read with their .bin buffers, glb files with their
+	binary chunk. The triangle primitives of the nodes of the default
+	scene are imported with the node transforms applied, files without
+	scenes import every mesh once. Texture coordinates are flipped to the
+	OBJ convention, v up.
+
+	Corners with equal position, normal and coordinate become one vertex,
+	merged with a hash map. Vertices without normal get the normal of
+	their position, the area weighted sum of its faces.
+
+	The mesh is written as one mob with indices of 8, 16 or 32 bits, the
+	fewest that reach its vertices.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../types.h"
+#include "../assets.h"
+#include "../arena.c"
+#include "../jobs.c"
+#include "../mob.c"
+
+#define IMPORT_PATH				(256U)
+#define IMPORT_CHUNK_SIZE		(1U << 20)	/* Bytes of obj per job. */
+#define IMPORT_MAX_CHUNKS		(4096U)
+#define IMPORT_PADDING			(16U)	/* Zeros after the file. */
+#define IMPORT_NONE				(0xFFFFFFFFU)	/* Missing corner index. */
+#define IMPORT_MAX_DEPTH		(64U)	/* Of json values and nodes. */
+#define IMPORT_RANGE_SIZE		(1U << 16)	/* Corners hashed per job. */
+#define IMPORT_BUCKETS			(64U)	/* At most, 4 per thread. */
+
+enum { POSITION, COORD, NORMAL };	/* index of a corner */
+
+typedef struct { /*! The mesh read from any format, before welding. */
+	const char *in, *out;
+	int verbose;
+	Job_System jobs;
+	float *positions, *coords, *normals;	/*! 3, 2 and 3 floats each. */
+	u32 num_positions, num_coords, num_normals;
+	u32 max_positions, max_coords, max_normals;
+	u32 *corners;				/*! 3 per corner, IMPORT_NONE if missing. */
+	u32 num_triangles, max_triangles;
+	float *smooth;				/*! Normal of each position. */
+	float *vertices;			/*! Welded, MOB_VERTEX_FLOATS each. */
+	u32 num_vertices, max_vertices;
+	u32 *indices, num_indices;
+	u32 *hashes, *sorted, *welded;	/*! Per corner while welding. */
+	u32 bucket_bits;			/*! Top bits of the hash picking a bucket. */
+	u32 skipped;				/*! Degenerate or non-triangle primitives. */
+} Import;
+
+typedef struct { /*! Lines of an obj file parsed by one job. */
+	Import *im;
+	const char *begin, *end;
+	u32 counts[ 3 ];			/*! Positions, coordinates, normals. */
+	u32 bases[ 3 ];				/*! Of the first one in the shared arrays. */
+	u32 num_triangles, first_triangle;
+	u32 num_lines, first_line;
+	u32 error;					/*! Line of the chunk, 0 if none. */
+} Import_Chunk;
+
+typedef struct { /*! Corners hashed and sorted into buckets by one job. */
+	Import *im;
+	u32 first, end;
+	u32 slots[ IMPORT_BUCKETS ];	/*! Counts, then the next slot of each. */
+} Import_Range;
+
+typedef struct { /*! Corners with equal top bits of the hash, merged by one
+	job into vertices numbered from base. */
+	Import *im;
+	const u32 *corners;
+	u32 count;
+	float *vertices;
+	u32 num_vertices, max_vertices;
+	u32 base;
+	int error;
+} Import_Bucket;
+
+//------------------------------------------------------------------------------
+
+static double import_milliseconds( void ) {
+	struct timespec t;
+	clock_gettime( CLOCK_MONOTONIC, &t );
+	return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+/*! Whole file in memory followed by IMPORT_PADDING zeros, 0 on failure. */
+static u8 *import_read( const char *file, size_t *size ) {
+	FILE *fh = fopen( file, "rb" );
+	u8 *data = 0;
+	long len;
+
+	if( fh && !fseek( fh, 0, SEEK_END ) && ( len = ftell( fh ) ) >= 0
+		&& !fseek( fh, 0, SEEK_SET ) && ( data = malloc( len + IMPORT_PADDING ) )
+		&& ( size_t ) len == fread( data, 1, len, fh ) )
+	{
+		memset( data + len, 0, IMPORT_PADDING );
+		*size = len;
+		fclose( fh );
+		return data;
+	}
+	fprintf( stderr, "Could not read file %s\n", file );
+	free( data );
+	if( fh ) {
+		fclose( fh );
+	}
+	return 0;
+}
+
+/*! Makes room for n more elements of size behind num, doubling. */
+static int import_reserve( void **data, u32 *max, u32 num, u32 n,
+	size_t size )
+{
+	u64 need = ( u64 ) num + n;
+	u64 m = *max ? *max : 1024;
+	void *tmp;
+
+	if( need <= *max ) {
+		return 0;
+	}
+	while( m < need ) {
+		m *= 2;
+	}
+	if( m > 0xFFFFFFFFULL || !( tmp = realloc( *data, m * size ) ) ) {
+		fprintf( stderr, "Out of memory, %llu elements.\n",
+			( unsigned long long ) need );
+		return -1;
+	}
+	*data = tmp;
+	*max = ( u32 ) m;
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+
+static const double import_powers[ 23 ] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+	1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*! 1 if the 8 bytes at s are all digits, their value in *value. Works on
+	the little endian word: each byte is checked and the digits are joined
+	pairwise, then in fours, then in eights. */
+static inline int import_eight_digits( const char *s, u32 *value ) {
+	u64 v;
+	memcpy( &v, s, 8 );
+
+	if( ( ( v & 0xF0F0F0F0F0F0F0F0ULL ) | ( ( ( v + 0x0606060606060606ULL )
+		& 0xF0F0F0F0F0F0F0F0ULL ) >> 4 ) ) != 0x3333333333333333ULL )
+	{
+		return 0;
+	}
+	v -= 0x3030303030303030ULL;
+	v = v * 10 + ( v >> 8 );
+	v = ( ( ( v & 0x000000FF000000FFULL ) * ( 100 + ( 1000000ULL << 32 ) ) )
+		+ ( ( ( v >> 16 ) & 0x000000FF000000FFULL )
+		* ( 1 + ( 10000ULL << 32 ) ) ) ) >> 32;
+	*value = ( u32 ) v;
+	return 1;
+}
+
+/*! Digits at *s into the mantissa, up to 19 significant ones. Returns the
+	number of digits read, *dropped counts the ones that did not fit. */
+static inline u32 import_digits( const char **s, u64 *mantissa,
+	u32 *significant, u32 *dropped )
+{
+	const char *p = *s;
+	u32 eight, n;
+
+	while( *significant + 8 <= 19 && import_eight_digits( p, &eight ) ) {
+		*mantissa = *mantissa * 100000000ULL + eight;
+		*significant += 8;
+		p += 8;
+	}
+	for( ; *p >= '0' && *p <= '9'; ++p ) {
+		if( *significant < 19 ) {
+			*mantissa = *mantissa * 10 + ( *p - '0' );
+			*significant += ( *mantissa > 0 );
+		} else {
+			++*dropped;
+		}
+	}
+	n = p - *s;
+	*s = p;
+	return n;
+}
+
+/*! Reads a decimal float at *s and moves *s behind it. Mantissas of up to
+	19 digits with small exponents are exact in doubles, the rest falls back
+	to strtod. -1 if there is no number. */
+static int import_float( const char **s, float *value ) {
+	const char *p = *s;
+	u64 mantissa = 0;
+	u32 significant = 0, dropped = 0, digits;
+	s32 exponent = 0;
+	int negative = ( '-' == *p );
+	double d;
+
+	p += ( '-' == *p || '+' == *p );
+	digits = import_digits( &p, &mantissa, &significant, &dropped );
+	exponent += dropped;
+
+	if( '.' == *p ) {
+		u32 n;
+
+		++p;
+		dropped = 0;
+		n = import_digits( &p, &mantissa, &significant, &dropped );
+		exponent -= n - dropped; /* each digit kept is a tenth less */
+		digits += n;
+	}
+	if( !digits ) {
+		char *end;
+		d = strtod( *s, &end ); /* inf, nan */
+		if( end == *s ) {
+			return -1;
+		}
+		*value = ( float ) d;
+		*s = end;
+		return 0;
+	}
+	if( 'e' == *p || 'E' == *p ) {
+		const char *q = p + 1;
+		int negative_exponent = ( '-' == *q );
+		s32 e = 0;
+
+		q += ( '-' == *q || '+' == *q );
+		if( *q >= '0' && *q <= '9' ) {
+			for( ; *q >= '0' && *q <= '9'; ++q ) {
+				e = ( e < 10000 ) ? e * 10 + ( *q - '0' ) : e;
+			}
+			exponent += negative_exponent ? -e : e;
+			p = q;
+		}
+	}
+	if( !mantissa ) {
+		d = 0.0;
+	} else if( mantissa < ( 1ULL << 53 ) && exponent >= -22 && exponent <= 22 ) {
+		d = ( exponent < 0 ) ? mantissa / import_powers[ -exponent ]
+			: mantissa * import_powers[ exponent ];
+	} else {
+		d = strtod( *s, 0 );
+		*value = ( float ) d;
+		*s = p;
+		return 0;
+	}
+	*value = ( float ) ( negative ? -d : d );
+	*s = p;
+	return 0;
+}
+
+//------------------------------------------------------------------------------
+
+static inline int import_space( char c ) {
+	return ' ' == c || '\t' == c || '\r' == c;
+}
+
+static inline const char *import_skip( const char *p ) {
+	while( import_space( *p ) ) {
+		++p;
+	}
+	return p;
+}
+
+/*! End of a line, \n or the end of the chunk. */
+static inline const char *import_line_end( const char *p, const char *end ) {
+	const char *e = memchr( p, '\n', end - p );
+	return e ? e : end;
+}
+
+/*! n floats of a v, vt or vn line, the ones after the first min are
+	optional and 0 if missing. */
+static int import_floats( const char *p, const char *e, float *out, u32 n,
+	u32 min )
+{
+	u32 i;
+
+	for( i = 0; i < n; ++i ) {
+		p = import_skip( p );
+
+		if( p >= e || '#' == *p ) {
+			break;
+		}
+		if( import_float( &p, &out[ i ] ) < 0
+			|| ( !import_space( *p ) && p < e && '#' != *p ) )
+		{
+			return -1;
+		}
+	}
+	for( ; i < n; ++i ) {
+		if( i < min ) {
+			return -1;
+		}
+		out[ i ] = 0.0f;
+	}
+	return 0;
+}
+
+/*! One v, v/vt, v//vn or v/vt/vn of a face, counts are the positions,
+	coordinates and normals before the line, totals those of the file. */
+static int import_corner( const char **s, const u32 *counts,
+	const u32 *totals, u32 *corner )
+{
+	const char *p = *s;
+	u32 i;
+
+	for( i = 0; i < 3; ++i ) {
+		int negative;
+		s64 value = 0;
+		const char *digits;
+
+		corner[ i ] = IMPORT_NONE;
+
+		if( i ) {
+			if( '/' != *p ) {
+				continue;
+			}
+			if( '/' == *++p && 1 == i ) {
+				continue;
+			}
+		}
+		negative = ( '-' == *p );
+		p += negative;
+
+		for( digits = p; *p >= '0' && *p <= '9' && p - digits < 10; ++p ) {
+			value = value * 10 + ( *p - '0' );
+		}
+		if( p == digits || !value ) {
+			return -1;
+		}
+		value = negative ? counts[ i ] - value : value - 1;
+
+		if( value < 0 || value >= totals[ i ] ) {
+			return -1;
+		}
+		corner[ i ] = ( u32 ) value;
+	}
+	*s = p;
+	return import_space( *p ) || !*p || '\n' == *p || '#' == *p ? 0 : -1;
+}
+
+/*! First pass of a chunk, counts what the second pass writes. */
+static void import_count_job( void *arg ) {
+	Import_Chunk *c = arg;
+	const char *p, *e;
+
+	for( p = c->begin; p < c->end; p = e + 1 ) {
+		e = import_line_end( p, c->end );
+		++c->num_lines;
+		p = import_skip( p );
+
+		if( 'v' == p[ 0 ] && import_space( p[ 1 ] ) ) {
+			++c->counts[ POSITION ];
+		} else if( 'v' == p[ 0 ] && 't' == p[ 1 ] && import_space( p[ 2 ] ) ) {
+			++c->counts[ COORD ];
+		} else if( 'v' == p[ 0 ] && 'n' == p[ 1 ] && import_space( p[ 2 ] ) ) {
+			++c->counts[ NORMAL ];
+		} else if( 'f' == p[ 0 ] && import_space( p[ 1 ] ) ) {
+			u32 n = 0;
+
+			for( ++p; p < e && '#' != *p; ) {
+				p = import_skip( p );
+				if( p < e && '#' != *p ) {
+					++n;
+					while( p < e && !import_space( *p ) ) {
+						++p;
+					}
+				}
+			}
+			c->num_triangles += ( n > 2 ) ? n - 2 : 0;
+		}
+	}
+}
+
+/*! Second pass of a chunk, parses into the places the first one counted. */
+static void import_parse_job( void *arg ) {
+	Import_Chunk *c = arg;
+	Import *im = c->im;
+	const u32 totals[ 3 ] = { im->num_positions, im->num_coords,
+		im->num_normals };
+	u32 counts[ 3 ] = { c->bases[ 0 ], c->bases[ 1 ], c->bases[ 2 ] };
+	u32 *corners = im->corners + 9 * c->first_triangle;
+	u32 line = 0;
+	const char *p, *e;
+
+	for( p = c->begin; p < c->end; p = e + 1 ) {
+		int ok = 1;
+
+		e = import_line_end( p, c->end );
+		++line;
+		p = import_skip( p );
+
+		if( 'v' == p[ 0 ] && import_space( p[ 1 ] ) ) {
+			ok = !import_floats( p + 1, e,
+				im->positions + 3 * counts[ POSITION ]++, 3, 3 );
+		} else if( 'v' == p[ 0 ] && 't' == p[ 1 ] && import_space( p[ 2 ] ) ) {
+			ok = !import_floats( p + 2, e,
+				im->coords + 2 * counts[ COORD ]++, 2, 1 );
+		} else if( 'v' == p[ 0 ] && 'n' == p[ 1 ] && import_space( p[ 2 ] ) ) {
+			ok = !import_floats( p + 2, e,
+				im->normals + 3 * counts[ NORMAL ]++, 3, 3 );
+		} else if( 'f' == p[ 0 ] && import_space( p[ 1 ] ) ) {
+			u32 first[ 3 ], previous[ 3 ], corner[ 3 ], n = 0;
+
+			for( ++p; ok; ++n ) {
+				p = import_skip( p );
+
+				if( p >= e || '#' == *p ) {
+					break;
+				}
+				ok = !import_corner( &p, counts, totals, corner );
+
+				if( !n ) {
+					memcpy( first, corner, sizeof( first ) );
+				} else if( n > 1 ) { /* fan */
+					memcpy( corners, first, sizeof( first ) );
+					memcpy( corners + 3, previous, sizeof( previous ) );
+					memcpy( corners + 6, corner, sizeof( corner ) );
+					corners += 9;
+				}
+				memcpy( previous, corner, sizeof( previous ) );
+			}
+			ok = ok && n > 2;
+		}
+		if( !ok ) {
+			c->error = line;
+			return;
+		}
+	}
+}
+
+static int import_obj( Import *im ) {
+	size_t size;
+	u8 *file = import_read( im->in, &size );
+	Import_Chunk *chunks;
+	Job_Counter counter = { 0 };
+	u32 num_chunks, i;
+	int result = -1;
+	double start = import_milliseconds( );
+
+	if( !file ) {
+		return -1;
+	}
+	num_chunks = size / IMPORT_CHUNK_SIZE + 1;
+	num_chunks = ( num_chunks > IMPORT_MAX_CHUNKS ) ? IMPORT_MAX_CHUNKS
+		: num_chunks;
+
+	if( !( chunks = calloc( num_chunks, sizeof( Import_Chunk ) ) ) ) {
+		free( file );
+		return -1;
+	}
+	/* chunks end after the first newline behind their share of the file */
+	for( i = 0; i < num_chunks; ++i ) {
+		const char *text = ( const char * ) file;
+		const char *begin = i ? chunks[ i - 1 ].end : text;
+		const char *split = text + size / num_chunks * ( i + 1 );
+		const char *e;
+
+		if( i + 1 == num_chunks ) {
+			split = text + size;
+		} else if( split < begin ) {
+			split = begin;
+		} else {
+			e = memchr( split, '\n', text + size - split );
+			split = e ? e + 1 : text + size;
+		}
+		chunks[ i ].im = im;
+		chunks[ i ].begin = begin;
+		chunks[ i ].end = split;
+		jobs_submit( &im->jobs, &counter, import_count_job, &chunks[ i ] );
+	}
+	jobs_wait( &im->jobs, &counter );
+
+	for( i = 0; i < num_chunks; ++i ) {
+		u64 triangles = ( u64 ) im->num_triangles + chunks[ i ].num_triangles;
+
+		chunks[ i ].bases[ POSITION ] = im->num_positions;
+		chunks[ i ].bases[ COORD ] = im->num_coords;
+		chunks[ i ].bases[ NORMAL ] = im->num_normals;
+		im->num_positions += chunks[ i ].counts[ POSITION ];
+		im->num_coords += chunks[ i ].counts[ COORD ];
+		im->num_normals += chunks[ i ].counts[ NORMAL ];
+
+		if( triangles > 0xFFFFFFFFULL / 9 ) {
+			fprintf( stderr, "%s has too many triangles.\n", im->in );
+			goto last;
+		}
+		chunks[ i ].first_triangle = im->num_triangles;
+		chunks[ i ].first_line = i ? chunks[ i - 1 ].first_line
+			+ chunks[ i - 1 ].num_lines : 0;
+		im->num_triangles = triangles;
+	}
+	im->max_positions = im->num_positions;
+	im->max_coords = im->num_coords;
+	im->max_normals = im->num_normals;
+	im->max_triangles = im->num_triangles;
+	im->positions = malloc( im->num_positions * 3 * sizeof( float ) + 1 );
+	im->coords = malloc( im->num_coords * 2 * sizeof( float ) + 1 );
+	im->normals = malloc( im->num_normals * 3 * sizeof( float ) + 1 );
+	im->corners = malloc( ( size_t ) im->num_triangles * 9 * sizeof( u32 ) + 1 );
+
+	if( !im->positions || !im->coords || !im->normals || !im->corners ) {
+		fprintf( stderr, "Out of memory for %s\n", im->in );
+		goto last;
+	}
+	if( im->verbose ) {
+		printf( "counted %u chunks in %.1f ms\n", num_chunks,
+			import_milliseconds( ) - start );
+	}
+	for( i = 0; i < num_chunks; ++i ) {
+		jobs_submit( &im->jobs, &counter, import_parse_job, &chunks[ i ] );
+	}
+	jobs_wait( &im->jobs, &counter );
+
+	for( i = 0; i < num_chunks; ++i ) {
+		if( chunks[ i ].error ) {
+			fprintf( stderr, "%s:%u: invalid line.\n", im->in,
+				chunks[ i ].first_line + chunks[ i ].error );
+			goto last;
+		}
+	}
+	if( im->verbose ) {
+		printf( "parsed %.1f MB in %.1f ms\n", size / 1048576.0,
+			import_milliseconds( ) - start );
+	}
+	result = 0;
+last:
+	free( chunks );
+	free( file );
+	return result;
+}
+
+//------------------------------------------------------------------------------
+
+enum { JSON_OBJECT, JSON_ARRAY, JSON_STRING, JSON_PRIMITIVE };
+
+typedef struct {
+	u32 type;
+	u32 start, end;				/*! In the text, strings without quotes. */
+	u32 size;					/*! Members or elements. */
+	u32 next;					/*! Token behind the value and its members. */
+} Json_Token;
+
+typedef struct { /*! Tokens of a json text, the members of an object follow
+	it as key and value tokens. */
+	const char *text;
+	u32 length, pos;
+	Json_Token *tokens;
+	u32 num_tokens, max_tokens;
+} Json;
+
+static s32 json_value( Json *j, u32 depth ) {
+	const char *t = j->text;
+	s32 index;
+
+	while( j->pos < j->length && ( import_space( t[ j->pos ] )
+		|| '\n' == t[ j->pos ] ) )
+	{
+		++j->pos;
+	}
+	if( j->pos >= j->length || depth > IMPORT_MAX_DEPTH
+		|| import_reserve( ( void ** ) &j->tokens, &j->max_tokens,
+			j->num_tokens, 1, sizeof( Json_Token ) ) < 0 )
+	{
+		return -1;
+	}
+	index = j->num_tokens++;
+	j->tokens[ index ] = ( Json_Token ) { JSON_PRIMITIVE, j->pos, 0, 0, 0 };
+
+	if( '{' == t[ j->pos ] || '[' == t[ j->pos ] ) {
+		int object = ( '{' == t[ j->pos ] );
+		char close = object ? '}' : ']';
+
+		j->tokens[ index ].type = object ? JSON_OBJECT : JSON_ARRAY;
+		++j->pos;
+
+		for( ;; ) {
+			while( j->pos < j->length && ( import_space( t[ j->pos ] )
+				|| '\n' == t[ j->pos ] || ',' == t[ j->pos ] ) )
+			{
+				++j->pos;
+			}
+			if( j->pos >= j->length ) {
+				return -1;
+			}
+			if( close == t[ j->pos ] ) {
+				++j->pos;
+				break;
+			}
+			if( object ) {
+				s32 key = json_value( j, depth + 1 );
+
+				if( key < 0 || JSON_STRING != j->tokens[ key ].type ) {
+					return -1;
+				}
+				while( j->pos < j->length && ( import_space( t[ j->pos ] )
+					|| '\n' == t[ j->pos ] ) )
+				{
+					++j->pos;
+				}
+				if( j->pos >= j->length || ':' != t[ j->pos++ ] ) {
+					return -1;
+				}
+			}
+			if( json_value( j, depth + 1 ) < 0 ) {
+				return -1;
+			}
+			++j->tokens[ index ].size;
+		}
+	} else if( '"' == t[ j->pos ] ) {
+		j->tokens[ index ].type = JSON_STRING;
+		j->tokens[ index ].start = ++j->pos;
+
+		while( j->pos < j->length && '"' != t[ j->pos ] ) {
+			j->pos += ( '\\' == t[ j->pos ] ) ? 2 : 1;
+		}
+		if( j->pos >= j->length ) {
+			return -1;
+		}
+		j->tokens[ index ].end = j->pos++;
+		j->tokens[ index ].next = j->num_tokens;
+		return index;
+	} else {
+		while( j->pos < j->length && !strchr( ",]} \t\r\n", t[ j->pos ] ) ) {
+			++j->pos;
+		}
+		if( j->pos == j->tokens[ index ].start ) {
+			return -1;
+		}
+	}
+	j->tokens[ index ].end = j->pos;
+	j->tokens[ index ].next = j->num_tokens;
+	return index;
+}
+
+static int json_equals( const Json *j, s32 token, const char *s ) {
+	const Json_Token *t = &j->tokens[ token ];
+	return JSON_STRING == t->type && strlen( s ) == t->end - t->start
+		&& !memcmp( j->text + t->start, s, t->end - t->start );
+}
+
+/*! Value of the member key of an object, -1 if there is none. */
+static s32 json_find( const Json *j, s32 object, const char *key ) {
+	u32 i, t;
+
+	if( object < 0 || JSON_OBJECT != j->tokens[ object ].type ) {
+		return -1;
+	}
+	for( i = 0, t = object + 1; i < j->tokens[ object ].size; ++i ) {
+		if( json_equals( j, t, key ) ) {
+			return t + 1;
+		}
+		t = j->tokens[ t + 1 ].next;
+	}
+	return -1;
+}
+
+/*! Element n of an array, -1 if out of range. */
+static s32 json_item( const Json *j, s32 array, s64 n ) {
+	u32 t;
+
+	if( array < 0 || JSON_ARRAY != j->tokens[ array ].type || n < 0
+		|| n >= j->tokens[ array ].size )
+	{
+		return -1;
+	}
+	for( t = array + 1; n--; t = j->tokens[ t ].next );
+	return t;
+}
+
+static double json_number( const Json *j, s32 token, double fallback ) {
+	if( token < 0 || JSON_PRIMITIVE != j->tokens[ token ].type ) {
+		return fallback;
+	}
+	return strtod( j->text + j->tokens[ token ].start, 0 );
+}
+
+static double json_member( const Json *j, s32 object, const char *key,
+	double fallback )
+{
+	return json_number( j, json_find( j, object, key ), fallback );
+}
+
+/*! Up to n numbers of the array key into out, the rest stays. */
+static void json_floats( const Json *j, s32 object, const char *key,
+	float *out, u32 n )
+{
+	s32 array = json_find( j, object, key );
+	u32 i;
+
+	for( i = 0; array >= 0 && i < n; ++i ) {
+		out[ i ] = json_number( j, json_item( j, array, i ), out[ i ] );
+	}
+}
+
+//------------------------------------------------------------------------------
+
+#define GLTF_BYTE			(5121U)
+#define GLTF_SHORT			(5123U)
+#define GLTF_INT			(5125U)
+#define GLTF_FLOAT			(5126U)
+#define GLTF_TRIANGLES		(4U)
+#define GLB_MAGIC			(0x46546C67U)	/* glTF */
+#define GLB_JSON			(0x4E4F534AU)
+#define GLB_BIN				(0x004E4942U)
+
+typedef struct {
+	const u8 *data;
+	size_t size;
+	u8 *owned;					/*! Read from a .bin, freed at the end. */
+} Gltf_Buffer;
+
+typedef struct {
+	Import *im;
+	Json json;
+	s32 accessors, views, meshes, nodes;	/*! Arrays of the json. */
+	Gltf_Buffer *buffers;
+	u32 num_buffers;
+} Gltf;
+
+typedef struct { /*! Elements of an accessor inside its buffer. */
+	const u8 *data;
+	u32 count, stride, component;
+} Gltf_Accessor;
+
+/*! Bit of a component type for the masks of gltf_accessor. */
+static u32 gltf_type_bit( u32 component ) {
+	return ( GLTF_BYTE == component ) ? 1 : ( GLTF_SHORT == component ) ? 2
+		: ( GLTF_INT == component ) ? 4 : ( GLTF_FLOAT == component ) ? 8 : 0;
+}
+
+/*! Checks accessor index holds elements of components of one of the
+	component types in type_mask and that they lie inside their buffer. */
+static int gltf_accessor( Gltf *g, s64 index, u32 components,
+	u32 type_mask, Gltf_Accessor *a )
+{
+	static const char *types[ ] = { "", "SCALAR", "VEC2", "VEC3" };
+	const Json *j = &g->json;
+	s32 accessor = json_item( j, g->accessors, index );
+	s32 view = json_item( j, g->views,
+		json_member( j, accessor, "bufferView", -1 ) );
+	s64 buffer = json_member( j, view, "buffer", -1 );
+	u64 offset = json_member( j, accessor, "byteOffset", 0 );
+	u64 view_offset = json_member( j, view, "byteOffset", 0 );
+	u64 view_length = json_member( j, view, "byteLength", 0 );
+	u32 size;
+
+	a->component = json_member( j, accessor, "componentType", 0 );
+	a->count = json_member( j, accessor, "count", 0 );
+	size = ( GLTF_FLOAT == a->component || GLTF_INT == a->component ) ? 4
+		: ( GLTF_SHORT == a->component ) ? 2 : 1;
+	a->stride = json_member( j, view, "byteStride", 0 );
+	a->stride = a->stride ? a->stride : size * components;
+
+	if( view < 0 || buffer < 0 || buffer >= g->num_buffers
+		|| json_find( j, accessor, "sparse" ) >= 0
+		|| !json_equals( j, json_find( j, accessor, "type" ),
+			types[ components ] )
+		|| !( gltf_type_bit( a->component ) & type_mask )
+		|| view_offset + view_length > g->buffers[ buffer ].size
+		|| ( a->count && offset + ( u64 ) ( a->count - 1 ) * a->stride
+			+ size * components > view_length ) )
+	{
+		fprintf( stderr, "Accessor %d of %s is not supported.\n", ( int ) index,
+			g->im->in );
+		return -1;
+	}
+	a->data = g->buffers[ buffer ].data + view_offset + offset;
+	return 0;
+}
+
+static inline u32 gltf_index( const Gltf_Accessor *a, u32 i ) {
+	const u8 *p = a->data + ( size_t ) i * a->stride;
+
+	if( GLTF_BYTE == a->component ) {
+		return *p;
+	} else if( GLTF_SHORT == a->component ) {
+		u16 v;
+		memcpy( &v, p, 2 );
+		return v;
+	} else {
+		u32 v;
+		memcpy( &v, p, 4 );
+		return v;
+	}
+}
+
+/*! r = a * b, column major. */
+static void gltf_multiply( float *r, const float *a, const float *b ) {
+	u32 i, k;
+
+	for( i = 0; i < 16; ++i ) {
+		r[ i ] = 0.0f;
+		for( k = 0; k < 4; ++k ) {
+			r[ i ] += a[ k * 4 + i % 4 ] * b[ i / 4 * 4 + k ];
+		}
+	}
+}
+
+/*! matrix or translation, rotation and scale of a node. */
+static void gltf_node_matrix( const Json *j, s32 node, float *m ) {
+	float t[ 3 ] = { 0.0f, 0.0f, 0.0f }, q[ 4 ] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	float s[ 3 ] = { 1.0f, 1.0f, 1.0f };
+	float x, y, z, w;
+
+	if( json_find( j, node, "matrix" ) >= 0 ) {
+		static const float identity[ 16 ] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1,
+			0, 0, 0, 0, 1 };
+		memcpy( m, identity, sizeof( identity ) );
+		json_floats( j, node, "matrix", m, 16 );
+		return;
+	}
+	json_floats( j, node, "translation", t, 3 );
+	json_floats( j, node, "rotation", q, 4 );
+	json_floats( j, node, "scale", s, 3 );
+	x = q[ 0 ], y = q[ 1 ], z = q[ 2 ], w = q[ 3 ];
+
+	m[ 0 ] = ( 1.0f - 2.0f * ( y * y + z * z ) ) * s[ 0 ];
+	m[ 1 ] = 2.0f * ( x * y + z * w ) * s[ 0 ];
+	m[ 2 ] = 2.0f * ( x * z - y * w ) * s[ 0 ];
+	m[ 4 ] = 2.0f * ( x * y - z * w ) * s[ 1 ];
+	m[ 5 ] = ( 1.0f - 2.0f * ( x * x + z * z ) ) * s[ 1 ];
+	m[ 6 ] = 2.0f * ( y * z + x * w ) * s[ 1 ];
+	m[ 8 ] = 2.0f * ( x * z + y * w ) * s[ 2 ];
+	m[ 9 ] = 2.0f * ( y * z - x * w ) * s[ 2 ];
+	m[ 10 ] = ( 1.0f - 2.0f * ( x * x + y * y ) ) * s[ 2 ];
+	m[ 3 ] = m[ 7 ] = m[ 11 ] = 0.0f;
+	m[ 12 ] = t[ 0 ], m[ 13 ] = t[ 1 ], m[ 14 ] = t[ 2 ], m[ 15 ] = 1.0f;
+}
+
+/*! Appends the triangles of a primitive transformed by m. */
+static int gltf_primitive( Gltf *g, s32 primitive, const float *m ) {
+	Import *im = g->im;
+	const Json *j = &g->json;
+	s32 attributes = json_find( j, primitive, "attributes" );
+	s32 normal = json_find( j, attributes, "NORMAL" );
+	s32 coord = json_find( j, attributes, "TEXCOORD_0" );
+	s32 indexed = json_find( j, primitive, "indices" );
+	Gltf_Accessor p, n, c, idx;
+	float cofactor[ 9 ], det;
+	u32 i, k, count;
+
+	if( GLTF_TRIANGLES != json_member( j, primitive, "mode", GLTF_TRIANGLES ) ) {
+		++im->skipped;
+		return 0;
+	}
+	if( gltf_accessor( g, json_number( j, json_find( j, attributes,
+			"POSITION" ), -1 ), 3, 8, &p ) < 0
+		|| ( normal >= 0 && gltf_accessor( g, json_number( j, normal, -1 ), 3,
+			8, &n ) < 0 )
+		|| ( coord >= 0 && gltf_accessor( g, json_number( j, coord, -1 ), 2,
+			8, &c ) < 0 )
+		|| ( indexed >= 0 && gltf_accessor( g, json_number( j, indexed, -1 ),
+			1, 1 | 2 | 4, &idx ) < 0 )
+		|| ( normal >= 0 && n.count != p.count )
+		|| ( coord >= 0 && c.count != p.count ) )
+	{
+		return -1;
+	}
+	count = ( indexed >= 0 ) ? idx.count : p.count;
+
+	if( import_reserve( ( void ** ) &im->positions, &im->max_positions,
+			im->num_positions, p.count, 3 * sizeof( float ) ) < 0
+		|| import_reserve( ( void ** ) &im->normals, &im->max_normals,
+			im->num_normals, p.count, 3 * sizeof( float ) ) < 0
+		|| import_reserve( ( void ** ) &im->coords, &im->max_coords,
+			im->num_coords, p.count, 2 * sizeof( float ) ) < 0
+		|| import_reserve( ( void ** ) &im->corners, &im->max_triangles,
+			im->num_triangles, count / 3, 9 * sizeof( u32 ) ) < 0 )
+	{
+		return -1;
+	}
+	/* normals go through the cofactors, the inverse transpose times the
+		determinant, whose sign also tells whether the winding flips */
+	for( i = 0; i < 9; ++i ) {
+		u32 r = i % 3, col = i / 3;
+		u32 r1 = ( r + 1 ) % 3, r2 = ( r + 2 ) % 3;
+		u32 c1 = ( col + 1 ) % 3, c2 = ( col + 2 ) % 3;
+		cofactor[ i ] = m[ c1 * 4 + r1 ] * m[ c2 * 4 + r2 ]
+			- m[ c1 * 4 + r2 ] * m[ c2 * 4 + r1 ];
+	}
+	det = m[ 0 ] * cofactor[ 0 ] + m[ 1 ] * cofactor[ 1 ]
+		+ m[ 2 ] * cofactor[ 2 ];
+
+	for( i = 0; i < p.count; ++i ) {
+		float v[ 3 ], *out = im->positions + 3 * ( im->num_positions + i );
+
+		memcpy( v, p.data + ( size_t ) i * p.stride, sizeof( v ) );
+		for( k = 0; k < 3; ++k ) {
+			out[ k ] = m[ k ] * v[ 0 ] + m[ 4 + k ] * v[ 1 ] + m[ 8 + k ] * v[ 2 ]
+				+ m[ 12 + k ];
+		}
+		if( normal >= 0 ) {
+			float length;
+
+			memcpy( v, n.data + ( size_t ) i * n.stride, sizeof( v ) );
+			out = im->normals + 3 * ( im->num_normals + i );
+
+			for( k = 0; k < 3; ++k ) {
+				out[ k ] = cofactor[ k ] * v[ 0 ] + cofactor[ 3 + k ] * v[ 1 ]
+					+ cofactor[ 6 + k ] * v[ 2 ];
+			}
+			length = sqrtf( out[ 0 ] * out[ 0 ] + out[ 1 ] * out[ 1 ]
+				+ out[ 2 ] * out[ 2 ] );
+			length = ( length > 0.0f ) ? ( ( det < 0.0f ) ? -1.0f : 1.0f )
+				/ length : 0.0f;
+			out[ 0 ] *= length, out[ 1 ] *= length, out[ 2 ] *= length;
+		}
+		if( coord >= 0 ) {
+			out = im->coords + 2 * ( im->num_coords + i );
+			memcpy( out, c.data + ( size_t ) i * c.stride, 2 * sizeof( float ) );
+			out[ 1 ] = 1.0f - out[ 1 ];
+		}
+	}
+	for( i = 0; i + 3 <= count; i += 3 ) {
+		u32 *corner = im->corners + 9 * im->num_triangles;
+
+		for( k = 0; k < 3; ++k ) {
+			/* a mirroring transform turns the triangle around */
+			u32 v = ( indexed >= 0 ) ? gltf_index( &idx, i + ( ( det < 0.0f
+				&& k ) ? 3 - k : k ) ) : i + ( ( det < 0.0f && k ) ? 3 - k : k );
+
+			if( v >= p.count ) {
+				fprintf( stderr, "Index %u of %s out of range.\n", i + k, im->in );
+				return -1;
+			}
+			corner[ 3 * k + POSITION ] = im->num_positions + v;
+			corner[ 3 * k + NORMAL ] = ( normal >= 0 ) ? im->num_normals + v
+				: IMPORT_NONE;
+			corner[ 3 * k + COORD ] = ( coord >= 0 ) ? im->num_coords + v
+				: IMPORT_NONE;
+		}
+		++im->num_triangles;
+	}
+	im->num_positions += p.count;
+	im->num_normals += ( normal >= 0 ) ? p.count : 0;
+	im->num_coords += ( coord >= 0 ) ? p.count : 0;
+	return 0;
+}
+
+static int gltf_mesh( Gltf *g, s64 index, const float *m ) {
+	s32 mesh = json_item( &g->json, g->meshes, index );
+	s32 primitives = json_find( &g->json, mesh, "primitives" );
+	u32 i;
+
+	if( mesh < 0 || primitives < 0 ) {
+		fprintf( stderr, "Mesh %d of %s is invalid.\n", ( int ) index,
+			g->im->in );
+		return -1;
+	}
+	for( i = 0; i < g->json.tokens[ primitives ].size; ++i ) {
+		if( gltf_primitive( g, json_item( &g->json, primitives, i ), m ) < 0 ) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int gltf_node( Gltf *g, s64 index, const float *parent, u32 depth ) {
+	const Json *j = &g->json;
+	s32 node = json_item( j, g->nodes, index );
+	s32 children = json_find( j, node, "children" );
+	float local[ 16 ], m[ 16 ];
+	u32 i;
+
+	if( node < 0 || depth > IMPORT_MAX_DEPTH ) {
+		fprintf( stderr, "Node %d of %s is invalid.\n", ( int ) index,
+			g->im->in );
+		return -1;
+	}
+	gltf_node_matrix( j, node, local );
+	gltf_multiply( m, parent, local );
+
+	if( json_find( j, node, "mesh" ) >= 0
+		&& gltf_mesh( g, json_member( j, node, "mesh", -1 ), m ) < 0 )
+	{
+		return -1;
+	}
+	for( i = 0; children >= 0 && i < j->tokens[ children ].size; ++i ) {
+		if( gltf_node( g, json_number( j, json_item( j, children, i ), -1 ), m,
+			depth + 1 ) < 0 )
+		{
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int import_gltf( Import *im ) {
+	static const float identity[ 16 ] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0,
+		0, 0, 0, 1 };
+	size_t size;
+	u8 *file = import_read( im->in, &size );
+	const char *slash = strrchr( im->in, '/' );
+	int dir_len = slash ? ( int ) ( slash - im->in + 1 ) : 0;
+	const u8 *bin = 0;
+	size_t bin_size = 0;
+	s32 scenes, scene, buffers, nodes;
+	Gltf g;
+	u32 i, header[ 5 ];
+	int result = -1;
+
+	if( !file ) {
+		return -1;
+	}
+	memset( &g, 0, sizeof( Gltf ) );
+	g.im = im;
+	g.json.text = ( const char * ) file;
+	g.json.length = size;
+	memcpy( header, file, size < sizeof( header ) ? size : sizeof( header ) );
+
+	if( size >= sizeof( header ) && GLB_MAGIC == header[ 0 ] ) {
+		/* 12 byte header, the json chunk, the binary chunk */
+		if( 2 != header[ 1 ] || GLB_JSON != header[ 4 ] || header[ 2 ] > size
+			|| 20ULL + header[ 3 ] > header[ 2 ] )
+		{
+			fprintf( stderr, "%s is no glb file of version 2.\n", im->in );
+			goto last;
+		}
+		g.json.text = ( const char * ) file + 20;
+		g.json.length = header[ 3 ];
+
+		if( 28ULL + header[ 3 ] <= header[ 2 ] ) {
+			u32 chunk[ 2 ];
+			memcpy( chunk, file + 20 + header[ 3 ], sizeof( chunk ) );
+
+			if( GLB_BIN == chunk[ 1 ] && 28ULL + header[ 3 ] + chunk[ 0 ]
+				<= header[ 2 ] )
+			{
+				bin = file + 28 + header[ 3 ];
+				bin_size = chunk[ 0 ];
+			}
+		}
+	}
+	if( json_value( &g.json, 0 ) < 0 || JSON_OBJECT != g.json.tokens[ 0 ].type ) {
+		fprintf( stderr, "%s is no json file.\n", im->in );
+		goto last;
+	}
+	g.accessors = json_find( &g.json, 0, "accessors" );
+	g.views = json_find( &g.json, 0, "bufferViews" );
+	g.meshes = json_find( &g.json, 0, "meshes" );
+	g.nodes = json_find( &g.json, 0, "nodes" );
+	buffers = json_find( &g.json, 0, "buffers" );
+	g.num_buffers = ( buffers >= 0 ) ? g.json.tokens[ buffers ].size : 0;
+
+	if( !( g.buffers = calloc( g.num_buffers + 1, sizeof( Gltf_Buffer ) ) ) ) {
+		goto last;
+	}
+	for( i = 0; i < g.num_buffers; ++i ) {
+		s32 buffer = json_item( &g.json, buffers, i );
+		s32 uri = json_find( &g.json, buffer, "uri" );
+		Gltf_Buffer *b = &g.buffers[ i ];
+		char path[ IMPORT_PATH ];
+
+		if( uri < 0 && !i && bin ) {
+			b->data = bin;
+			b->size = bin_size;
+		} else if( uri < 0 || !strncmp( g.json.text + g.json.tokens[ uri ].start,
+			"data:", 5 ) )
+		{
+			fprintf( stderr, "Buffer %u of %s is not a file.\n", i, im->in );
+			goto last;
+		} else {
+			u32 len = g.json.tokens[ uri ].end - g.json.tokens[ uri ].start;
+
+			if( dir_len + len >= IMPORT_PATH ) {
+				goto last;
+			}
+			snprintf( path, IMPORT_PATH, "%.*s%.*s", dir_len, im->in, ( int ) len,
+				g.json.text + g.json.tokens[ uri ].start );
+
+			if( !( b->owned = import_read( path, &b->size ) ) ) {
+				goto last;
+			}
+			b->data = b->owned;
+		}
+		if( b->size > json_member( &g.json, buffer, "byteLength", 0 ) ) {
+			b->size = json_member( &g.json, buffer, "byteLength", 0 );
+		}
+	}
+	scenes = json_find( &g.json, 0, "scenes" );
+	scene = json_item( &g.json, scenes, json_member( &g.json, 0, "scene", 0 ) );
+	nodes = json_find( &g.json, scene, "nodes" );
+
+	if( scene >= 0 ) {
+		for( i = 0; nodes >= 0 && i < g.json.tokens[ nodes ].size; ++i ) {
+			if( gltf_node( &g, json_number( &g.json, json_item( &g.json, nodes,
+				i ), -1 ), identity, 0 ) < 0 )
+			{
+				goto last;
+			}
+		}
+	} else {
+		for( i = 0; g.meshes >= 0 && i < g.json.tokens[ g.meshes ].size; ++i ) {
+			if( gltf_mesh( &g, i, identity ) < 0 ) {
+				goto last;
+			}
+		}
+	}
+	result = 0;
+last:
+	for( i = 0; g.buffers && i < g.num_buffers; ++i ) {
+		free( g.buffers[ i ].owned );
+	}
+	free( g.buffers );
+	free( g.json.tokens );
+	free( file );
+	return result;
+}
+
+//------------------------------------------------------------------------------
+
+/*! Normal of each position used by a corner without one. */
+static int import_smooth_normals( Import *im ) {
+	u32 i, k;
+
+	for( i = 0; i < 3 * im->num_triangles; ++i ) {
+		if( IMPORT_NONE == im->corners[ 3 * i + NORMAL ] ) {
+			break;
+		}
+	}
+	if( i == 3 * im->num_triangles ) {
+		return 0;
+	}
+	if( !( im->smooth = calloc( im->num_positions * 3 + 1, sizeof( float ) ) ) ) {
+		return -1;
+	}
+	for( i = 0; i < im->num_triangles; ++i ) {
+		const u32 *c = im->corners + 9 * i;
+		const float *a = im->positions + 3 * c[ POSITION ];
+		const float *b = im->positions + 3 * c[ 3 + POSITION ];
+		const float *d = im->positions + 3 * c[ 6 + POSITION ];
+		float u[ 3 ] = { b[ 0 ] - a[ 0 ], b[ 1 ] - a[ 1 ], b[ 2 ] - a[ 2 ] };
+		float v[ 3 ] = { d[ 0 ] - a[ 0 ], d[ 1 ] - a[ 1 ], d[ 2 ] - a[ 2 ] };
+		float n[ 3 ] = { u[ 1 ] * v[ 2 ] - u[ 2 ] * v[ 1 ],
+			u[ 2 ] * v[ 0 ] - u[ 0 ] * v[ 2 ], u[ 0 ] * v[ 1 ] - u[ 1 ] * v[ 0 ] };
+
+		for( k = 0; k < 3; ++k ) { /* the cross product is twice the area */
+			float *s = im->smooth + 3 * c[ 3 * k + POSITION ];
+			s[ 0 ] += n[ 0 ], s[ 1 ] += n[ 1 ], s[ 2 ] += n[ 2 ];
+		}
+	}
+	for( i = 0; i < im->num_positions; ++i ) {
+		float *s = im->smooth + 3 * i;
+		float length = sqrtf( s[ 0 ] * s[ 0 ] + s[ 1 ] * s[ 1 ] + s[ 2 ] * s[ 2 ] );
+
+		if( length > 0.0f ) {
+			s[ 0 ] /= length, s[ 1 ] /= length, s[ 2 ] /= length;
+		} else {
+			s[ 0 ] = 0.0f, s[ 1 ] = 0.0f, s[ 2 ] = 1.0f;
+		}
+	}
+	return 0;
+}
+
+static inline u32 import_hash( const float *v ) {
+	u64 h = 0x9E3779B97F4A7C15ULL;
+	u32 w[ MOB_VERTEX_FLOATS ], i;
+
+	memcpy( w, v, sizeof( w ) );
+	for( i = 0; i < MOB_VERTEX_FLOATS; ++i ) {
+		h = ( h ^ w[ i ] ) * 0xFF51AFD7ED558CCDULL;
+	}
+	return ( u32 ) ( h ^ ( h >> 32 ) );
+}
+
+/*! Position, normal and coordinate of the corner c. */
+static inline void import_gather( const Import *im, u32 c, float *v ) {
+	const u32 *corner = im->corners + 3 * c;
+
+	memcpy( v, im->positions + 3 * corner[ POSITION ], 3 * sizeof( float ) );
+	memcpy( v + 3, ( IMPORT_NONE == corner[ NORMAL ] ) ? im->smooth + 3
+		* corner[ POSITION ] : im->normals + 3 * corner[ NORMAL ],
+		3 * sizeof( float ) );
+
+	if( IMPORT_NONE == corner[ COORD ] ) {
+		v[ 6 ] = v[ 7 ] = 0.0f;
+	} else {
+		memcpy( v + 6, im->coords + 2 * corner[ COORD ], 2 * sizeof( float ) );
+	}
+}
+
+static inline u32 import_bucket( const Import *im, u32 hash ) {
+	return ( u32 ) ( ( u64 ) hash >> ( 32 - im->bucket_bits ) );
+}
+
+/*! Hashes the corners of a range and counts them per bucket. */
+static void import_hash_job( void *arg ) {
+	Import_Range *r = arg;
+	float v[ MOB_VERTEX_FLOATS ];
+	u32 c;
+
+	for( c = r->first; c < r->end; ++c ) {
+		import_gather( r->im, c, v );
+		r->im->hashes[ c ] = import_hash( v );
+		++r->slots[ import_bucket( r->im, r->im->hashes[ c ] ) ];
+	}
+}
+
+/*! Sorts the corners of a range into the slots of their buckets. */
+static void import_scatter_job( void *arg ) {
+	Import_Range *r = arg;
+	u32 c;
+
+	for( c = r->first; c < r->end; ++c ) {
+		r->im->sorted[ r->slots[ import_bucket( r->im, r->im->hashes[ c ] ) ]++ ]
+			= c;
+	}
+}
+
+/*! Open addressing table of size slots for the vertices of a bucket, at
+	most half full. 0 if out of memory. */
+static u32 *import_table( const Import_Bucket *b, u32 size ) {
+	u32 *table = malloc( ( size_t ) size * sizeof( u32 ) );
+	u32 i, j;
+
+	if( table ) {
+		memset( table, 0xFF, ( size_t ) size * sizeof( u32 ) );
+
+		for( i = 0; i < b->num_vertices; ++i ) {
+			j = import_hash( b->vertices + ( size_t ) i * MOB_VERTEX_FLOATS );
+
+			for( j &= size - 1; IMPORT_NONE != table[ j ]; j = ( j + 1 )
+				& ( size - 1 ) );
+			table[ j ] = i;
+		}
+	}
+	return table;
+}
+
+/*! Merges the equal corners of a bucket, no other bucket can hold them.
+	The table starts at a vertex for every 6 corners, the ratio of closed
+	meshes, and grows as needed: a small table misses the cache less. */
+static void import_bucket_job( void *arg ) {
+	Import_Bucket *b = arg;
+	Import *im = b->im;
+	u32 size = 16, mask, i;
+	u32 *table;
+
+	while( size < b->count / 3 && size < ( 1U << 31 ) ) {
+		size *= 2;
+	}
+	if( !( table = import_table( b, size ) ) ) {
+		b->error = 1;
+		return;
+	}
+	mask = size - 1;
+
+	for( i = 0; i < b->count; ++i ) {
+		u32 c = b->corners[ i ], j = im->hashes[ c ] & mask;
+		float v[ MOB_VERTEX_FLOATS ];
+
+		if( 2 * b->num_vertices >= size && size < ( 1U << 31 ) ) {
+			free( table );
+			size *= 2;
+			mask = size - 1;
+			j = im->hashes[ c ] & mask;
+
+			if( !( table = import_table( b, size ) ) ) {
+				b->error = 1;
+				return;
+			}
+		}
+		import_gather( im, c, v );
+
+		while( IMPORT_NONE != table[ j ] && memcmp( b->vertices + ( size_t )
+			table[ j ] * MOB_VERTEX_FLOATS, v, sizeof( v ) ) )
+		{
+			j = ( j + 1 ) & mask;
+		}
+		if( IMPORT_NONE == table[ j ] ) {
+			if( import_reserve( ( void ** ) &b->vertices, &b->max_vertices,
+				b->num_vertices, 1, sizeof( v ) ) < 0 )
+			{
+				b->error = 1;
+				break;
+			}
+			table[ j ] = b->num_vertices;
+			memcpy( b->vertices + ( size_t ) b->num_vertices++
+				* MOB_VERTEX_FLOATS, v, sizeof( v ) );
+		}
+		im->welded[ c ] = table[ j ];
+	}
+	free( table );
+}
+
+/*! Turns the corners into vertices and indices, equal vertices merged and
+	triangles with merged corners dropped. The corners are sorted into
+	buckets by the top bits of their hash, equal ones always land in the
+	same bucket and each bucket is merged by its own job. A bucket jumps
+	through the corners, without workers the one bucket reads them in
+	order. */
+static int import_weld( Import *im ) {
+	u32 num_corners = 3 * im->num_triangles;
+	u32 num_ranges = num_corners / IMPORT_RANGE_SIZE + 1, total = 0, i, k;
+	Import_Range *ranges = calloc( num_ranges, sizeof( Import_Range ) );
+	Import_Bucket buckets[ IMPORT_BUCKETS ];
+	Job_Counter counter = { 0 };
+	u32 num_buckets;
+	int result = -1;
+
+	for( im->bucket_bits = 0; im->jobs.num_threads && ( 1U << im->bucket_bits )
+		< 4 * ( im->jobs.num_threads + 1 ) && ( 1U << im->bucket_bits )
+		< IMPORT_BUCKETS; ++im->bucket_bits );
+	num_buckets = 1U << im->bucket_bits;
+	memset( buckets, 0, sizeof( buckets ) );
+	im->hashes = malloc( ( size_t ) num_corners * sizeof( u32 ) + 1 );
+	im->sorted = malloc( ( size_t ) num_corners * sizeof( u32 ) + 1 );
+	im->welded = malloc( ( size_t ) num_corners * sizeof( u32 ) + 1 );
+	im->indices = malloc( ( size_t ) num_corners * sizeof( u32 ) + 1 );
+
+	if( !ranges || !im->hashes || !im->sorted || !im->welded || !im->indices ) {
+		goto last;
+	}
+	for( i = 0; i < num_ranges; ++i ) {
+		ranges[ i ].im = im;
+		ranges[ i ].first = i * IMPORT_RANGE_SIZE;
+		ranges[ i ].end = ( i + 1 < num_ranges ) ? ranges[ i ].first
+			+ IMPORT_RANGE_SIZE : num_corners;
+		jobs_submit( &im->jobs, &counter, import_hash_job, &ranges[ i ] );
+	}
+	jobs_wait( &im->jobs, &counter );
+
+	/* the counts become the first slot of each range in each bucket */
+	for( k = 0; k < num_buckets; ++k ) {
+		buckets[ k ].im = im;
+		buckets[ k ].corners = im->sorted + total;
+
+		for( i = 0; i < num_ranges; ++i ) {
+			u32 n = ranges[ i ].slots[ k ];
+			ranges[ i ].slots[ k ] = total;
+			total += n;
+		}
+		buckets[ k ].count = total - ( buckets[ k ].corners - im->sorted );
+	}
+	for( i = 0; i < num_ranges; ++i ) {
+		jobs_submit( &im->jobs, &counter, import_scatter_job, &ranges[ i ] );
+	}
+	jobs_wait( &im->jobs, &counter );
+
+	for( k = 0; k < num_buckets; ++k ) {
+		jobs_submit( &im->jobs, &counter, import_bucket_job, &buckets[ k ] );
+	}
+	jobs_wait( &im->jobs, &counter );
+
+	for( k = 0; k < num_buckets; ++k ) {
+		if( buckets[ k ].error ) {
+			goto last;
+		}
+		buckets[ k ].base = im->num_vertices;
+		im->num_vertices += buckets[ k ].num_vertices;
+	}
+	im->max_vertices = im->num_vertices;
+	im->vertices = malloc( ( size_t ) im->num_vertices * MOB_VERTEX_FLOATS
+		* sizeof( float ) + 1 );
+
+	if( !im->vertices ) {
+		goto last;
+	}
+	for( k = 0; k < num_buckets; ++k ) {
+		memcpy( im->vertices + ( size_t ) buckets[ k ].base
+			* MOB_VERTEX_FLOATS, buckets[ k ].vertices, ( size_t )
+			buckets[ k ].num_vertices * MOB_VERTEX_FLOATS * sizeof( float ) );
+	}
+	for( i = 0; i < num_corners; i += 3 ) {
+		u32 *triangle = im->indices + im->num_indices;
+
+		for( k = 0; k < 3; ++k ) {
+			triangle[ k ] = buckets[ import_bucket( im, im->hashes[ i + k ] ) ].base
+				+ im->welded[ i + k ];
+		}
+		if( triangle[ 0 ] != triangle[ 1 ] && triangle[ 1 ] != triangle[ 2 ]
+			&& triangle[ 0 ] != triangle[ 2 ] )
+		{
+			im->num_indices += 3;
+		} else {
+			++im->skipped;
+		}
+	}
+	result = 0;
+last:
+	for( k = 0; k < IMPORT_BUCKETS; ++k ) {
+		free( buckets[ k ].vertices );
+	}
+	free( ranges );
+	free( im->hashes );
+	free( im->sorted );
+	free( im->welded );
+	im->hashes = im->sorted = im->welded = 0;
+	return result;
+}
+
+//------------------------------------------------------------------------------
+
+/*! Writes the welded mesh as an interleaved mob. */
+static int import_write( Import *im, u32 *index_size ) {
+	u8 header[ MOB_MAX_HEADER ];
+	u32 header_size;
+	void *packed;
+	FILE *fh;
+	int ok;
+
+	if( !im->num_indices ) {
+		fprintf( stderr, "%s has no triangles.\n", im->in );
+		return -1;
+	}
+	header_size = mob_write_header( header, VBO_INTERLEAVED,
+		im->num_vertices, im->num_indices, 0, index_size );
+
+	if( !( packed = malloc( ( size_t ) im->num_indices * *index_size ) ) ) {
+		fprintf( stderr, "Out of memory for %s\n", im->in );
+		return -1;
+	}
+	mob_pack_indices( im->indices, im->num_indices, *index_size, packed );
+	fh = fopen( im->out, "wb" );
+	ok = ( 0 != fh )
+		&& 1 == fwrite( header, header_size, 1, fh )
+		&& im->num_vertices == fwrite( im->vertices, MOB_VERTEX_FLOATS
+			* sizeof( float ), im->num_vertices, fh )
+		&& im->num_indices == fwrite( packed, *index_size, im->num_indices,
+			fh );
+	free( packed );
+
+	if( ( fh && fclose( fh ) ) || !ok ) {
+		fprintf( stderr, "Could not write file %s\n", im->out );
+		return -1;
+	}
+	return 0;
+}
+
+static int import( Import *im ) {
+	const char *dot = strrchr( im->in, '.' );
+	double start = import_milliseconds( );
+	u32 index_size;
+	int gltf = dot && ( !strcmp( dot, ".gltf" ) || !strcmp( dot, ".glb" ) );
+
+	if( ( gltf ? import_gltf( im ) : import_obj( im ) ) < 0
+		|| import_smooth_normals( im ) < 0 )
+	{
+		return -1;
+	}
+	if( im->verbose ) {
+		printf( "read %u positions, %u normals, %u coordinates in %.1f ms\n",
+			im->num_positions, im->num_normals, im->num_coords,
+			import_milliseconds( ) - start );
+	}
+	if( import_weld( im ) < 0 ) {
+		fprintf( stderr, "Out of memory for %s\n", im->in );
+		return -1;
+	}
+	if( im->verbose ) {
+		printf( "welded %u corners into %u vertices in %.1f ms\n",
+			im->num_triangles * 3, im->num_vertices,
+			import_milliseconds( ) - start );
+	}
+	if( import_write( im, &index_size ) < 0 ) {
+		return -1;
+	}
+	printf( "%s: %u triangles, %u vertices, %u bit indices, %u skipped, "
+		"%.1f ms with %u threads\n", im->in, im->num_indices / 3,
+		im->num_vertices, 8 * index_size, im->skipped,
+		import_milliseconds( ) - start, im->jobs.num_threads + 1 );
+	return 0;
+}
+
+int main( int argc, char **argv ) {
+	Import im;
+	int i, threads = 0, result;
+
+	memset( &im, 0, sizeof( Import ) );
+
+	for( i = 1; i < argc; ++i ) {
+		if( 0 == strcmp( argv[ i ], "-j" ) && i + 1 < argc ) {
+			threads = atoi( argv[ ++i ] );
+		} else if( 0 == strcmp( argv[ i ], "-v" ) ) {
+			im.verbose = 1;
+		} else if( !im.in ) {
+			im.in = argv[ i ];
+		} else {
+			im.out = argv[ i ];
+		}
+	}
+	if( !im.in || !im.out || strlen( im.out ) >= IMPORT_PATH ) {
+		fprintf( stderr, "usage: %s <in.obj|in.gltf|in.glb> <out.mob> "
+			"[-j threads] [-v]\n", argv[ 0 ] );
+		return -1;
+	}
+	/* the calling thread parses in jobs_wait, -j 1 starts no workers */
+	jobs_init( &im.jobs, ( threads > 1 ) ? threads - 1 : -threads );
+	result = import( &im );
+	jobs_shutdown( &im.jobs );
+	free( im.positions );
+	free( im.coords );
+	free( im.normals );
+	free( im.corners );
+	free( im.smooth );
+	free( im.vertices );
+	free( im.indices );
+	return result < 0 ? -1 : 0;
+}
@@ -0,0 +1,23 @@
+#!/bin/sh
+# Renders generated scenes of growing size headless and prints one CSV row
+# per size. Extra arguments go to gen_scene, e.g. --triangles 200.
+# usage: tools/sweep_scene.sh [gen_scene options] > sweep.csv
+
+DIR=${DIR:-/tmp/sweep_scene}
+FRAMES=${FRAMES:-120}
+SIZES=${SIZES:-"10 100 1000 10000 100000 1000000"}
+
+echo "objects,load_ms,cpu_p50,cpu_p95,gpu_p50,gpu_p95,gl_calls_per_frame"
+for n in $SIZES; do
+	mkdir -p "$DIR" && ./gen_scene "$DIR/$n" --objects "$n" "$@" > /dev/null || exit 1
+	load=$(./test --headless --scene "$DIR/$n/scene.txt" --frames "$FRAMES" \
+		--report "$DIR/$n/report.json" | sed -n 's/.*loaded in \([0-9.]*\) ms.*/\1/p')
+	awk -v n="$n" -v load="$load" '
+		/"cpu_ms"|"gpu_ms"/ {
+			match( $0, /"p50": [0-9.]*/ ); p50 = substr( $0, RSTART + 7, RLENGTH - 7 )
+			match( $0, /"p95": [0-9.]*/ ); p95 = substr( $0, RSTART + 7, RLENGTH - 7 )
+			row = row "," p50 "," p95
+		}
+		/"gl_calls_per_frame"/ { gsub( /[^0-9.]/, "", $2 ); calls = $2 }
+		END { print n "," load row "," calls }' "$DIR/$n/report.json"
+done
@@ -0,0 +1,211 @@
+/* gcc -Wall -O2 -o vt_tile tools/vt_tile.c */
+
+/*
+	Cuts a binary PPM (P6) into the page file of --virtual-texture:
+
+		vt_tile <image.ppm> <out.vt>
+
+	Every level is read in strips of one page row, so the image never has to
+	fit in memory. The pages get a border of their neighbours for bilinear
+	filtering, edges are clamped. Each level is the 2x2 box filter of the one
+	before, kept in a temporary file. See virtual_texture.h for the layout.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include "../types.h"
+#include "../virtual_texture.h"
+
+typedef struct {
+	FILE *fh;
+	off_t offset;		/*! Of the first row. */
+	u32 width, height;
+	u32 channels;		/*! 3 for the PPM, 4 for the levels after it. */
+} Tile_Source;
+
+static int tile_open_ppm( Tile_Source *s, const char *file ) {
+	u32 max = 0;
+
+	memset( s, 0, sizeof( Tile_Source ) );
+	s->fh = fopen( file, "rb" );
+
+	if( !s->fh || 3 != fscanf( s->fh, "P6 %u %u %u", &s->width, &s->height,
+		&max ) || 255 != max || 1 != fread( &max, 1, 1, s->fh ) )
+	{
+		fprintf( stderr, "Could not read file %s\n", file );
+		return -1;
+	}
+	s->offset = ftello( s->fh );
+	s->channels = 3;
+	return 0;
+}
+
+/*! Reads count RGBA rows from y, clamped to the last one. */
+static int tile_read_rows( const Tile_Source *s, u32 y, u32 count, u8 *rgba,
+	u8 *row )
+{
+	u32 i, x, stride = s->width * s->channels;
+
+	for( i = 0; i < count; ++i ) {
+		u32 r = ( y + i < s->height ) ? y + i : s->height - 1;
+		u8 *dst = rgba + ( size_t ) i * s->width * 4;
+
+		if( fseeko( s->fh, s->offset + ( off_t ) r * stride, SEEK_SET )
+			|| 1 != fread( row, stride, 1, s->fh ) )
+		{
+			fprintf( stderr, "Could not read row %u\n", r );
+			return -1;
+		}
+		for( x = 0; x < s->width; ++x ) {
+			const u8 *src = row + x * s->channels;
+			dst[ 4 * x + 0 ] = src[ 0 ];
+			dst[ 4 * x + 1 ] = src[ 1 ];
+			dst[ 4 * x + 2 ] = src[ 2 ];
+			dst[ 4 * x + 3 ] = ( 4 == s->channels ) ? src[ 3 ] : 255;
+		}
+	}
+	return 0;
+}
+
+/*! Writes the pages of one level and, unless it is the last one, its 2x2
+	box filter into next. */
+static int tile_level( const Tile_Source *s, FILE *out, FILE *next ) {
+	u32 cols = ( s->width + VT_PAGE_TEXELS - 1 ) / VT_PAGE_TEXELS;
+	u32 rows = ( s->height + VT_PAGE_TEXELS - 1 ) / VT_PAGE_TEXELS;
+	u32 half_w = ( s->width + 1 ) / 2, half_h = ( s->height + 1 ) / 2;
+	size_t row_bytes = ( size_t ) s->width * 4;
+	u8 *strip = malloc( row_bytes * VT_SLOT_TEXELS );
+	u8 *row = malloc( row_bytes );
+	u8 *page = malloc( VT_PAGE_BYTES );
+	u8 *half = malloc( ( size_t ) half_w * 4 );
+	u32 r, c, x, y, i;
+	int result = -1;
+
+	if( !strip || !row || !page || !half ) {
+		fprintf( stderr, "Out of memory for a strip of %u texels.\n",
+			s->width );
+		goto last;
+	}
+	for( r = 0; r < rows; ++r ) {
+		/* row -1 of the border is clamped to 0 like the rest */
+		u32 y0 = r * VT_PAGE_TEXELS;
+		u32 top = y0 ? y0 - VT_BORDER : 0;
+
+		if( tile_read_rows( s, top, VT_SLOT_TEXELS, strip, row ) < 0 ) {
+			goto last;
+		}
+		for( c = 0; c < cols; ++c ) {
+			for( y = 0; y < VT_SLOT_TEXELS; ++y ) {
+				/* strip row of page row y, clamped at the top edge */
+				u32 sy = y0 ? y : ( y ? y - VT_BORDER : 0 );
+				const u8 *src = strip + sy * row_bytes;
+				u8 *dst = page + y * VT_SLOT_TEXELS * 4;
+
+				for( x = 0; x < VT_SLOT_TEXELS; ++x ) {
+					s32 sx = ( s32 ) ( c * VT_PAGE_TEXELS + x ) - VT_BORDER;
+					sx = ( sx < 0 ) ? 0 : ( sx >= ( s32 ) s->width )
+						? ( s32 ) s->width - 1 : sx;
+					memcpy( dst + 4 * x, src + 4 * sx, 4 );
+				}
+			}
+			if( 1 != fwrite( page, VT_PAGE_BYTES, 1, out ) ) {
+				fprintf( stderr, "Could not write page %u, %u\n", c, r );
+				goto last;
+			}
+		}
+		if( !next ) {
+			continue;
+		}
+		/* rows y0 / 2 ... of the next level, both source rows are in the
+			strip */
+		for( y = y0 / 2; y < half_h && y < ( y0 + VT_PAGE_TEXELS ) / 2; ++y ) {
+			u32 sy = 2 * y - top;
+			const u8 *a = strip + sy * row_bytes;
+			const u8 *b = ( 2 * y + 1 < s->height ) ? a + row_bytes : a;
+
+			for( x = 0; x < half_w; ++x ) {
+				u32 x0 = 8 * x, x1 = ( 2 * x + 1 < s->width ) ? x0 + 4 : x0;
+				for( i = 0; i < 4; ++i ) {
+					half[ 4 * x + i ] = ( a[ x0 + i ] + a[ x1 + i ]
+						+ b[ x0 + i ] + b[ x1 + i ] + 2 ) / 4;
+				}
+			}
+			if( 1 != fwrite( half, half_w * 4, 1, next ) ) {
+				fprintf( stderr, "Could not write a temporary file\n" );
+				goto last;
+			}
+		}
+	}
+	result = 0;
+last:
+	free( strip );
+	free( row );
+	free( page );
+	free( half );
+	return result;
+}
+
+int main( int argc, char **argv ) {
+	VT_Header h = { VT_MAGIC, 0, 0, VT_PAGE_TEXELS, VT_BORDER, 1, 1, 0 };
+	Tile_Source s;
+	FILE *out = 0, *next;
+	u32 cols, rows, l;
+	int result = -1;
+
+	if( 3 != argc ) {
+		fprintf( stderr, "usage: %s <image.ppm> <out.vt>\n", argv[ 0 ] );
+		return -1;
+	}
+	if( tile_open_ppm( &s, argv[ 1 ] ) < 0 ) {
+		goto last;
+	}
+	h.width = s.width;
+	h.height = s.height;
+	cols = ( s.width + VT_PAGE_TEXELS - 1 ) / VT_PAGE_TEXELS;
+	rows = ( s.height + VT_PAGE_TEXELS - 1 ) / VT_PAGE_TEXELS;
+
+	while( h.pages < cols || h.pages < rows ) {
+		h.pages *= 2;
+		h.levels++;
+	}
+	if( !s.width || !s.height || h.levels > VT_MAX_LEVELS ) {
+		fprintf( stderr, "Image %s of %u x %u texels not supported.\n",
+			argv[ 1 ], s.width, s.height );
+		goto last;
+	}
+	out = fopen( argv[ 2 ], "wb" );
+
+	if( !out || 1 != fwrite( &h, sizeof( VT_Header ), 1, out ) ) {
+		fprintf( stderr, "Could not write file %s\n", argv[ 2 ] );
+		goto last;
+	}
+	for( l = 0; l < h.levels; ++l ) {
+		next = ( l + 1 < h.levels ) ? tmpfile( ) : 0;
+
+		if( ( l + 1 < h.levels && !next ) || tile_level( &s, out, next ) < 0 ) {
+			if( next ) {
+				fclose( next );
+			}
+			goto last;
+		}
+		fclose( s.fh );
+		s.fh = next;
+		s.offset = 0;
+		s.width = ( s.width + 1 ) / 2;
+		s.height = ( s.height + 1 ) / 2;
+		s.channels = 4;
+	}
+	printf( "%s: %u x %u texels, %u levels, %u pages per side\n", argv[ 2 ],
+		h.width, h.height, h.levels, h.pages );
+	result = 0;
+last:
+	if( s.fh ) {
+		fclose( s.fh );
+	}
+	if( out && fclose( out ) ) {
+		result = -1;
+	}
+	return result;
+}
@@ -0,0 +1,450 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "virtual_texture.h"
+
+/*! Index of page x, y of a level in the arrays over all virtual pages. */
+static u32 vt_page_index( const Virtual_Texture *vt, u32 level, u32 x, u32 y ) {
+	return vt->level_first[ level ] + y * ( vt->header.pages >> level ) + x;
+}
+
+static void vt_page_coords( const Virtual_Texture *vt, u32 page, u32 *level,
+	u32 *x, u32 *y )
+{
+	u32 l = vt->header.levels - 1;
+	while( page < vt->level_first[ l ] ) {
+		--l;
+	}
+	page -= vt->level_first[ l ];
+	*level = l;
+	*x = page % ( vt->header.pages >> l );
+	*y = page / ( vt->header.pages >> l );
+}
+
+static void vt_reset_dirty( Virtual_Texture *vt, u32 level ) {
+	vt->dirty[ level ][ 0 ] = vt->dirty[ level ][ 1 ] = VT_PINNED;
+	vt->dirty[ level ][ 2 ] = vt->dirty[ level ][ 3 ] = 0;
+}
+
+static void vt_mark_dirty( Virtual_Texture *vt, u32 level, u32 x0, u32 y0,
+	u32 x1, u32 y1 )
+{
+	u32 *d = vt->dirty[ level ];
+	d[ 0 ] = ( x0 < d[ 0 ] ) ? x0 : d[ 0 ];
+	d[ 1 ] = ( y0 < d[ 1 ] ) ? y0 : d[ 1 ];
+	d[ 2 ] = ( x1 > d[ 2 ] ) ? x1 : d[ 2 ];
+	d[ 3 ] = ( y1 > d[ 3 ] ) ? y1 : d[ 3 ];
+}
+
+/*! Points the indirection of page x, y of level and of all pages below it
+	to the slot of the page itself or of its closest resident parent. The
+	last level is always resident. */
+static void vt_refresh( Virtual_Texture *vt, u32 level, u32 x, u32 y ) {
+	u32 l = level, n = 1, i, j;
+
+	for( ;; ) {
+		u32 x0 = x << ( level - l ), y0 = y << ( level - l );
+
+		for( j = y0; j < y0 + n; ++j ) {
+			for( i = x0; i < x0 + n; ++i ) {
+				u32 page = vt_page_index( vt, l, i, j );
+				u8 *e = vt->indirection + 4 * page;
+				u32 slot = vt->page_slots[ page ];
+
+				if( slot-- ) {
+					e[ 0 ] = slot % VT_CACHE_SLOTS;
+					e[ 1 ] = slot / VT_CACHE_SLOTS;
+					e[ 2 ] = l;
+					e[ 3 ] = 255;
+				} else {
+					memcpy( e, vt->indirection
+						+ 4 * vt_page_index( vt, l + 1, i >> 1, j >> 1 ), 4 );
+				}
+			}
+		}
+		vt_mark_dirty( vt, l, x0, y0, x0 + n - 1, y0 + n - 1 );
+
+		if( 0 == l-- ) {
+			break;
+		}
+		n <<= 1;
+	}
+}
+
+/*! Reads a page from the file into a slot of the cache texture. */
+static int vt_load_page( Virtual_Texture *vt, u32 page, u32 slot ) {
+	u32 level, x, y;
+	u64 offset;
+
+	vt_page_coords( vt, page, &level, &x, &y );
+	offset = vt->level_offset[ level ]
+		+ ( ( u64 ) y * vt->level_cols[ level ] + x ) * VT_PAGE_BYTES;
+
+	if( fseeko( vt->fh, ( off_t ) offset, SEEK_SET )
+		|| 1 != fread( vt->page_data, VT_PAGE_BYTES, 1, vt->fh ) )
+	{
+		fprintf( stderr, "Could not read virtual texture page %u\n", page );
+		return -1;
+	}
+	glBindTexture( GL_TEXTURE_2D, vt->cache_tex );
+	glTexSubImage2D( GL_TEXTURE_2D, 0,
+		( slot % VT_CACHE_SLOTS ) * VT_SLOT_TEXELS,
+		( slot / VT_CACHE_SLOTS ) * VT_SLOT_TEXELS,
+		VT_SLOT_TEXELS, VT_SLOT_TEXELS, GL_RGBA, GL_UNSIGNED_BYTE,
+		vt->page_data );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	vt->slots[ slot ].page = page;
+	vt->page_slots[ page ] = slot + 1;
+	vt->resident++;
+	vt->uploads++;
+	vt_refresh( vt, level, x, y );
+	return 0;
+}
+
+/*! An empty slot or the least recently used one not needed by this frame,
+	-1 if every slot is. */
+static int vt_find_slot( Virtual_Texture *vt ) {
+	u32 i, oldest = vt->frame;
+	int best = -1;
+
+	for( i = 0; i < VT_CACHE_SLOTS * VT_CACHE_SLOTS; ++i ) {
+		const VT_Slot *s = &vt->slots[ i ];
+		if( VT_PINNED == s->page ) {
+			return i;
+		}
+		if( s->last_used < oldest ) {
+			oldest = s->last_used;
+			best = i;
+		}
+	}
+	return best;
+}
+
+static void vt_evict( Virtual_Texture *vt, u32 slot ) {
+	VT_Slot *s = &vt->slots[ slot ];
+	u32 level, x, y;
+
+	if( VT_PINNED == s->page ) {
+		return;
+	}
+	vt_page_coords( vt, s->page, &level, &x, &y );
+	vt->page_slots[ s->page ] = 0;
+	s->page = VT_PINNED;
+	vt->resident--;
+	vt->evictions++;
+	vt_refresh( vt, level, x, y );
+}
+
+/*! Marks page x, y of level and its parents as used by this frame, the
+	ones not resident are requested. */
+static void vt_mark( Virtual_Texture *vt, u32 level, u32 x, u32 y ) {
+	for( ; level < vt->header.levels; ++level, x >>= 1, y >>= 1 ) {
+		u32 page;
+
+		if( x >= vt->level_cols[ level ] || y >= vt->level_rows[ level ] ) {
+			continue;
+		}
+		page = vt_page_index( vt, level, x, y );
+
+		if( vt->page_marked[ page ] == vt->frame ) {
+			return; /* so are the parents */
+		}
+		vt->page_marked[ page ] = vt->frame;
+
+		if( vt->page_slots[ page ] ) {
+			VT_Slot *s = &vt->slots[ vt->page_slots[ page ] - 1 ];
+			if( VT_PINNED != s->last_used ) {
+				s->last_used = vt->frame;
+			}
+		} else if( vt->num_requests < vt->max_requests ) {
+			vt->requests[ vt->num_requests++ ] = page;
+		}
+	}
+}
+
+static int vt_compare_pages( const void *a, const void *b ) {
+	u32 x = *( const u32 * ) a, y = *( const u32 * ) b;
+	return ( x < y ) - ( x > y ); /* higher levels first */
+}
+
+static void vt_upload_indirection( Virtual_Texture *vt ) {
+	u32 l;
+
+	glBindTexture( GL_TEXTURE_2D, vt->indirection_tex );
+	for( l = 0; l < vt->header.levels; ++l ) {
+		const u32 *d = vt->dirty[ l ];
+		if( d[ 0 ] > d[ 2 ] ) {
+			continue;
+		}
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, vt->header.pages >> l );
+		glTexSubImage2D( GL_TEXTURE_2D, l, d[ 0 ], d[ 1 ],
+			d[ 2 ] - d[ 0 ] + 1, d[ 3 ] - d[ 1 ] + 1, GL_RGBA, GL_UNSIGNED_BYTE,
+			vt->indirection + 4 * vt_page_index( vt, l, d[ 0 ], d[ 1 ] ) );
+		vt_reset_dirty( vt, l );
+	}
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+}
+
+/*! Opens a page file of tools/vt_tile and creates the cache, indirection
+	and feedback objects for a width x height view. The last level is
+	loaded and stays resident. Call vt_free also on failure. */
+int vt_init( Virtual_Texture *vt, const char *file, int width, int height ) {
+	VT_Header *h = &vt->header;
+	u64 offset = sizeof( VT_Header ), size;
+	u32 l, cache = VT_CACHE_SLOTS * VT_SLOT_TEXELS;
+	GLint target_fbo;
+
+	memset( vt, 0, sizeof( Virtual_Texture ) );
+	vt->fh = fopen( file, "rb" );
+
+	if( !vt->fh || 1 != fread( h, sizeof( VT_Header ), 1, vt->fh ) ) {
+		fprintf( stderr, "Could not read file %s\n", file );
+		return -1;
+	}
+	if( ( VT_MAGIC != h->magic ) || ( VT_PAGE_TEXELS != h->page_texels )
+		|| ( VT_BORDER != h->border ) || ( h->levels < 1 )
+		|| ( h->levels > VT_MAX_LEVELS )
+		|| ( h->pages != ( 1U << ( h->levels - 1 ) ) )
+		|| !h->width || !h->height
+		|| ( h->width > ( u64 ) h->pages * VT_PAGE_TEXELS )
+		|| ( h->height > ( u64 ) h->pages * VT_PAGE_TEXELS ) )
+	{
+		fprintf( stderr, "Virtual texture %s invalid.\n", file );
+		return -1;
+	}
+	for( l = 0; l < h->levels; ++l ) {
+		u64 texels = ( u64 ) VT_PAGE_TEXELS << l;
+		vt->level_first[ l ] = vt->num_pages;
+		vt->num_pages += ( h->pages >> l ) * ( h->pages >> l );
+		vt->level_cols[ l ] = ( h->width + texels - 1 ) / texels;
+		vt->level_rows[ l ] = ( h->height + texels - 1 ) / texels;
+		vt->level_offset[ l ] = offset;
+		offset += ( u64 ) vt->level_cols[ l ] * vt->level_rows[ l ]
+			* VT_PAGE_BYTES;
+		vt_reset_dirty( vt, l );
+	}
+	fseeko( vt->fh, 0, SEEK_END );
+	size = ftello( vt->fh );
+
+	if( size < offset ) {
+		fprintf( stderr, "File length %llu of %s inconsistent, expected "
+			"%llu.\n", ( unsigned long long ) size, file,
+			( unsigned long long ) offset );
+		return -1;
+	}
+	vt->fb_width = ( width < VT_FEEDBACK_SCALE ) ? 1
+		: width / VT_FEEDBACK_SCALE;
+	vt->fb_height = ( height < VT_FEEDBACK_SCALE ) ? 1
+		: height / VT_FEEDBACK_SCALE;
+	vt->max_requests = vt->fb_width * vt->fb_height * h->levels;
+	vt->page_slots = calloc( vt->num_pages, sizeof( u16 ) );
+	vt->page_marked = calloc( vt->num_pages, sizeof( u32 ) );
+	vt->indirection = calloc( vt->num_pages, 4 );
+	vt->requests = malloc( vt->max_requests * sizeof( u32 ) );
+	vt->feedback = malloc( vt->fb_width * vt->fb_height * 4 * sizeof( u16 ) );
+	vt->page_data = malloc( VT_PAGE_BYTES );
+
+	if( !vt->page_slots || !vt->page_marked || !vt->indirection
+		|| !vt->requests || !vt->feedback || !vt->page_data )
+	{
+		fprintf( stderr, "Out of memory for %u virtual pages.\n",
+			vt->num_pages );
+		return -1;
+	}
+	for( l = 0; l < VT_CACHE_SLOTS * VT_CACHE_SLOTS; ++l ) {
+		vt->slots[ l ].page = VT_PINNED;
+	}
+	glGenTextures( 1, &vt->cache_tex );
+	glBindTexture( GL_TEXTURE_2D, vt->cache_tex );
+	glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, cache, cache, 0, GL_RGBA,
+		GL_UNSIGNED_BYTE, 0 );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0 );
+
+	glGenTextures( 1, &vt->indirection_tex );
+	glBindTexture( GL_TEXTURE_2D, vt->indirection_tex );
+	for( l = 0; l < h->levels; ++l ) {
+		glTexImage2D( GL_TEXTURE_2D, l, GL_RGBA8, h->pages >> l,
+			h->pages >> l, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0 );
+	}
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+		GL_NEAREST_MIPMAP_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+	glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, h->levels - 1 );
+	glBindTexture( GL_TEXTURE_2D, 0 );
+
+	glGetIntegerv( GL_FRAMEBUFFER_BINDING, &target_fbo );
+	glGenRenderbuffers( 1, &vt->color_rb );
+	glBindRenderbuffer( GL_RENDERBUFFER, vt->color_rb );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA16UI, vt->fb_width,
+		vt->fb_height );
+	glGenRenderbuffers( 1, &vt->depth_rb );
+	glBindRenderbuffer( GL_RENDERBUFFER, vt->depth_rb );
+	glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+		vt->fb_width, vt->fb_height );
+	glBindRenderbuffer( GL_RENDERBUFFER, 0 );
+	glGenFramebuffers( 1, &vt->fbo );
+	glBindFramebuffer( GL_FRAMEBUFFER, vt->fbo );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_RENDERBUFFER, vt->color_rb );
+	glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+		GL_RENDERBUFFER, vt->depth_rb );
+
+	if( GL_FRAMEBUFFER_COMPLETE != glCheckFramebufferStatus( GL_FRAMEBUFFER ) ) {
+		fprintf( stderr, "Error: virtual texture feedback FBO incomplete!\n" );
+		glBindFramebuffer( GL_FRAMEBUFFER, target_fbo );
+		return -1;
+	}
+	glBindFramebuffer( GL_FRAMEBUFFER, target_fbo );
+
+	glGenBuffers( 1, &vt->pbo );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, vt->pbo );
+	glBufferData( GL_PIXEL_PACK_BUFFER,
+		vt->fb_width * vt->fb_height * 4 * sizeof( u16 ), 0, GL_STREAM_READ );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+
+	vt->frame = 1;
+	if( vt_load_page( vt, vt->level_first[ h->levels - 1 ], 0 ) < 0 ) {
+		return -1;
+	}
+	vt->slots[ 0 ].last_used = VT_PINNED;
+	vt_upload_indirection( vt );
+	return 0;
+}
+
+/*! Reads back the feedback of the last frame, loads up to VT_UPLOADS
+	missing pages, coarse ones first, and uploads the changed indirection. */
+void vt_update( Virtual_Texture *vt ) {
+	u32 i, n = vt->fb_width * vt->fb_height;
+
+	vt->frame++;
+	vt->num_requests = 0;
+
+	if( vt->feedback_pending ) {
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, vt->pbo );
+		glGetBufferSubData( GL_PIXEL_PACK_BUFFER, 0, n * 4 * sizeof( u16 ),
+			vt->feedback );
+		glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+		vt->feedback_pending = 0;
+
+		for( i = 0; i < n; ++i ) {
+			const u16 *f = vt->feedback + 4 * i;
+			if( f[ 3 ] ) {
+				vt_mark( vt, f[ 2 ], f[ 0 ], f[ 1 ] );
+			}
+		}
+	}
+	qsort( vt->requests, vt->num_requests, sizeof( u32 ), vt_compare_pages );
+
+	for( i = 0; i < vt->num_requests && i < VT_UPLOADS; ++i ) {
+		int slot = vt_find_slot( vt );
+		if( slot < 0 ) {
+			break;
+		}
+		vt_evict( vt, slot );
+		if( vt_load_page( vt, vt->requests[ i ], slot ) < 0 ) {
+			break;
+		}
+		vt->slots[ slot ].last_used = vt->frame;
+	}
+	vt_upload_indirection( vt );
+}
+
+static void vt_set_uniforms( const Virtual_Texture *vt, const Shader *p,
+	float lod_bias )
+{
+	const s16 *uni_loc = p->uniform_locations;
+	float texels = ( float ) vt->header.pages * VT_PAGE_TEXELS;
+
+	glUniform2f( uni_loc[ ULOC_SCALE ], vt->header.width / texels,
+		vt->header.height / texels );
+	glUniform4f( uni_loc[ ULOC_VT_PARAMS ], texels,
+		( float ) vt->header.pages, ( float ) ( vt->header.levels - 1 ),
+		lod_bias );
+}
+
+/*! Renders into the feedback FBO with p until vt_end_feedback, the caller
+	sets the matrices and draws. The pass runs at 1 / VT_FEEDBACK_SCALE of
+	the size, the level of detail is biased to match the full size. */
+void vt_begin_feedback( Virtual_Texture *vt, const Shader *p ) {
+	const GLuint none[ 4 ] = { 0, 0, 0, 0 };
+	GLint target_fbo;
+
+	glGetIntegerv( GL_FRAMEBUFFER_BINDING, &target_fbo );
+	vt->target_fbo = target_fbo;
+	glBindFramebuffer( GL_FRAMEBUFFER, vt->fbo );
+	glViewport( 0, 0, vt->fb_width, vt->fb_height );
+	glClearBufferuiv( GL_COLOR, 0, none );
+	glClear( GL_DEPTH_BUFFER_BIT );
+	glUseProgram( p->program_id );
+	vt_set_uniforms( vt, p, -log2f( VT_FEEDBACK_SCALE ) );
+}
+
+/*! Starts the read back of the feedback into the PBO, vt_update reads it
+	in the next frame. Restores the framebuffer and a width x height
+	viewport. */
+void vt_end_feedback( Virtual_Texture *vt, int width, int height ) {
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, vt->pbo );
+	glReadPixels( 0, 0, vt->fb_width, vt->fb_height, GL_RGBA_INTEGER,
+		GL_UNSIGNED_SHORT, 0 );
+	glBindBuffer( GL_PIXEL_PACK_BUFFER, 0 );
+	vt->feedback_pending = 1;
+	glBindFramebuffer( GL_FRAMEBUFFER, vt->target_fbo );
+	glViewport( 0, 0, width, height );
+}
+
+/*! Binds the cache to unit 0 and the indirection to unit 1 for p, which
+	uses vt_fragment_shader. */
+void vt_bind( const Virtual_Texture *vt, const Shader *p ) {
+	const s16 *uni_loc = p->uniform_locations;
+
+	glActiveTexture( GL_TEXTURE1 );
+	glBindTexture( GL_TEXTURE_2D, vt->indirection_tex );
+	glActiveTexture( GL_TEXTURE0 );
+	glBindTexture( GL_TEXTURE_2D, vt->cache_tex );
+	glUniform1i( uni_loc[ ULOC_TEXTURE0 ], 0 );
+	glUniform1i( uni_loc[ ULOC_TEXTURE1 ], 1 );
+	glUniform4f( uni_loc[ ULOC_VT_CACHE ], 1.0f / VT_CACHE_SLOTS,
+		1.0f / VT_CACHE_SLOTS, ( float ) VT_BORDER / VT_SLOT_TEXELS,
+		( float ) VT_PAGE_TEXELS / VT_SLOT_TEXELS );
+	vt_set_uniforms( vt, p, 0.0f );
+}
+
+void vt_summary( const Virtual_Texture *vt, FILE *out ) {
+	fprintf( out, "virtual texture: %u x %u, %u of %u pages resident, "
+		"%u uploads, %u evictions\n", vt->header.width, vt->header.height,
+		vt->resident, VT_CACHE_SLOTS * VT_CACHE_SLOTS, vt->uploads,
+		vt->evictions );
+}
+
+void vt_free( Virtual_Texture *vt ) {
+	if( vt->cache_tex ) {
+		glDeleteTextures( 1, &vt->cache_tex );
+		glDeleteTextures( 1, &vt->indirection_tex );
+	}
+	if( vt->fbo ) {
+		glDeleteFramebuffers( 1, &vt->fbo );
+	}
+	if( vt->color_rb ) {
+		glDeleteRenderbuffers( 1, &vt->color_rb );
+		glDeleteRenderbuffers( 1, &vt->depth_rb );
+	}
+	if( vt->pbo ) {
+		glDeleteBuffers( 1, &vt->pbo );
+	}
+	if( vt->fh ) {
+		fclose( vt->fh );
+	}
+	free( vt->page_slots );
+	free( vt->page_marked );
+	free( vt->indirection );
+	free( vt->requests );
+	free( vt->feedback );
+	free( vt->page_data );
+	memset( vt, 0, sizeof( Virtual_Texture ) );
+}
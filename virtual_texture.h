@@ -0,0 +1,71 @@
+#ifndef CTOOL_VIRTUAL_TEXTURE
+#define CTOOL_VIRTUAL_TEXTURE
+
+#include <stdio.h>
+#include "types.h"
+
+#define VT_MAGIC			(0x31305456U)	/* "VT01" */
+#define VT_PAGE_TEXELS		(128U)	/* Payload of a page per side. */
+#define VT_BORDER			(1U)	/* Texels of the neighbours for bilinear. */
+#define VT_SLOT_TEXELS		(VT_PAGE_TEXELS + 2U * VT_BORDER)
+#define VT_PAGE_BYTES		(VT_SLOT_TEXELS * VT_SLOT_TEXELS * 4U)
+#define VT_CACHE_SLOTS		(16U)	/* Per side, the cache holds 256 pages. */
+#define VT_MAX_LEVELS		(11U)	/* 1024 pages, 128k texels per side. */
+#define VT_FEEDBACK_SCALE	(8U)	/* Feedback pass at 1 / 8 of the size. */
+#define VT_UPLOADS			(8U)	/* Pages read and uploaded per frame. */
+#define VT_PINNED			(0xFFFFFFFFU)
+
+typedef struct { /*! Header of a page file written by tools/vt_tile. The
+	image sits in the corner of a square virtual texture of pages *
+	VT_PAGE_TEXELS texels per side, only the pages covering the image are
+	stored. Level l has
+	ceil( width / ( VT_PAGE_TEXELS << l ) ) columns, the pages follow the
+	header level by level, row by row, VT_SLOT_TEXELS squared RGBA8 each,
+	borders included. */
+	u32 magic;
+	u32 width, height;		/*! Source image. */
+	u32 page_texels;		/*! VT_PAGE_TEXELS */
+	u32 border;				/*! VT_BORDER */
+	u32 pages;				/*! Per side of level 0, a power of 2. */
+	u32 levels;				/*! log2( pages ) + 1, the last one is 1 page. */
+	u32 pad_unused;
+} VT_Header;
+
+typedef struct { /*! One page of the physical cache texture. */
+	u32 page;				/*! Virtual page held, VT_PINNED if empty. */
+	u32 last_used;			/*! Frame of the last request, VT_PINNED never
+								gets evicted. */
+} VT_Slot;
+
+typedef struct { /*! Pages of a huge image streamed into a fixed cache
+	texture. A feedback pass at low resolution writes the page every pixel
+	needs, the pages read back one frame later are loaded, least recently
+	used ones are evicted. The indirection texture has one texel per
+	virtual page and a mip-map level per page level, it points to the slot
+	of the page or of its closest resident parent. */
+	VT_Header header;
+	FILE *fh;
+	u32 level_first[ VT_MAX_LEVELS ];	/*! First virtual page of a level. */
+	u32 level_cols[ VT_MAX_LEVELS ];	/*! Stored pages of a level. */
+	u32 level_rows[ VT_MAX_LEVELS ];
+	u64 level_offset[ VT_MAX_LEVELS ];	/*! In the file. */
+	u32 num_pages;						/*! Virtual pages of all levels. */
+	u16 *page_slots;		/*! Per virtual page, slot + 1 or 0. */
+	u32 *page_marked;		/*! Frame the page was last requested. */
+	u8 *indirection;		/*! RGBA8 per virtual page: slot x, y, level. */
+	u32 dirty[ VT_MAX_LEVELS ][ 4 ];	/*! x0, y0, x1, y1 not uploaded. */
+	VT_Slot slots[ VT_CACHE_SLOTS * VT_CACHE_SLOTS ];
+	u32 *requests, num_requests;		/*! Missing pages of the frame. */
+	u32 max_requests;
+	u8 *page_data;			/*! One page read from the file. */
+	u32 cache_tex, indirection_tex;
+	u32 fbo, color_rb, depth_rb, pbo;
+	int fb_width, fb_height;
+	u16 *feedback;			/*! RGBA16UI: page x, y, level, valid. */
+	int feedback_pending;	/*! The PBO holds the last feedback pass. */
+	s32 target_fbo;			/*! Bound before the feedback pass. */
+	u32 frame;
+	u32 resident, uploads, evictions;
+} Virtual_Texture;
+
+#endif /* CTOOL_VIRTUAL_TEXTURE */